@@ -0,0 +1,13 @@
+#ifndef BenchUtilities_hpp
+#define BenchUtilities_hpp
+
+#include <chrono>
+
+// Shared by the benchmarks, header only so each target stays one file.
+inline double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+#endif
@@ -0,0 +1,178 @@
+// Builds a BVH over one million bounding spheres scattered on a large
+// terrain, then compares frustum culling and ray casts through it against
+// a loop over every sphere. Also times refitting after a hundredth of the
+// spheres move, and how many such frames pass before the tree degrades
+// enough to want a rebuild. No device is needed.
+//
+// Usage: bvhBench [spheres]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtilities.hpp"
+#include "Bvh.hpp"
+
+namespace
+{
+const int FRAMES = 20;
+const int RAYS = 10000;
+// Rays also cast through the flat loop, which is slow.
+const int CHECKED_RAYS = 100;
+const float WORLD_SIZE = 4000.0f;
+const float FAR = 1000.0f;
+
+size_t cullFlat(const Frustum &frustum, const std::vector<glm::vec4> &bounds)
+{
+    size_t visible = 0;
+    for (const glm::vec4 &sphere : bounds)
+    {
+        visible += frustum.intersectsSphere(glm::vec3(sphere), sphere.w) ? 1 : 0;
+    }
+    return visible;
+}
+
+bool raycastFlat(const Ray &ray, const std::vector<glm::vec4> &bounds, BvhHit &hit)
+{
+    bool found = false;
+    for (uint32_t i = 0; i < bounds.size(); i++)
+    {
+        float distance;
+        if (ray.intersectsSphere(glm::vec3(bounds[i]), bounds[i].w, FAR, distance) && (!found || distance < hit.distance))
+        {
+            found = true;
+            hit.item = i;
+            hit.distance = distance;
+        }
+    }
+    return found;
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    if (count == 0)
+    {
+        std::cerr << "Usage: bvhBench [spheres]" << std::endl;
+        return 1;
+    }
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> positions(-0.5f * WORLD_SIZE, 0.5f * WORLD_SIZE);
+    std::uniform_real_distribution<float> heights(0.0f, 20.0f);
+    std::uniform_real_distribution<float> radii(0.5f, 3.0f);
+    std::uniform_real_distribution<float> steps(-1.0f, 1.0f);
+
+    std::vector<glm::vec4> bounds(count);
+    for (auto &sphere : bounds)
+    {
+        sphere = glm::vec4(positions(generator), heights(generator), positions(generator), radii(generator));
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    Bvh bvh;
+    bvh.build(bounds);
+    double buildTime = millisecondsSince(start);
+
+    // Above the middle of the terrain, looking down at the horizon.
+    glm::mat4 projection = glm::perspective(glm::radians(65.0f), 16.0f / 9.0f, 0.1f, FAR);
+    projection[1][1] *= -1.0f;
+    glm::vec3 eye(0.0f, 60.0f, 0.0f);
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(300.0f, 0.0f, 400.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::fromMatrix(projection * view);
+
+    double flatTime = 0.0;
+    double bvhTime = 0.0;
+    size_t flatVisible = 0;
+    std::vector<uint32_t> visible;
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        start = std::chrono::high_resolution_clock::now();
+        flatVisible = cullFlat(frustum, bounds);
+        flatTime += millisecondsSince(start) / FRAMES;
+
+        visible.clear();
+        start = std::chrono::high_resolution_clock::now();
+        bvh.cull(frustum, bounds, visible);
+        bvhTime += millisecondsSince(start) / FRAMES;
+    }
+    size_t bvhVisible = visible.size();
+
+    // Rays from the eye toward random points of the terrain.
+    std::vector<Ray> rays;
+    for (int i = 0; i < RAYS; i++)
+    {
+        glm::vec3 target(positions(generator) * 0.25f, 0.0f, positions(generator) * 0.25f);
+        rays.push_back(Ray(eye, target - eye));
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+    size_t hits = 0;
+    std::vector<BvhHit> bvhHits(RAYS);
+    for (int i = 0; i < RAYS; i++)
+    {
+        hits += bvh.raycast(rays[i], bounds, FAR, bvhHits[i]) ? 1 : 0;
+    }
+    double raycastTime = millisecondsSince(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    bool raysMatch = true;
+    for (int i = 0; i < CHECKED_RAYS; i++)
+    {
+        BvhHit hit;
+        bool found = raycastFlat(rays[i], bounds, hit);
+        raysMatch = raysMatch && found == (bvhHits[i].item != ~0u) && (!found || hit.item == bvhHits[i].item);
+    }
+    double flatRaycastTime = millisecondsSince(start) / CHECKED_RAYS * RAYS;
+
+    // A hundredth of the spheres wander each frame, the same ones.
+    std::vector<uint32_t> moving;
+    for (uint32_t i = 0; i < count; i += 100)
+    {
+        moving.push_back(i);
+    }
+
+    double refitTime = 0.0;
+    int refits = 0;
+    while (!bvh.needsRebuild() && refits < 10000)
+    {
+        for (uint32_t item : moving)
+        {
+            bounds[item] += glm::vec4(steps(generator), 0.0f, steps(generator), 0.0f) * 4.0f;
+        }
+
+        start = std::chrono::high_resolution_clock::now();
+        bvh.refit(bounds, moving);
+        refitTime += millisecondsSince(start);
+        refits++;
+    }
+    float degradation = bvh.degradation();
+
+    // Refitted boxes still hold their spheres, culling stays exact.
+    visible.clear();
+    bvh.cull(frustum, bounds, visible);
+    bool refitMatches = visible.size() == cullFlat(frustum, bounds);
+
+    start = std::chrono::high_resolution_clock::now();
+    bvh.build(bounds);
+    double rebuildTime = millisecondsSince(start);
+
+    std::printf("%zu spheres, %zu nodes, built in %.1f ms\n", count, bvh.nodes().size(), buildTime);
+    std::printf("%-12s %10s %10s\n", "culling", "ms", "visible");
+    std::printf("%-12s %10.3f %10zu\n", "flat", flatTime, flatVisible);
+    std::printf("%-12s %10.3f %10zu\n", "bvh", bvhTime, bvhVisible);
+    std::printf("%d rays, %zu hits: bvh %.3f ms, flat %.1f ms estimated from %d rays\n",
+                RAYS, hits, raycastTime, flatRaycastTime, CHECKED_RAYS);
+    std::printf("refit of %zu moved spheres: %.3f ms, %d frames until %.2fx the built cost, rebuilt in %.1f ms\n",
+                moving.size(), refits > 0 ? refitTime / refits : 0.0, refits, degradation, rebuildTime);
+
+    if (bvhVisible != flatVisible || !raysMatch || !refitMatches)
+    {
+        std::cerr << "BVH queries differ from the flat loop." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
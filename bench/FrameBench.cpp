@@ -0,0 +1,453 @@
+// Renders a scene for a fixed number of frames along a scripted camera path,
+// an orbit around a point or a recorded input file, with a fixed time step
+// so every run sees the same frames. Per frame it times the renderer update,
+// the command buffer encoding, the queue submit, the present and the wait
+// for a free frame, and the GPU time of the frame and of each of its scopes
+// when the device has timestamps. Prints percentiles and a histogram of the
+// frame time, and writes the same numbers to a JSON file, one value per
+// line, to diff between runs.
+//
+// Usage: vulkanBench [--frames <count>] [--output <path>] [--size <width> <height>]
+//                    [--orbit <radius> <height>] [--replay <path>]
+//                    [--trace <path> <first frame> <frame count>]
+//                    [renderer flags]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+#include "BenchUtilities.hpp"
+#include "CpuProfiler.hpp"
+#include "Input.hpp"
+#include "Renderer.hpp"
+#include "Swapchain.hpp"
+#include "VulkanUtilities.hpp"
+
+namespace
+{
+// Seconds each frame advances, whatever it really took.
+const double STEP = 1.0 / 60.0;
+// Pipeline compilation and the first streamed cells, left out of the stats.
+const uint32_t WARMUP_FRAMES = 30;
+const uint32_t HISTOGRAM_BINS = 20;
+// Characters of the longest histogram bar.
+const uint32_t HISTOGRAM_WIDTH = 50;
+
+struct BenchSettings
+{
+    uint32_t frames = 1000;
+    std::string outputPath = "bench_results.json";
+    int width = 1280;
+    int height = 720;
+    // Around the origin, looking at ORBIT_TARGET, one turn over the run.
+    float orbitRadius = 6.0f;
+    float orbitHeight = 3.0f;
+    // Recorded input instead of the orbit.
+    std::string replayPath;
+    // CPU trace of frames [traceFirst, traceFirst + traceFrames).
+    std::string tracePath;
+    uint32_t traceFirst = 0;
+    uint32_t traceFrames = 0;
+    RendererSettings renderer;
+};
+
+const glm::vec3 ORBIT_TARGET = glm::vec3(0.0f, 1.0f, 0.0f);
+
+// Milliseconds per frame of one part of it.
+struct Metric
+{
+    std::string name;
+    std::vector<double> samples;
+};
+
+struct Summary
+{
+    size_t count = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+Summary summarize(std::vector<double> samples)
+{
+    Summary summary;
+    if (samples.empty())
+    {
+        return summary;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double total = 0.0;
+    for (double sample : samples)
+    {
+        total += sample;
+    }
+
+    size_t count = samples.size();
+    summary.count = count;
+    summary.mean = total / count;
+    summary.p50 = samples[count / 2];
+    summary.p90 = samples[count * 90 / 100];
+    summary.p99 = samples[count * 99 / 100];
+    summary.max = samples.back();
+    return summary;
+}
+
+// Equal bins from the fastest to the slowest sample.
+std::vector<uint32_t> histogram(const std::vector<double> &samples, double &first, double &width)
+{
+    std::vector<uint32_t> counts(HISTOGRAM_BINS, 0);
+    if (samples.empty())
+    {
+        first = 0.0;
+        width = 0.0;
+        return counts;
+    }
+
+    auto range = std::minmax_element(samples.begin(), samples.end());
+    first = *range.first;
+    width = std::max((*range.second - first) / HISTOGRAM_BINS, 1e-6);
+    for (double sample : samples)
+    {
+        size_t bin = static_cast<size_t>((sample - first) / width);
+        counts[std::min(bin, counts.size() - 1)]++;
+    }
+    return counts;
+}
+
+std::string jsonString(const std::string &text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void report(const BenchSettings &settings, const std::vector<Metric> &metrics, const Metric &frame)
+{
+    std::printf("%-24s %8s %8s %8s %8s %8s   (ms, %zu frames)\n", "", "mean", "p50", "p90", "p99", "max", frame.samples.size());
+    for (const Metric &metric : metrics)
+    {
+        if (metric.samples.empty())
+        {
+            std::printf("%-24s %8s\n", metric.name.c_str(), "n/a");
+            continue;
+        }
+
+        Summary summary = summarize(metric.samples);
+        std::printf(
+            "%-24s %8.3f %8.3f %8.3f %8.3f %8.3f\n",
+            metric.name.c_str(), summary.mean, summary.p50, summary.p90, summary.p99, summary.max);
+    }
+
+    double first;
+    double width;
+    std::vector<uint32_t> counts = histogram(frame.samples, first, width);
+    uint32_t highest = std::max(*std::max_element(counts.begin(), counts.end()), 1u);
+    std::printf("\nFrame time histogram:\n");
+    for (size_t bin = 0; bin < counts.size(); bin++)
+    {
+        std::string bar(counts[bin] * HISTOGRAM_WIDTH / highest, '#');
+        std::printf(
+            "%8.3f - %8.3f ms %6u %s\n",
+            first + bin * width, first + (bin + 1) * width, counts[bin], bar.c_str());
+    }
+
+    std::ofstream file(settings.outputPath);
+    if (!file)
+    {
+        throw std::runtime_error("Unable to write bench results " + settings.outputPath + ".");
+    }
+
+    file << std::fixed << std::setprecision(4);
+    file << "{\n";
+    file << "  \"scene\": " << jsonString(settings.renderer.scenePath) << ",\n";
+    file << "  \"path\": " << jsonString(settings.replayPath.empty() ? "orbit" : settings.replayPath) << ",\n";
+    file << "  \"width\": " << settings.width << ",\n";
+    file << "  \"height\": " << settings.height << ",\n";
+    file << "  \"frames\": " << frame.samples.size() << ",\n";
+    file << "  \"warmup\": " << WARMUP_FRAMES << ",\n";
+    file << "  \"metrics\": {\n";
+    for (size_t i = 0; i < metrics.size(); i++)
+    {
+        Summary summary = summarize(metrics[i].samples);
+        file << "    " << jsonString(metrics[i].name) << ": {\n";
+        file << "      \"count\": " << summary.count << ",\n";
+        file << "      \"mean\": " << summary.mean << ",\n";
+        file << "      \"p50\": " << summary.p50 << ",\n";
+        file << "      \"p90\": " << summary.p90 << ",\n";
+        file << "      \"p99\": " << summary.p99 << ",\n";
+        file << "      \"max\": " << summary.max << "\n";
+        file << "    }" << (i + 1 < metrics.size() ? "," : "") << "\n";
+    }
+    file << "  },\n";
+    file << "  \"histogram\": {\n";
+    file << "    \"metric\": " << jsonString(frame.name) << ",\n";
+    file << "    \"first\": " << first << ",\n";
+    file << "    \"width\": " << width << ",\n";
+    file << "    \"counts\": [\n";
+    for (size_t bin = 0; bin < counts.size(); bin++)
+    {
+        file << "      " << counts[bin] << (bin + 1 < counts.size() ? "," : "") << "\n";
+    }
+    file << "    ]\n";
+    file << "  }\n";
+    file << "}\n";
+
+    std::cout << "\nResults written to " << settings.outputPath << "." << std::endl;
+}
+
+void parseArguments(int argc, char **argv, BenchSettings &settings)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (settings.renderer.parseArgument(argc, argv, i))
+        {
+            continue;
+        }
+
+        std::string argument = argv[i];
+        if (argument == "--frames" && i + 1 < argc)
+        {
+            settings.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (argument == "--output" && i + 1 < argc)
+        {
+            settings.outputPath = argv[++i];
+        }
+        else if (argument == "--size" && i + 2 < argc)
+        {
+            settings.width = std::stoi(argv[++i]);
+            settings.height = std::stoi(argv[++i]);
+        }
+        else if (argument == "--orbit" && i + 2 < argc)
+        {
+            settings.orbitRadius = std::stof(argv[++i]);
+            settings.orbitHeight = std::stof(argv[++i]);
+        }
+        else if (argument == "--replay" && i + 1 < argc)
+        {
+            settings.replayPath = argv[++i];
+        }
+        else if (argument == "--trace" && i + 3 < argc)
+        {
+            settings.tracePath = argv[++i];
+            settings.traceFirst = static_cast<uint32_t>(std::stoul(argv[++i]));
+            settings.traceFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else
+        {
+            throw std::runtime_error("Unknown argument " + argument + ".");
+        }
+    }
+
+    if (settings.frames <= WARMUP_FRAMES || settings.width <= 0 || settings.height <= 0)
+    {
+        throw std::runtime_error("Unable to bench, more frames than the warmup and a size are needed.");
+    }
+}
+
+// Scopes are named after their parents, "gpu/scene/shading".
+void addGpuSamples(const std::vector<GpuScopeTime> &scopes, std::vector<Metric> &metrics)
+{
+    std::vector<std::string> path;
+    for (const GpuScopeTime &scope : scopes)
+    {
+        path.resize(scope.depth);
+        path.push_back(scope.depth == 0 ? "gpu" : path.back() + "/" + scope.name);
+
+        auto metric = std::find_if(metrics.begin(), metrics.end(), [&](const Metric &candidate) {
+            return candidate.name == path.back();
+        });
+        if (metric == metrics.end())
+        {
+            metric = metrics.insert(metrics.end(), Metric{path.back()});
+        }
+        metric->samples.push_back(scope.milliseconds);
+    }
+}
+
+void resizeCallback(GLFWwindow *window, int width, int height)
+{
+    Input::instance().resizeEvent(width, height);
+}
+
+void run(const BenchSettings &settings)
+{
+    if (!glfwInit())
+    {
+        throw std::runtime_error("Unable to initialize GLFW.");
+    }
+
+    // A fixed size, runs stay comparable. No key or mouse callbacks, the
+    // path alone moves the camera.
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(settings.width, settings.height, "vulkanBench", nullptr, nullptr);
+    if (!window)
+    {
+        throw std::runtime_error("Unable to create GLFW window.");
+    }
+    glfwSetFramebufferSizeCallback(window, resizeCallback);
+
+    int width;
+    int height;
+    glfwGetFramebufferSize(window, &width, &height);
+
+    // Validation would dominate the CPU times.
+    VkInstance instance;
+    VulkanUtilities::createInstance(instance, false);
+    VkSurfaceKHR surface;
+    if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create window surface.");
+    }
+
+    Swapchain swapchain;
+    swapchain.offscreen = settings.renderer.dynamicResolution;
+    swapchain.deferred = settings.renderer.deferred && !settings.renderer.gpuDriven;
+    swapchain.init(instance, surface, width, height);
+
+    if (!settings.replayPath.empty())
+    {
+        Input::instance().startReplay(settings.replayPath);
+    }
+    Input::instance().resizeEvent(width, height);
+
+    Renderer renderer;
+    renderer.init(swapchain, width, height, settings.renderer);
+
+    CpuProfiler::instance().setThreadName("main");
+    if (!settings.tracePath.empty())
+    {
+        CpuProfiler::instance().capture(settings.tracePath, settings.traceFrames, settings.traceFirst);
+    }
+
+    Metric update = {"update"};
+    Metric encode = {"encode"};
+    Metric submit = {"submit"};
+    Metric present = {"present"};
+    // Fence and image acquire, the GPU or the display holding the CPU back.
+    Metric wait = {"wait"};
+    Metric frame = {"frame"};
+    // The GPU frame, then its scopes by path, in the order they appeared.
+    std::vector<Metric> gpu;
+
+    VkRenderPassBeginInfo renderPassInfo;
+    for (uint32_t i = 0; i < settings.frames && !glfwWindowShouldClose(window); i++)
+    {
+        if (Input::instance().isReplaying() && Input::instance().replayFinished())
+        {
+            break;
+        }
+
+        CpuProfiler::instance().endFrame();
+        CpuScope frameScope("frame");
+
+        auto frameStart = std::chrono::high_resolution_clock::now();
+        Input::instance().update(STEP);
+
+        if (settings.replayPath.empty())
+        {
+            float angle = glm::radians(360.0f * i / settings.frames);
+            glm::vec3 position = ORBIT_TARGET + glm::vec3(
+                settings.orbitRadius * std::cos(angle),
+                settings.orbitHeight,
+                settings.orbitRadius * std::sin(angle));
+            renderer.camera().lookAt(position, ORBIT_TARGET);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        renderer.update(STEP);
+        double updateTime = millisecondsSince(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        VkResult status = swapchain.run(renderPassInfo);
+        double waitTime = millisecondsSince(start);
+
+        double presentTime = 0.0;
+        if (status == VK_SUCCESS || status == VK_SUBOPTIMAL_KHR)
+        {
+            renderer.encode(
+                swapchain.graphicsQueue,
+                swapchain.imageIndex,
+                swapchain.getCommandBuffer(),
+                renderPassInfo,
+                swapchain.getStartSemaphore(),
+                swapchain.getEndSemaphore(),
+                swapchain.getFence());
+
+            start = std::chrono::high_resolution_clock::now();
+            swapchain.commit();
+            presentTime = millisecondsSince(start);
+        }
+
+        bool resized = Input::instance().isResized() || (status != VK_SUCCESS && status != VK_SUBOPTIMAL_KHR);
+        if (resized)
+        {
+            glfwGetFramebufferSize(window, &width, &height);
+            swapchain.resize(width, height);
+            renderer.resize(swapchain, width, height);
+        }
+
+        swapchain.step();
+
+        // A frame that resized or rendered nothing says little.
+        if (i < WARMUP_FRAMES || resized)
+        {
+            continue;
+        }
+
+        const FrameTimings &timings = renderer.frameTimings();
+        update.samples.push_back(updateTime);
+        encode.samples.push_back(timings.encode);
+        submit.samples.push_back(timings.submit);
+        present.samples.push_back(presentTime);
+        wait.samples.push_back(waitTime);
+        frame.samples.push_back(millisecondsSince(frameStart));
+        addGpuSamples(renderer.gpuProfiler().results(), gpu);
+    }
+
+    vkDeviceWaitIdle(swapchain.device);
+    renderer.clean();
+    swapchain.clean();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    if (frame.samples.empty())
+    {
+        throw std::runtime_error("Unable to bench, no frame was rendered after the warmup.");
+    }
+
+    std::vector<Metric> metrics = {update, encode, submit, present, wait, frame};
+    metrics.insert(metrics.end(), gpu.begin(), gpu.end());
+    report(settings, metrics, frame);
+}
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        BenchSettings settings;
+        parseArguments(argc, argv, settings);
+        run(settings);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
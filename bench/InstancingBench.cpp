@@ -0,0 +1,152 @@
+// Compares the draw count and CPU cost of one draw per object against
+// the instanced groups built by InstanceBatcher. No device is needed,
+// the command stream is counted rather than recorded.
+//
+// Usage: instancingBench [objects] [meshes] [materials]
+
+#include <cstdlib>
+#include <cstdio>
+#include <random>
+
+#include "BenchUtilities.hpp"
+#include "InstanceBatcher.hpp"
+#include "TransformUtilities.hpp"
+
+namespace
+{
+const int FRAMES = 200;
+
+struct BenchObject
+{
+    uint32_t mesh;
+    uint32_t features;
+    glm::mat4 model;
+};
+
+// What the per-object path recorded: pipeline, vertex buffer, index buffer,
+// push constant and draw, with binds skipped when unchanged.
+struct CommandCount
+{
+    size_t draws = 0;
+    size_t commands = 0;
+};
+
+CommandCount recordPerObject(const std::vector<BenchObject> &objects, const std::vector<glm::mat4> &modelViewProjections, std::vector<glm::mat4> &pushed)
+{
+    CommandCount count;
+    uint32_t boundFeatures = UINT32_MAX;
+    uint32_t boundMesh = UINT32_MAX;
+
+    pushed.clear();
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        if (objects[i].features != boundFeatures)
+        {
+            boundFeatures = objects[i].features;
+            count.commands++;
+        }
+        if (objects[i].mesh != boundMesh)
+        {
+            boundMesh = objects[i].mesh;
+            count.commands += 2;
+        }
+
+        pushed.push_back(modelViewProjections[i]);
+        count.commands += 2;
+        count.draws++;
+    }
+
+    return count;
+}
+
+CommandCount recordBatched(InstanceBatcher &batcher, const std::vector<BenchObject> &objects, const std::vector<glm::mat4> &modelViewProjections)
+{
+    batcher.clear();
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        InstanceData instance;
+        instance.modelViewProjection = modelViewProjections[i];
+        instance.model = objects[i].model;
+        batcher.add(DrawKey::make(objects[i].features, 0, objects[i].mesh, 0.0f), instance);
+    }
+    batcher.build();
+
+    // Vertex, instance and index buffers are bound once.
+    CommandCount count;
+    count.commands = 2;
+
+    uint32_t boundFeatures = UINT32_MAX;
+    for (auto &group : batcher.groups())
+    {
+        if (group.features != boundFeatures)
+        {
+            boundFeatures = group.features;
+            count.commands++;
+        }
+
+        count.commands++;
+        count.draws++;
+    }
+
+    return count;
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t objectCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    uint32_t meshCount = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 16;
+    uint32_t materialCount = argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 4;
+
+    if (objectCount == 0 || meshCount == 0 || materialCount == 0)
+    {
+        std::cerr << "Usage: instancingBench [objects] [meshes] [materials]" << std::endl;
+        return 1;
+    }
+
+    // Shuffled submission order, the worst case for bind skipping.
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<uint32_t> meshes(0, meshCount - 1);
+    std::uniform_int_distribution<uint32_t> materials(0, materialCount - 1);
+    std::uniform_real_distribution<float> positions(-100.0f, 100.0f);
+
+    std::vector<BenchObject> objects(objectCount);
+    std::vector<glm::mat4> models(objectCount);
+    for (size_t i = 0; i < objectCount; i++)
+    {
+        objects[i].mesh = meshes(generator);
+        objects[i].features = materials(generator);
+        objects[i].model = glm::translate(glm::mat4(1.0f), glm::vec3(positions(generator), 0.0f, positions(generator)));
+        models[i] = objects[i].model;
+    }
+
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+    std::vector<glm::mat4> modelViewProjections(objectCount);
+    TransformUtilities::multiplyBatch(viewProjection, models.data(), modelViewProjections.data(), objectCount);
+
+    std::vector<glm::mat4> pushed;
+    pushed.reserve(objectCount);
+    CommandCount perObject;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        perObject = recordPerObject(objects, modelViewProjections, pushed);
+    }
+    double perObjectTime = millisecondsSince(start) / FRAMES;
+
+    InstanceBatcher batcher;
+    CommandCount batched;
+    start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        batched = recordBatched(batcher, objects, modelViewProjections);
+    }
+    double batchedTime = millisecondsSince(start) / FRAMES;
+
+    std::printf("%zu objects, %u meshes, %u materials, %d frames\n", objectCount, meshCount, materialCount, FRAMES);
+    std::printf("%-12s %10s %10s %12s\n", "path", "draws", "commands", "cpu ms/frame");
+    std::printf("%-12s %10zu %10zu %12.3f\n", "per object", perObject.draws, perObject.commands, perObjectTime);
+    std::printf("%-12s %10zu %10zu %12.3f\n", "instanced", batched.draws, batched.commands, batchedTime);
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Assigns a growing number of random point lights to the clusters of the
+// demo camera with the CPU version of cluster.comp. Reports the assignment
+// cost and how many lights a fragment loops over per cluster, against the
+// whole list a plain forward loop would walk. No device is needed.
+//
+// Usage: lightingBench [max lights]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtilities.hpp"
+#include "ClusterGrid.hpp"
+
+namespace
+{
+const int FRAMES = 10;
+
+// Same as Camera.
+const float FOV = 65.0f;
+const float NEAR = 0.01f;
+const float FAR = 100.0f;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t maxLights = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 16384;
+    if (maxLights == 0)
+    {
+        std::cerr << "Usage: lightingBench [max lights]" << std::endl;
+        return 1;
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(FOV), 16.0f / 9.0f, NEAR, FAR);
+    projection[1][1] *= -1.0f;
+    ClusterGrid grid = ClusterGrid::fromProjection(projection, NEAR, FAR);
+
+    // Lights scattered in front of the camera, already in view space.
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> depths(1.0f, 60.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> ranges(0.5f, 2.0f);
+
+    std::vector<glm::vec4> allLights(maxLights);
+    for (auto &light : allLights)
+    {
+        float depth = depths(generator);
+        glm::vec2 extent = glm::vec2(depth) / grid.projectionScale;
+        light = glm::vec4(unit(generator) * extent.x, unit(generator) * extent.y, -depth, ranges(generator));
+    }
+
+    std::printf("%ux%ux%u clusters, %d frames\n", ClusterGrid::COUNT_X, ClusterGrid::COUNT_Y, ClusterGrid::COUNT_Z, FRAMES);
+    std::printf("%8s %12s %10s %10s %10s %12s\n", "lights", "assign ms", "indices", "average", "max", "vs forward");
+
+    std::vector<ClusterRange> clusterRanges;
+    std::vector<uint32_t> indices;
+    for (uint32_t count = 256; count <= maxLights; count *= 2)
+    {
+        std::vector<glm::vec4> lights(allLights.begin(), allLights.begin() + count);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < FRAMES; frame++)
+        {
+            grid.assign(lights, clusterRanges, indices);
+        }
+        double assignTime = millisecondsSince(start) / FRAMES;
+
+        // Lights per fragment, over the clusters that have any.
+        uint32_t occupied = 0;
+        uint32_t most = 0;
+        for (auto &range : clusterRanges)
+        {
+            occupied += range.count > 0 ? 1 : 0;
+            most = std::max(most, range.count);
+        }
+        double average = occupied > 0 ? static_cast<double>(indices.size()) / occupied : 0.0;
+
+        std::printf("%8u %12.3f %10zu %10.1f %10u %11.1fx\n",
+                    count, assignTime, indices.size(), average, most, average > 0.0 ? count / average : 0.0);
+    }
+
+    return 0;
+}
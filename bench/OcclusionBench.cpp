@@ -0,0 +1,189 @@
+// Rasterizes the buildings of a generated city as occluders and tests
+// small props along the streets against them, from a camera at street
+// level. Reports the raster and test cost with one thread and with the
+// pool, and the share of props in the frustum that were culled. No device
+// is needed.
+//
+// Usage: occlusionBench [blocks per side] [props]
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtilities.hpp"
+#include "OcclusionRasterizer.hpp"
+#include "Frustum.hpp"
+
+namespace
+{
+const int FRAMES = 100;
+
+const float BLOCK_SIZE = 60.0f;
+const float STREET_WIDTH = 20.0f;
+const float BLOCK_PITCH = BLOCK_SIZE + STREET_WIDTH;
+
+// Unit box standing on the origin, buildings and props scale it.
+const glm::vec3 BOX_MIN(-0.5f, 0.0f, -0.5f);
+const glm::vec3 BOX_MAX(0.5f, 1.0f, 0.5f);
+
+struct Box
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+
+    Box()
+    {
+        for (int corner = 0; corner < 8; corner++)
+        {
+            positions.push_back(glm::vec3(
+                (corner & 1) ? BOX_MAX.x : BOX_MIN.x,
+                (corner & 2) ? BOX_MAX.y : BOX_MIN.y,
+                (corner & 4) ? BOX_MAX.z : BOX_MIN.z));
+        }
+
+        // Two triangles per face, corners indexed by their xyz bits.
+        const uint32_t faces[6][4] = {
+            {0, 2, 6, 4}, {1, 5, 7, 3}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 6, 7, 5}};
+        for (auto &face : faces)
+        {
+            uint32_t quad[6] = {face[0], face[1], face[2], face[0], face[2], face[3]};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+};
+
+glm::mat4 boxModel(const glm::vec3 &position, const glm::vec3 &size)
+{
+    return glm::scale(glm::translate(glm::mat4(1.0f), position), size);
+}
+
+glm::mat4 cameraViewProjection(const glm::vec3 &eye, const glm::vec3 &target)
+{
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.5f, 2000.0f);
+    projection[1][1] *= -1.0f;
+    return projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t blocks = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 16;
+    size_t propCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+
+    if (blocks == 0 || propCount == 0)
+    {
+        std::cerr << "Usage: occlusionBench [blocks per side] [props]" << std::endl;
+        return 1;
+    }
+
+    Box box;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> heights(10.0f, 80.0f);
+    std::uniform_real_distribution<float> propSizes(0.5f, 3.0f);
+    std::uniform_real_distribution<float> streetOffsets(-0.4f * STREET_WIDTH, 0.4f * STREET_WIDTH);
+    std::uniform_real_distribution<float> along(-STREET_WIDTH, blocks * BLOCK_PITCH);
+    std::uniform_int_distribution<uint32_t> streets(0, blocks);
+
+    // Four buildings per block.
+    std::vector<glm::mat4> buildings;
+    const float lot = BLOCK_SIZE * 0.5f;
+    for (uint32_t row = 0; row < blocks; row++)
+    {
+        for (uint32_t column = 0; column < blocks; column++)
+        {
+            for (int building = 0; building < 4; building++)
+            {
+                glm::vec3 position(
+                    column * BLOCK_PITCH + lot * (building & 1) + lot * 0.5f,
+                    0.0f,
+                    row * BLOCK_PITCH + lot * (building >> 1) + lot * 0.5f);
+                buildings.push_back(boxModel(position, glm::vec3(lot - 2.0f, heights(generator), lot - 2.0f)));
+            }
+        }
+    }
+
+    // Props along the streets, which run between the blocks.
+    std::vector<glm::mat4> props(propCount);
+    for (auto &prop : props)
+    {
+        float street = streets(generator) * BLOCK_PITCH - 0.5f * STREET_WIDTH + streetOffsets(generator);
+        float position = along(generator);
+        bool alongX = generator() & 1;
+        glm::vec3 center = alongX ? glm::vec3(position, 0.0f, street) : glm::vec3(street, 0.0f, position);
+        prop = boxModel(center, glm::vec3(propSizes(generator)));
+    }
+
+    // Street corner outside the city, looking across it.
+    float half = 0.5f * blocks * BLOCK_PITCH;
+    glm::mat4 viewProjection = cameraViewProjection(glm::vec3(-10.0f, 1.8f, -10.0f), glm::vec3(half, 1.8f, half));
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+    std::vector<glm::mat4> occluders(buildings.size());
+    for (size_t i = 0; i < buildings.size(); i++)
+    {
+        occluders[i] = viewProjection * buildings[i];
+    }
+
+    std::vector<glm::mat4> propTransforms;
+    for (auto &prop : props)
+    {
+        glm::vec3 center = glm::vec3(prop * glm::vec4(0.0f, 0.5f, 0.0f, 1.0f));
+        if (frustum.intersectsSphere(center, glm::length(glm::vec3(prop[0])) + glm::length(glm::vec3(prop[1]))))
+        {
+            propTransforms.push_back(viewProjection * prop);
+        }
+    }
+
+    ThreadPool pool;
+    OcclusionRasterizer rasterizer;
+
+    auto renderOccluders = [&](ThreadPool *threads) {
+        rasterizer.clear();
+        for (auto &occluder : occluders)
+        {
+            rasterizer.addOccluder(box.positions.data(), box.indices.data(), box.indices.size(), occluder);
+        }
+        rasterizer.render(threads);
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        renderOccluders(nullptr);
+    }
+    double singleTime = millisecondsSince(start) / FRAMES;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        renderOccluders(&pool);
+    }
+    double poolTime = millisecondsSince(start) / FRAMES;
+
+    size_t culled = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        culled = 0;
+        for (auto &transform : propTransforms)
+        {
+            if (!rasterizer.isVisible(BOX_MIN, BOX_MAX, transform))
+            {
+                culled++;
+            }
+        }
+    }
+    double testTime = millisecondsSince(start) / FRAMES;
+
+    std::printf("%u x %u blocks, %zu buildings, %zu props, %ux%u buffer, %s, %d frames\n",
+                blocks, blocks, buildings.size(), props.size(), rasterizer.width(), rasterizer.height(), OcclusionRasterizer::instructionSet(), FRAMES);
+    std::printf("occluder triangles after clipping  %zu\n", rasterizer.triangleCount());
+    std::printf("raster ms/frame, 1 thread          %.3f\n", singleTime);
+    std::printf("raster ms/frame, %2zu threads        %.3f\n", pool.size() + 1, poolTime);
+    std::printf("test ms/frame                      %.3f\n", testTime);
+    std::printf("props in frustum                   %zu\n", propTransforms.size());
+    std::printf("culled fraction                    %.3f\n", propTransforms.empty() ? 0.0 : static_cast<double>(culled) / propTransforms.size());
+
+    return 0;
+}
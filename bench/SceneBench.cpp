@@ -0,0 +1,247 @@
+// Runs the per frame CPU passes, transforms then bounds and frustum culling,
+// over one million entities. Once with the fat objects the renderer used to
+// keep, once with the dense arrays of Scene. Also times destroying and
+// recreating a tenth of the entities through their handles, and the
+// hierarchy update when part of the roots move. No device is needed.
+//
+// Usage: sceneBench [entities]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtilities.hpp"
+#include "Frustum.hpp"
+#include "Scene.hpp"
+#include "ThreadPool.hpp"
+#include "TransformUtilities.hpp"
+
+namespace
+{
+const int FRAMES = 20;
+const uint32_t MESHES = 16;
+// Children of each root in the hierarchy run.
+const uint32_t CHILDREN = 7;
+
+const std::string MODEL_PATH = "./resources/models/cube.obj";
+
+// Layout of the old Object: name, path, mesh, model and flags side by side.
+struct FatObject
+{
+    std::string name;
+    const std::string *path;
+    uint32_t mesh;
+    glm::mat4 model;
+    uint32_t features;
+    bool occluder;
+};
+
+struct PassTimes
+{
+    double transforms = 0.0;
+    double culling = 0.0;
+    size_t visible = 0;
+};
+
+// What the renderer did per frame with a vector of objects: gather the
+// models, multiply, then walk the objects again for bounds and culling.
+PassTimes runObjects(
+    const std::vector<FatObject> &objects,
+    const std::vector<MeshRange> &ranges,
+    const glm::mat4 &viewProjection,
+    std::vector<glm::mat4> &models,
+    std::vector<glm::mat4> &modelViewProjections)
+{
+    PassTimes times;
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    models.resize(objects.size());
+    modelViewProjections.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        models[i] = objects[i].model;
+    }
+    TransformUtilities::multiplyBatch(viewProjection, models.data(), modelViewProjections.data(), models.size());
+    times.transforms = millisecondsSince(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        glm::vec4 sphere = ranges[objects[i].mesh].boundingSphere(models[i]);
+        times.visible += frustum.intersectsSphere(glm::vec3(sphere), sphere.w) ? 1 : 0;
+    }
+    times.culling = millisecondsSince(start);
+
+    return times;
+}
+
+PassTimes runScene(
+    Scene &scene,
+    const std::vector<MeshRange> &ranges,
+    const glm::mat4 &viewProjection,
+    std::vector<glm::mat4> &modelViewProjections)
+{
+    PassTimes times;
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    modelViewProjections.resize(scene.size());
+    TransformUtilities::multiplyBatch(viewProjection, scene.models().data(), modelViewProjections.data(), scene.size());
+    times.transforms = millisecondsSince(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    scene.updateBounds(ranges);
+    const std::vector<glm::vec4> &bounds = scene.bounds();
+    for (size_t i = 0; i < bounds.size(); i++)
+    {
+        times.visible += frustum.intersectsSphere(glm::vec3(bounds[i]), bounds[i].w) ? 1 : 0;
+    }
+    times.culling = millisecondsSince(start);
+
+    return times;
+}
+
+// Moves every stride-th root, then updates the scene. Returns the update
+// time.
+double moveRoots(Scene &scene, const std::vector<EntityHandle> &roots, size_t stride, float offset, const std::vector<MeshRange> &ranges, ThreadPool *threadPool)
+{
+    for (size_t i = 0; i < roots.size(); i += stride)
+    {
+        scene.setPosition(roots[i], glm::vec3(static_cast<float>(i % 1000), offset, static_cast<float>(i / 1000)));
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    scene.updateTransforms(ranges, threadPool);
+    return millisecondsSince(start);
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t entityCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    if (entityCount == 0)
+    {
+        std::cerr << "Usage: sceneBench [entities]" << std::endl;
+        return 1;
+    }
+
+    // Unit spheres, whatever the mesh.
+    std::vector<MeshRange> ranges(MESHES);
+    for (auto &range : ranges)
+    {
+        range.min = glm::vec3(-0.5f);
+        range.max = glm::vec3(0.5f);
+        range.radius = 0.87f;
+    }
+
+    // Scattered around a camera looking down -z, about a third in view.
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<uint32_t> meshes(0, MESHES - 1);
+    std::uniform_real_distribution<float> positions(-500.0f, 500.0f);
+
+    std::vector<FatObject> objects(entityCount);
+    Scene scene;
+    scene.reserve(entityCount);
+    std::vector<EntityHandle> handles(entityCount);
+    for (size_t i = 0; i < entityCount; i++)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(positions(generator), 0.0f, positions(generator)));
+        uint32_t mesh = meshes(generator);
+
+        objects[i].name = "entity";
+        objects[i].path = &MODEL_PATH;
+        objects[i].mesh = mesh;
+        objects[i].model = model;
+        objects[i].features = FeaturesDefault;
+        objects[i].occluder = false;
+
+        handles[i] = scene.create("entity", mesh);
+        scene.setPosition(handles[i], glm::vec3(model[3]));
+    }
+    scene.updateTransforms(ranges, nullptr);
+
+    glm::mat4 viewProjection = glm::perspective(glm::radians(65.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    viewProjection[1][1] *= -1.0f;
+
+    std::vector<glm::mat4> models;
+    std::vector<glm::mat4> modelViewProjections;
+    PassTimes fat;
+    PassTimes dense;
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        PassTimes times = runObjects(objects, ranges, viewProjection, models, modelViewProjections);
+        fat.transforms += times.transforms / FRAMES;
+        fat.culling += times.culling / FRAMES;
+        fat.visible = times.visible;
+
+        times = runScene(scene, ranges, viewProjection, modelViewProjections);
+        dense.transforms += times.transforms / FRAMES;
+        dense.culling += times.culling / FRAMES;
+        dense.visible = times.visible;
+    }
+
+    // A tenth of the entities, at random, destroyed then created again.
+    std::shuffle(handles.begin(), handles.end(), generator);
+    size_t churn = entityCount / 10;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < churn; i++)
+    {
+        scene.destroy(handles[i]);
+    }
+    for (size_t i = 0; i < churn; i++)
+    {
+        handles[i] = scene.create("entity", meshes(generator));
+    }
+    double churnTime = millisecondsSince(start);
+
+    // Roots with their children, a fraction of the roots moves each frame.
+    Scene hierarchy;
+    hierarchy.reserve(entityCount);
+    std::vector<EntityHandle> roots;
+    for (size_t i = 0; i + CHILDREN < entityCount; i += CHILDREN + 1)
+    {
+        roots.push_back(hierarchy.create("root", meshes(generator)));
+        for (uint32_t child = 0; child < CHILDREN; child++)
+        {
+            EntityHandle entity = hierarchy.create("child", meshes(generator), roots.back());
+            hierarchy.setPosition(entity, glm::vec3(static_cast<float>(child), 1.0f, 0.0f));
+        }
+    }
+    hierarchy.updateTransforms(ranges, nullptr);
+
+    ThreadPool threadPool;
+    double serialTime = 0.0;
+    double parallelTime = 0.0;
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        serialTime += moveRoots(hierarchy, roots, 100, static_cast<float>(frame), ranges, nullptr) / FRAMES;
+    }
+    size_t fewChanged = hierarchy.changed().size();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        parallelTime += moveRoots(hierarchy, roots, 100, static_cast<float>(frame), ranges, &threadPool) / FRAMES;
+    }
+    double allTime = 0.0;
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        allTime += moveRoots(hierarchy, roots, 1, static_cast<float>(frame), ranges, &threadPool) / FRAMES;
+    }
+    size_t allChanged = hierarchy.changed().size();
+
+    std::printf("%zu entities, %d frames, %zu bytes per object against %zu per entity\n",
+                entityCount, FRAMES, sizeof(FatObject), sizeof(glm::mat4) + sizeof(glm::vec4) + 4 * sizeof(uint32_t));
+    std::printf("%-10s %14s %10s %10s %10s\n", "storage", "transforms ms", "cull ms", "total ms", "visible");
+    std::printf("%-10s %14.3f %10.3f %10.3f %10zu\n", "objects", fat.transforms, fat.culling, fat.transforms + fat.culling, fat.visible);
+    std::printf("%-10s %14.3f %10.3f %10.3f %10zu\n", "scene", dense.transforms, dense.culling, dense.transforms + dense.culling, dense.visible);
+    std::printf("destroyed and recreated %zu entities in %.3f ms\n", churn, churnTime);
+
+    std::printf("\n%zu roots with %u children each, %zu worker threads\n", roots.size(), CHILDREN, threadPool.size());
+    std::printf("%-22s %10s %10s\n", "update", "changed", "ms");
+    std::printf("%-22s %10zu %10.3f\n", "1% of roots, serial", fewChanged, serialTime);
+    std::printf("%-22s %10zu %10.3f\n", "1% of roots, parallel", fewChanged, parallelTime);
+    std::printf("%-22s %10zu %10.3f\n", "all roots, parallel", allChanged, allTime);
+
+    return 0;
+}
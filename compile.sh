@@ -1,2 +1,11 @@
 $VULKAN_SDK/bin/glslangValidator -V resources/shaders/shader.vert -o resources/shaders/vert.spv
 $VULKAN_SDK/bin/glslangValidator -V resources/shaders/shader.frag -o resources/shaders/frag.spv
+$VULKAN_SDK/bin/glslangValidator -V resources/shaders/indirect.vert -o resources/shaders/indirect_vert.spv
+$VULKAN_SDK/bin/glslangValidator -V resources/shaders/cull.comp -o resources/shaders/cull.spv
+$VULKAN_SDK/bin/glslangValidator -V resources/shaders/depth.vert -o resources/shaders/depth_vert.spv
+$VULKAN_SDK/bin/glslangValidator -V resources/shaders/hiz.comp -o resources/shaders/hiz.spv
+$VULKAN_SDK/bin/glslangValidator -V resources/shaders/cluster.comp -o resources/shaders/cluster.spv
+$VULKAN_SDK/bin/glslangValidator -V resources/shaders/gbuffer.frag -o resources/shaders/gbuffer_frag.spv
+$VULKAN_SDK/bin/glslangValidator -V resources/shaders/fullscreen.vert -o resources/shaders/fullscreen_vert.spv
+$VULKAN_SDK/bin/glslangValidator -V resources/shaders/deferred.frag -o resources/shaders/deferred_frag.spv
+$VULKAN_SDK/bin/glslangValidator -V resources/shaders/upscale.frag -o resources/shaders/upscale_frag.spv
@@ -0,0 +1,77 @@
+// Point and spot lights of the frame descriptor set, shared by shader.frag
+// and deferred.frag. See ClusteredLighting.hpp.
+struct Light
+{
+    vec4 positionRange;
+    vec4 colorCosInner;
+    vec4 directionCosOuter;
+};
+
+struct ClusterRange
+{
+    uint offset;
+    uint count;
+};
+
+layout(std140, binding = 3) uniform ClusterUniforms {
+    mat4 view;
+    vec2 projectionScale;
+    vec2 screenSize;
+    float near;
+    float far;
+    float sliceScale;
+    float sliceBias;
+    uvec4 clusterCount;
+    uint indexCapacity;
+} grid;
+
+layout(std430, binding = 4) readonly buffer Lights {
+    Light lights[];
+};
+
+layout(std430, binding = 5) readonly buffer Clusters {
+    ClusterRange clusters[];
+};
+
+layout(std430, binding = 6) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+// Only the lights assigned to this fragment's cluster by cluster.comp.
+vec3 clusteredLighting(vec3 position, vec3 normal)
+{
+    uvec3 count = grid.clusterCount.xyz;
+    float depth = -(grid.view * vec4(position, 1.0)).z;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / grid.screenSize * vec2(count.xy)), count.xy - 1u);
+    uint slice = uint(clamp(log(depth) * grid.sliceScale + grid.sliceBias, 0.0, float(count.z - 1u)));
+    ClusterRange range = clusters[(slice * count.y + tile.y) * count.x + tile.x];
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0; i < range.count; i++)
+    {
+        Light pointLight = lights[lightIndices[range.offset + i]];
+        vec3 toLight = pointLight.positionRange.xyz - position;
+        float distanceSquared = dot(toLight, toLight);
+        float rangeSquared = pointLight.positionRange.w * pointLight.positionRange.w;
+        if (distanceSquared >= rangeSquared)
+        {
+            continue;
+        }
+
+        // Inverse square, windowed to reach zero at the range.
+        vec3 direction = toLight * inversesqrt(max(distanceSquared, 1e-8));
+        float window = 1.0 - (distanceSquared * distanceSquared) / (rangeSquared * rangeSquared);
+        float attenuation = window * window / (distanceSquared + 1.0);
+
+        float cone = 1.0;
+        if (pointLight.directionCosOuter.w >= -1.0)
+        {
+            float cosAngle = dot(-direction, pointLight.directionCosOuter.xyz);
+            cone = smoothstep(pointLight.directionCosOuter.w, pointLight.colorCosInner.w, cosAngle);
+        }
+
+        result += pointLight.colorCosInner.rgb * max(dot(normal, direction), 0.0) * attenuation * cone;
+    }
+
+    return result;
+}
@@ -0,0 +1,50 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Lighting subpass of Swapchain::deferredRenderPass, once per pixel
+// whatever the overdraw of the G-buffer subpass was.
+layout(constant_id = 3) const float LIGHT_COLOR_R = 1.0;
+layout(constant_id = 4) const float LIGHT_COLOR_G = 1.0;
+layout(constant_id = 5) const float LIGHT_COLOR_B = 1.0;
+layout(constant_id = 6) const float AMBIENT = 0.02;
+
+layout(binding = 2) uniform LightInfo {
+    vec3 reversedDirection;
+} light;
+
+#include "clustered.glsl"
+
+// The G-buffer, read at this pixel only.
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput albedoInput;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput normalInput;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput depthInput;
+
+layout(push_constant) uniform Constants {
+    mat4 inverseViewProjection;
+} constants;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4 albedo = subpassLoad(albedoInput);
+    vec4 normal = subpassLoad(normalInput);
+
+    // Unlit objects and the cleared background keep their albedo.
+    if (normal.w == 0.0)
+    {
+        outColor = albedo;
+        return;
+    }
+
+    float depth = subpassLoad(depthInput).r;
+    vec2 ndc = gl_FragCoord.xy / grid.screenSize * 2.0 - 1.0;
+    vec4 position = constants.inverseViewProjection * vec4(ndc, depth, 1.0);
+    position /= position.w;
+
+    vec3 _normal = normalize(normal.xyz);
+    float nDotL = max(dot(light.reversedDirection, _normal), 0.0);
+    vec3 diffuse = vec3(LIGHT_COLOR_R, LIGHT_COLOR_G, LIGHT_COLOR_B) * nDotL + clusteredLighting(position.xyz, _normal);
+
+    outColor = (vec4(diffuse, 1.0) + AMBIENT) * albedo;
+}
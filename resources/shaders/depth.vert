@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Depth pre-pass, reads MeshPool::positionBuffer.
+layout(location = 0) in vec3 inPosition;
+
+// Per instance, see InstanceData.
+layout(location = 4) in mat4 inModelViewProjection;
+
+// Must match shader.vert bit for bit, see VK_COMPARE_OP_EQUAL in the main pass.
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = inModelViewProjection * vec4(inPosition, 1.0);
+}
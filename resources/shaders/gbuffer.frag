@@ -0,0 +1,35 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Same variant switches as shader.frag, lighting is left to deferred.frag.
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool LIT = true;
+layout(constant_id = 2) const bool ALPHA_TEST = false;
+layout(constant_id = 7) const float ALPHA_CUTOFF = 0.5;
+
+layout(binding = 1) uniform sampler2D texSampler;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec3 fragPosition;
+
+layout(location = 0) out vec4 outAlbedo;
+// World space normal, lit flag in w. Positions come back from depth.
+layout(location = 1) out vec4 outNormal;
+
+void main() {
+    vec4 albedo = vec4(fragColor, 1.0);
+    if (TEXTURED)
+    {
+        albedo = texture(texSampler, fragTexCoord);
+    }
+
+    if (ALPHA_TEST && albedo.a < ALPHA_CUTOFF)
+    {
+        discard;
+    }
+
+    outAlbedo = albedo;
+    outNormal = vec4(normalize(normal), LIT ? 1.0 : 0.0);
+}
@@ -0,0 +1,42 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Instances are drawn from the commands written by cull.comp, the model
+// matrix is fetched with the instance index.
+layout(push_constant) uniform FrameConstants {
+    mat4 viewProjection;
+} frame;
+
+struct Instance
+{
+    mat4 model;
+    vec4 boundingSphere;
+    uvec4 mesh;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec3 inNormal;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) out vec3 fragPosition;
+
+void main()
+{
+    mat4 model = instances[gl_InstanceIndex].model;
+    vec4 position = model * vec4(inPosition, 1.0);
+
+    gl_Position = frame.viewProjection * position;
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+
+    fragNormal = mat3(model) * inNormal;
+    fragPosition = position.xyz;
+}
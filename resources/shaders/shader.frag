@@ -1,20 +1,52 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Variant switches, see FragmentFeatures in ShaderVariant.hpp.
+// Disabled branches and the sampler are compiled out per pipeline.
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool LIT = true;
+layout(constant_id = 2) const bool ALPHA_TEST = false;
+layout(constant_id = 3) const float LIGHT_COLOR_R = 1.0;
+layout(constant_id = 4) const float LIGHT_COLOR_G = 1.0;
+layout(constant_id = 5) const float LIGHT_COLOR_B = 1.0;
+layout(constant_id = 6) const float AMBIENT = 0.02;
+layout(constant_id = 7) const float ALPHA_CUTOFF = 0.5;
 
 layout(binding = 1) uniform sampler2D texSampler;
 layout(binding = 2) uniform LightInfo {
     vec3 reversedDirection;
 } light;
 
+#include "clustered.glsl"
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
 layout(location = 2) in vec3 normal;
+layout(location = 3) in vec3 fragPosition;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    vec3 _normal = normalize(normal);
-    float nDotL = max(dot(light.reversedDirection, _normal), 0.0);
-    outColor = (vec4(vec3(1.0, 1.0, 1.0) * vec3(1.0, 1.0, 1.0) * nDotL, 1.0) + 0.02) * texture(texSampler, fragTexCoord) ;
+    vec4 albedo = vec4(fragColor, 1.0);
+    if (TEXTURED)
+    {
+        albedo = texture(texSampler, fragTexCoord);
+    }
+
+    if (ALPHA_TEST && albedo.a < ALPHA_CUTOFF)
+    {
+        discard;
+    }
+
+    vec4 lighting = vec4(1.0);
+    if (LIT)
+    {
+        vec3 _normal = normalize(normal);
+        float nDotL = max(dot(light.reversedDirection, _normal), 0.0);
+        vec3 diffuse = vec3(LIGHT_COLOR_R, LIGHT_COLOR_G, LIGHT_COLOR_B) * nDotL + clusteredLighting(fragPosition, _normal);
+        lighting = vec4(diffuse, 1.0) + AMBIENT;
+    }
+
+    outColor = lighting * albedo;
 }
@@ -1,28 +1,30 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 0) uniform CameraInfo {
-    mat4 viewProjection;
-} cameraInfo;
-
-layout(binding = 3) uniform ObjectInfo {
-    mat4 model;
-} object;
-
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 layout(location = 3) in vec3 inNormal;
 
+// Per instance, see InstanceData. Multiplied on the CPU once per object.
+layout(location = 4) in mat4 inModelViewProjection;
+layout(location = 8) in mat4 inModel;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) out vec3 fragNormal;
+// World space, for the clustered lights.
+layout(location = 3) out vec3 fragPosition;
+
+// Same depth as depth.vert, the main pass tests for equality after the pre-pass.
+invariant gl_Position;
 
 void main()
 {
-    gl_Position = cameraInfo.viewProjection * object.model * vec4(inPosition, 1.0);
+    gl_Position = inModelViewProjection * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 
-    fragNormal = inNormal;
+    fragNormal = mat3(inModel) * inNormal;
+    fragPosition = (inModel * vec4(inPosition, 1.0)).xyz;
 }
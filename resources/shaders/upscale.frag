@@ -0,0 +1,48 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Present pass of the dynamic resolution path. Scales the part of the scene
+// image this frame rendered up to the swapchain image, then sharpens it the
+// way contrast adaptive sharpening does: the negative lobe shrinks where the
+// neighbourhood is already close to black or white, so edges don't ring.
+layout(binding = 0) uniform sampler2D scene;
+
+layout(push_constant) uniform Constants {
+    // Rendered area, in scene image texture coordinates.
+    vec2 inputScale;
+    // One scene image texel.
+    vec2 inputTexel;
+    vec2 outputSize;
+    // 0 is plain bilinear.
+    float sharpness;
+} constants;
+
+layout(location = 0) out vec4 outColor;
+
+vec3 sampleScene(vec2 uv)
+{
+    // Past the rendered area the image holds older frames.
+    vec2 limit = constants.inputScale - 0.5 * constants.inputTexel;
+    return texture(scene, clamp(uv, 0.5 * constants.inputTexel, limit)).rgb;
+}
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / constants.outputSize * constants.inputScale;
+
+    vec3 center = sampleScene(uv);
+    vec3 north = sampleScene(uv - vec2(0.0, constants.inputTexel.y));
+    vec3 south = sampleScene(uv + vec2(0.0, constants.inputTexel.y));
+    vec3 west = sampleScene(uv - vec2(constants.inputTexel.x, 0.0));
+    vec3 east = sampleScene(uv + vec2(constants.inputTexel.x, 0.0));
+
+    vec3 minimum = min(center, min(min(north, south), min(west, east)));
+    vec3 maximum = max(center, max(max(north, south), max(west, east)));
+
+    // Headroom before clipping, relative to the local peak.
+    vec3 amount = sqrt(clamp(min(minimum, 1.0 - maximum) / max(maximum, vec3(1.0 / 65536.0)), 0.0, 1.0));
+    vec3 weight = -amount * constants.sharpness / mix(8.0, 5.0, constants.sharpness);
+
+    vec3 color = (center + (north + south + west + east) * weight) / (1.0 + 4.0 * weight);
+    outColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,31 @@
+#include "ApiCounters.hpp"
+
+std::atomic<uint64_t> ApiCounters::_counts[ApiCallCount];
+
+ApiCounts ApiCounters::take()
+{
+    ApiCounts counts;
+    for (uint32_t call = 0; call < ApiCallCount; call++)
+    {
+        counts[call] = _counts[call].exchange(0, std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+const char *ApiCounters::name(ApiCall call)
+{
+    static const char *names[ApiCallCount] = {
+        "draws",
+        "dispatches",
+        "pipeline binds",
+        "descriptor set binds",
+        "buffer binds",
+        "push constants",
+        "descriptor updates",
+        "maps",
+        "unmaps",
+        "submits",
+    };
+
+    return names[call];
+}
@@ -0,0 +1,134 @@
+#ifndef ApiCounters_hpp
+#define ApiCounters_hpp
+
+#include <atomic>
+
+#include "common.hpp"
+
+// Vulkan calls counted by the Counted wrappers.
+enum ApiCall : uint32_t
+{
+    // Direct and indirect, one per call whatever the draw count.
+    ApiDraw,
+    ApiDispatch,
+    ApiBindPipeline,
+    ApiBindDescriptorSets,
+    // Vertex and index buffers.
+    ApiBindBuffers,
+    ApiPushConstants,
+    // Descriptor writes and copies, not vkUpdateDescriptorSets calls.
+    ApiUpdateDescriptors,
+    ApiMap,
+    ApiUnmap,
+    ApiSubmit,
+
+    ApiCallCount,
+};
+
+typedef std::array<uint64_t, ApiCallCount> ApiCounts;
+
+// Calls made by any thread since the last take.
+class ApiCounters
+{
+public:
+    static void add(ApiCall call, uint64_t count = 1) { _counts[call].fetch_add(count, std::memory_order_relaxed); }
+    // Returns the counts and starts over.
+    static ApiCounts take();
+    static const char *name(ApiCall call);
+
+private:
+    static std::atomic<uint64_t> _counts[ApiCallCount];
+};
+
+// Same arguments as the Vulkan functions they stand for, counted on the
+// way. Every call the renderer makes to these goes through here.
+namespace Counted
+{
+inline void vkCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+    ApiCounters::add(ApiDraw);
+    ::vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+inline void vkCmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+{
+    ApiCounters::add(ApiDraw);
+    ::vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+inline void vkCmdDrawIndexedIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+    ApiCounters::add(ApiDraw);
+    ::vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+}
+
+inline void vkCmdDispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+    ApiCounters::add(ApiDispatch);
+    ::vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+inline void vkCmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline)
+{
+    ApiCounters::add(ApiBindPipeline);
+    ::vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+}
+
+inline void vkCmdBindDescriptorSets(
+    VkCommandBuffer commandBuffer,
+    VkPipelineBindPoint bindPoint,
+    VkPipelineLayout layout,
+    uint32_t firstSet,
+    uint32_t setCount,
+    const VkDescriptorSet *sets,
+    uint32_t dynamicOffsetCount,
+    const uint32_t *dynamicOffsets)
+{
+    ApiCounters::add(ApiBindDescriptorSets);
+    ::vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, firstSet, setCount, sets, dynamicOffsetCount, dynamicOffsets);
+}
+
+inline void vkCmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount, const VkBuffer *buffers, const VkDeviceSize *offsets)
+{
+    ApiCounters::add(ApiBindBuffers);
+    ::vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, buffers, offsets);
+}
+
+inline void vkCmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+    ApiCounters::add(ApiBindBuffers);
+    ::vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+}
+
+inline void vkCmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void *values)
+{
+    ApiCounters::add(ApiPushConstants);
+    ::vkCmdPushConstants(commandBuffer, layout, stages, offset, size, values);
+}
+
+inline void vkUpdateDescriptorSets(VkDevice device, uint32_t writeCount, const VkWriteDescriptorSet *writes, uint32_t copyCount, const VkCopyDescriptorSet *copies)
+{
+    ApiCounters::add(ApiUpdateDescriptors, writeCount + copyCount);
+    ::vkUpdateDescriptorSets(device, writeCount, writes, copyCount, copies);
+}
+
+inline VkResult vkMapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags, void **data)
+{
+    ApiCounters::add(ApiMap);
+    return ::vkMapMemory(device, memory, offset, size, flags, data);
+}
+
+inline void vkUnmapMemory(VkDevice device, VkDeviceMemory memory)
+{
+    ApiCounters::add(ApiUnmap);
+    ::vkUnmapMemory(device, memory);
+}
+
+inline VkResult vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *submits, VkFence fence)
+{
+    ApiCounters::add(ApiSubmit);
+    return ::vkQueueSubmit(queue, submitCount, submits, fence);
+}
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include <stdexcept>
+
+#include "BindState.hpp"
+#include "ApiCounters.hpp"
+
+void BindState::reset(VkCommandBuffer commandBuffer)
+{
+    _commandBuffer = commandBuffer;
+    _stats = BindStats();
+
+    _pipeline = VK_NULL_HANDLE;
+    for (uint32_t i = 0; i < MAX_SETS; i++)
+    {
+        _layouts[i] = VK_NULL_HANDLE;
+        _descriptorSets[i] = VK_NULL_HANDLE;
+    }
+    for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; i++)
+    {
+        _vertexBuffers[i] = VK_NULL_HANDLE;
+        _vertexOffsets[i] = 0;
+    }
+    _indexBuffer = VK_NULL_HANDLE;
+    _indexOffset = 0;
+}
+
+void BindState::bindPipeline(VkPipeline pipeline)
+{
+    _stats.requested++;
+    if (pipeline == _pipeline)
+    {
+        return;
+    }
+
+    Counted::vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    _pipeline = pipeline;
+    _stats.issued++;
+}
+
+void BindState::bindDescriptorSet(VkPipelineLayout layout, uint32_t set, VkDescriptorSet descriptorSet)
+{
+    if (set >= MAX_SETS)
+    {
+        throw std::runtime_error("Unable to track descriptor set " + std::to_string(set) + ".");
+    }
+
+    _stats.requested++;
+    if (layout == _layouts[set] && descriptorSet == _descriptorSets[set])
+    {
+        return;
+    }
+
+    Counted::vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set, 1, &descriptorSet, 0, nullptr);
+    _layouts[set] = layout;
+    _descriptorSets[set] = descriptorSet;
+    _stats.issued++;
+}
+
+void BindState::bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset)
+{
+    if (binding >= MAX_VERTEX_BINDINGS)
+    {
+        throw std::runtime_error("Unable to track vertex binding " + std::to_string(binding) + ".");
+    }
+
+    _stats.requested++;
+    if (buffer == _vertexBuffers[binding] && offset == _vertexOffsets[binding])
+    {
+        return;
+    }
+
+    Counted::vkCmdBindVertexBuffers(_commandBuffer, binding, 1, &buffer, &offset);
+    _vertexBuffers[binding] = buffer;
+    _vertexOffsets[binding] = offset;
+    _stats.issued++;
+}
+
+void BindState::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+    _stats.requested++;
+    if (buffer == _indexBuffer && offset == _indexOffset && indexType == _indexType)
+    {
+        return;
+    }
+
+    Counted::vkCmdBindIndexBuffer(_commandBuffer, buffer, offset, indexType);
+    _indexBuffer = buffer;
+    _indexOffset = offset;
+    _indexType = indexType;
+    _stats.issued++;
+}
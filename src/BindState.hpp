@@ -0,0 +1,48 @@
+#ifndef BindState_hpp
+#define BindState_hpp
+
+#include "common.hpp"
+
+// Binds per frame: requested by the draw loop, and actually recorded.
+struct BindStats
+{
+    uint32_t requested = 0;
+    uint32_t issued = 0;
+};
+
+// Records binds into a command buffer, skipping those that match what is
+// already bound. Only valid within one command buffer, reset it per recording.
+class BindState
+{
+public:
+    BindState(){};
+    ~BindState(){};
+
+    void reset(VkCommandBuffer commandBuffer);
+
+    void bindPipeline(VkPipeline pipeline);
+    void bindDescriptorSet(VkPipelineLayout layout, uint32_t set, VkDescriptorSet descriptorSet);
+    void bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0);
+    void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+
+    const BindStats &stats() const { return _stats; }
+
+private:
+    static const uint32_t MAX_SETS = 4;
+    static const uint32_t MAX_VERTEX_BINDINGS = 4;
+
+    VkCommandBuffer _commandBuffer = VK_NULL_HANDLE;
+    BindStats _stats;
+
+    VkPipeline _pipeline = VK_NULL_HANDLE;
+    // Sets stay valid across pipelines with compatible layouts, so the layout is tracked too.
+    VkPipelineLayout _layouts[MAX_SETS];
+    VkDescriptorSet _descriptorSets[MAX_SETS];
+    VkBuffer _vertexBuffers[MAX_VERTEX_BINDINGS];
+    VkDeviceSize _vertexOffsets[MAX_VERTEX_BINDINGS];
+    VkBuffer _indexBuffer = VK_NULL_HANDLE;
+    VkDeviceSize _indexOffset = 0;
+    VkIndexType _indexType = VK_INDEX_TYPE_UINT32;
+};
+
+#endif
@@ -0,0 +1,457 @@
+#include "Bvh.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+// Marks stack entries whose node is inside the frustum, so its subtree
+// skips the plane tests.
+const uint32_t INSIDE = 1u << 31;
+
+float surfaceArea(const glm::vec3 &min, const glm::vec3 &max)
+{
+    glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+struct Bin
+{
+    glm::vec3 min = glm::vec3(INFINITY);
+    glm::vec3 max = glm::vec3(-INFINITY);
+    uint32_t count = 0;
+};
+}
+
+const uint32_t Bvh::NO_NODE;
+
+void Bvh::clear()
+{
+    _nodes.clear();
+    _parents.clear();
+    _items.clear();
+    _leafOf.clear();
+    _stamps.clear();
+    _cost = 0.0;
+    _buildCost = 0.0;
+}
+
+void Bvh::build(const std::vector<glm::vec4> &bounds)
+{
+    clear();
+
+    uint32_t count = static_cast<uint32_t>(bounds.size());
+    if (count == 0)
+    {
+        return;
+    }
+
+    _items.resize(count);
+    std::iota(_items.begin(), _items.end(), 0);
+    _leafOf.resize(count);
+    _nodes.reserve(2 * count - 1);
+    _parents.reserve(2 * count - 1);
+
+    BvhNode root;
+    root.first = 0;
+    root.count = count;
+    _nodes.push_back(root);
+    _parents.push_back(NO_NODE);
+
+    // Spheres reordered along with the items, so each split reads its
+    // range in order instead of gathering from the scene order.
+    std::vector<glm::vec4> spheres(bounds);
+    std::vector<uint32_t> pending = {0};
+    while (!pending.empty())
+    {
+        uint32_t node = pending.back();
+        pending.pop_back();
+        _split(node, spheres, pending);
+    }
+
+    _stamps.assign(_nodes.size(), 0);
+    _stamp = 0;
+
+    _cost = 0.0;
+    for (uint32_t node = 0; node < _nodes.size(); node++)
+    {
+        _cost += _nodeCost(node);
+    }
+    float rootArea = surfaceArea(_nodes[0].min, _nodes[0].max);
+    _buildCost = rootArea > 0.0f ? _cost / rootArea : 0.0;
+}
+
+void Bvh::_fitLeaf(uint32_t node, const std::vector<glm::vec4> &bounds)
+{
+    BvhNode &leaf = _nodes[node];
+    leaf.min = glm::vec3(INFINITY);
+    leaf.max = glm::vec3(-INFINITY);
+    for (uint32_t i = leaf.first; i < leaf.first + leaf.count; i++)
+    {
+        const glm::vec4 &sphere = bounds[_items[i]];
+        glm::vec3 center(sphere);
+        leaf.min = glm::min(leaf.min, center - sphere.w);
+        leaf.max = glm::max(leaf.max, center + sphere.w);
+    }
+}
+
+void Bvh::_split(uint32_t node, std::vector<glm::vec4> &spheres, std::vector<uint32_t> &pending)
+{
+    uint32_t first = _nodes[node].first;
+    uint32_t count = _nodes[node].count;
+    uint32_t end = first + count;
+
+    glm::vec3 boxMin(INFINITY);
+    glm::vec3 boxMax(-INFINITY);
+    glm::vec3 centroidMin(INFINITY);
+    glm::vec3 centroidMax(-INFINITY);
+    for (uint32_t i = first; i < end; i++)
+    {
+        glm::vec3 center(spheres[i]);
+        boxMin = glm::min(boxMin, center - spheres[i].w);
+        boxMax = glm::max(boxMax, center + spheres[i].w);
+        centroidMin = glm::min(centroidMin, center);
+        centroidMax = glm::max(centroidMax, center);
+    }
+    _nodes[node].min = boxMin;
+    _nodes[node].max = boxMax;
+
+    auto makeLeaf = [&]() {
+        for (uint32_t i = first; i < end; i++)
+        {
+            _leafOf[_items[i]] = node;
+        }
+    };
+
+    if (count == 1)
+    {
+        makeLeaf();
+        return;
+    }
+
+    // Bins along the three axes in one pass over the items. Most nodes are
+    // small, fewer bins keep their fixed cost down.
+    uint32_t binCount = std::min(BIN_COUNT, count);
+    Bin bins[3][BIN_COUNT];
+    glm::vec3 extent = centroidMax - centroidMin;
+    glm::vec3 binScale(0.0f);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        binScale[axis] = extent[axis] > 0.0f ? binCount / extent[axis] : 0.0f;
+    }
+
+    auto binOf = [&](const glm::vec4 &sphere, int axis) {
+        uint32_t bin = static_cast<uint32_t>((sphere[axis] - centroidMin[axis]) * binScale[axis]);
+        return std::min(bin, binCount - 1);
+    };
+
+    for (uint32_t i = first; i < end; i++)
+    {
+        glm::vec3 center(spheres[i]);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            Bin &bin = bins[axis][binOf(spheres[i], axis)];
+            bin.min = glm::min(bin.min, center - spheres[i].w);
+            bin.max = glm::max(bin.max, center + spheres[i].w);
+            bin.count++;
+        }
+    }
+
+    // Cost of splitting after each bin, relative to testing the items.
+    float parentArea = surfaceArea(boxMin, boxMax);
+    float bestCost = INFINITY;
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (extent[axis] <= 0.0f)
+        {
+            continue;
+        }
+
+        // Right sides first, from the last bin.
+        float rightAreas[BIN_COUNT];
+        uint32_t rightCounts[BIN_COUNT];
+        Bin right;
+        for (uint32_t bin = binCount - 1; bin > 0; bin--)
+        {
+            right.min = glm::min(right.min, bins[axis][bin].min);
+            right.max = glm::max(right.max, bins[axis][bin].max);
+            right.count += bins[axis][bin].count;
+            rightAreas[bin] = right.count > 0 ? surfaceArea(right.min, right.max) : 0.0f;
+            rightCounts[bin] = right.count;
+        }
+
+        Bin left;
+        for (uint32_t split = 1; split < binCount; split++)
+        {
+            const Bin &bin = bins[axis][split - 1];
+            left.min = glm::min(left.min, bin.min);
+            left.max = glm::max(left.max, bin.max);
+            left.count += bin.count;
+            if (left.count == 0 || rightCounts[split] == 0)
+            {
+                continue;
+            }
+
+            float cost = surfaceArea(left.min, left.max) * left.count + rightAreas[split] * rightCounts[split];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    float splitCost = parentArea > 0.0f ? TRAVERSAL_COST + bestCost / parentArea : INFINITY;
+    if (count <= MAX_LEAF_SIZE && (bestAxis < 0 || splitCost >= static_cast<float>(count)))
+    {
+        makeLeaf();
+        return;
+    }
+
+    uint32_t middle;
+    if (bestAxis >= 0)
+    {
+        // Items and spheres swapped together.
+        middle = first;
+        uint32_t last = end;
+        while (middle < last)
+        {
+            if (binOf(spheres[middle], bestAxis) < bestSplit)
+            {
+                middle++;
+            }
+            else
+            {
+                last--;
+                std::swap(spheres[middle], spheres[last]);
+                std::swap(_items[middle], _items[last]);
+            }
+        }
+    }
+    else
+    {
+        // Every centroid in the same place, any halves will do.
+        middle = first + count / 2;
+    }
+
+    uint32_t left = static_cast<uint32_t>(_nodes.size());
+    BvhNode child;
+    child.first = first;
+    child.count = middle - first;
+    _nodes.push_back(child);
+    child.first = middle;
+    child.count = end - middle;
+    _nodes.push_back(child);
+    _parents.push_back(node);
+    _parents.push_back(node);
+
+    _nodes[node].first = left;
+    _nodes[node].count = 0;
+    pending.push_back(left);
+    pending.push_back(left + 1);
+}
+
+double Bvh::_nodeCost(uint32_t node) const
+{
+    const BvhNode &bvhNode = _nodes[node];
+    double weight = bvhNode.count > 0 ? static_cast<double>(bvhNode.count) : TRAVERSAL_COST;
+    return surfaceArea(bvhNode.min, bvhNode.max) * weight;
+}
+
+float Bvh::degradation() const
+{
+    if (_nodes.empty() || _buildCost <= 0.0)
+    {
+        return 1.0f;
+    }
+
+    float rootArea = surfaceArea(_nodes[0].min, _nodes[0].max);
+    return rootArea > 0.0f ? static_cast<float>(_cost / rootArea / _buildCost) : 1.0f;
+}
+
+void Bvh::refit(const std::vector<glm::vec4> &bounds, const std::vector<uint32_t> &changed)
+{
+    if (bounds.size() != _leafOf.size())
+    {
+        throw std::runtime_error("Unable to refit the BVH, items were added or removed since the build.");
+    }
+
+    if (_nodes.empty() || changed.empty())
+    {
+        return;
+    }
+
+    if (++_stamp == 0)
+    {
+        std::fill(_stamps.begin(), _stamps.end(), 0);
+        _stamp = 1;
+    }
+
+    // The leaves of the changed items, then every ancestor once.
+    _refitNodes.clear();
+    for (uint32_t item : changed)
+    {
+        uint32_t leaf = _leafOf[item];
+        if (_stamps[leaf] != _stamp)
+        {
+            _stamps[leaf] = _stamp;
+            _refitNodes.push_back(leaf);
+        }
+    }
+    for (size_t i = 0; i < _refitNodes.size(); i++)
+    {
+        uint32_t parent = _parents[_refitNodes[i]];
+        if (parent != NO_NODE && _stamps[parent] != _stamp)
+        {
+            _stamps[parent] = _stamp;
+            _refitNodes.push_back(parent);
+        }
+    }
+
+    // Children are always after their parent, so from the back every node
+    // sees its children refitted.
+    std::sort(_refitNodes.begin(), _refitNodes.end(), std::greater<uint32_t>());
+    for (uint32_t node : _refitNodes)
+    {
+        _cost -= _nodeCost(node);
+
+        BvhNode &bvhNode = _nodes[node];
+        if (bvhNode.count > 0)
+        {
+            _fitLeaf(node, bounds);
+        }
+        else
+        {
+            const BvhNode &left = _nodes[bvhNode.first];
+            const BvhNode &right = _nodes[bvhNode.first + 1];
+            bvhNode.min = glm::min(left.min, right.min);
+            bvhNode.max = glm::max(left.max, right.max);
+        }
+
+        _cost += _nodeCost(node);
+    }
+}
+
+void Bvh::cull(const Frustum &frustum, const std::vector<glm::vec4> &bounds, std::vector<uint32_t> &visible) const
+{
+    if (_nodes.empty())
+    {
+        return;
+    }
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        uint32_t entry = stack.back();
+        stack.pop_back();
+
+        uint32_t inside = entry & INSIDE;
+        const BvhNode &node = _nodes[entry & ~INSIDE];
+        if (!inside)
+        {
+            if (!frustum.intersectsBox(node.min, node.max))
+            {
+                continue;
+            }
+            inside = frustum.containsBox(node.min, node.max) ? INSIDE : 0;
+        }
+
+        if (node.count == 0)
+        {
+            stack.push_back(node.first | inside);
+            stack.push_back((node.first + 1) | inside);
+            continue;
+        }
+
+        for (uint32_t i = node.first; i < node.first + node.count; i++)
+        {
+            const glm::vec4 &sphere = bounds[_items[i]];
+            if (inside || frustum.intersectsSphere(glm::vec3(sphere), sphere.w))
+            {
+                visible.push_back(_items[i]);
+            }
+        }
+    }
+}
+
+bool Bvh::raycast(const Ray &ray, const std::vector<glm::vec4> &bounds, float maxDistance, BvhHit &hit, const ItemTest &test) const
+{
+    float entry;
+    if (_nodes.empty() || !ray.intersectsBox(_nodes[0].min, _nodes[0].max, maxDistance, entry))
+    {
+        return false;
+    }
+
+    // Nodes with the distance the ray enters them, nearest child on top.
+    std::vector<std::pair<uint32_t, float>> stack;
+    stack.reserve(64);
+    stack.push_back(std::make_pair(0u, entry));
+
+    bool found = false;
+    float closest = maxDistance;
+    while (!stack.empty())
+    {
+        uint32_t index = stack.back().first;
+        float distance = stack.back().second;
+        stack.pop_back();
+        if (distance > closest)
+        {
+            continue;
+        }
+
+        const BvhNode &node = _nodes[index];
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                const glm::vec4 &sphere = bounds[_items[i]];
+                float itemDistance;
+                if (!ray.intersectsSphere(glm::vec3(sphere), sphere.w, closest, itemDistance))
+                {
+                    continue;
+                }
+                if (test && !test(_items[i], itemDistance))
+                {
+                    continue;
+                }
+
+                if (itemDistance <= closest && (!found || itemDistance < closest))
+                {
+                    found = true;
+                    closest = itemDistance;
+                    hit.item = _items[i];
+                    hit.distance = itemDistance;
+                }
+            }
+            continue;
+        }
+
+        float leftDistance;
+        float rightDistance;
+        const BvhNode &left = _nodes[node.first];
+        const BvhNode &right = _nodes[node.first + 1];
+        bool hitsLeft = ray.intersectsBox(left.min, left.max, closest, leftDistance);
+        bool hitsRight = ray.intersectsBox(right.min, right.max, closest, rightDistance);
+        if (hitsLeft && hitsRight)
+        {
+            bool leftFirst = leftDistance <= rightDistance;
+            stack.push_back(leftFirst ? std::make_pair(node.first + 1, rightDistance) : std::make_pair(node.first, leftDistance));
+            stack.push_back(leftFirst ? std::make_pair(node.first, leftDistance) : std::make_pair(node.first + 1, rightDistance));
+        }
+        else if (hitsLeft)
+        {
+            stack.push_back(std::make_pair(node.first, leftDistance));
+        }
+        else if (hitsRight)
+        {
+            stack.push_back(std::make_pair(node.first + 1, rightDistance));
+        }
+    }
+
+    return found;
+}
@@ -0,0 +1,96 @@
+#ifndef Bvh_hpp
+#define Bvh_hpp
+
+#include <functional>
+
+#include "common.hpp"
+#include "Frustum.hpp"
+#include "Ray.hpp"
+
+struct BvhNode
+{
+    glm::vec3 min;
+    // Leaves: first entry of items(). Inner nodes: left child, the right
+    // child follows it.
+    uint32_t first;
+    glm::vec3 max;
+    // Items of a leaf, 0 for inner nodes.
+    uint32_t count;
+};
+
+struct BvhHit
+{
+    uint32_t item = ~0u;
+    float distance = 0.0f;
+};
+
+// Bounding volume hierarchy over bounding spheres, Scene::bounds(), items
+// are their indices. Built top down with the surface area heuristic over
+// binned centroids. Moving items only refit the boxes on their way to the
+// root, which keeps queries correct but lets boxes grow and overlap, so the
+// SAH cost is tracked through refits and needsRebuild tells when it drifted
+// too far from the one of the last build.
+class Bvh
+{
+public:
+    static const uint32_t NO_NODE = ~0u;
+
+    Bvh(){};
+    ~Bvh(){};
+
+    void build(const std::vector<glm::vec4> &bounds);
+    // Items whose bounds changed since the last build or refit. Throws if
+    // the item count changed, that takes a build.
+    void refit(const std::vector<glm::vec4> &bounds, const std::vector<uint32_t> &changed);
+    void clear();
+
+    bool empty() const { return _nodes.empty(); }
+    // SAH cost now over SAH cost after the last build, 1 right after it.
+    float degradation() const;
+    bool needsRebuild() const { return degradation() > REBUILD_DEGRADATION; }
+
+    // Appends the items whose sphere intersects the frustum, in no order.
+    void cull(const Frustum &frustum, const std::vector<glm::vec4> &bounds, std::vector<uint32_t> &visible) const;
+    // Exact test of an item whose sphere the ray hits, gives the distance.
+    typedef std::function<bool(uint32_t item, float &distance)> ItemTest;
+
+    // Closest item the ray hits within maxDistance, by its sphere or by the
+    // test when there is one.
+    bool raycast(const Ray &ray, const std::vector<glm::vec4> &bounds, float maxDistance, BvhHit &hit, const ItemTest &test = nullptr) const;
+
+    const std::vector<BvhNode> &nodes() const { return _nodes; }
+    // Item indices, each leaf owns a contiguous range.
+    const std::vector<uint32_t> &items() const { return _items; }
+
+private:
+    // Split candidates per axis.
+    static const uint32_t BIN_COUNT = 16;
+    // Leaves never hold more than this, small ones go by the heuristic.
+    static const uint32_t MAX_LEAF_SIZE = 8;
+    // Cost of visiting a node relative to testing one item.
+    static constexpr float TRAVERSAL_COST = 1.0f;
+    static constexpr float REBUILD_DEGRADATION = 1.5f;
+
+    // Spheres in item order, reordered with the items.
+    void _split(uint32_t node, std::vector<glm::vec4> &spheres, std::vector<uint32_t> &pending);
+    void _fitLeaf(uint32_t node, const std::vector<glm::vec4> &bounds);
+    double _nodeCost(uint32_t node) const;
+
+    std::vector<BvhNode> _nodes;
+    std::vector<uint32_t> _parents;
+    std::vector<uint32_t> _items;
+    // Leaf holding each item.
+    std::vector<uint32_t> _leafOf;
+
+    // Sum of _nodeCost over the nodes, kept up to date by refit. The build
+    // one is relative to the root area.
+    double _cost = 0.0;
+    double _buildCost = 0.0;
+
+    // Nodes to refit, visited once per refit through the stamps.
+    std::vector<uint32_t> _refitNodes;
+    std::vector<uint32_t> _stamps;
+    uint32_t _stamp = 0;
+};
+
+#endif
@@ -12,7 +12,7 @@ Camera::Camera(const float ratio)
     _near = 0.01f;
     _far = 100.0f;
 
-    _movementSpeed = 0.05f;
+    _movementSpeed = 3.0f;
     _rotationSpeed = 0.1f;
 
     _position = glm::vec3(2.0f, 2.0f, 0.0f);
@@ -25,11 +25,11 @@ Camera::Camera(const float ratio)
     glm::vec3 direction = _front;
 }
 
-void Camera::update()
+void Camera::update(double deltaTime)
 {
     _updateView();
 
-    updateWithKeys();
+    updateWithKeys(deltaTime);
 
     if (Input::instance().hasOffset())
     {
@@ -48,25 +48,26 @@ void Camera::_updateView()
     _view = glm::lookAt(_position, _position + _front, _up);
 }
 
-void Camera::updateWithKeys()
+void Camera::updateWithKeys(double deltaTime)
 {
+    float step = _movementSpeed * static_cast<float>(deltaTime);
     if (Input::instance().pressed(Input::KeyW))
     {
-        _position += _movementSpeed * _front;
+        _position += step * _front;
     }
     if (Input::instance().pressed(Input::KeyS))
     {
-        _position -= _movementSpeed * _front;
+        _position -= step * _front;
     }
     if (Input::instance().pressed(Input::KeyD))
     {
         glm::vec3 right = glm::normalize(glm::cross(_front, _up));
-        _position += _movementSpeed * right;
+        _position += step * right;
     }
     if (Input::instance().pressed(Input::KeyA))
     {
         glm::vec3 right = glm::normalize(glm::cross(_front, _up));
-        _position -= _movementSpeed * right;
+        _position -= step * right;
     }
 }
 
@@ -94,7 +95,29 @@ void Camera::updateWithMouse()
     _front = glm::normalize(front);
 }
 
+void Camera::lookAt(const glm::vec3 &position, const glm::vec3 &target)
+{
+    _position = position;
+    _front = glm::normalize(target - position);
+
+    // Angles updateWithMouse builds the front vector from.
+    pitch = glm::degrees(asin(_front.y));
+    yaw = glm::degrees(atan2(_front.z, _front.x));
+
+    _updateView();
+}
+
 glm::mat4 Camera::getViewProjectionMatrix() const
 {
     return _proj * _view;
 }
+
+Ray Camera::getRay(float x, float y) const
+{
+    // Back from the near plane to the far plane.
+    glm::mat4 inverse = glm::inverse(getViewProjectionMatrix());
+    glm::vec4 near = inverse * glm::vec4(x, y, 0.0f, 1.0f);
+    glm::vec4 far = inverse * glm::vec4(x, y, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(near) / near.w;
+    return Ray(origin, glm::vec3(far) / far.w - origin);
+}
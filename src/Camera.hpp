@@ -2,6 +2,7 @@
 #define Camera_hpp
 
 #include "common.hpp"
+#include "Ray.hpp"
 
 class Camera
 {
@@ -11,11 +12,22 @@ public:
 
     void setProjection(float ratio, float fov, float near, float far);
     void updatePosition(double time);
-    void update();
-    void updateWithKeys();
+    // Movement follows the frame time, mouse look the cursor offset.
+    void update(double deltaTime);
+    void updateWithKeys(double deltaTime);
     void updateWithMouse();
+    // Scripted paths, mouse look carries on from there.
+    void lookAt(const glm::vec3 &position, const glm::vec3 &target);
 
     glm::mat4 getViewProjectionMatrix() const;
+    glm::mat4 getViewMatrix() const { return _view; }
+    glm::mat4 getProjectionMatrix() const { return _proj; }
+    glm::vec3 getPosition() const { return _position; }
+    float getNear() const { return _near; }
+    float getFar() const { return _far; }
+    // Through a point of the screen in normalized device coordinates, y
+    // down. The center while the cursor is captured.
+    Ray getRay(float x = 0.0f, float y = 0.0f) const;
 
 private:
     void _updateProjection();
@@ -33,7 +45,8 @@ private:
     float _near;
     float _far;
     float _rotationSpeed = 0.1f;
-    float _movementSpeed = 0.1f;
+    // World units per second.
+    float _movementSpeed = 3.0f;
 };
 
 #endif
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <limits>
+
+#include "ClusterGrid.hpp"
+
+namespace
+{
+bool intersects(const glm::vec4 &sphere, const glm::vec3 &min, const glm::vec3 &max)
+{
+    glm::vec3 center(sphere.x, sphere.y, sphere.z);
+    glm::vec3 offset = glm::clamp(center, min, max) - center;
+    return glm::dot(offset, offset) <= sphere.w * sphere.w;
+}
+}
+
+void ClusterGrid::bounds(uint32_t x, uint32_t y, uint32_t z, glm::vec3 &min, glm::vec3 &max) const
+{
+    min = glm::vec3(std::numeric_limits<float>::max());
+    max = glm::vec3(-std::numeric_limits<float>::max());
+
+    // The four tile corners on the near and far planes of the slice.
+    for (int corner = 0; corner < 8; corner++)
+    {
+        float ndcX = static_cast<float>(x + (corner & 1)) / COUNT_X * 2.0f - 1.0f;
+        float ndcY = static_cast<float>(y + ((corner >> 1) & 1)) / COUNT_Y * 2.0f - 1.0f;
+        float depth = sliceDepth(z + (corner >> 2));
+
+        glm::vec3 point(ndcX * depth / projectionScale.x, ndcY * depth / projectionScale.y, -depth);
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+}
+
+void ClusterGrid::assign(
+    const std::vector<glm::vec4> &lights,
+    std::vector<ClusterRange> &ranges,
+    std::vector<uint32_t> &indices) const
+{
+    ranges.resize(COUNT);
+    indices.clear();
+
+    for (uint32_t z = 0; z < COUNT_Z; z++)
+    {
+        for (uint32_t y = 0; y < COUNT_Y; y++)
+        {
+            for (uint32_t x = 0; x < COUNT_X; x++)
+            {
+                glm::vec3 min;
+                glm::vec3 max;
+                bounds(x, y, z, min, max);
+
+                ClusterRange &range = ranges[index(x, y, z)];
+                range.offset = static_cast<uint32_t>(indices.size());
+                for (uint32_t light = 0; light < lights.size(); light++)
+                {
+                    if (intersects(lights[light], min, max))
+                    {
+                        indices.push_back(light);
+                    }
+                }
+                range.count = static_cast<uint32_t>(indices.size()) - range.offset;
+            }
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef ClusterGrid_hpp
+#define ClusterGrid_hpp
+
+#include <cmath>
+
+#include "common.hpp"
+
+// Lights of one cluster in the light index list, uvec2 in the shaders.
+struct ClusterRange
+{
+    uint32_t offset;
+    uint32_t count;
+};
+
+static_assert(sizeof(ClusterRange) == 8, "ClusterRange must match the shader layout.");
+
+// The view frustum split in screen tiles and exponential depth slices,
+// shared by cluster.comp and shader.frag through ClusterUniforms.
+struct ClusterGrid
+{
+    static const uint32_t COUNT_X = 16;
+    static const uint32_t COUNT_Y = 9;
+    static const uint32_t COUNT_Z = 24;
+    static const uint32_t COUNT = COUNT_X * COUNT_Y * COUNT_Z;
+
+    // Diagonal of the projection, view xy = ndc xy * depth / scale.
+    glm::vec2 projectionScale = glm::vec2(1.0f);
+    float near = 0.1f;
+    float far = 100.0f;
+
+    // slice = log(depth) * sliceScale + sliceBias.
+    float sliceScale = 1.0f;
+    float sliceBias = 0.0f;
+
+    // Symmetric perspective projection with a [0, 1] depth range.
+    static ClusterGrid fromProjection(const glm::mat4 &projection, float near, float far)
+    {
+        ClusterGrid grid;
+        grid.projectionScale = glm::vec2(projection[0][0], projection[1][1]);
+        grid.near = near;
+        grid.far = far;
+
+        float logRatio = std::log(far / near);
+        grid.sliceScale = COUNT_Z / logRatio;
+        grid.sliceBias = -std::log(near) * grid.sliceScale;
+        return grid;
+    }
+
+    static uint32_t index(uint32_t x, uint32_t y, uint32_t z) { return (z * COUNT_Y + y) * COUNT_X + x; }
+
+    // View depth, positive in front of the camera.
+    float sliceDepth(uint32_t slice) const
+    {
+        return near * std::pow(far / near, static_cast<float>(slice) / COUNT_Z);
+    }
+
+    uint32_t slice(float depth) const
+    {
+        float slice = std::log(depth) * sliceScale + sliceBias;
+        return static_cast<uint32_t>(std::min(std::max(slice, 0.0f), static_cast<float>(COUNT_Z - 1)));
+    }
+
+    // View space box around the froxel.
+    void bounds(uint32_t x, uint32_t y, uint32_t z, glm::vec3 &min, glm::vec3 &max) const;
+
+    // CPU version of cluster.comp: `lights` are view space spheres, the
+    // ranges and indices come out in the layout of the storage buffers.
+    void assign(
+        const std::vector<glm::vec4> &lights,
+        std::vector<ClusterRange> &ranges,
+        std::vector<uint32_t> &indices) const;
+};
+
+#endif
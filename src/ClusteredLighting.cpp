@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cstring>
+
+#include "ClusteredLighting.hpp"
+#include "ApiCounters.hpp"
+#include "VulkanUtilities.hpp"
+
+const std::string CLUSTER_SHADER_PATH = "./resources/shaders/cluster.spv";
+
+// Matches local_size_x in cluster.comp.
+static const uint32_t CLUSTER_GROUP_SIZE = 64;
+
+// Light index list size, as an average per cluster. Clusters past the end
+// of the list lose their lights for that frame.
+static const uint32_t AVERAGE_LIGHTS_PER_CLUSTER = 64;
+
+// Point lights never pass the cone test.
+static const float NO_CONE = -2.0f;
+
+void ClusteredLighting::init(Swapchain &swapchain, PipelineRegistry &pipelines, uint32_t maxLights)
+{
+    _device = swapchain.device;
+    _maxLights = std::max(1u, maxLights);
+    _indexCapacity = ClusterGrid::COUNT * AVERAGE_LIGHTS_PER_CLUSTER;
+
+    uint32_t imageCount = swapchain.imageCount;
+    _uniformBuffers.resize(imageCount);
+    _uniformBuffersMemory.resize(imageCount);
+    _uniformData.resize(imageCount);
+    _lightBuffers.resize(imageCount);
+    _lightBuffersMemory.resize(imageCount);
+    _lightData.resize(imageCount);
+    _clusterBuffers.resize(imageCount);
+    _clusterBuffersMemory.resize(imageCount);
+    _indexBuffers.resize(imageCount);
+    _indexBuffersMemory.resize(imageCount);
+    _counterBuffers.resize(imageCount);
+    _counterBuffersMemory.resize(imageCount);
+
+    for (size_t i = 0; i < imageCount; i++)
+    {
+        VulkanUtilities::createBuffer(
+            _device,
+            swapchain.physicalDevice,
+            sizeof(ClusterUniforms),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _uniformBuffers[i],
+            _uniformBuffersMemory[i]);
+
+        Counted::vkMapMemory(_device, _uniformBuffersMemory[i], 0, sizeof(ClusterUniforms), 0, &_uniformData[i]);
+
+        // Rewritten every frame, lights can move.
+        VulkanUtilities::createBuffer(
+            _device,
+            swapchain.physicalDevice,
+            sizeof(GpuLight) * _maxLights,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _lightBuffers[i],
+            _lightBuffersMemory[i]);
+
+        Counted::vkMapMemory(_device, _lightBuffersMemory[i], 0, sizeof(GpuLight) * _maxLights, 0, &_lightData[i]);
+
+        VulkanUtilities::createBuffer(
+            _device,
+            swapchain.physicalDevice,
+            sizeof(ClusterRange) * ClusterGrid::COUNT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _clusterBuffers[i],
+            _clusterBuffersMemory[i]);
+
+        VulkanUtilities::createBuffer(
+            _device,
+            swapchain.physicalDevice,
+            sizeof(uint32_t) * _indexCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _indexBuffers[i],
+            _indexBuffersMemory[i]);
+
+        VulkanUtilities::createBuffer(
+            _device,
+            swapchain.physicalDevice,
+            sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _counterBuffers[i],
+            _counterBuffersMemory[i]);
+    }
+
+    // Reads the uniforms and lights, writes the ranges, indices and counter.
+    _setLayout = VulkanUtilities::createDescriptorSetLayout(
+        _device,
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+        VK_SHADER_STAGE_COMPUTE_BIT);
+    _createDescriptorSets(imageCount);
+
+    _layout = pipelines.getLayout({_setLayout});
+    _pipeline = pipelines.getCompute(pipelines.loadShader(CLUSTER_SHADER_PATH), Specialization(), _layout);
+}
+
+void ClusteredLighting::_createDescriptorSets(uint32_t imageCount)
+{
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = imageCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = 4 * imageCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = imageCount;
+
+    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create descriptor pool.");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(imageCount, _setLayout);
+    _sets.resize(imageCount);
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = imageCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(_device, &allocInfo, _sets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to allocate descriptor sets.");
+    }
+
+    for (uint32_t i = 0; i < imageCount; i++)
+    {
+        VkDescriptorBufferInfo bufferInfos[] = {
+            uniformInfo(i),
+            lightInfo(i),
+            clusterInfo(i),
+            indexInfo(i),
+            {_counterBuffers[i], 0, VK_WHOLE_SIZE},
+        };
+
+        std::array<VkWriteDescriptorSet, 5> descriptorWrites = {};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++)
+        {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = _sets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+        }
+
+        Counted::vkUpdateDescriptorSets(_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void ClusteredLighting::addPointLight(const glm::vec3 &position, float range, const glm::vec3 &color)
+{
+    if (_lights.size() >= _maxLights)
+    {
+        return;
+    }
+
+    GpuLight light = {};
+    light.positionRange = glm::vec4(position, range);
+    light.colorCosInner = glm::vec4(color, 1.0f);
+    light.directionCosOuter = glm::vec4(0.0f, -1.0f, 0.0f, NO_CONE);
+    _lights.push_back(light);
+}
+
+void ClusteredLighting::addSpotLight(
+    const glm::vec3 &position,
+    float range,
+    const glm::vec3 &color,
+    const glm::vec3 &direction,
+    float innerAngle,
+    float outerAngle)
+{
+    if (_lights.size() >= _maxLights)
+    {
+        return;
+    }
+
+    GpuLight light = {};
+    light.positionRange = glm::vec4(position, range);
+    light.colorCosInner = glm::vec4(color, std::cos(innerAngle));
+    light.directionCosOuter = glm::vec4(glm::normalize(direction), std::cos(outerAngle));
+    _lights.push_back(light);
+}
+
+LightResources ClusteredLighting::addPasses(
+    RenderGraph &graph,
+    uint32_t imageIndex,
+    const glm::mat4 &view,
+    const glm::mat4 &projection,
+    float near,
+    float far,
+    VkExtent2D extent)
+{
+    ClusterGrid grid = ClusterGrid::fromProjection(projection, near, far);
+
+    ClusterUniforms uniforms = {};
+    uniforms.view = view;
+    uniforms.projectionScale = grid.projectionScale;
+    uniforms.screenSize = glm::vec2(extent.width, extent.height);
+    uniforms.near = grid.near;
+    uniforms.far = grid.far;
+    uniforms.sliceScale = grid.sliceScale;
+    uniforms.sliceBias = grid.sliceBias;
+    uniforms.clusterCount[0] = ClusterGrid::COUNT_X;
+    uniforms.clusterCount[1] = ClusterGrid::COUNT_Y;
+    uniforms.clusterCount[2] = ClusterGrid::COUNT_Z;
+    uniforms.clusterCount[3] = static_cast<uint32_t>(_lights.size());
+    uniforms.indexCapacity = _indexCapacity;
+    memcpy(_uniformData[imageIndex], &uniforms, sizeof(uniforms));
+    if (!_lights.empty())
+    {
+        memcpy(_lightData[imageIndex], _lights.data(), sizeof(GpuLight) * _lights.size());
+    }
+
+    RenderResource counter = graph.importBuffer("light counter", _counterBuffers[imageIndex]);
+    LightResources resources;
+    resources.clusters = graph.importBuffer("clusters", _clusterBuffers[imageIndex]);
+    resources.indices = graph.importBuffer("light indices", _indexBuffers[imageIndex]);
+
+    VkBuffer counterBuffer = _counterBuffers[imageIndex];
+    RenderPassId clear = graph.addPass("clear light counter", [counterBuffer](VkCommandBuffer commandBuffer) {
+        vkCmdFillBuffer(commandBuffer, counterBuffer, 0, sizeof(uint32_t), 0);
+    });
+    graph.write(clear, counter, ResourceUsage::TransferWrite);
+
+    RenderPassId assign = graph.addPass("assign lights", [this, imageIndex](VkCommandBuffer commandBuffer) {
+        Counted::vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+        Counted::vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _layout, 0, 1, &_sets[imageIndex], 0, nullptr);
+        Counted::vkCmdDispatch(commandBuffer, (ClusterGrid::COUNT + CLUSTER_GROUP_SIZE - 1) / CLUSTER_GROUP_SIZE, 1, 1);
+    });
+    graph.write(assign, counter, ResourceUsage::ComputeWrite);
+    graph.write(assign, resources.clusters, ResourceUsage::ComputeWrite);
+    graph.write(assign, resources.indices, ResourceUsage::ComputeWrite);
+
+    return resources;
+}
+
+void ClusteredLighting::clean()
+{
+    // The layout and pipeline belong to the registry.
+    vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+
+    for (size_t i = 0; i < _uniformBuffers.size(); i++)
+    {
+        Counted::vkUnmapMemory(_device, _uniformBuffersMemory[i]);
+        vkDestroyBuffer(_device, _uniformBuffers[i], nullptr);
+        vkFreeMemory(_device, _uniformBuffersMemory[i], nullptr);
+        Counted::vkUnmapMemory(_device, _lightBuffersMemory[i]);
+        vkDestroyBuffer(_device, _lightBuffers[i], nullptr);
+        vkFreeMemory(_device, _lightBuffersMemory[i], nullptr);
+        vkDestroyBuffer(_device, _clusterBuffers[i], nullptr);
+        vkFreeMemory(_device, _clusterBuffersMemory[i], nullptr);
+        vkDestroyBuffer(_device, _indexBuffers[i], nullptr);
+        vkFreeMemory(_device, _indexBuffersMemory[i], nullptr);
+        vkDestroyBuffer(_device, _counterBuffers[i], nullptr);
+        vkFreeMemory(_device, _counterBuffersMemory[i], nullptr);
+    }
+
+    _uniformBuffers.clear();
+    _uniformBuffersMemory.clear();
+    _uniformData.clear();
+    _lightBuffers.clear();
+    _lightBuffersMemory.clear();
+    _lightData.clear();
+    _clusterBuffers.clear();
+    _clusterBuffersMemory.clear();
+    _indexBuffers.clear();
+    _indexBuffersMemory.clear();
+    _counterBuffers.clear();
+    _counterBuffersMemory.clear();
+    _sets.clear();
+    _lights.clear();
+}
@@ -0,0 +1,120 @@
+#ifndef ClusteredLighting_hpp
+#define ClusteredLighting_hpp
+
+#include "common.hpp"
+#include "ClusterGrid.hpp"
+#include "PipelineRegistry.hpp"
+#include "RenderGraph.hpp"
+#include "Swapchain.hpp"
+
+// Point or spot light, std430 layout shared by cluster.comp and shader.frag.
+struct GpuLight
+{
+    // World space position, range.
+    glm::vec4 positionRange;
+    // Color, cosine of the inner cone angle.
+    glm::vec4 colorCosInner;
+    // Spot direction, cosine of the outer cone angle. Below -1 for point lights.
+    glm::vec4 directionCosOuter;
+};
+
+static_assert(sizeof(GpuLight) == 48, "GpuLight must match the shader layout.");
+
+// Per frame uniforms of cluster.comp and shader.frag, std140.
+struct ClusterUniforms
+{
+    glm::mat4 view;
+    glm::vec2 projectionScale;
+    glm::vec2 screenSize;
+    float near;
+    float far;
+    float sliceScale;
+    float sliceBias;
+    // Grid size, light count in w.
+    uint32_t clusterCount[4];
+    uint32_t indexCapacity;
+    uint32_t padding[3];
+};
+
+static_assert(sizeof(ClusterUniforms) == 128, "ClusterUniforms must match the shader layout.");
+
+// Lists written by the assignment, read by the shading passes.
+struct LightResources
+{
+    RenderResource clusters;
+    RenderResource indices;
+};
+
+// Clustered forward shading. Each frame a compute pass assigns the lights
+// to the froxels of ClusterGrid and writes one compact index list per
+// cluster, the fragment shader then only loops over its own cluster.
+class ClusteredLighting
+{
+public:
+    ClusteredLighting(){};
+    ~ClusteredLighting(){};
+
+    void init(Swapchain &swapchain, PipelineRegistry &pipelines, uint32_t maxLights);
+    void clean();
+
+    // Lights past maxLights are ignored.
+    void addPointLight(const glm::vec3 &position, float range, const glm::vec3 &color);
+    // Cone angles in radians, from the axis.
+    void addSpotLight(
+        const glm::vec3 &position,
+        float range,
+        const glm::vec3 &color,
+        const glm::vec3 &direction,
+        float innerAngle,
+        float outerAngle);
+
+    // Uploads the lights and adds the assignment passes. The passes reading
+    // the lists declare them as fragment shader reads.
+    LightResources addPasses(
+        RenderGraph &graph,
+        uint32_t imageIndex,
+        const glm::mat4 &view,
+        const glm::mat4 &projection,
+        float near,
+        float far,
+        VkExtent2D extent);
+
+    // Bound to the frame descriptor set for the fragment shader.
+    VkDescriptorBufferInfo uniformInfo(uint32_t imageIndex) const { return {_uniformBuffers[imageIndex], 0, sizeof(ClusterUniforms)}; }
+    VkDescriptorBufferInfo lightInfo(uint32_t imageIndex) const { return {_lightBuffers[imageIndex], 0, VK_WHOLE_SIZE}; }
+    VkDescriptorBufferInfo clusterInfo(uint32_t imageIndex) const { return {_clusterBuffers[imageIndex], 0, VK_WHOLE_SIZE}; }
+    VkDescriptorBufferInfo indexInfo(uint32_t imageIndex) const { return {_indexBuffers[imageIndex], 0, VK_WHOLE_SIZE}; }
+
+    size_t lightCount() const { return _lights.size(); }
+
+private:
+    void _createDescriptorSets(uint32_t imageCount);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    uint32_t _maxLights = 0;
+    uint32_t _indexCapacity = 0;
+    std::vector<GpuLight> _lights;
+
+    // Per frame data.
+    std::vector<VkBuffer> _uniformBuffers;
+    std::vector<VkDeviceMemory> _uniformBuffersMemory;
+    std::vector<void *> _uniformData;
+    std::vector<VkBuffer> _lightBuffers;
+    std::vector<VkDeviceMemory> _lightBuffersMemory;
+    std::vector<void *> _lightData;
+    // Written by the assignment pass.
+    std::vector<VkBuffer> _clusterBuffers;
+    std::vector<VkDeviceMemory> _clusterBuffersMemory;
+    std::vector<VkBuffer> _indexBuffers;
+    std::vector<VkDeviceMemory> _indexBuffersMemory;
+    std::vector<VkBuffer> _counterBuffers;
+    std::vector<VkDeviceMemory> _counterBuffersMemory;
+
+    VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> _sets;
+    VkPipelineLayout _layout = VK_NULL_HANDLE;
+    VkPipeline _pipeline = VK_NULL_HANDLE;
+};
+
+#endif
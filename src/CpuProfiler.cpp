@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include "CpuProfiler.hpp"
+
+std::atomic<bool> CpuProfiler::_enabled{false};
+thread_local CpuProfiler::ThreadBuffer *CpuProfiler::_localBuffer = nullptr;
+
+namespace
+{
+// Set before the thread has a ring, it takes it then.
+thread_local std::string threadName;
+
+// As a JSON string, names may hold quotes or backslashes.
+void writeString(std::ostream &file, const char *text)
+{
+    file << '"';
+    for (const char *c = text; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            file << '\\' << *c;
+        }
+        else if (static_cast<unsigned char>(*c) < 0x20)
+        {
+            file << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(*c) << std::dec << std::setfill(' ');
+        }
+        else
+        {
+            file << *c;
+        }
+    }
+    file << '"';
+}
+}
+
+CpuProfiler &CpuProfiler::instance()
+{
+    static CpuProfiler profiler;
+
+    return profiler;
+}
+
+uint64_t CpuProfiler::now()
+{
+    auto time = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+}
+
+void CpuProfiler::capture(const std::string &path, uint32_t frames, uint32_t skip)
+{
+    if (_state != State::Idle)
+    {
+        std::cerr << "A trace is already being captured." << std::endl;
+        return;
+    }
+
+    _path = path;
+    _frames = std::max(frames, 1u);
+    _skip = skip;
+    _state = State::Waiting;
+}
+
+void CpuProfiler::endFrame()
+{
+    switch (_state)
+    {
+    case State::Idle:
+        break;
+    case State::Waiting:
+        if (_skip > 0)
+        {
+            _skip--;
+            break;
+        }
+        _start = now();
+        _enabled.store(true, std::memory_order_relaxed);
+        _state = State::Recording;
+        break;
+    case State::Recording:
+        if (--_frames > 0)
+        {
+            break;
+        }
+        _end = now();
+        _enabled.store(false, std::memory_order_relaxed);
+        _state = State::Idle;
+        _export();
+        break;
+    }
+}
+
+void CpuProfiler::record(const char *name, uint64_t start, uint64_t end)
+{
+    ThreadBuffer &buffer = _threadBuffer();
+
+    // Single writer, the head publishes the slot. The fence keeps the slot
+    // stores after the previous head store, so a reader that saw them
+    // before its acquire fence sees the head move past the slot it read.
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Event &event = buffer.events[head % RING_SIZE];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::setThreadName(const std::string &name)
+{
+    threadName = name;
+    if (_localBuffer)
+    {
+        std::lock_guard<std::mutex> lock(_buffersMutex);
+        _localBuffer->name = name;
+    }
+}
+
+CpuProfiler::ThreadBuffer &CpuProfiler::_threadBuffer()
+{
+    if (!_localBuffer)
+    {
+        std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+        buffer->events.reset(new Event[RING_SIZE]);
+
+        std::lock_guard<std::mutex> lock(_buffersMutex);
+        buffer->id = static_cast<uint32_t>(_buffers.size()) + 1;
+        buffer->name = threadName.empty() ? "thread " + std::to_string(buffer->id) : threadName;
+        _localBuffer = buffer.get();
+        _buffers.push_back(std::move(buffer));
+    }
+
+    return *_localBuffer;
+}
+
+void CpuProfiler::_export() const
+{
+    std::ofstream file(_path);
+    if (!file)
+    {
+        std::cerr << "Unable to write trace " << _path << "." << std::endl;
+        return;
+    }
+
+    // Microseconds from the start of the capture.
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"vulkanDemo\"}}";
+
+    size_t eventCount = 0;
+    bool overwritten = false;
+    std::lock_guard<std::mutex> lock(_buffersMutex);
+    for (const auto &buffer : _buffers)
+    {
+        file << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->id
+             << ", \"args\": {\"name\": ";
+        writeString(file, buffer->name.c_str());
+        file << "}}";
+
+        // Other threads may still write, a slot read while it was rewritten
+        // is past the ring once the head is read again.
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = head > RING_SIZE ? head - RING_SIZE : 0;
+        bool oldest = true;
+        for (uint64_t i = first; i < head; i++)
+        {
+            const Event &event = buffer->events[i % RING_SIZE];
+            const char *name = event.name.load(std::memory_order_relaxed);
+            uint64_t start = event.start.load(std::memory_order_relaxed);
+            uint64_t end = event.end.load(std::memory_order_relaxed);
+            // Pairs with the fence in record, the field loads may not move
+            // past the head check below.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (i + RING_SIZE <= buffer->head.load(std::memory_order_acquire))
+            {
+                continue;
+            }
+
+            // The ring wrapped inside the capture.
+            if (oldest && first > 0 && start >= _start)
+            {
+                overwritten = true;
+            }
+            oldest = false;
+            if (start < _start || start >= _end)
+            {
+                continue;
+            }
+
+            file << ",\n{\"name\": ";
+            writeString(file, name);
+            file << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id
+                 << ", \"ts\": " << (start - _start) * 1e-3 << ", \"dur\": " << (end - start) * 1e-3 << "}";
+            eventCount++;
+        }
+    }
+    file << "\n]}\n";
+
+    std::cout << "Trace of " << eventCount << " events written to " << _path << "." << std::endl;
+    if (overwritten)
+    {
+        std::cerr << "The trace is missing its oldest events, capture fewer frames." << std::endl;
+    }
+}
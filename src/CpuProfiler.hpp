@@ -0,0 +1,114 @@
+#ifndef CpuProfiler_hpp
+#define CpuProfiler_hpp
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "common.hpp"
+
+// Scoped CPU markers for a range of frames, exported as Chrome trace events
+// for chrome://tracing or Perfetto. Each thread writes the scopes it ends
+// into a ring buffer of its own, so recording takes no lock, and the export
+// keeps what falls in the captured frames. Between captures markers only
+// test a flag.
+class CpuProfiler
+{
+public:
+    static CpuProfiler &instance();
+
+    static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+    // Nanoseconds on the steady clock.
+    static uint64_t now();
+
+    // Records `frames` frames once `skip` more have passed, then writes them
+    // to `path`. Ignored while a capture is running.
+    void capture(const std::string &path, uint32_t frames, uint32_t skip = 0);
+    bool capturing() const { return _state != State::Idle; }
+    // Between two frames, on the main thread.
+    void endFrame();
+
+    // `name` must outlive the profiler, string literals do.
+    void record(const char *name, uint64_t start, uint64_t end);
+    // Shown for the calling thread in the trace.
+    void setThreadName(const std::string &name);
+
+private:
+    CpuProfiler(){};
+    CpuProfiler(CpuProfiler const &) = delete;
+    void operator=(CpuProfiler const &) = delete;
+
+    // Per thread, scopes past that many in a capture overwrite the oldest.
+    static const uint32_t RING_SIZE = 1 << 16;
+
+    // Fields are atomic since the export may read a slot being rewritten,
+    // it then drops it.
+    struct Event
+    {
+        std::atomic<const char *> name;
+        std::atomic<uint64_t> start;
+        std::atomic<uint64_t> end;
+    };
+
+    struct ThreadBuffer
+    {
+        std::string name;
+        uint32_t id = 0;
+        // Events written so far, the ring holds the last RING_SIZE.
+        std::atomic<uint64_t> head{0};
+        std::unique_ptr<Event[]> events;
+    };
+
+    enum class State
+    {
+        Idle,
+        Waiting,
+        Recording,
+    };
+
+    ThreadBuffer &_threadBuffer();
+    void _export() const;
+
+    static std::atomic<bool> _enabled;
+    // Ring of the calling thread, created on its first marker.
+    static thread_local ThreadBuffer *_localBuffer;
+
+    // Registered on their first marker, kept until exit.
+    mutable std::mutex _buffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> _buffers;
+
+    // Main thread only.
+    State _state = State::Idle;
+    std::string _path;
+    uint32_t _frames = 0;
+    uint32_t _skip = 0;
+    uint64_t _start = 0;
+    uint64_t _end = 0;
+};
+
+// Marker for the enclosing C++ scope.
+class CpuScope
+{
+public:
+    explicit CpuScope(const char *name)
+        : _name(name), _start(CpuProfiler::enabled() ? CpuProfiler::now() : 0)
+    {
+    }
+
+    ~CpuScope()
+    {
+        if (_start != 0)
+        {
+            CpuProfiler::instance().record(_name, _start, CpuProfiler::now());
+        }
+    }
+
+private:
+    CpuScope(CpuScope const &) = delete;
+    void operator=(CpuScope const &) = delete;
+
+    const char *_name;
+    uint64_t _start;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef DrawKey_hpp
+#define DrawKey_hpp
+
+#include <algorithm>
+#include <cstdint>
+
+// 64 bit draw sort key, most significant field first:
+// pipeline (12) | material (8) | mesh (20) | depth (24).
+// Sorting ascending groups draws by state, the most expensive change
+// first, then front to back inside a state for early-Z.
+struct DrawKey
+{
+    static const uint32_t DEPTH_BITS = 24;
+    static const uint32_t MESH_BITS = 20;
+    static const uint32_t MATERIAL_BITS = 8;
+    static const uint32_t PIPELINE_BITS = 12;
+
+    // `depth` is normalized, 0 at the camera.
+    static uint64_t make(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+    {
+        const float depthMax = static_cast<float>((1u << DEPTH_BITS) - 1);
+        uint32_t quantized = static_cast<uint32_t>(std::min(std::max(depth, 0.0f), 1.0f) * depthMax);
+
+        return (field(pipeline, PIPELINE_BITS) << (MATERIAL_BITS + MESH_BITS + DEPTH_BITS)) |
+               (field(material, MATERIAL_BITS) << (MESH_BITS + DEPTH_BITS)) |
+               (field(mesh, MESH_BITS) << DEPTH_BITS) |
+               quantized;
+    }
+
+    // Key without the depth, equal for draws that can share one instanced call.
+    static uint64_t state(uint64_t key) { return key >> DEPTH_BITS; }
+
+    static uint32_t pipeline(uint64_t key) { return extract(key, MATERIAL_BITS + MESH_BITS + DEPTH_BITS, PIPELINE_BITS); }
+    static uint32_t material(uint64_t key) { return extract(key, MESH_BITS + DEPTH_BITS, MATERIAL_BITS); }
+    static uint32_t mesh(uint64_t key) { return extract(key, DEPTH_BITS, MESH_BITS); }
+
+private:
+    static uint64_t field(uint32_t value, uint32_t bits) { return static_cast<uint64_t>(value) & ((1ull << bits) - 1); }
+    static uint32_t extract(uint64_t key, uint32_t shift, uint32_t bits) { return static_cast<uint32_t>((key >> shift) & ((1ull << bits) - 1)); }
+};
+
+#endif
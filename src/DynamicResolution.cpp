@@ -0,0 +1,200 @@
+#include "DynamicResolution.hpp"
+#include "ApiCounters.hpp"
+
+const std::string FULLSCREEN_VERT_SHADER_PATH = "./resources/shaders/fullscreen_vert.spv";
+const std::string UPSCALE_FRAG_SHADER_PATH = "./resources/shaders/upscale_frag.spv";
+
+namespace
+{
+// Weight of a new measurement in the average.
+const float SMOOTHING = 0.1f;
+// Fraction of the way to the ideal scale taken per measurement.
+const float STEP = 0.25f;
+// Below this fraction of the budget the scale goes back up.
+const float HEADROOM = 0.85f;
+}
+
+void ResolutionController::update(float gpuTime)
+{
+    averageTime = averageTime > 0.0f ? glm::mix(averageTime, gpuTime, SMOOTHING) : gpuTime;
+    if (averageTime <= 0.0f || (averageTime <= budget && averageTime >= HEADROOM * budget))
+    {
+        return;
+    }
+
+    float ideal = scale * std::sqrt(budget / averageTime);
+    scale = glm::clamp(glm::mix(scale, ideal, STEP), minScale, maxScale);
+}
+
+void DynamicResolution::init(Swapchain &swapchain, PipelineRegistry &pipelines, float budget, float minScale)
+{
+    _device = swapchain.device;
+    _extent = swapchain.parameters.extent;
+    _controller.budget = budget;
+    _controller.minScale = std::min(minScale, _controller.maxScale);
+
+    // Bilinear between texels, upscale.frag keeps away from the edges itself.
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    if (vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create texture sampler.");
+    }
+
+    _setLayout = VulkanUtilities::createDescriptorSetLayout(
+        _device,
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER},
+        VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create descriptor pool.");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_setLayout;
+
+    if (vkAllocateDescriptorSets(_device, &allocInfo, &_set) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to allocate descriptor sets.");
+    }
+
+    VkPushConstantRange constants = {};
+    constants.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    constants.offset = 0;
+    constants.size = sizeof(UpscaleConstants);
+
+    // One full screen triangle over the swapchain image.
+    _pipelines = &pipelines;
+    _pipelineState.vertexShader = pipelines.loadShader(FULLSCREEN_VERT_SHADER_PATH);
+    _pipelineState.fragmentShader = pipelines.loadShader(UPSCALE_FRAG_SHADER_PATH);
+    _pipelineState.vertexLayout = VertexLayout::None;
+    _pipelineState.depthTest = VK_FALSE;
+    _pipelineState.depthWrite = VK_FALSE;
+    _pipelineState.layout = pipelines.getLayout({_setLayout}, {constants});
+    _pipelineState.subpass = 0;
+
+    resize(swapchain, pipelines);
+}
+
+void DynamicResolution::resize(Swapchain &swapchain, PipelineRegistry &pipelines)
+{
+    _extent = swapchain.parameters.extent;
+    _renderPass = swapchain.presentRenderPass;
+    _framebuffers = swapchain.getPresentFramebuffers();
+    _updateSet(swapchain);
+
+    _pipelineState.renderPassKey = swapchain.presentRenderPassKey;
+    _pipeline = pipelines.request(_pipelineState, _renderPass);
+}
+
+void DynamicResolution::_updateSet(Swapchain &swapchain)
+{
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler = _sampler;
+    imageInfo.imageView = swapchain.getSceneColorImageView();
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = _set;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    Counted::vkUpdateDescriptorSets(_device, 1, &descriptorWrite, 0, nullptr);
+}
+
+VkExtent2D DynamicResolution::renderExtent() const
+{
+    VkExtent2D extent;
+    extent.width = std::max(1u, static_cast<uint32_t>(_extent.width * _controller.scale + 0.5f));
+    extent.height = std::max(1u, static_cast<uint32_t>(_extent.height * _controller.scale + 0.5f));
+    extent.width = std::min(extent.width, _extent.width);
+    extent.height = std::min(extent.height, _extent.height);
+    return extent;
+}
+
+void DynamicResolution::addUpscalePass(RenderGraph &graph, uint32_t imageIndex, RenderResource scene, RenderResource target)
+{
+    VkExtent2D rendered = renderExtent();
+    glm::vec2 size(_extent.width, _extent.height);
+
+    UpscaleConstants constants = {};
+    constants.inputScale = glm::vec2(rendered.width, rendered.height) / size;
+    constants.inputTexel = glm::vec2(1.0f) / size;
+    constants.outputSize = size;
+    constants.sharpness = MAX_SHARPNESS * glm::clamp(2.0f * (1.0f - _controller.scale), 0.0f, 1.0f);
+
+    VkFramebuffer framebuffer = _framebuffers[imageIndex];
+    RenderPassId pass = graph.addPass("upscale", [this, framebuffer, constants](VkCommandBuffer commandBuffer) {
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = _renderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea.extent = _extent;
+
+        VkViewport viewport = {};
+        viewport.width = static_cast<float>(_extent.width);
+        viewport.height = static_cast<float>(_extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        VkRect2D scissor = {};
+        scissor.extent = _extent;
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        // Skipped while the pipeline compiles, like the deferred lighting.
+        if (_pipelines->isReady(_pipeline))
+        {
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            Counted::vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines->pipeline(_pipeline));
+            Counted::vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                _pipelineState.layout,
+                0,
+                1,
+                &_set,
+                0,
+                nullptr);
+            Counted::vkCmdPushConstants(commandBuffer, _pipelineState.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+            Counted::vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        }
+        vkCmdEndRenderPass(commandBuffer);
+    });
+    graph.read(pass, scene, ResourceUsage::FragmentRead);
+    graph.attachment(pass, target, ResourceUsage::ColorAttachment, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+}
+
+void DynamicResolution::clean()
+{
+    // The layout and pipeline belong to the registry.
+    vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+    vkDestroySampler(_device, _sampler, nullptr);
+}
@@ -0,0 +1,85 @@
+#ifndef DynamicResolution_hpp
+#define DynamicResolution_hpp
+
+#include "common.hpp"
+#include "PipelineRegistry.hpp"
+#include "RenderGraph.hpp"
+#include "Swapchain.hpp"
+
+// Picks the render scale from the measured GPU frame time. The cost of a
+// frame mostly follows its pixel count, the square of the scale, so each
+// step aims at the scale that would fit the budget. It only moves once the
+// time leaves a band under the budget, and then only part of the way.
+struct ResolutionController
+{
+    // Milliseconds.
+    float budget = 16.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float scale = 1.0f;
+    // Smoothed measurements, 0 before the first one.
+    float averageTime = 0.0f;
+
+    void update(float gpuTime);
+};
+
+// Push constants of upscale.frag.
+struct UpscaleConstants
+{
+    glm::vec2 inputScale;
+    glm::vec2 inputTexel;
+    glm::vec2 outputSize;
+    float sharpness;
+    float padding;
+};
+
+// Renders the scene to a part of Swapchain's offscreen color image, sized by
+// ResolutionController, and scales it to the swapchain image in a last pass.
+// The GPU frame time comes from GpuProfiler.
+class DynamicResolution
+{
+public:
+    DynamicResolution(){};
+    ~DynamicResolution(){};
+
+    // Budget in milliseconds. A minimum scale of 1 keeps the full resolution.
+    void init(Swapchain &swapchain, PipelineRegistry &pipelines, float budget, float minScale);
+    void resize(Swapchain &swapchain, PipelineRegistry &pipelines);
+    void clean();
+
+    // With each GPU frame time measured, in milliseconds.
+    void update(float gpuTime) { _controller.update(gpuTime); }
+
+    // Part of the offscreen image the scene renders to this frame, from the
+    // top left corner.
+    VkExtent2D renderExtent() const;
+
+    // Scales `scene` into `target`, the swapchain image.
+    void addUpscalePass(RenderGraph &graph, uint32_t imageIndex, RenderResource scene, RenderResource target);
+
+    float scale() const { return _controller.scale; }
+    float gpuTime() const { return _controller.averageTime; }
+
+private:
+    void _updateSet(Swapchain &swapchain);
+
+    // Reached at half resolution, none at full resolution.
+    static constexpr float MAX_SHARPNESS = 0.8f;
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VkExtent2D _extent = {};
+    ResolutionController _controller;
+
+    VkSampler _sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet _set = VK_NULL_HANDLE;
+
+    PipelineRegistry *_pipelines = nullptr;
+    PipelineState _pipelineState;
+    PipelineHandle _pipeline = INVALID_PIPELINE;
+    VkRenderPass _renderPass = VK_NULL_HANDLE;
+    std::vector<VkFramebuffer> _framebuffers;
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <sstream>
+
+#include "FrameCounters.hpp"
+
+namespace
+{
+// Bits in StatisticInputVertices order, results come lowest bit first.
+const VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+// Millions, one decimal.
+std::string millions(uint64_t value)
+{
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed << value * 1e-6 << "M";
+    return out.str();
+}
+}
+
+void FrameCounters::init(Swapchain &swapchain, const std::string &csvPath)
+{
+    _device = swapchain.device;
+    _statistics = swapchain.features.pipelineStatisticsQuery == VK_TRUE;
+    if (!_statistics)
+    {
+        std::cerr << "Pipeline statistics are unsupported, only Vulkan calls are counted." << std::endl;
+    }
+
+    VkQueryPoolCreateInfo queryInfo = {};
+    queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryInfo.queryCount = 1;
+    queryInfo.pipelineStatistics = STATISTIC_FLAGS;
+
+    _frames.resize(swapchain.imageCount);
+    for (auto &frame : _frames)
+    {
+        if (_statistics && vkCreateQueryPool(_device, &queryInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Unable to create query pool.");
+        }
+    }
+
+    if (!csvPath.empty())
+    {
+        _csv.open(csvPath);
+        if (!_csv)
+        {
+            throw std::runtime_error("Unable to write frame counters " + csvPath + ".");
+        }
+
+        for (uint32_t statistic = 0; statistic < StatisticCount; statistic++)
+        {
+            _csv << name(static_cast<PipelineStatistic>(statistic)) << ",";
+        }
+        for (uint32_t call = 0; call < ApiCallCount; call++)
+        {
+            _csv << ApiCounters::name(static_cast<ApiCall>(call)) << (call + 1 < ApiCallCount ? "," : "\n");
+        }
+    }
+
+    // Calls made while loading are not a frame's.
+    ApiCounters::take();
+}
+
+void FrameCounters::clean()
+{
+    for (auto &frame : _frames)
+    {
+        if (frame.queryPool != VK_NULL_HANDLE)
+        {
+            vkDestroyQueryPool(_device, frame.queryPool, nullptr);
+        }
+    }
+    _frames.clear();
+    _previous = NO_FRAME;
+    _csv.close();
+}
+
+void FrameCounters::beginFrame(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    // Everything since the previous frame began is that frame's.
+    ApiCounts calls = ApiCounters::take();
+    if (_previous != NO_FRAME)
+    {
+        _frames[_previous].calls = calls;
+    }
+    _previous = imageIndex;
+
+    Frame &frame = _frames[imageIndex];
+    FrameCounts counts;
+    if (frame.pending && _read(frame, counts))
+    {
+        _last = counts;
+        for (uint32_t statistic = 0; statistic < StatisticCount; statistic++)
+        {
+            _totals.statistics[statistic] += counts.statistics[statistic];
+        }
+        for (uint32_t call = 0; call < ApiCallCount; call++)
+        {
+            _totals.calls[call] += counts.calls[call];
+        }
+        _totalFrames++;
+
+        if (_csv.is_open())
+        {
+            for (uint64_t value : counts.statistics)
+            {
+                _csv << value << ",";
+            }
+            for (uint32_t call = 0; call < ApiCallCount; call++)
+            {
+                _csv << counts.calls[call] << (call + 1 < ApiCallCount ? "," : "\n");
+            }
+        }
+    }
+    frame.pending = false;
+
+    _recording = true;
+    if (_statistics)
+    {
+        vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, 1);
+        vkCmdBeginQuery(commandBuffer, frame.queryPool, 0, 0);
+    }
+}
+
+void FrameCounters::endFrame(VkCommandBuffer commandBuffer)
+{
+    if (!_recording)
+    {
+        return;
+    }
+
+    if (_statistics)
+    {
+        vkCmdEndQuery(commandBuffer, _frames[_previous].queryPool, 0);
+    }
+    _frames[_previous].pending = true;
+    _recording = false;
+}
+
+bool FrameCounters::_read(Frame &frame, FrameCounts &counts)
+{
+    counts.calls = frame.calls;
+    if (!_statistics)
+    {
+        return true;
+    }
+
+    // No wait flag, not ready means the frame is still on the GPU.
+    VkResult result = vkGetQueryPoolResults(
+        _device,
+        frame.queryPool,
+        0,
+        1,
+        sizeof(counts.statistics),
+        counts.statistics.data(),
+        sizeof(counts.statistics),
+        VK_QUERY_RESULT_64_BIT);
+    return result == VK_SUCCESS;
+}
+
+FrameCounts FrameCounters::averages() const
+{
+    FrameCounts averages = _totals;
+    uint32_t frames = std::max(_totalFrames, 1u);
+    for (auto &value : averages.statistics)
+    {
+        value /= frames;
+    }
+    for (auto &value : averages.calls)
+    {
+        value /= frames;
+    }
+    return averages;
+}
+
+void FrameCounters::resetAverages()
+{
+    _totals = FrameCounts();
+    _totalFrames = 0;
+}
+
+std::string FrameCounters::summary() const
+{
+    std::ostringstream out;
+    if (_statistics)
+    {
+        out << millions(_last.statistics[StatisticInputPrimitives]) << " primitives, "
+            << millions(_last.statistics[StatisticClippingPrimitives]) << " after clipping, "
+            << millions(_last.statistics[StatisticFragmentInvocations]) << " fragments, ";
+    }
+    out << _last.calls[ApiDraw] << " draws, "
+        << _last.calls[ApiBindPipeline] + _last.calls[ApiBindDescriptorSets] + _last.calls[ApiBindBuffers] << " binds, "
+        << _last.calls[ApiSubmit] << " submits";
+    return out.str();
+}
+
+const char *FrameCounters::name(PipelineStatistic statistic)
+{
+    static const char *names[StatisticCount] = {
+        "input vertices",
+        "input primitives",
+        "vertex invocations",
+        "clipping invocations",
+        "clipping primitives",
+        "fragment invocations",
+    };
+
+    return names[statistic];
+}
@@ -0,0 +1,89 @@
+#ifndef FrameCounters_hpp
+#define FrameCounters_hpp
+
+#include <fstream>
+
+#include "common.hpp"
+#include "ApiCounters.hpp"
+#include "Swapchain.hpp"
+
+// Pipeline statistics, in the order the query returns them.
+enum PipelineStatistic : uint32_t
+{
+    StatisticInputVertices,
+    StatisticInputPrimitives,
+    StatisticVertexInvocations,
+    // Primitives entering clipping, and the ones left after it.
+    StatisticClippingInvocations,
+    StatisticClippingPrimitives,
+    StatisticFragmentInvocations,
+
+    StatisticCount,
+};
+
+// Workload of one frame. Geometry and shading from the GPU, API overhead
+// from the CPU.
+struct FrameCounts
+{
+    // Zero without pipeline statistics support.
+    std::array<uint64_t, StatisticCount> statistics = {};
+    ApiCounts calls = {};
+};
+
+// Per frame pipeline statistics and Vulkan call counts. The statistics
+// query covers the whole command buffer and is read when its swapchain
+// image is recorded again, like GpuProfiler's timestamps, together with
+// the calls made for that frame. A frame still on the GPU is skipped.
+class FrameCounters
+{
+public:
+    FrameCounters(){};
+    ~FrameCounters(){};
+
+    // One line per frame to `csvPath`, unless empty.
+    void init(Swapchain &swapchain, const std::string &csvPath);
+    void clean();
+
+    // Right after vkBeginCommandBuffer, outside any render pass.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    // Right before vkEndCommandBuffer.
+    void endFrame(VkCommandBuffer commandBuffer);
+
+    bool hasStatistics() const { return _statistics; }
+    // Last frame read, all zero before the first.
+    const FrameCounts &last() const { return _last; }
+    // Per frame, over the frames read since the last reset.
+    FrameCounts averages() const;
+    void resetAverages();
+    // Main counts of the last frame read, short enough for a window title.
+    std::string summary() const;
+
+    static const char *name(PipelineStatistic statistic);
+
+private:
+    struct Frame
+    {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        // Made between its beginFrame and the next one.
+        ApiCounts calls = {};
+        bool pending = false;
+    };
+
+    static const uint32_t NO_FRAME = ~0u;
+
+    bool _read(Frame &frame, FrameCounts &counts);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    bool _statistics = false;
+    std::vector<Frame> _frames;
+    uint32_t _previous = NO_FRAME;
+    bool _recording = false;
+
+    FrameCounts _last;
+    FrameCounts _totals;
+    uint32_t _totalFrames = 0;
+
+    std::ofstream _csv;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef Frustum_hpp
+#define Frustum_hpp
+
+#include "common.hpp"
+
+// Six planes pointing inwards, extracted from a view-projection matrix
+// with a [0, 1] depth range.
+struct Frustum
+{
+    enum Plane
+    {
+        Left,
+        Right,
+        Bottom,
+        Top,
+        Near,
+        Far,
+        PlaneCount
+    };
+
+    glm::vec4 planes[PlaneCount];
+
+    static Frustum fromMatrix(const glm::mat4 &viewProjection)
+    {
+        // glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+        {
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        }
+
+        Frustum frustum;
+        frustum.planes[Left] = rows[3] + rows[0];
+        frustum.planes[Right] = rows[3] - rows[0];
+        frustum.planes[Bottom] = rows[3] + rows[1];
+        frustum.planes[Top] = rows[3] - rows[1];
+        frustum.planes[Near] = rows[2];
+        frustum.planes[Far] = rows[3] - rows[2];
+
+        for (int i = 0; i < PlaneCount; i++)
+        {
+            glm::vec4 &plane = frustum.planes[i];
+            float length = glm::length(glm::vec3(plane.x, plane.y, plane.z));
+            plane = plane / length;
+        }
+
+        return frustum;
+    }
+
+    bool intersectsSphere(const glm::vec3 &center, float radius) const
+    {
+        for (int i = 0; i < PlaneCount; i++)
+        {
+            const glm::vec4 &plane = planes[i];
+            if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool intersectsBox(const glm::vec3 &min, const glm::vec3 &max) const
+    {
+        for (int i = 0; i < PlaneCount; i++)
+        {
+            const glm::vec4 &plane = planes[i];
+
+            // Corner furthest along the plane normal.
+            glm::vec3 corner(
+                plane.x >= 0.0f ? max.x : min.x,
+                plane.y >= 0.0f ? max.y : min.y,
+                plane.z >= 0.0f ? max.z : min.z);
+
+            if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Entirely on the inner side of every plane.
+    bool containsBox(const glm::vec3 &min, const glm::vec3 &max) const
+    {
+        for (int i = 0; i < PlaneCount; i++)
+        {
+            const glm::vec4 &plane = planes[i];
+
+            // Corner least along the plane normal.
+            glm::vec3 corner(
+                plane.x >= 0.0f ? min.x : max.x,
+                plane.y >= 0.0f ? min.y : max.y,
+                plane.z >= 0.0f ? min.z : max.z);
+
+            if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+#endif
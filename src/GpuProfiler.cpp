@@ -0,0 +1,198 @@
+#include <algorithm>
+
+#include "GpuProfiler.hpp"
+
+void GpuProfiler::init(Swapchain &swapchain)
+{
+    _device = swapchain.device;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(swapchain.physicalDevice, &properties);
+    _available = properties.limits.timestampComputeAndGraphics == VK_TRUE;
+    _timestampPeriod = properties.limits.timestampPeriod;
+    if (!_available)
+    {
+        std::cerr << "Timestamps are unsupported, GPU times are not measured." << std::endl;
+        return;
+    }
+
+    // Every graphics queue counts with the same bits then, take the first.
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(swapchain.physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(swapchain.physicalDevice, &familyCount, families.data());
+    for (const auto &family : families)
+    {
+        if (family.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        {
+            uint32_t bits = family.timestampValidBits;
+            _timestampMask = bits >= 64 ? ~0ull : (1ull << bits) - 1;
+            break;
+        }
+    }
+
+    VkQueryPoolCreateInfo queryInfo = {};
+    queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = 2 * MAX_SCOPES;
+
+    _frames.resize(swapchain.imageCount);
+    for (auto &frame : _frames)
+    {
+        if (vkCreateQueryPool(_device, &queryInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Unable to create query pool.");
+        }
+    }
+    _timestamps.resize(2 * MAX_SCOPES);
+}
+
+void GpuProfiler::clean()
+{
+    for (auto &frame : _frames)
+    {
+        vkDestroyQueryPool(_device, frame.queryPool, nullptr);
+    }
+    _frames.clear();
+    _frame = nullptr;
+    _open.clear();
+    _results.clear();
+    resetAverages();
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    _results.clear();
+    if (!_available)
+    {
+        return;
+    }
+
+    _frame = &_frames[imageIndex];
+    if (_frame->pending)
+    {
+        _read(*_frame);
+        _frame->pending = false;
+    }
+
+    _frame->names.clear();
+    _frame->depths.clear();
+    _open.clear();
+    vkCmdResetQueryPool(commandBuffer, _frame->queryPool, 0, 2 * MAX_SCOPES);
+    beginScope(commandBuffer, "frame");
+}
+
+void GpuProfiler::endFrame(VkCommandBuffer commandBuffer)
+{
+    if (!_frame)
+    {
+        return;
+    }
+
+    // Scopes left open end with the frame.
+    while (!_open.empty())
+    {
+        endScope(commandBuffer);
+    }
+    _frame->pending = !_frame->names.empty();
+    _frame = nullptr;
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string &name)
+{
+    if (!_frame)
+    {
+        return;
+    }
+
+    uint32_t scope = static_cast<uint32_t>(_frame->names.size());
+    if (scope >= MAX_SCOPES)
+    {
+        _open.push_back(NO_SCOPE);
+        return;
+    }
+
+    _frame->names.push_back(name);
+    _frame->depths.push_back(static_cast<uint32_t>(_open.size()));
+    _open.push_back(scope);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _frame->queryPool, 2 * scope);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer)
+{
+    if (!_frame || _open.empty())
+    {
+        return;
+    }
+
+    uint32_t scope = _open.back();
+    _open.pop_back();
+    if (scope != NO_SCOPE)
+    {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _frame->queryPool, 2 * scope + 1);
+    }
+}
+
+void GpuProfiler::_read(Frame &frame)
+{
+    // No wait flag, not ready means the frame is still on the GPU.
+    uint32_t queryCount = 2 * static_cast<uint32_t>(frame.names.size());
+    VkResult result = vkGetQueryPoolResults(
+        _device,
+        frame.queryPool,
+        0,
+        queryCount,
+        queryCount * sizeof(uint64_t),
+        _timestamps.data(),
+        sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+    {
+        return;
+    }
+
+    _results.resize(frame.names.size());
+    for (size_t i = 0; i < frame.names.size(); i++)
+    {
+        uint64_t ticks = (_timestamps[2 * i + 1] - _timestamps[2 * i]) & _timestampMask;
+        _results[i].name = frame.names[i];
+        _results[i].depth = frame.depths[i];
+        _results[i].milliseconds = static_cast<double>(ticks) * _timestampPeriod * 1e-6;
+    }
+
+    // Scopes come and go with the passes, matched by name and depth. A new
+    // one goes after the scope before it, under the same parent.
+    size_t position = 0;
+    for (const GpuScopeTime &scope : _results)
+    {
+        auto total = std::find_if(_totals.begin(), _totals.end(), [&](const GpuScopeTime &candidate) {
+            return candidate.depth == scope.depth && candidate.name == scope.name;
+        });
+        if (total == _totals.end())
+        {
+            total = _totals.insert(_totals.begin() + position, scope);
+        }
+        else
+        {
+            total->milliseconds += scope.milliseconds;
+        }
+        position = static_cast<size_t>(total - _totals.begin()) + 1;
+    }
+    _totalFrames++;
+}
+
+std::vector<GpuScopeTime> GpuProfiler::averages() const
+{
+    std::vector<GpuScopeTime> averages = _totals;
+    for (auto &average : averages)
+    {
+        average.milliseconds /= std::max(_totalFrames, 1u);
+    }
+    return averages;
+}
+
+void GpuProfiler::resetAverages()
+{
+    _totals.clear();
+    _totalFrames = 0;
+}
@@ -0,0 +1,116 @@
+#ifndef GpuProfiler_hpp
+#define GpuProfiler_hpp
+
+#include "common.hpp"
+#include "Swapchain.hpp"
+
+// GPU time of one scope of a frame.
+struct GpuScopeTime
+{
+    std::string name;
+    // 0 for the whole frame, 1 for the scopes in it, and so on.
+    uint32_t depth = 0;
+    double milliseconds = 0.0;
+};
+
+// Measures nested scopes of the frame with a timestamp at each end. Every
+// swapchain image has its query pool, read when the image is recorded
+// again, a few frames later, so the CPU never waits for the GPU: a frame
+// still running then is skipped. Without timestamp support nothing is
+// recorded and no frame is ever read.
+class GpuProfiler
+{
+public:
+    GpuProfiler(){};
+    ~GpuProfiler(){};
+
+    void init(Swapchain &swapchain);
+    void clean();
+
+    // Reads the scopes of the previous frame on this image, then opens the
+    // frame scope. Right after vkBeginCommandBuffer.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    // Right before vkEndCommandBuffer.
+    void endFrame(VkCommandBuffer commandBuffer);
+
+    // Between beginFrame and endFrame, inside render passes too. Past
+    // MAX_SCOPES a frame, scopes are not measured.
+    void beginScope(VkCommandBuffer commandBuffer, const std::string &name);
+    void endScope(VkCommandBuffer commandBuffer);
+
+    bool available() const { return _available; }
+    // Read by the last beginFrame, parents before their children, empty if
+    // it read none.
+    const std::vector<GpuScopeTime> &results() const { return _results; }
+    // Milliseconds, negative if the last beginFrame read no frame.
+    double frameTime() const { return _results.empty() ? -1.0 : _results[0].milliseconds; }
+
+    // Time of each scope per frame, over the frames read since the last
+    // reset, in the order they first appeared.
+    std::vector<GpuScopeTime> averages() const;
+    void resetAverages();
+
+private:
+    static const uint32_t MAX_SCOPES = 64;
+    static const uint32_t NO_SCOPE = ~0u;
+
+    struct Frame
+    {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        // Scope i is timed by queries 2i and 2i + 1.
+        std::vector<std::string> names;
+        std::vector<uint32_t> depths;
+        bool pending = false;
+    };
+
+    void _read(Frame &frame);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    bool _available = false;
+    // Nanoseconds per tick.
+    double _timestampPeriod = 1.0;
+    // Bits the timestamps wrap around at.
+    uint64_t _timestampMask = ~0ull;
+
+    std::vector<Frame> _frames;
+    // Being recorded.
+    Frame *_frame = nullptr;
+    // Scopes open in it, NO_SCOPE past MAX_SCOPES.
+    std::vector<uint32_t> _open;
+
+    std::vector<uint64_t> _timestamps;
+    std::vector<GpuScopeTime> _results;
+    std::vector<GpuScopeTime> _totals;
+    uint32_t _totalFrames = 0;
+};
+
+// Scope that ends with the C++ one. Does nothing without a profiler.
+class GpuScope
+{
+public:
+    GpuScope(GpuProfiler *profiler, VkCommandBuffer commandBuffer, const std::string &name)
+        : _profiler(profiler), _commandBuffer(commandBuffer)
+    {
+        if (_profiler)
+        {
+            _profiler->beginScope(_commandBuffer, name);
+        }
+    }
+
+    ~GpuScope()
+    {
+        if (_profiler)
+        {
+            _profiler->endScope(_commandBuffer);
+        }
+    }
+
+private:
+    GpuScope(GpuScope const &) = delete;
+    void operator=(GpuScope const &) = delete;
+
+    GpuProfiler *_profiler;
+    VkCommandBuffer _commandBuffer;
+};
+
+#endif
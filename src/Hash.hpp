@@ -0,0 +1,31 @@
+#ifndef Hash_hpp
+#define Hash_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+// FNV-1a, good enough for cache keys and shader contents.
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = FNV_OFFSET_BASIS)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t hash = seed;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+template <typename T>
+inline uint64_t hashCombine(uint64_t seed, const T &value)
+{
+    return hashBytes(&value, sizeof(value), seed);
+}
+
+#endif
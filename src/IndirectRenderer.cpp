@@ -0,0 +1,757 @@
+#include <algorithm>
+
+#include "IndirectRenderer.hpp"
+#include "ApiCounters.hpp"
+#include "VulkanUtilities.hpp"
+
+const std::string CULL_SHADER_PATH = "./resources/shaders/cull.spv";
+const std::string INDIRECT_VERT_SHADER_PATH = "./resources/shaders/indirect_vert.spv";
+const std::string INDIRECT_FRAG_SHADER_PATH = "./resources/shaders/frag.spv";
+const std::string HIZ_SHADER_PATH = "./resources/shaders/hiz.spv";
+
+// Matches local_size_x in cull.comp.
+static const uint32_t CULL_GROUP_SIZE = 64;
+// Matches local_size_x and local_size_y in hiz.comp.
+static const uint32_t PYRAMID_GROUP_SIZE = 8;
+
+// Pushed to hiz.comp.
+struct PyramidConstants
+{
+    int32_t sourceSize[2];
+    int32_t destinationSize[2];
+};
+
+void IndirectRenderer::addInstance(const glm::mat4 &model, uint32_t mesh, const MeshPool &meshes)
+{
+    GpuInstance instance = {};
+    instance.model = model;
+    instance.boundingSphere = meshes.range(mesh).boundingSphere(model);
+    instance.mesh = mesh;
+    _instances.push_back(instance);
+}
+
+void IndirectRenderer::init(
+    Swapchain &swapchain,
+    PipelineRegistry &pipelines,
+    MeshPool &meshes,
+    VkDescriptorSetLayout frameSetLayout,
+    bool occlusionCulling)
+{
+    if (_instances.empty())
+    {
+        throw std::runtime_error("Unable to draw indirectly without instances.");
+    }
+
+    _device = swapchain.device;
+    _instanceCount = static_cast<uint32_t>(_instances.size());
+    _pipelines = &pipelines;
+    _meshes = &meshes;
+    _drawIndexedIndirectCount = swapchain.cmdDrawIndexedIndirectCount;
+    _occlusionCulling = occlusionCulling;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(swapchain.physicalDevice, &properties);
+    _maxDrawCount = swapchain.features.multiDrawIndirect ? properties.limits.maxDrawIndirectCount : 1;
+
+    // The count path can't be split across calls, use the per slot path instead.
+    if (_drawIndexedIndirectCount != nullptr && instanceCount() > _maxDrawCount)
+    {
+        _drawIndexedIndirectCount = nullptr;
+    }
+
+    std::cout << "Indirect renderer: " << instanceCount() << " instances, "
+              << (_drawIndexedIndirectCount != nullptr ? "count buffer" : "per slot draws")
+              << (_occlusionCulling ? ", Hi-Z occlusion culling." : ".") << std::endl;
+
+    std::vector<GpuMesh> gpuMeshes;
+    for (auto &range : meshes.ranges())
+    {
+        GpuMesh mesh = {};
+        mesh.firstIndex = range.firstIndex;
+        mesh.indexCount = range.indexCount;
+        mesh.vertexOffset = range.vertexOffset;
+        gpuMeshes.push_back(mesh);
+    }
+
+    VulkanUtilities::createDeviceLocalBuffer(
+        _instances.data(),
+        sizeof(GpuInstance) * _instances.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        _device,
+        swapchain.physicalDevice,
+        _instanceBuffer,
+        _instanceBufferMemory,
+        swapchain.commandPool,
+        swapchain.graphicsQueue);
+
+    VulkanUtilities::createDeviceLocalBuffer(
+        gpuMeshes.data(),
+        sizeof(GpuMesh) * gpuMeshes.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        _device,
+        swapchain.physicalDevice,
+        _meshBuffer,
+        _meshBufferMemory,
+        swapchain.commandPool,
+        swapchain.graphicsQueue);
+
+    // Only the GPU copy is needed from here on.
+    std::vector<GpuInstance>().swap(_instances);
+
+    // Nothing was visible before the first frame, it draws everything late.
+    std::vector<uint32_t> visibility(_instanceCount, 0);
+    VulkanUtilities::createDeviceLocalBuffer(
+        visibility.data(),
+        sizeof(uint32_t) * visibility.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        _device,
+        swapchain.physicalDevice,
+        _visibilityBuffer,
+        _visibilityBufferMemory,
+        swapchain.commandPool,
+        swapchain.graphicsQueue);
+
+    uint32_t imageCount = swapchain.imageCount;
+    _commandBuffers.resize(imageCount);
+    _commandBuffersMemory.resize(imageCount);
+    _countBuffers.resize(imageCount);
+    _countBuffersMemory.resize(imageCount);
+    _uniformBuffers.resize(imageCount);
+    _uniformBuffersMemory.resize(imageCount);
+    _uniformData.resize(imageCount);
+    _uploadBuffers.resize(imageCount);
+    _uploadBuffersMemory.resize(imageCount);
+    _uploadData.resize(imageCount);
+
+    for (size_t i = 0; i < imageCount; i++)
+    {
+        VulkanUtilities::createBuffer(
+            _device,
+            swapchain.physicalDevice,
+            sizeof(VkDrawIndexedIndirectCommand) * _instanceCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _commandBuffers[i],
+            _commandBuffersMemory[i]);
+
+        VulkanUtilities::createBuffer(
+            _device,
+            swapchain.physicalDevice,
+            sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _countBuffers[i],
+            _countBuffersMemory[i]);
+
+        VulkanUtilities::createBuffer(
+            _device,
+            swapchain.physicalDevice,
+            sizeof(CullUniforms),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _uniformBuffers[i],
+            _uniformBuffersMemory[i]);
+
+        Counted::vkMapMemory(_device, _uniformBuffersMemory[i], 0, sizeof(CullUniforms), 0, &_uniformData[i]);
+
+        VulkanUtilities::createBuffer(
+            _device,
+            swapchain.physicalDevice,
+            sizeof(GpuInstance) * _instanceCount,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _uploadBuffers[i],
+            _uploadBuffersMemory[i]);
+
+        Counted::vkMapMemory(_device, _uploadBuffersMemory[i], 0, sizeof(GpuInstance) * _instanceCount, 0, &_uploadData[i]);
+    }
+
+    // Culling reads instances and meshes, writes commands and the count,
+    // reads and writes visibility, samples the pyramid.
+    _cullSetLayout = VulkanUtilities::createDescriptorSetLayout(
+        _device,
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER},
+        VK_SHADER_STAGE_COMPUTE_BIT);
+    _instanceSetLayout = VulkanUtilities::createDescriptorSetLayout(_device, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER}, VK_SHADER_STAGE_VERTEX_BIT);
+    _pyramidSetLayout = VulkanUtilities::createDescriptorSetLayout(
+        _device,
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE},
+        VK_SHADER_STAGE_COMPUTE_BIT);
+    _createDescriptorSets(imageCount);
+
+    // Only texelFetch, the filter doesn't matter.
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(_device, &samplerInfo, nullptr, &_pyramidSampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create depth pyramid sampler.");
+    }
+
+    VkPushConstantRange pyramidConstants = {};
+    pyramidConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pyramidConstants.offset = 0;
+    pyramidConstants.size = sizeof(PyramidConstants);
+
+    _pyramidLayout = pipelines.getLayout({_pyramidSetLayout}, {pyramidConstants});
+    _pyramidPipeline = pipelines.getCompute(pipelines.loadShader(HIZ_SHADER_PATH), Specialization(), _pyramidLayout);
+
+    VkPushConstantRange cullConstants = {};
+    cullConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullConstants.offset = 0;
+    cullConstants.size = sizeof(uint32_t);
+
+    CullFeatures cullFeatures;
+    cullFeatures.compact = _drawIndexedIndirectCount != nullptr ? VK_TRUE : VK_FALSE;
+
+    _cullLayout = pipelines.getLayout({_cullSetLayout}, {cullConstants});
+    _cullPipeline = pipelines.getCompute(
+        pipelines.loadShader(CULL_SHADER_PATH),
+        Specialization::of(cullFeatures),
+        _cullLayout);
+
+    VkPushConstantRange drawConstants = {};
+    drawConstants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    drawConstants.offset = 0;
+    drawConstants.size = sizeof(glm::mat4);
+
+    _drawState.vertexShader = pipelines.loadShader(INDIRECT_VERT_SHADER_PATH);
+    _drawState.fragmentShader = pipelines.loadShader(INDIRECT_FRAG_SHADER_PATH);
+    _drawState.fragmentSpecialization = Specialization::of(FragmentFeatures::fromFlags(FeaturesDefault));
+    _drawState.layout = pipelines.getLayout({frameSetLayout, _instanceSetLayout}, {drawConstants});
+    _drawState.subpass = SUBPASS_MAIN;
+
+    resize(swapchain);
+}
+
+void IndirectRenderer::_createDescriptorSets(uint32_t imageCount)
+{
+    std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = 5 * imageCount + 1;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = imageCount;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[2].descriptorCount = imageCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = imageCount + 1;
+
+    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create descriptor pool.");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(imageCount, _cullSetLayout);
+    layouts.push_back(_instanceSetLayout);
+    std::vector<VkDescriptorSet> sets(layouts.size());
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+    allocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(_device, &allocInfo, sets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to allocate descriptor sets.");
+    }
+
+    _cullSets.assign(sets.begin(), sets.begin() + imageCount);
+    _instanceSet = sets.back();
+
+    VkDescriptorBufferInfo instanceInfo = {_instanceBuffer, 0, VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo meshInfo = {_meshBuffer, 0, VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo visibilityInfo = {_visibilityBuffer, 0, VK_WHOLE_SIZE};
+
+    // The pyramid at binding 5 is written on resize.
+    const uint32_t uniformBinding = 6;
+
+    for (size_t i = 0; i < imageCount; i++)
+    {
+        VkDescriptorBufferInfo bufferInfos[] = {
+            instanceInfo,
+            meshInfo,
+            {_commandBuffers[i], 0, VK_WHOLE_SIZE},
+            {_countBuffers[i], 0, VK_WHOLE_SIZE},
+            visibilityInfo,
+        };
+        VkDescriptorBufferInfo uniformInfo = {_uniformBuffers[i], 0, sizeof(CullUniforms)};
+
+        std::array<VkWriteDescriptorSet, 6> descriptorWrites = {};
+        for (uint32_t binding = 0; binding < uniformBinding - 1; binding++)
+        {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = _cullSets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+        }
+
+        VkWriteDescriptorSet &uniformWrite = descriptorWrites.back();
+        uniformWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        uniformWrite.dstSet = _cullSets[i];
+        uniformWrite.dstBinding = uniformBinding;
+        uniformWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uniformWrite.descriptorCount = 1;
+        uniformWrite.pBufferInfo = &uniformInfo;
+
+        Counted::vkUpdateDescriptorSets(_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    VkWriteDescriptorSet instanceWrite = {};
+    instanceWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    instanceWrite.dstSet = _instanceSet;
+    instanceWrite.dstBinding = 0;
+    instanceWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    instanceWrite.descriptorCount = 1;
+    instanceWrite.pBufferInfo = &instanceInfo;
+
+    Counted::vkUpdateDescriptorSets(_device, 1, &instanceWrite, 0, nullptr);
+}
+
+void IndirectRenderer::resize(Swapchain &swapchain)
+{
+    _drawState.renderPassKey = swapchain.renderPassKey;
+    _drawPipeline = _pipelines->request(_drawState, swapchain.renderPass);
+
+    // The depth attachment was recreated with the new extent.
+    _destroyDepthPyramid();
+    _createDepthPyramid(swapchain);
+}
+
+void IndirectRenderer::_createDepthPyramid(Swapchain &swapchain)
+{
+    _depthExtent = swapchain.parameters.extent;
+
+    // Each level rounds up, so a level L texel covers 2^(L+1) depth pixels.
+    _pyramidExtents.clear();
+    VkExtent2D extent = _depthExtent;
+    do
+    {
+        extent.width = std::max(1u, (extent.width + 1) / 2);
+        extent.height = std::max(1u, (extent.height + 1) / 2);
+        _pyramidExtents.push_back(extent);
+    } while (extent.width > 1 || extent.height > 1);
+
+    uint32_t levelCount = static_cast<uint32_t>(_pyramidExtents.size());
+
+    VulkanUtilities::createImage(
+        swapchain.physicalDevice,
+        _device,
+        _pyramidExtents[0].width,
+        _pyramidExtents[0].height,
+        VK_FORMAT_R32_SFLOAT,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        _pyramidImage,
+        _pyramidImageMemory,
+        levelCount);
+
+    _pyramidView = VulkanUtilities::createImageView(_pyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, _device, 0, levelCount);
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        _pyramidLevelViews.push_back(
+            VulkanUtilities::createImageView(_pyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, _device, level, 1));
+    }
+
+    // Stays in GENERAL, written and sampled.
+    VkCommandBuffer commandBuffer = VulkanUtilities::beginSingleTimeCommands(swapchain.commandPool, _device);
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = _pyramidImage;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VulkanUtilities::endSingleTimeCommands(commandBuffer, swapchain.graphicsQueue, swapchain.commandPool, _device);
+
+    // One set per level, reading the level above.
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = levelCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = levelCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = levelCount;
+
+    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_pyramidDescriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create descriptor pool.");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(levelCount, _pyramidSetLayout);
+    _pyramidSets.resize(levelCount);
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _pyramidDescriptorPool;
+    allocInfo.descriptorSetCount = levelCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(_device, &allocInfo, _pyramidSets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to allocate descriptor sets.");
+    }
+
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        VkDescriptorImageInfo sourceInfo = {};
+        sourceInfo.sampler = _pyramidSampler;
+        if (level == 0)
+        {
+            sourceInfo.imageView = swapchain.getDepthImageView();
+            sourceInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        }
+        else
+        {
+            sourceInfo.imageView = _pyramidLevelViews[level - 1];
+            sourceInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        }
+
+        VkDescriptorImageInfo destinationInfo = {};
+        destinationInfo.imageView = _pyramidLevelViews[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = _pyramidSets[level];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pImageInfo = &sourceInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = _pyramidSets[level];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &destinationInfo;
+
+        Counted::vkUpdateDescriptorSets(_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    VkDescriptorImageInfo pyramidInfo = {};
+    pyramidInfo.sampler = _pyramidSampler;
+    pyramidInfo.imageView = _pyramidView;
+    pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    for (auto &cullSet : _cullSets)
+    {
+        VkWriteDescriptorSet pyramidWrite = {};
+        pyramidWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        pyramidWrite.dstSet = cullSet;
+        pyramidWrite.dstBinding = 5;
+        pyramidWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        pyramidWrite.descriptorCount = 1;
+        pyramidWrite.pImageInfo = &pyramidInfo;
+
+        Counted::vkUpdateDescriptorSets(_device, 1, &pyramidWrite, 0, nullptr);
+    }
+}
+
+void IndirectRenderer::_destroyDepthPyramid()
+{
+    if (_pyramidImage == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    vkDestroyDescriptorPool(_device, _pyramidDescriptorPool, nullptr);
+    for (auto &view : _pyramidLevelViews)
+    {
+        vkDestroyImageView(_device, view, nullptr);
+    }
+    vkDestroyImageView(_device, _pyramidView, nullptr);
+    vkDestroyImage(_device, _pyramidImage, nullptr);
+    vkFreeMemory(_device, _pyramidImageMemory, nullptr);
+
+    _pyramidDescriptorPool = VK_NULL_HANDLE;
+    _pyramidSets.clear();
+    _pyramidLevelViews.clear();
+    _pyramidView = VK_NULL_HANDLE;
+    _pyramidImage = VK_NULL_HANDLE;
+    _pyramidImageMemory = VK_NULL_HANDLE;
+}
+
+CullResources IndirectRenderer::importResources(RenderGraph &graph, uint32_t imageIndex)
+{
+    CullResources resources;
+    resources.instances = graph.importBuffer("instances", _instanceBuffer);
+    resources.commands = graph.importBuffer("draw commands", _commandBuffers[imageIndex]);
+    resources.count = graph.importBuffer("draw count", _countBuffers[imageIndex]);
+    resources.visibility = graph.importBuffer("visibility", _visibilityBuffer);
+    resources.pyramid = graph.importImage("depth pyramid", _pyramidImage, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+    return resources;
+}
+
+void IndirectRenderer::addUploadPass(RenderGraph &graph, const CullResources &resources, uint32_t imageIndex, const Scene &scene)
+{
+    const std::vector<uint32_t> &changed = scene.changed();
+    if (changed.empty())
+    {
+        return;
+    }
+
+    // Packed in the staging buffer, consecutive instances share a region.
+    GpuInstance *staged = static_cast<GpuInstance *>(_uploadData[imageIndex]);
+    VkDeviceSize stride = sizeof(GpuInstance);
+    uint32_t count = 0;
+    _uploadRegions.clear();
+    for (uint32_t index : changed)
+    {
+        if (index >= _instanceCount)
+        {
+            break;
+        }
+
+        GpuInstance &instance = staged[count];
+        instance.model = scene.models()[index];
+        instance.boundingSphere = scene.bounds()[index];
+        instance.mesh = scene.meshes()[index];
+
+        VkDeviceSize source = stride * count;
+        VkDeviceSize destination = stride * index;
+        if (!_uploadRegions.empty() && _uploadRegions.back().dstOffset + _uploadRegions.back().size == destination)
+        {
+            _uploadRegions.back().size += stride;
+        }
+        else
+        {
+            _uploadRegions.push_back({source, destination, stride});
+        }
+        count++;
+    }
+
+    VkBuffer uploadBuffer = _uploadBuffers[imageIndex];
+    RenderPassId pass = graph.addPass("upload instances", [this, uploadBuffer](VkCommandBuffer commandBuffer) {
+        vkCmdCopyBuffer(
+            commandBuffer,
+            uploadBuffer,
+            _instanceBuffer,
+            static_cast<uint32_t>(_uploadRegions.size()),
+            _uploadRegions.data());
+    });
+    graph.write(pass, resources.instances, ResourceUsage::TransferWrite);
+}
+
+void IndirectRenderer::addCullPasses(
+    RenderGraph &graph,
+    const CullResources &resources,
+    uint32_t imageIndex,
+    const glm::mat4 &viewProjection,
+    CullPhase phase)
+{
+    // Both phases of a frame write the same values.
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+    CullUniforms uniforms = {};
+    uniforms.viewProjection = viewProjection;
+    for (int i = 0; i < Frustum::PlaneCount; i++)
+    {
+        uniforms.planes[i] = frustum.planes[i];
+    }
+    uniforms.depthSize = glm::vec2(_depthExtent.width, _depthExtent.height);
+    uniforms.instanceCount = instanceCount();
+    uniforms.pyramidLevels = static_cast<uint32_t>(_pyramidExtents.size());
+    memcpy(_uniformData[imageIndex], &uniforms, sizeof(uniforms));
+
+    bool late = phase == CullPhase::Late;
+    VkBuffer countBuffer = _countBuffers[imageIndex];
+    RenderPassId clear = graph.addPass(late ? "clear late draw count" : "clear draw count", [countBuffer](VkCommandBuffer commandBuffer) {
+        vkCmdFillBuffer(commandBuffer, countBuffer, 0, sizeof(uint32_t), 0);
+    });
+    graph.write(clear, resources.count, ResourceUsage::TransferWrite);
+
+    RenderPassId cull = graph.addPass(late ? "late cull" : "cull", [this, imageIndex, phase](VkCommandBuffer commandBuffer) {
+        uint32_t phaseConstant = static_cast<uint32_t>(phase);
+
+        Counted::vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+        Counted::vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cullLayout, 0, 1, &_cullSets[imageIndex], 0, nullptr);
+        Counted::vkCmdPushConstants(commandBuffer, _cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &phaseConstant);
+        Counted::vkCmdDispatch(commandBuffer, (instanceCount() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    });
+    graph.read(cull, resources.instances, ResourceUsage::ComputeRead);
+    graph.write(cull, resources.commands, ResourceUsage::ComputeWrite);
+    graph.write(cull, resources.count, ResourceUsage::ComputeWrite);
+
+    // Early reads what the previous late phase left, late updates it.
+    if (phase == CullPhase::Early)
+    {
+        graph.read(cull, resources.visibility, ResourceUsage::ComputeRead);
+    }
+    else if (late)
+    {
+        graph.write(cull, resources.visibility, ResourceUsage::ComputeWrite);
+        graph.read(cull, resources.pyramid, ResourceUsage::ComputeRead);
+    }
+}
+
+void IndirectRenderer::addDepthPyramidPass(RenderGraph &graph, const CullResources &resources, RenderResource depth)
+{
+    RenderPassId pass = graph.addPass("depth pyramid", [this](VkCommandBuffer commandBuffer) {
+        Counted::vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pyramidPipeline);
+
+        VkExtent2D source = _depthExtent;
+        for (size_t level = 0; level < _pyramidExtents.size(); level++)
+        {
+            const VkExtent2D &destination = _pyramidExtents[level];
+
+            PyramidConstants constants = {};
+            constants.sourceSize[0] = static_cast<int32_t>(source.width);
+            constants.sourceSize[1] = static_cast<int32_t>(source.height);
+            constants.destinationSize[0] = static_cast<int32_t>(destination.width);
+            constants.destinationSize[1] = static_cast<int32_t>(destination.height);
+
+            Counted::vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pyramidLayout, 0, 1, &_pyramidSets[level], 0, nullptr);
+            Counted::vkCmdPushConstants(commandBuffer, _pyramidLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+            Counted::vkCmdDispatch(
+                commandBuffer,
+                (destination.width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+                (destination.height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+                1);
+
+            // The next level reads this one, the graph orders the last one
+            // before the late phase.
+            if (level + 1 < _pyramidExtents.size())
+            {
+                VkMemoryBarrier levelBarrier = {};
+                levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+                vkCmdPipelineBarrier(
+                    commandBuffer,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+            }
+
+            source = destination;
+        }
+    });
+    graph.read(pass, depth, ResourceUsage::ComputeSampled);
+    graph.write(pass, resources.pyramid, ResourceUsage::ComputeWrite);
+}
+
+void IndirectRenderer::draw(
+    VkCommandBuffer commandBuffer,
+    BindState &binds,
+    uint32_t imageIndex,
+    VkDescriptorSet frameSet,
+    const glm::mat4 &viewProjection)
+{
+    // The object fallback has a different layout, wait for our own pipeline.
+    if (!_pipelines->isReady(_drawPipeline))
+    {
+        return;
+    }
+
+    binds.bindPipeline(_pipelines->pipeline(_drawPipeline));
+    binds.bindDescriptorSet(_drawState.layout, 0, frameSet);
+    binds.bindDescriptorSet(_drawState.layout, 1, _instanceSet);
+    binds.bindVertexBuffer(0, _meshes->vertexBuffer);
+    binds.bindIndexBuffer(_meshes->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    Counted::vkCmdPushConstants(commandBuffer, _drawState.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &viewProjection);
+
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    if (_drawIndexedIndirectCount != nullptr)
+    {
+        ApiCounters::add(ApiDraw);
+        _drawIndexedIndirectCount(
+            commandBuffer,
+            _commandBuffers[imageIndex],
+            0,
+            _countBuffers[imageIndex],
+            0,
+            instanceCount(),
+            stride);
+        return;
+    }
+
+    // Culled slots have instanceCount 0. Without multiDrawIndirect this is
+    // one call per instance and the CPU cost is back.
+    for (uint32_t first = 0; first < instanceCount(); first += _maxDrawCount)
+    {
+        uint32_t drawCount = std::min(_maxDrawCount, instanceCount() - first);
+        Counted::vkCmdDrawIndexedIndirect(commandBuffer, _commandBuffers[imageIndex], first * stride, drawCount, stride);
+    }
+}
+
+void IndirectRenderer::clean()
+{
+    // Layouts and pipelines belong to the registry.
+    vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _cullSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _instanceSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _pyramidSetLayout, nullptr);
+    vkDestroySampler(_device, _pyramidSampler, nullptr);
+    _destroyDepthPyramid();
+
+    for (size_t i = 0; i < _commandBuffers.size(); i++)
+    {
+        vkDestroyBuffer(_device, _commandBuffers[i], nullptr);
+        vkFreeMemory(_device, _commandBuffersMemory[i], nullptr);
+        vkDestroyBuffer(_device, _countBuffers[i], nullptr);
+        vkFreeMemory(_device, _countBuffersMemory[i], nullptr);
+        Counted::vkUnmapMemory(_device, _uniformBuffersMemory[i]);
+        vkDestroyBuffer(_device, _uniformBuffers[i], nullptr);
+        vkFreeMemory(_device, _uniformBuffersMemory[i], nullptr);
+        Counted::vkUnmapMemory(_device, _uploadBuffersMemory[i]);
+        vkDestroyBuffer(_device, _uploadBuffers[i], nullptr);
+        vkFreeMemory(_device, _uploadBuffersMemory[i], nullptr);
+    }
+
+    vkDestroyBuffer(_device, _visibilityBuffer, nullptr);
+    vkFreeMemory(_device, _visibilityBufferMemory, nullptr);
+
+    vkDestroyBuffer(_device, _instanceBuffer, nullptr);
+    vkFreeMemory(_device, _instanceBufferMemory, nullptr);
+    vkDestroyBuffer(_device, _meshBuffer, nullptr);
+    vkFreeMemory(_device, _meshBufferMemory, nullptr);
+
+    _commandBuffers.clear();
+    _commandBuffersMemory.clear();
+    _countBuffers.clear();
+    _countBuffersMemory.clear();
+    _uniformBuffers.clear();
+    _uniformBuffersMemory.clear();
+    _uniformData.clear();
+    _uploadBuffers.clear();
+    _uploadBuffersMemory.clear();
+    _uploadData.clear();
+    _cullSets.clear();
+    _instanceCount = 0;
+}
@@ -0,0 +1,191 @@
+#ifndef IndirectRenderer_hpp
+#define IndirectRenderer_hpp
+
+#include "common.hpp"
+#include "BindState.hpp"
+#include "Frustum.hpp"
+#include "MeshPool.hpp"
+#include "PipelineRegistry.hpp"
+#include "RenderGraph.hpp"
+#include "Scene.hpp"
+#include "Swapchain.hpp"
+
+// Per instance data, std430 layout shared by cull.comp and indirect.vert.
+struct GpuInstance
+{
+    glm::mat4 model;
+    // World space center and radius.
+    glm::vec4 boundingSphere;
+    uint32_t mesh;
+    uint32_t padding[3];
+};
+
+static_assert(sizeof(GpuInstance) == 96, "GpuInstance must match the shader layout.");
+
+struct GpuMesh
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t padding;
+};
+
+// Per frame uniforms of cull.comp, std140.
+struct CullUniforms
+{
+    glm::mat4 viewProjection;
+    glm::vec4 planes[Frustum::PlaneCount];
+    glm::vec2 depthSize;
+    uint32_t instanceCount;
+    uint32_t pyramidLevels;
+};
+
+static_assert(sizeof(CullUniforms) == 176, "CullUniforms must match the shader layout.");
+
+// Two phase occlusion culling. Early draws what was visible last frame,
+// the Hi-Z pyramid is built from that depth, then late tests every
+// instance against it and draws the newly visible ones.
+enum class CullPhase : uint32_t
+{
+    // Frustum only.
+    All,
+    Early,
+    Late,
+};
+
+// Culling buffers of one frame, and the pyramid, in the render graph. The
+// draws read instances from the vertex shader.
+struct CullResources
+{
+    RenderResource instances;
+    RenderResource commands;
+    RenderResource count;
+    RenderResource visibility;
+    RenderResource pyramid;
+};
+
+// Draws every instance with a fixed number of commands. A compute pass
+// frustum culls the instances and writes the indirect draws, so the CPU
+// cost of a frame doesn't depend on the instance count.
+class IndirectRenderer
+{
+public:
+    IndirectRenderer(){};
+    ~IndirectRenderer(){};
+
+    // Instances are addressed through gl_InstanceIndex, which needs a non zero firstInstance.
+    static bool isSupported(const Swapchain &swapchain) { return swapchain.features.drawIndirectFirstInstance == VK_TRUE; }
+
+    // Staged until init. Instance i mirrors dense index i of the scene.
+    void addInstance(const glm::mat4 &model, uint32_t mesh, const MeshPool &meshes);
+
+    // `frameSetLayout` is bound as set 0 for the fragment shader.
+    void init(
+        Swapchain &swapchain,
+        PipelineRegistry &pipelines,
+        MeshPool &meshes,
+        VkDescriptorSetLayout frameSetLayout,
+        bool occlusionCulling);
+    void resize(Swapchain &swapchain);
+    void clean();
+
+    CullResources importResources(RenderGraph &graph, uint32_t imageIndex);
+
+    // Copies the instances whose world matrix changed in the last scene
+    // update, before the culling. The scene keeps the entity count of init.
+    void addUploadPass(RenderGraph &graph, const CullResources &resources, uint32_t imageIndex, const Scene &scene);
+
+    // Adds the draw count clear and the culling dispatch. The draws read
+    // commands and count as indirect arguments.
+    void addCullPasses(
+        RenderGraph &graph,
+        const CullResources &resources,
+        uint32_t imageIndex,
+        const glm::mat4 &viewProjection,
+        CullPhase phase);
+
+    // Downsamples `depth` into the pyramid, between the early and late phases.
+    void addDepthPyramidPass(RenderGraph &graph, const CullResources &resources, RenderResource depth);
+
+    // Records the draws, inside the render pass. Binds go through `binds`,
+    // reset for `commandBuffer`.
+    void draw(
+        VkCommandBuffer commandBuffer,
+        BindState &binds,
+        uint32_t imageIndex,
+        VkDescriptorSet frameSet,
+        const glm::mat4 &viewProjection);
+
+    uint32_t instanceCount() const { return _instanceCount; }
+    bool occlusionCulling() const { return _occlusionCulling; }
+
+private:
+    void _createDescriptorSets(uint32_t imageCount);
+    void _createDepthPyramid(Swapchain &swapchain);
+    void _destroyDepthPyramid();
+
+    VkDevice _device = VK_NULL_HANDLE;
+    PipelineRegistry *_pipelines = nullptr;
+    MeshPool *_meshes = nullptr;
+
+    std::vector<GpuInstance> _instances;
+    uint32_t _instanceCount = 0;
+
+    // Count buffer path, null when VK_KHR_draw_indirect_count is missing.
+    PFN_vkCmdDrawIndexedIndirectCountKHR _drawIndexedIndirectCount = nullptr;
+    uint32_t _maxDrawCount = 1;
+
+    // Static data.
+    VkBuffer _instanceBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory _instanceBufferMemory = VK_NULL_HANDLE;
+    VkBuffer _meshBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory _meshBufferMemory = VK_NULL_HANDLE;
+
+    // Per frame data, written by the culling pass.
+    std::vector<VkBuffer> _commandBuffers;
+    std::vector<VkDeviceMemory> _commandBuffersMemory;
+    std::vector<VkBuffer> _countBuffers;
+    std::vector<VkDeviceMemory> _countBuffersMemory;
+    std::vector<VkBuffer> _uniformBuffers;
+    std::vector<VkDeviceMemory> _uniformBuffersMemory;
+    std::vector<void *> _uniformData;
+    // Moved instances, copied into the instance buffer. Room for all of them.
+    std::vector<VkBuffer> _uploadBuffers;
+    std::vector<VkDeviceMemory> _uploadBuffersMemory;
+    std::vector<void *> _uploadData;
+    std::vector<VkBufferCopy> _uploadRegions;
+
+    // One flag per instance, written by the late phase.
+    bool _occlusionCulling = false;
+    VkBuffer _visibilityBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory _visibilityBufferMemory = VK_NULL_HANDLE;
+
+    // Hi-Z pyramid, R32 farthest depth, level 0 at half resolution. Kept in
+    // GENERAL layout. Bound even without occlusion culling, the shader uses it.
+    VkExtent2D _depthExtent = {};
+    VkImage _pyramidImage = VK_NULL_HANDLE;
+    VkDeviceMemory _pyramidImageMemory = VK_NULL_HANDLE;
+    VkImageView _pyramidView = VK_NULL_HANDLE;
+    std::vector<VkImageView> _pyramidLevelViews;
+    std::vector<VkExtent2D> _pyramidExtents;
+    VkSampler _pyramidSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _pyramidSetLayout = VK_NULL_HANDLE;
+    // Recreated with the pyramid on resize.
+    VkDescriptorPool _pyramidDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> _pyramidSets;
+    VkPipelineLayout _pyramidLayout = VK_NULL_HANDLE;
+    VkPipeline _pyramidPipeline = VK_NULL_HANDLE;
+
+    VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _cullSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _instanceSetLayout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> _cullSets;
+    VkDescriptorSet _instanceSet = VK_NULL_HANDLE;
+
+    VkPipelineLayout _cullLayout = VK_NULL_HANDLE;
+    VkPipeline _cullPipeline = VK_NULL_HANDLE;
+    PipelineState _drawState;
+    PipelineHandle _drawPipeline = INVALID_PIPELINE;
+};
+
+#endif
@@ -1,4 +1,12 @@
+#include <fstream>
+#include <limits>
+#include <sstream>
+
 #include "Input.hpp"
+#include "CpuProfiler.hpp"
+
+// First line of a recording.
+static const std::string RECORDING_HEADER = "input 1";
 
 Input &Input::instance()
 {
@@ -9,47 +17,172 @@ Input &Input::instance()
 
 void Input::resizeEvent(const uint32_t width, const uint32_t height)
 {
-    _width = width > 0 ? width : 1;
-    _height = height > 0 ? height : 1;
-    _resized = true;
+    _handle({_time, Event::Resize, static_cast<double>(width), static_cast<double>(height)});
 }
 
 void Input::keyDownEvent(int key, int action)
 {
-    if (key == GLFW_KEY_UNKNOWN)
+    // Replays ignore the keyboard and the mouse.
+    if (!_replaying)
     {
-        return;
+        _handle({_time, Event::Key, static_cast<double>(key), static_cast<double>(action)});
     }
+}
 
-    if (action == GLFW_PRESS)
+void Input::mouseMoveEvent(double xPos, double yPos)
+{
+    if (!_replaying)
     {
-        _keys[key].pressed = true;
+        _handle({_time, Event::MouseMove, xPos, yPos});
     }
-    else if (action == GLFW_RELEASE)
+}
+
+void Input::mouseButtonEvent(int button, int action)
+{
+    if (!_replaying)
     {
-        _keys[key].pressed = false;
+        _handle({_time, Event::MouseButton, static_cast<double>(button), static_cast<double>(action)});
     }
 }
 
-void Input::mouseMoveEvent(double xPos, double yPos)
+void Input::_handle(const Event &event)
 {
-    if (!_cursorSet)
+    if (_recording)
     {
+        _events.push_back(event);
+    }
+
+    _apply(event);
+}
+
+void Input::_apply(const Event &event)
+{
+    switch (event.type)
+    {
+    case Event::Resize:
+    {
+        uint32_t width = static_cast<uint32_t>(event.a);
+        uint32_t height = static_cast<uint32_t>(event.b);
+        _width = width > 0 ? width : 1;
+        _height = height > 0 ? height : 1;
+        _resized = true;
+        break;
+    }
+    case Event::Key:
+    {
+        int key = static_cast<int>(event.a);
+        int action = static_cast<int>(event.b);
+        if (key < 0 || key > GLFW_KEY_LAST)
+        {
+            return;
+        }
+
+        if (action == GLFW_PRESS)
+        {
+            _keys[key].pressed = true;
+        }
+        else if (action == GLFW_RELEASE)
+        {
+            _keys[key].pressed = false;
+        }
+        break;
+    }
+    case Event::MouseMove:
+    {
+        double xPos = event.a;
+        double yPos = event.b;
+        if (!_cursorSet)
+        {
+            _lastCursorX = xPos;
+            _lastCursorY = yPos;
+            _cursorSet = true;
+        }
+
+        float xOffset = xPos - _lastCursorX;
+        float yOffset = _lastCursorY - yPos;
         _lastCursorX = xPos;
         _lastCursorY = yPos;
-        _cursorSet = true;
+
+        // Several moves can arrive in one frame, none is lost.
+        _cursorOffset.x += xOffset * _sensitivity;
+        _cursorOffset.y += yOffset * _sensitivity;
+        break;
     }
+    case Event::MouseButton:
+    {
+        int button = static_cast<int>(event.a);
+        int action = static_cast<int>(event.b);
+        if (button < 0 || button > GLFW_MOUSE_BUTTON_LAST)
+        {
+            return;
+        }
 
-    float xOffset = xPos - _lastCursorX;
-    float yOffset = _lastCursorY - yPos;
-    _lastCursorX = xPos;
-    _lastCursorY = yPos;
+        if (action == GLFW_PRESS)
+        {
+            _mouseButtons[button] = true;
+        }
+        else if (action == GLFW_RELEASE)
+        {
+            _mouseButtons[button] = false;
+        }
+        break;
+    }
+    }
+}
 
-    xOffset *= _sensitivity;
-    yOffset *= _sensitivity;
+void Input::startRecording()
+{
+    _events.clear();
+    _recording = true;
+}
+
+void Input::saveRecording(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Unable to write input recording " + path + ".");
+    }
+
+    // Times round trip exactly, replays stay frame exact.
+    file.precision(std::numeric_limits<double>::max_digits10);
+    file << RECORDING_HEADER << "\n";
+    for (const Event &event : _events)
+    {
+        file << event.time << " " << event.type << " " << event.a << " " << event.b << "\n";
+    }
+}
+
+void Input::startReplay(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open input recording " + path + ".");
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line != RECORDING_HEADER)
+    {
+        throw std::runtime_error("Unable to replay " + path + ", not an input recording.");
+    }
+
+    _events.clear();
+    for (uint32_t number = 2; std::getline(file, line); number++)
+    {
+        std::istringstream fields(line);
+        Event event;
+        uint32_t type;
+        if (!(fields >> event.time >> type >> event.a >> event.b) || type > Event::MouseButton)
+        {
+            throw std::runtime_error("Unable to parse " + path + ":" + std::to_string(number) + ".");
+        }
+        event.type = static_cast<Event::Type>(type);
+        _events.push_back(event);
+    }
 
-    _cursorOffset.x = xOffset;
-    _cursorOffset.y = yOffset;
+    _replaying = true;
+    _nextEvent = 0;
 }
 
 bool Input::hasOffset() const {
@@ -61,11 +194,31 @@ bool Input::pressed(const Key &keyboardKey) const
     return _keys[keyboardKey].pressed;
 }
 
-void Input::update()
+bool Input::pressed(const MouseButton &mouseButton) const
 {
+    return _mouseButtons[mouseButton];
+}
+
+void Input::update(double deltaTime)
+{
+    CpuScope scope("input");
     _resized = false;
     _cursorOffset.x = 0;
     _cursorOffset.y = 0;
+    _time += deltaTime;
+
+    if (_replaying)
+    {
+        while (_nextEvent < _events.size() && _events[_nextEvent].time <= _time)
+        {
+            const Event &event = _events[_nextEvent++];
+            if (event.type != Event::Resize)
+            {
+                _apply(event);
+            }
+        }
+    }
 
+    // Also during a replay, the window still needs its events.
     glfwPollEvents();
 }
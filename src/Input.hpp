@@ -143,15 +143,59 @@ public:
         KeyMenu = GLFW_KEY_MENU
     };
 
+    enum MouseButton
+    {
+        MouseLeft = GLFW_MOUSE_BUTTON_LEFT,
+        MouseRight = GLFW_MOUSE_BUTTON_RIGHT,
+        MouseMiddle = GLFW_MOUSE_BUTTON_MIDDLE
+    };
+
+    // What the GLFW callbacks received, at the input time of the frame.
+    struct Event
+    {
+        enum Type : uint32_t
+        {
+            Resize,
+            Key,
+            MouseMove,
+            MouseButton,
+        };
+
+        double time;
+        Type type;
+        // Width and height, key and action, cursor position, or button and action.
+        double a;
+        double b;
+    };
+
     void resizeEvent(const uint32_t width, const uint32_t height);
     void keyDownEvent(int key, int action);
     void mouseMoveEvent(double xPos, double yPos);
-    void update();
+    void mouseButtonEvent(int button, int action);
+
+    // Keeps every event from now on, for saveRecording.
+    void startRecording();
+    void saveRecording(const std::string &path) const;
+    // Key and mouse events come from the file instead of GLFW, each one in
+    // the first update that reaches its time. Resizes stay live, the window
+    // belongs to the machine replaying.
+    void startReplay(const std::string &path);
+    bool isReplaying() const { return _replaying; }
+    // Every event of the replay was applied.
+    bool replayFinished() const { return _replaying && _nextEvent == _events.size(); }
+
+    // Advances the input time by the frame time, then applies the events
+    // that arrived since the last frame.
+    void update(double deltaTime);
     // `const` at the end guarantees that no class members will be changed
     bool pressed(const Key &keyboardKey) const;
+    bool pressed(const MouseButton &mouseButton) const;
     bool hasOffset() const;
 
 private:
+    void _handle(const Event &event);
+    void _apply(const Event &event);
+
     // Screen size params
     uint32_t _width = 1;
     uint32_t _height = 1;
@@ -169,8 +213,16 @@ private:
     };
 
     KeyboardKey _keys[GLFW_KEY_LAST + 1];
+    bool _mouseButtons[GLFW_MOUSE_BUTTON_LAST + 1] = {};
     CursorOffset _cursorOffset;
 
+    // Recording and replay.
+    double _time = 0.0;
+    bool _recording = false;
+    bool _replaying = false;
+    std::vector<Event> _events;
+    size_t _nextEvent = 0;
+
 private:
     Input(){};
     ~Input(){};
@@ -0,0 +1,47 @@
+#include "InstanceBatcher.hpp"
+
+void InstanceBatcher::clear()
+{
+    _items.clear();
+    _added.clear();
+    _groups.clear();
+    _instances.clear();
+}
+
+void InstanceBatcher::add(uint64_t key, const InstanceData &instance)
+{
+    SortItem item;
+    item.key = key;
+    item.index = static_cast<uint32_t>(_added.size());
+
+    _items.push_back(item);
+    _added.push_back(instance);
+}
+
+void InstanceBatcher::build(ThreadPool *pool)
+{
+    RadixSort::sort(_items, _scratch, pool);
+
+    _groups.clear();
+    _instances.resize(_items.size());
+
+    for (size_t i = 0; i < _items.size(); i++)
+    {
+        const SortItem &item = _items[i];
+        _instances[i] = _added[item.index];
+
+        // Depth only orders instances inside a group.
+        if (i == 0 || DrawKey::state(_items[i - 1].key) != DrawKey::state(item.key))
+        {
+            InstanceGroup group;
+            group.mesh = DrawKey::mesh(item.key);
+            group.features = DrawKey::pipeline(item.key);
+            group.material = DrawKey::material(item.key);
+            group.firstInstance = static_cast<uint32_t>(i);
+            group.instanceCount = 0;
+            _groups.push_back(group);
+        }
+
+        _groups.back().instanceCount++;
+    }
+}
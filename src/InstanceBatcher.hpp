@@ -0,0 +1,47 @@
+#ifndef InstanceBatcher_hpp
+#define InstanceBatcher_hpp
+
+#include "common.hpp"
+#include "DrawKey.hpp"
+#include "MeshUtilities.hpp"
+#include "RadixSort.hpp"
+
+// Consecutive instances drawn with one call.
+struct InstanceGroup
+{
+    uint32_t mesh;
+    // Pipeline field of the key, FragmentFeature flags.
+    uint32_t features;
+    uint32_t material;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+// Collects the visible objects of a frame, sorts them by DrawKey and packs
+// those sharing a pipeline, material and mesh into instanced groups. CPU
+// only, the renderer copies `instances()` into the per frame instance buffer.
+class InstanceBatcher
+{
+public:
+    InstanceBatcher(){};
+    ~InstanceBatcher(){};
+
+    void clear();
+    void add(uint64_t key, const InstanceData &instance);
+
+    // Orders the instances by key, after the last add of the frame.
+    void build(ThreadPool *pool = nullptr);
+
+    const std::vector<InstanceGroup> &groups() const { return _groups; }
+    const std::vector<InstanceData> &instances() const { return _instances; }
+
+private:
+    std::vector<SortItem> _items;
+    std::vector<SortItem> _scratch;
+    std::vector<InstanceData> _added;
+
+    std::vector<InstanceGroup> _groups;
+    std::vector<InstanceData> _instances;
+};
+
+#endif
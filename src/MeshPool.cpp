@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <limits>
+
+#include "MeshPool.hpp"
+#include "ThreadPool.hpp"
+#include "VulkanUtilities.hpp"
+
+uint32_t MeshPool::add(const std::string &path)
+{
+    auto found = _paths.find(path);
+    if (found != _paths.end())
+    {
+        return found->second;
+    }
+
+    if (vertexBuffer != VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("Unable to add a mesh to an uploaded pool.");
+    }
+
+    Mesh mesh;
+    MeshUtilities::loadMesh(path, mesh);
+    return _append(path, mesh);
+}
+
+std::vector<uint32_t> MeshPool::addAll(const std::vector<std::string> &paths, ThreadPool *threadPool)
+{
+    if (vertexBuffer != VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("Unable to add a mesh to an uploaded pool.");
+    }
+
+    // Each new path once.
+    std::vector<std::string> missing;
+    for (const std::string &path : paths)
+    {
+        if (_paths.find(path) == _paths.end() && std::find(missing.begin(), missing.end(), path) == missing.end())
+        {
+            missing.push_back(path);
+        }
+    }
+
+    // Parsing is the slow part and touches nothing shared. A failure is
+    // rethrown here, the workers can't.
+    std::vector<Mesh> meshes(missing.size());
+    std::vector<std::string> errors(missing.size());
+    auto load = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            try
+            {
+                MeshUtilities::loadMesh(missing[i], meshes[i]);
+            }
+            catch (const std::exception &e)
+            {
+                errors[i] = e.what();
+            }
+        }
+    };
+    if (threadPool != nullptr)
+    {
+        threadPool->parallelFor(missing.size(), load);
+    }
+    else
+    {
+        load(0, missing.size());
+    }
+
+    // Appended in path order, the pool layout doesn't depend on timing.
+    for (size_t i = 0; i < missing.size(); i++)
+    {
+        if (!errors[i].empty())
+        {
+            throw std::runtime_error("Unable to load mesh " + missing[i] + ": " + errors[i]);
+        }
+        _append(missing[i], meshes[i]);
+    }
+
+    std::vector<uint32_t> indices;
+    for (const std::string &path : paths)
+    {
+        indices.push_back(_paths.at(path));
+    }
+    return indices;
+}
+
+uint32_t MeshPool::_append(const std::string &path, const Mesh &mesh)
+{
+    MeshRange range;
+    range.firstIndex = static_cast<uint32_t>(_indices.size());
+    range.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    range.vertexOffset = static_cast<int32_t>(_vertices.size());
+    range.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    _fitBounds(mesh, range);
+
+    _vertices.insert(_vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    _indices.insert(_indices.end(), mesh.indices.begin(), mesh.indices.end());
+
+    uint32_t id = static_cast<uint32_t>(_ranges.size());
+    _ranges.push_back(range);
+    _paths[path] = id;
+    return id;
+}
+
+void MeshPool::_fitBounds(const Mesh &mesh, MeshRange &range)
+{
+    // Sphere around the box center, not minimal but cheap and conservative.
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(-std::numeric_limits<float>::max());
+    for (auto &vertex : mesh.vertices)
+    {
+        min = glm::min(min, vertex.pos);
+        max = glm::max(max, vertex.pos);
+    }
+
+    range.min = min;
+    range.max = max;
+    range.center = (min + max) * 0.5f;
+    range.radius = 0.0f;
+    for (auto &vertex : mesh.vertices)
+    {
+        range.radius = std::max(range.radius, glm::length(vertex.pos - range.center));
+    }
+}
+
+void MeshPool::reserveStreamed(uint32_t vertexCount, uint32_t indexCount)
+{
+    if (vertexBuffer != VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("Unable to reserve room in an uploaded pool.");
+    }
+
+    _streamedVertices = vertexCount;
+    _streamedIndices = indexCount;
+}
+
+uint32_t MeshPool::addStreamed(const Mesh &mesh)
+{
+    if (vertexBuffer == VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("Unable to stream a mesh before the upload.");
+    }
+
+    uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    uint32_t indexCount = static_cast<uint32_t>(mesh.indices.size());
+    uint32_t vertexOffset = _allocate(_freeVertices, vertexCount);
+    if (vertexOffset == NO_MESH)
+    {
+        return NO_MESH;
+    }
+    uint32_t firstIndex = _allocate(_freeIndices, indexCount);
+    if (firstIndex == NO_MESH)
+    {
+        _release(_freeVertices, vertexOffset, vertexCount);
+        return NO_MESH;
+    }
+
+    MeshRange range;
+    range.firstIndex = firstIndex;
+    range.indexCount = indexCount;
+    range.vertexOffset = static_cast<int32_t>(vertexOffset);
+    range.vertexCount = vertexCount;
+    _fitBounds(mesh, range);
+
+    // The occlusion rasterizer reads these.
+    for (uint32_t i = 0; i < vertexCount; i++)
+    {
+        _positions[vertexOffset + i] = mesh.vertices[i].pos;
+    }
+    std::copy(mesh.indices.begin(), mesh.indices.end(), _indices.begin() + firstIndex);
+
+    if (!_freeMeshes.empty())
+    {
+        uint32_t id = _freeMeshes.back();
+        _freeMeshes.pop_back();
+        _ranges[id] = range;
+        return id;
+    }
+
+    _ranges.push_back(range);
+    return static_cast<uint32_t>(_ranges.size() - 1);
+}
+
+void MeshPool::removeStreamed(uint32_t mesh)
+{
+    MeshRange &range = _ranges.at(mesh);
+    _release(_freeVertices, static_cast<uint32_t>(range.vertexOffset), range.vertexCount);
+    _release(_freeIndices, range.firstIndex, range.indexCount);
+    range = MeshRange();
+    _freeMeshes.push_back(mesh);
+}
+
+uint32_t MeshPool::_allocate(std::vector<FreeRange> &free, uint32_t count)
+{
+    for (size_t i = 0; i < free.size(); i++)
+    {
+        if (free[i].count >= count)
+        {
+            uint32_t offset = free[i].offset;
+            free[i].offset += count;
+            free[i].count -= count;
+            if (free[i].count == 0)
+            {
+                free.erase(free.begin() + i);
+            }
+            return offset;
+        }
+    }
+    return NO_MESH;
+}
+
+void MeshPool::_release(std::vector<FreeRange> &free, uint32_t offset, uint32_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Kept sorted by offset.
+    auto next = std::lower_bound(free.begin(), free.end(), offset, [](const FreeRange &range, uint32_t offset) {
+        return range.offset < offset;
+    });
+    next = free.insert(next, {offset, count});
+
+    if (next + 1 != free.end() && next->offset + next->count == (next + 1)->offset)
+    {
+        next->count += (next + 1)->count;
+        free.erase(next + 1);
+    }
+    if (next != free.begin() && (next - 1)->offset + (next - 1)->count == next->offset)
+    {
+        (next - 1)->count += next->count;
+        free.erase(next);
+    }
+}
+
+void MeshPool::upload(
+    VkPhysicalDevice &physicalDevice,
+    VkDevice &device,
+    VkCommandPool &commandPool,
+    VkQueue &graphicsQueue)
+{
+    if (_vertices.empty() && _streamedVertices == 0)
+    {
+        throw std::runtime_error("Unable to upload an empty mesh pool.");
+    }
+
+    // The streamed room follows the loaded meshes, uploaded as zeros.
+    if (_streamedVertices > 0)
+    {
+        _freeVertices.push_back({static_cast<uint32_t>(_vertices.size()), _streamedVertices});
+        _freeIndices.push_back({static_cast<uint32_t>(_indices.size()), _streamedIndices});
+        _vertices.resize(_vertices.size() + _streamedVertices);
+        _indices.resize(_indices.size() + _streamedIndices);
+    }
+
+    VulkanUtilities::createDeviceLocalBuffer(
+        _vertices.data(),
+        sizeof(_vertices[0]) * _vertices.size(),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        device,
+        physicalDevice,
+        vertexBuffer,
+        _vertexBufferMemory,
+        commandPool,
+        graphicsQueue);
+
+    _positions.resize(_vertices.size());
+    for (size_t i = 0; i < _vertices.size(); i++)
+    {
+        _positions[i] = _vertices[i].pos;
+    }
+
+    VulkanUtilities::createDeviceLocalBuffer(
+        _positions.data(),
+        sizeof(_positions[0]) * _positions.size(),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        device,
+        physicalDevice,
+        positionBuffer,
+        _positionBufferMemory,
+        commandPool,
+        graphicsQueue);
+
+    VulkanUtilities::createDeviceLocalBuffer(
+        _indices.data(),
+        sizeof(_indices[0]) * _indices.size(),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        device,
+        physicalDevice,
+        indexBuffer,
+        _indexBufferMemory,
+        commandPool,
+        graphicsQueue);
+
+    std::vector<Vertex>().swap(_vertices);
+}
+
+void MeshPool::clean(VkDevice &device)
+{
+    vkDestroyBuffer(device, indexBuffer, nullptr);
+    vkDestroyBuffer(device, positionBuffer, nullptr);
+    vkDestroyBuffer(device, vertexBuffer, nullptr);
+
+    vkFreeMemory(device, _vertexBufferMemory, nullptr);
+    vkFreeMemory(device, _positionBufferMemory, nullptr);
+    vkFreeMemory(device, _indexBufferMemory, nullptr);
+
+    indexBuffer = VK_NULL_HANDLE;
+    positionBuffer = VK_NULL_HANDLE;
+    vertexBuffer = VK_NULL_HANDLE;
+    _positionBufferMemory = VK_NULL_HANDLE;
+    _vertexBufferMemory = VK_NULL_HANDLE;
+    _indexBufferMemory = VK_NULL_HANDLE;
+
+    _ranges.clear();
+    _paths.clear();
+    _freeVertices.clear();
+    _freeIndices.clear();
+    _freeMeshes.clear();
+    _streamedVertices = 0;
+    _streamedIndices = 0;
+    _positions.clear();
+    _indices.clear();
+}
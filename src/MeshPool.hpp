@@ -0,0 +1,122 @@
+#ifndef MeshPool_hpp
+#define MeshPool_hpp
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "MeshUtilities.hpp"
+
+class ThreadPool;
+
+// Where a mesh lives inside the pool buffers.
+struct MeshRange
+{
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    int32_t vertexOffset = 0;
+    uint32_t vertexCount = 0;
+
+    // Bounding box and sphere in model space.
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // World space center and radius. The largest axis scale keeps the
+    // sphere conservative under non uniform scaling.
+    glm::vec4 boundingSphere(const glm::mat4 &model) const
+    {
+        float scale = std::max(
+            glm::length(glm::vec3(model[0])),
+            std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+        return glm::vec4(glm::vec3(model * glm::vec4(center, 1.0f)), radius * scale);
+    }
+};
+
+// Every mesh in one vertex and one index buffer, so draws only differ in
+// their offsets and can be issued from a single indirect buffer.
+class MeshPool
+{
+public:
+    static const uint32_t NO_MESH = ~0u;
+
+    MeshPool(){};
+    ~MeshPool(){};
+
+    // Loads each path once and returns its mesh index.
+    uint32_t add(const std::string &path);
+    // Same for many paths, the new ones are loaded in parallel on the pool,
+    // which may be null. Indices follow the paths.
+    std::vector<uint32_t> addAll(const std::vector<std::string> &paths, ThreadPool *threadPool);
+
+    // Room left in the device buffers for meshes streamed in after the
+    // upload, set before it.
+    void reserveStreamed(uint32_t vertexCount, uint32_t indexCount);
+    // Places a mesh in the reserved room, NO_MESH when no free range is
+    // large enough. Only the CPU copies are written, the caller copies the
+    // mesh into the device buffers at its range.
+    uint32_t addStreamed(const Mesh &mesh);
+    // Its ranges and index go to later meshes, the GPU must be done with it.
+    void removeStreamed(uint32_t mesh);
+
+    // Creates the device buffers, only streamed meshes can be added afterwards.
+    void upload(
+        VkPhysicalDevice &physicalDevice,
+        VkDevice &device,
+        VkCommandPool &commandPool,
+        VkQueue &graphicsQueue);
+
+    void clean(VkDevice &device);
+
+    const MeshRange &range(uint32_t mesh) const { return _ranges.at(mesh); }
+    const std::vector<MeshRange> &ranges() const { return _ranges; }
+
+    // Kept on the CPU after upload for software occlusion. Indices are
+    // relative to the mesh, offset them like the draws do.
+    const std::vector<glm::vec3> &positions() const { return _positions; }
+    const std::vector<uint32_t> &indices() const { return _indices; }
+
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    // Positions only, same indexing as vertexBuffer. Depth passes fetch
+    // about a quarter of the bytes.
+    VkBuffer positionBuffer = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+
+private:
+    // Free run of vertices or indices in the streamed room.
+    struct FreeRange
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    uint32_t _append(const std::string &path, const Mesh &mesh);
+    static void _fitBounds(const Mesh &mesh, MeshRange &range);
+    // First fit, NO_MESH when nothing fits. Released runs merge with their
+    // neighbours.
+    static uint32_t _allocate(std::vector<FreeRange> &free, uint32_t count);
+    static void _release(std::vector<FreeRange> &free, uint32_t offset, uint32_t count);
+
+    std::unordered_map<std::string, uint32_t> _paths;
+    std::vector<MeshRange> _ranges;
+
+    uint32_t _streamedVertices = 0;
+    uint32_t _streamedIndices = 0;
+    std::vector<FreeRange> _freeVertices;
+    std::vector<FreeRange> _freeIndices;
+    // Indices of removed streamed meshes.
+    std::vector<uint32_t> _freeMeshes;
+
+    // Staged until upload.
+    std::vector<Vertex> _vertices;
+    std::vector<uint32_t> _indices;
+    std::vector<glm::vec3> _positions;
+
+    VkDeviceMemory _vertexBufferMemory = VK_NULL_HANDLE;
+    VkDeviceMemory _positionBufferMemory = VK_NULL_HANDLE;
+    VkDeviceMemory _indexBufferMemory = VK_NULL_HANDLE;
+};
+
+#endif
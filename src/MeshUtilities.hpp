@@ -50,6 +50,28 @@ struct Vertex
         return attributeDescriptions;
     }
 
+    // Tightly packed positions at binding 0, see MeshPool::positionBuffer.
+    static VkVertexInputBindingDescription getPositionBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription = {};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(glm::vec3);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static VkVertexInputAttributeDescription getPositionAttributeDescription()
+    {
+        VkVertexInputAttributeDescription attributeDescription = {};
+        attributeDescription.binding = 0;
+        attributeDescription.location = 0;
+        attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescription.offset = 0;
+
+        return attributeDescription;
+    }
+
     bool operator==(const Vertex &other) const
     {
         return pos == other.pos
@@ -59,6 +81,46 @@ struct Vertex
     }
 };
 
+// Per instance vertex stream, see shader.vert.
+struct InstanceData
+{
+    glm::mat4 modelViewProjection;
+    // World space position and normal for the clustered lights.
+    glm::mat4 model;
+
+    static VkVertexInputBindingDescription getBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription = {};
+        bindingDescription.binding = 1;
+        bindingDescription.stride = sizeof(InstanceData);
+        // Advances once per instance instead of once per vertex.
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        return bindingDescription;
+    }
+
+    // A mat4 attribute takes one location per column, after the Vertex ones.
+    static std::array<VkVertexInputAttributeDescription, 8> getAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, 8> attributeDescriptions = {};
+
+        for (uint32_t column = 0; column < 4; column++)
+        {
+            attributeDescriptions[column].binding = 1;
+            attributeDescriptions[column].location = 4 + column;
+            attributeDescriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attributeDescriptions[column].offset = offsetof(InstanceData, modelViewProjection) + column * sizeof(glm::vec4);
+
+            attributeDescriptions[column + 4].binding = 1;
+            attributeDescriptions[column + 4].location = 8 + column;
+            attributeDescriptions[column + 4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attributeDescriptions[column + 4].offset = offsetof(InstanceData, model) + column * sizeof(glm::vec4);
+        }
+
+        return attributeDescriptions;
+    }
+};
+
 typedef struct _Mesh {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
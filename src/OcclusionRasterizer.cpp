@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include "OcclusionRasterizer.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OCCLUSION_RASTERIZER_AVX2
+#endif
+
+namespace
+{
+// Below this w a vertex is treated as being on the camera plane.
+const float MIN_W = 1e-5f;
+
+// Screen space triangles thinner than this cover no pixel center.
+const float MIN_AREA = 1e-8f;
+
+float min3(float a, float b, float c)
+{
+    return std::min(a, std::min(b, c));
+}
+
+float max3(float a, float b, float c)
+{
+    return std::max(a, std::max(b, c));
+}
+}
+
+OcclusionRasterizer::OcclusionRasterizer(uint32_t width, uint32_t height)
+{
+    resize(width, height);
+}
+
+const char *OcclusionRasterizer::instructionSet()
+{
+#ifdef OCCLUSION_RASTERIZER_AVX2
+    return "AVX2";
+#else
+    return "scalar";
+#endif
+}
+
+void OcclusionRasterizer::resize(uint32_t width, uint32_t height)
+{
+    _tilesX = std::max(1u, (width + TILE_WIDTH - 1) / TILE_WIDTH);
+    _tilesY = std::max(1u, (height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+    _width = _tilesX * TILE_WIDTH;
+    _height = _tilesY * TILE_HEIGHT;
+
+    _depth.assign(_width * _height, 1.0f);
+    _tileMaxDepth.assign(_tilesX * _tilesY, 1.0f);
+    _bins.resize(_tilesX * _tilesY);
+}
+
+void OcclusionRasterizer::clear()
+{
+    std::fill(_depth.begin(), _depth.end(), 1.0f);
+    std::fill(_tileMaxDepth.begin(), _tileMaxDepth.end(), 1.0f);
+    _occluders.clear();
+    _triangleCount = 0;
+}
+
+void OcclusionRasterizer::addOccluder(
+    const glm::vec3 *positions,
+    const uint32_t *indices,
+    size_t indexCount,
+    const glm::mat4 &modelViewProjection)
+{
+    Occluder occluder;
+    occluder.positions = positions;
+    occluder.indices = indices;
+    occluder.indexCount = indexCount;
+    occluder.modelViewProjection = modelViewProjection;
+    _occluders.push_back(occluder);
+}
+
+void OcclusionRasterizer::render(ThreadPool *pool)
+{
+    const size_t occluderCount = _occluders.size();
+    _firstTriangle.resize(occluderCount);
+    _setupCount.resize(occluderCount);
+
+    // Near plane clipping turns a triangle into at most two.
+    uint32_t slots = 0;
+    for (size_t i = 0; i < occluderCount; i++)
+    {
+        _firstTriangle[i] = slots;
+        slots += static_cast<uint32_t>(_occluders[i].indexCount / 3) * 2;
+    }
+    _triangles.resize(slots);
+
+    auto setup = [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            _setupCount[i] = _setup(_occluders[i], _triangles.data() + _firstTriangle[i]);
+        }
+    };
+
+    if (pool)
+    {
+        pool->parallelFor(occluderCount, setup);
+    }
+    else
+    {
+        setup(0, occluderCount);
+    }
+
+    // Cheap next to rasterization, one thread keeps the bins lock free.
+    for (auto &bin : _bins)
+    {
+        bin.clear();
+    }
+
+    _triangleCount = 0;
+    for (size_t i = 0; i < occluderCount; i++)
+    {
+        for (uint32_t index = _firstTriangle[i]; index < _firstTriangle[i] + _setupCount[i]; index++)
+        {
+            const Triangle &triangle = _triangles[index];
+            for (int32_t tileY = triangle.minY / TILE_HEIGHT; tileY <= triangle.maxY / static_cast<int32_t>(TILE_HEIGHT); tileY++)
+            {
+                for (int32_t tileX = triangle.minX / TILE_WIDTH; tileX <= triangle.maxX / static_cast<int32_t>(TILE_WIDTH); tileX++)
+                {
+                    _bins[tileY * _tilesX + tileX].push_back(index);
+                }
+            }
+        }
+        _triangleCount += _setupCount[i];
+    }
+
+    // Tiles differ a lot in cost, each thread takes them one at a time.
+    std::atomic<uint32_t> nextTile(0);
+    const uint32_t tileCount = static_cast<uint32_t>(_bins.size());
+    auto rasterize = [this, &nextTile, tileCount](size_t, size_t) {
+        uint32_t tile;
+        while ((tile = nextTile++) < tileCount)
+        {
+            _rasterizeTile(tile);
+        }
+    };
+
+    if (pool)
+    {
+        pool->parallelFor(pool->size() + 1, rasterize);
+    }
+    else
+    {
+        rasterize(0, 1);
+    }
+}
+
+uint32_t OcclusionRasterizer::_setup(const Occluder &occluder, Triangle *triangles) const
+{
+    uint32_t count = 0;
+    for (size_t i = 0; i + 2 < occluder.indexCount; i += 3)
+    {
+        glm::vec4 input[3];
+        for (int corner = 0; corner < 3; corner++)
+        {
+            const glm::vec3 &position = occluder.positions[occluder.indices[i + corner]];
+            input[corner] = occluder.modelViewProjection * glm::vec4(position, 1.0f);
+        }
+
+        // Clipped against z >= 0, the near plane with a [0, 1] depth range.
+        glm::vec4 clipped[4];
+        int clippedCount = 0;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            const glm::vec4 &current = input[corner];
+            const glm::vec4 &next = input[(corner + 1) % 3];
+            bool currentInside = current.z >= 0.0f;
+            bool nextInside = next.z >= 0.0f;
+
+            if (currentInside)
+            {
+                clipped[clippedCount++] = current;
+            }
+            if (currentInside != nextInside)
+            {
+                float t = current.z / (current.z - next.z);
+                clipped[clippedCount++] = current + (next - current) * t;
+            }
+        }
+
+        for (int fan = 1; fan + 1 < clippedCount; fan++)
+        {
+            if (_setupTriangle(clipped[0], clipped[fan], clipped[fan + 1], triangles[count]))
+            {
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+bool OcclusionRasterizer::_setupTriangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2, Triangle &triangle) const
+{
+    const glm::vec4 *vertices[3] = {&v0, &v1, &v2};
+    float x[3];
+    float y[3];
+    float z[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec4 &vertex = *vertices[i];
+        if (vertex.w < MIN_W)
+        {
+            return false;
+        }
+
+        float inverseW = 1.0f / vertex.w;
+        x[i] = (vertex.x * inverseW * 0.5f + 0.5f) * _width;
+        y[i] = (vertex.y * inverseW * 0.5f + 0.5f) * _height;
+        z[i] = vertex.z * inverseW;
+    }
+
+    // Beyond the far plane, the cleared depth already hides it.
+    if (min3(z[0], z[1], z[2]) > 1.0f)
+    {
+        return false;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (std::fabs(area) < MIN_AREA)
+    {
+        return false;
+    }
+
+    // Pixels whose center is inside the bounding box, clamped before the
+    // integer conversion since clipped vertices can be far off screen.
+    float minX = std::max(0.0f, std::ceil(min3(x[0], x[1], x[2]) - 0.5f));
+    float maxX = std::min(static_cast<float>(_width - 1), std::floor(max3(x[0], x[1], x[2]) - 0.5f));
+    float minY = std::max(0.0f, std::ceil(min3(y[0], y[1], y[2]) - 0.5f));
+    float maxY = std::min(static_cast<float>(_height - 1), std::floor(max3(y[0], y[1], y[2]) - 0.5f));
+    if (minX > maxX || minY > maxY)
+    {
+        return false;
+    }
+
+    triangle.minX = static_cast<int32_t>(minX);
+    triangle.maxX = static_cast<int32_t>(maxX);
+    triangle.minY = static_cast<int32_t>(minY);
+    triangle.maxY = static_cast<int32_t>(maxY);
+
+    // Both windings are drawn, open meshes occlude from either side.
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < 3; i++)
+    {
+        int j = (i + 1) % 3;
+        triangle.edgeA[i] = sign * (y[i] - y[j]);
+        triangle.edgeB[i] = sign * (x[j] - x[i]);
+        triangle.edgeC[i] = -(triangle.edgeA[i] * x[i] + triangle.edgeB[i] * y[i]);
+    }
+
+    triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    triangle.depthB = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+    triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+
+    return true;
+}
+
+void OcclusionRasterizer::_rasterizeTile(uint32_t tile)
+{
+    const std::vector<uint32_t> &bin = _bins[tile];
+    if (bin.empty())
+    {
+        return;
+    }
+
+    const int32_t tileX = static_cast<int32_t>((tile % _tilesX) * TILE_WIDTH);
+    const int32_t tileY = static_cast<int32_t>((tile / _tilesX) * TILE_HEIGHT);
+
+#ifdef OCCLUSION_RASTERIZER_AVX2
+    const __m256 laneCenters = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+#endif
+
+    for (uint32_t index : bin)
+    {
+        const Triangle &triangle = _triangles[index];
+
+        // Spans start on a multiple of eight, which keeps them in the tile.
+        const int32_t x0 = std::max(triangle.minX, tileX) & ~7;
+        const int32_t x1 = std::min(triangle.maxX, tileX + static_cast<int32_t>(TILE_WIDTH) - 1);
+        const int32_t y0 = std::max(triangle.minY, tileY);
+        const int32_t y1 = std::min(triangle.maxY, tileY + static_cast<int32_t>(TILE_HEIGHT) - 1);
+
+#ifdef OCCLUSION_RASTERIZER_AVX2
+        const __m256 edgeA0 = _mm256_set1_ps(triangle.edgeA[0]);
+        const __m256 edgeA1 = _mm256_set1_ps(triangle.edgeA[1]);
+        const __m256 edgeA2 = _mm256_set1_ps(triangle.edgeA[2]);
+        const __m256 depthA = _mm256_set1_ps(triangle.depthA);
+#endif
+
+        for (int32_t y = y0; y <= y1; y++)
+        {
+            float *row = &_depth[y * _width];
+            const float centerY = y + 0.5f;
+
+            // Everything that only depends on the row.
+            const float rowEdge0 = triangle.edgeB[0] * centerY + triangle.edgeC[0];
+            const float rowEdge1 = triangle.edgeB[1] * centerY + triangle.edgeC[1];
+            const float rowEdge2 = triangle.edgeB[2] * centerY + triangle.edgeC[2];
+            const float rowDepth = triangle.depthB * centerY + triangle.depthC;
+
+#ifdef OCCLUSION_RASTERIZER_AVX2
+            const __m256 rowEdge0Wide = _mm256_set1_ps(rowEdge0);
+            const __m256 rowEdge1Wide = _mm256_set1_ps(rowEdge1);
+            const __m256 rowEdge2Wide = _mm256_set1_ps(rowEdge2);
+            const __m256 rowDepthWide = _mm256_set1_ps(rowDepth);
+
+            for (int32_t x = x0; x <= x1; x += 8)
+            {
+                __m256 centerX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneCenters);
+                __m256 edge0 = _mm256_add_ps(_mm256_mul_ps(edgeA0, centerX), rowEdge0Wide);
+                __m256 edge1 = _mm256_add_ps(_mm256_mul_ps(edgeA1, centerX), rowEdge1Wide);
+                __m256 edge2 = _mm256_add_ps(_mm256_mul_ps(edgeA2, centerX), rowEdge2Wide);
+
+                // A sign bit in any edge means the center is outside.
+                __m256 outside = _mm256_or_ps(_mm256_or_ps(edge0, edge1), edge2);
+
+                __m256 depth = _mm256_add_ps(_mm256_mul_ps(depthA, centerX), rowDepthWide);
+                __m256 current = _mm256_loadu_ps(row + x);
+                __m256 nearest = _mm256_min_ps(current, depth);
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(nearest, current, outside));
+            }
+#else
+            for (int32_t x = x0; x <= x1; x++)
+            {
+                const float centerX = x + 0.5f;
+                if (triangle.edgeA[0] * centerX + rowEdge0 >= 0.0f
+                    && triangle.edgeA[1] * centerX + rowEdge1 >= 0.0f
+                    && triangle.edgeA[2] * centerX + rowEdge2 >= 0.0f)
+                {
+                    row[x] = std::min(row[x], triangle.depthA * centerX + rowDepth);
+                }
+            }
+#endif
+        }
+    }
+
+    float farthest = 0.0f;
+    for (int32_t y = tileY; y < tileY + static_cast<int32_t>(TILE_HEIGHT); y++)
+    {
+        const float *row = &_depth[y * _width + tileX];
+#ifdef OCCLUSION_RASTERIZER_AVX2
+        __m256 rowMax = _mm256_loadu_ps(row);
+        for (uint32_t x = 8; x < TILE_WIDTH; x += 8)
+        {
+            rowMax = _mm256_max_ps(rowMax, _mm256_loadu_ps(row + x));
+        }
+
+        float lanes[8];
+        _mm256_storeu_ps(lanes, rowMax);
+        farthest = std::max(farthest, *std::max_element(lanes, lanes + 8));
+#else
+        farthest = std::max(farthest, *std::max_element(row, row + TILE_WIDTH));
+#endif
+    }
+    _tileMaxDepth[tile] = farthest;
+}
+
+bool OcclusionRasterizer::isVisible(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &modelViewProjection) const
+{
+    float minX = std::numeric_limits<float>::max();
+    float minY = std::numeric_limits<float>::max();
+    float maxX = -std::numeric_limits<float>::max();
+    float maxY = -std::numeric_limits<float>::max();
+    float nearest = std::numeric_limits<float>::max();
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 position(
+            (corner & 1) ? max.x : min.x,
+            (corner & 2) ? max.y : min.y,
+            (corner & 4) ? max.z : min.z,
+            1.0f);
+        glm::vec4 clip = modelViewProjection * position;
+
+        // Crossing the near plane, the box may cover the whole screen.
+        if (clip.z < 0.0f || clip.w < MIN_W)
+        {
+            return true;
+        }
+
+        float inverseW = 1.0f / clip.w;
+        float x = (clip.x * inverseW * 0.5f + 0.5f) * _width;
+        float y = (clip.y * inverseW * 0.5f + 0.5f) * _height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z * inverseW);
+    }
+
+    // Off screen, frustum culling decides.
+    if (maxX < 0.0f || maxY < 0.0f || minX >= _width || minY >= _height)
+    {
+        return true;
+    }
+
+    // Every pixel the rectangle touches, not only the covered centers.
+    const int32_t x0 = static_cast<int32_t>(std::max(0.0f, std::floor(minX)));
+    const int32_t x1 = static_cast<int32_t>(std::min(static_cast<float>(_width - 1), std::floor(maxX)));
+    const int32_t y0 = static_cast<int32_t>(std::max(0.0f, std::floor(minY)));
+    const int32_t y1 = static_cast<int32_t>(std::min(static_cast<float>(_height - 1), std::floor(maxY)));
+
+#ifdef OCCLUSION_RASTERIZER_AVX2
+    const __m256i laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 nearestWide = _mm256_set1_ps(nearest);
+#endif
+
+    for (int32_t tileY = y0 / TILE_HEIGHT; tileY <= y1 / static_cast<int32_t>(TILE_HEIGHT); tileY++)
+    {
+        for (int32_t tileX = x0 / TILE_WIDTH; tileX <= x1 / static_cast<int32_t>(TILE_WIDTH); tileX++)
+        {
+            // Everything in the tile is in front of the box.
+            if (_tileMaxDepth[tileY * _tilesX + tileX] < nearest)
+            {
+                continue;
+            }
+
+            const int32_t spanX0 = std::max(x0, tileX * static_cast<int32_t>(TILE_WIDTH));
+            const int32_t spanX1 = std::min(x1, (tileX + 1) * static_cast<int32_t>(TILE_WIDTH) - 1);
+            const int32_t spanY0 = std::max(y0, tileY * static_cast<int32_t>(TILE_HEIGHT));
+            const int32_t spanY1 = std::min(y1, (tileY + 1) * static_cast<int32_t>(TILE_HEIGHT) - 1);
+
+#ifdef OCCLUSION_RASTERIZER_AVX2
+            // Lanes outside [spanX0, spanX1] are masked off.
+            const __m256i first = _mm256_set1_epi32(spanX0 - 1);
+            const __m256i last = _mm256_set1_epi32(spanX1 + 1);
+#endif
+
+            for (int32_t y = spanY0; y <= spanY1; y++)
+            {
+                const float *row = &_depth[y * _width];
+#ifdef OCCLUSION_RASTERIZER_AVX2
+                for (int32_t x = spanX0 & ~7; x <= spanX1; x += 8)
+                {
+                    __m256i lanes = _mm256_add_epi32(_mm256_set1_epi32(x), laneIndices);
+                    __m256i inSpan = _mm256_and_si256(_mm256_cmpgt_epi32(lanes, first), _mm256_cmpgt_epi32(last, lanes));
+                    __m256 behind = _mm256_cmp_ps(_mm256_loadu_ps(row + x), nearestWide, _CMP_GE_OQ);
+                    if (_mm256_movemask_ps(_mm256_and_ps(behind, _mm256_castsi256_ps(inSpan))) != 0)
+                    {
+                        return true;
+                    }
+                }
+#else
+                for (int32_t x = spanX0; x <= spanX1; x++)
+                {
+                    if (row[x] >= nearest)
+                    {
+                        return true;
+                    }
+                }
+#endif
+            }
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,101 @@
+#ifndef OcclusionRasterizer_hpp
+#define OcclusionRasterizer_hpp
+
+#include "common.hpp"
+#include "ThreadPool.hpp"
+
+// Depth only software rasterizer for occlusion culling on the CPU.
+// Occluder triangles are drawn into a small depth buffer split in tiles,
+// each tile is one task, then bounding boxes are tested against it.
+// With AVX2 a row is processed eight pixels at a time, other targets
+// use the same loops in scalar code.
+class OcclusionRasterizer
+{
+public:
+    static const uint32_t TILE_WIDTH = 32;
+    static const uint32_t TILE_HEIGHT = 16;
+
+    // Sizes are rounded up to whole tiles.
+    explicit OcclusionRasterizer(uint32_t width = 256, uint32_t height = 128);
+
+    void resize(uint32_t width, uint32_t height);
+
+    // Drops the occluders and clears the depth to the far plane.
+    void clear();
+
+    // Only referenced until render(). Indices are relative to positions.
+    void addOccluder(
+        const glm::vec3 *positions,
+        const uint32_t *indices,
+        size_t indexCount,
+        const glm::mat4 &modelViewProjection);
+
+    // Clips, sets up and bins the triangles, then rasterizes the tiles.
+    void render(ThreadPool *pool = nullptr);
+
+    // False when the box is behind the occluders everywhere it covers.
+    // Safe to call from several threads once render() returned.
+    bool isVisible(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &modelViewProjection) const;
+
+    uint32_t width() const { return _width; }
+    uint32_t height() const { return _height; }
+    // Row major normalized device depth, 1 where nothing was drawn.
+    const float *depth() const { return _depth.data(); }
+    // Triangles left after near plane clipping and culling, last render().
+    size_t triangleCount() const { return _triangleCount; }
+
+    // "AVX2" or "scalar", whichever this file was compiled for.
+    static const char *instructionSet();
+
+private:
+    struct Occluder
+    {
+        const glm::vec3 *positions;
+        const uint32_t *indices;
+        size_t indexCount;
+        glm::mat4 modelViewProjection;
+    };
+
+    // In pixels, centers at half integers.
+    struct Triangle
+    {
+        // Edge functions a * x + b * y + c, positive inside.
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        // Depth plane a * x + b * y + c.
+        float depthA;
+        float depthB;
+        float depthC;
+        // Inclusive pixel bounds, inside the buffer.
+        int32_t minX;
+        int32_t minY;
+        int32_t maxX;
+        int32_t maxY;
+    };
+
+    // Writes up to two triangles per input triangle, returns how many.
+    uint32_t _setup(const Occluder &occluder, Triangle *triangles) const;
+    bool _setupTriangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2, Triangle &triangle) const;
+    void _rasterizeTile(uint32_t tile);
+
+    uint32_t _width = 0;
+    uint32_t _height = 0;
+    uint32_t _tilesX = 0;
+    uint32_t _tilesY = 0;
+
+    std::vector<float> _depth;
+    // Farthest depth of each tile, most tests never read the pixels.
+    std::vector<float> _tileMaxDepth;
+
+    std::vector<Occluder> _occluders;
+    // Two slots per input triangle, occluder i starts at _firstTriangle[i].
+    std::vector<Triangle> _triangles;
+    std::vector<uint32_t> _firstTriangle;
+    std::vector<uint32_t> _setupCount;
+    // Triangles overlapping each tile.
+    std::vector<std::vector<uint32_t>> _bins;
+    size_t _triangleCount = 0;
+};
+
+#endif
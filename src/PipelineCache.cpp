@@ -0,0 +1,164 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "PipelineCache.hpp"
+
+static const uint32_t CACHE_MAGIC = 0x50434348; // "PCCH"
+static const uint32_t CACHE_VERSION = 1;
+
+void PipelineCache::init(VkPhysicalDevice &physicalDevice, VkDevice &device, const std::string &path)
+{
+    _device = device;
+    _path = path;
+    _warm = false;
+
+    vkGetPhysicalDeviceProperties(physicalDevice, &_properties);
+
+    std::vector<char> blob;
+    _warm = _readBlob(blob);
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = _warm ? blob.size() : 0;
+    createInfo.pInitialData = _warm ? blob.data() : nullptr;
+
+    if (vkCreatePipelineCache(_device, &createInfo, nullptr, &handle) != VK_SUCCESS)
+    {
+        // A blob the driver doesn't like is not fatal, start over with an empty cache.
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        _warm = false;
+
+        if (vkCreatePipelineCache(_device, &createInfo, nullptr, &handle) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Unable to create pipeline cache.");
+        }
+    }
+
+    std::cout << "Pipeline cache " << (_warm ? "loaded from " : "created, no valid data in ") << _path << std::endl;
+}
+
+void PipelineCache::_fillHeader(FileHeader &header) const
+{
+    header = {};
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.vendorID = _properties.vendorID;
+    header.deviceID = _properties.deviceID;
+    header.driverVersion = _properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, _properties.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+bool PipelineCache::_readBlob(std::vector<char> &blob) const
+{
+    std::ifstream file(_path, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    FileHeader stored;
+    if (!file.read(reinterpret_cast<char *>(&stored), sizeof(stored)))
+    {
+        return false;
+    }
+
+    FileHeader expected;
+    _fillHeader(expected);
+
+    if (stored.magic != expected.magic ||
+        stored.version != expected.version ||
+        stored.vendorID != expected.vendorID ||
+        stored.deviceID != expected.deviceID ||
+        stored.driverVersion != expected.driverVersion ||
+        memcmp(stored.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        std::cout << "Pipeline cache " << _path << " was written by another device or driver, ignoring it." << std::endl;
+        return false;
+    }
+
+    // The size comes from the file, it must fit in what is left of it.
+    std::streampos dataStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::streamoff remaining = file.tellg() - dataStart;
+    if (dataStart < 0 || remaining < 0 || stored.dataSize != static_cast<uint64_t>(remaining))
+    {
+        std::cout << "Pipeline cache " << _path << " is truncated or corrupt, ignoring it." << std::endl;
+        return false;
+    }
+    file.seekg(dataStart);
+
+    blob.resize(static_cast<size_t>(stored.dataSize));
+    if (!file.read(blob.data(), blob.size()))
+    {
+        return false;
+    }
+
+    // Driver header: length, version, vendor ID, device ID, cache UUID.
+    const size_t driverHeaderSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (blob.size() < driverHeaderSize)
+    {
+        return false;
+    }
+
+    uint32_t fields[4];
+    memcpy(fields, blob.data(), sizeof(fields));
+
+    return fields[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           fields[2] == expected.vendorID &&
+           fields[3] == expected.deviceID &&
+           memcmp(blob.data() + sizeof(fields), expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::save()
+{
+    if (handle == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(_device, handle, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+    {
+        return;
+    }
+
+    std::vector<char> blob(dataSize);
+    if (vkGetPipelineCacheData(_device, handle, &dataSize, blob.data()) != VK_SUCCESS)
+    {
+        std::cerr << "Unable to read pipeline cache data." << std::endl;
+        return;
+    }
+
+    FileHeader header;
+    _fillHeader(header);
+    header.dataSize = dataSize;
+
+    // Write next to the target and rename, so a crash never leaves a truncated cache behind.
+    std::string temporaryPath = _path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+    {
+        std::cerr << "Unable to write pipeline cache to " << temporaryPath << std::endl;
+        return;
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(blob.data(), dataSize);
+    file.close();
+
+    if (!file || std::rename(temporaryPath.c_str(), _path.c_str()) != 0)
+    {
+        std::cerr << "Unable to write pipeline cache to " << _path << std::endl;
+        std::remove(temporaryPath.c_str());
+    }
+}
+
+void PipelineCache::clean()
+{
+    vkDestroyPipelineCache(_device, handle, nullptr);
+    handle = VK_NULL_HANDLE;
+}
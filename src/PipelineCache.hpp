@@ -0,0 +1,46 @@
+#ifndef PipelineCache_hpp
+#define PipelineCache_hpp
+
+#include "common.hpp"
+
+// Wraps a VkPipelineCache that is seeded from and saved back to disk,
+// so pipelines compiled in a previous run don't have to be rebuilt.
+class PipelineCache
+{
+public:
+    PipelineCache(){};
+    ~PipelineCache(){};
+
+    void init(VkPhysicalDevice &physicalDevice, VkDevice &device, const std::string &path);
+    void save();
+    void clean();
+
+    // True when the cache was seeded with a valid blob from disk.
+    bool isWarm() const { return _warm; }
+
+    VkPipelineCache handle = VK_NULL_HANDLE;
+
+private:
+    // Prepended to the driver blob. The driver validates its own header too,
+    // but some implementations crash on foreign data, so check first.
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+    };
+
+    bool _readBlob(std::vector<char> &blob) const;
+    void _fillHeader(FileHeader &header) const;
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties _properties;
+    std::string _path;
+    bool _warm = false;
+};
+
+#endif
@@ -0,0 +1,524 @@
+#include <sstream>
+
+#include "PipelineRegistry.hpp"
+#include "Hash.hpp"
+#include "VulkanUtilities.hpp"
+
+uint64_t PipelineState::hash() const
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = hashCombine(hash, vertexShader);
+    hash = hashCombine(hash, fragmentShader);
+    hash = hashCombine(hash, vertexSpecialization.entries);
+    hash = hashBytes(vertexSpecialization.data.data(), vertexSpecialization.dataSize, hash);
+    hash = hashCombine(hash, fragmentSpecialization.entries);
+    hash = hashBytes(fragmentSpecialization.data.data(), fragmentSpecialization.dataSize, hash);
+    hash = hashCombine(hash, vertexLayout);
+    hash = hashCombine(hash, topology);
+    hash = hashCombine(hash, polygonMode);
+    hash = hashCombine(hash, cullMode);
+    hash = hashCombine(hash, frontFace);
+    hash = hashCombine(hash, depthTest);
+    hash = hashCombine(hash, depthWrite);
+    hash = hashCombine(hash, depthCompareOp);
+    hash = hashCombine(hash, blendEnable);
+    hash = hashCombine(hash, colorAttachmentCount);
+    hash = hashCombine(hash, layout);
+    hash = hashCombine(hash, renderPassKey);
+    hash = hashCombine(hash, subpass);
+    return hash;
+}
+
+bool PipelineState::operator==(const PipelineState &other) const
+{
+    return vertexShader == other.vertexShader &&
+           fragmentShader == other.fragmentShader &&
+           vertexSpecialization == other.vertexSpecialization &&
+           fragmentSpecialization == other.fragmentSpecialization &&
+           vertexLayout == other.vertexLayout &&
+           topology == other.topology &&
+           polygonMode == other.polygonMode &&
+           cullMode == other.cullMode &&
+           frontFace == other.frontFace &&
+           depthTest == other.depthTest &&
+           depthWrite == other.depthWrite &&
+           depthCompareOp == other.depthCompareOp &&
+           blendEnable == other.blendEnable &&
+           colorAttachmentCount == other.colorAttachmentCount &&
+           layout == other.layout &&
+           renderPassKey == other.renderPassKey &&
+           subpass == other.subpass;
+}
+
+uint64_t PipelineLayoutKey::hash() const
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (auto &setLayout : setLayouts)
+    {
+        hash = hashCombine(hash, setLayout);
+    }
+    for (auto &range : pushConstantRanges)
+    {
+        hash = hashCombine(hash, range.stageFlags);
+        hash = hashCombine(hash, range.offset);
+        hash = hashCombine(hash, range.size);
+    }
+    return hash;
+}
+
+bool PipelineLayoutKey::operator==(const PipelineLayoutKey &other) const
+{
+    if (setLayouts != other.setLayouts || pushConstantRanges.size() != other.pushConstantRanges.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < pushConstantRanges.size(); i++)
+    {
+        const VkPushConstantRange &range = pushConstantRanges[i];
+        const VkPushConstantRange &otherRange = other.pushConstantRanges[i];
+        if (range.stageFlags != otherRange.stageFlags || range.offset != otherRange.offset || range.size != otherRange.size)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PipelineRegistry::init(VkDevice &device, PipelineCache &pipelineCache, ThreadPool &threadPool)
+{
+    _device = device;
+    _pipelineCache = &pipelineCache;
+    _threadPool = &threadPool;
+}
+
+void PipelineRegistry::clean()
+{
+    waitIdle();
+
+    std::cout << "Pipeline registry: " << _entries.size() << " pipelines, "
+              << _computePipelines.size() << " compute pipelines, "
+              << _pipelineHits << " reused, "
+              << _shaderModules.size() << " shader modules." << std::endl;
+
+    for (auto &entry : _entries)
+    {
+        vkDestroyPipeline(_device, entry->pipeline, nullptr);
+    }
+
+    for (auto &entry : _computePipelines)
+    {
+        vkDestroyPipeline(_device, entry.second, nullptr);
+    }
+
+    for (auto &entry : _layouts)
+    {
+        vkDestroyPipelineLayout(_device, entry.second, nullptr);
+    }
+
+    for (auto &shaderModule : _shaderModules)
+    {
+        vkDestroyShaderModule(_device, shaderModule, nullptr);
+    }
+
+    _entries.clear();
+    _handles.clear();
+    _computePipelines.clear();
+    _layouts.clear();
+    _shaderModules.clear();
+    _shaderPaths.clear();
+    _shaderContents.clear();
+    _fallback = INVALID_PIPELINE;
+}
+
+VkShaderModule PipelineRegistry::_createShaderModule(const std::vector<char> &code)
+{
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(_device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create shader module!");
+    }
+
+    return shaderModule;
+}
+
+ShaderId PipelineRegistry::loadShader(const std::string &path)
+{
+    auto byPath = _shaderPaths.find(path);
+    if (byPath != _shaderPaths.end())
+    {
+        return byPath->second;
+    }
+
+    auto code = VulkanUtilities::readFile(path);
+    uint64_t contentHash = hashBytes(code.data(), code.size());
+
+    ShaderId id;
+    auto byContent = _shaderContents.find(contentHash);
+    if (byContent != _shaderContents.end())
+    {
+        id = byContent->second;
+    }
+    else
+    {
+        id = static_cast<ShaderId>(_shaderModules.size());
+        _shaderModules.push_back(_createShaderModule(code));
+        _shaderContents[contentHash] = id;
+    }
+
+    _shaderPaths[path] = id;
+    return id;
+}
+
+VkPipelineLayout PipelineRegistry::getLayout(
+    const std::vector<VkDescriptorSetLayout> &setLayouts,
+    const std::vector<VkPushConstantRange> &pushConstantRanges)
+{
+    PipelineLayoutKey key;
+    key.setLayouts = setLayouts;
+    key.pushConstantRanges = pushConstantRanges;
+
+    auto found = _layouts.find(key);
+    if (found != _layouts.end())
+    {
+        return found->second;
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+    VkPipelineLayout pipelineLayout;
+    if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create pipeline layout.");
+    }
+
+    _layouts[key] = pipelineLayout;
+    return pipelineLayout;
+}
+
+PipelineHandle PipelineRegistry::request(const PipelineState &state, VkRenderPass renderPass)
+{
+    auto found = _handles.find(state);
+    if (found != _handles.end())
+    {
+        _pipelineHits++;
+        return found->second;
+    }
+
+    PipelineHandle handle = static_cast<PipelineHandle>(_entries.size());
+    _entries.emplace_back(new Entry());
+    _handles[state] = handle;
+
+    Entry *entry = _entries.back().get();
+    entry->state = state;
+    entry->status.store(Pending);
+
+    // Resolve modules now, workers must not touch containers the caller may grow.
+    VkShaderModule vertexShader = _shaderModules.at(state.vertexShader);
+    VkShaderModule fragmentShader = state.fragmentShader == NO_SHADER ? VK_NULL_HANDLE : _shaderModules.at(state.fragmentShader);
+
+    _threadPool->submit([this, entry, vertexShader, fragmentShader, renderPass]() {
+        try
+        {
+            entry->pipeline = _createPipeline(entry->state, vertexShader, fragmentShader, renderPass);
+            entry->status.store(Ready);
+        }
+        catch (const std::exception &e)
+        {
+            entry->error = e.what();
+            entry->status.store(Failed);
+        }
+
+        std::lock_guard<std::mutex> lock(_compiledMutex);
+        _compiled.notify_all();
+    });
+
+    return handle;
+}
+
+void PipelineRegistry::_check(const Entry &entry) const
+{
+    if (entry.status.load() == Failed)
+    {
+        throw std::runtime_error(entry.error);
+    }
+}
+
+bool PipelineRegistry::isReady(PipelineHandle handle) const
+{
+    const Entry &entry = *_entries.at(handle);
+    _check(entry);
+    return entry.status.load() == Ready;
+}
+
+VkPipeline PipelineRegistry::pipeline(PipelineHandle handle) const
+{
+    if (isReady(handle))
+    {
+        return _entries[handle]->pipeline;
+    }
+
+    if (_fallback != INVALID_PIPELINE && _fallback != handle && isReady(_fallback))
+    {
+        return _entries[_fallback]->pipeline;
+    }
+
+    return VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineRegistry::wait(PipelineHandle handle)
+{
+    const Entry &entry = *_entries.at(handle);
+
+    std::unique_lock<std::mutex> lock(_compiledMutex);
+    _compiled.wait(lock, [&entry] { return entry.status.load() != Pending; });
+    lock.unlock();
+
+    _check(entry);
+    return entry.pipeline;
+}
+
+void PipelineRegistry::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(_compiledMutex);
+    _compiled.wait(lock, [this] {
+        for (auto &entry : _entries)
+        {
+            if (entry->status.load() == Pending)
+            {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+VkPipeline PipelineRegistry::getCompute(ShaderId shader, const Specialization &specialization, VkPipelineLayout layout)
+{
+    uint64_t key = FNV_OFFSET_BASIS;
+    key = hashCombine(key, shader);
+    key = hashCombine(key, specialization.entries);
+    key = hashBytes(specialization.data.data(), specialization.dataSize, key);
+    key = hashCombine(key, layout);
+
+    auto found = _computePipelines.find(key);
+    if (found != _computePipelines.end())
+    {
+        _pipelineHits++;
+        return found->second;
+    }
+
+    VkPipelineShaderStageCreateInfo stageInfo = {};
+    stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stageInfo.module = _shaderModules.at(shader);
+    stageInfo.pName = "main";
+
+    VkSpecializationInfo specializationInfo = specialization.info();
+    if (!specialization.empty())
+    {
+        stageInfo.pSpecializationInfo = &specializationInfo;
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = stageInfo;
+    pipelineInfo.layout = layout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(_device, _pipelineCache->handle, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create compute pipeline.");
+    }
+
+    _computePipelines[key] = pipeline;
+    return pipeline;
+}
+
+static void describeVertexInput(
+    VertexLayout layout,
+    std::vector<VkVertexInputBindingDescription> &bindings,
+    std::vector<VkVertexInputAttributeDescription> &attributes)
+{
+    switch (layout)
+    {
+    case VertexLayout::Mesh:
+    {
+        bindings.push_back(Vertex::getBindingDescription());
+        auto meshAttributes = Vertex::getAttributeDescriptions();
+        attributes.insert(attributes.end(), meshAttributes.begin(), meshAttributes.end());
+        break;
+    }
+    case VertexLayout::MeshInstanced:
+    {
+        describeVertexInput(VertexLayout::Mesh, bindings, attributes);
+        bindings.push_back(InstanceData::getBindingDescription());
+        auto instanceAttributes = InstanceData::getAttributeDescriptions();
+        attributes.insert(attributes.end(), instanceAttributes.begin(), instanceAttributes.end());
+        break;
+    }
+    case VertexLayout::PositionInstanced:
+    {
+        bindings.push_back(Vertex::getPositionBindingDescription());
+        attributes.push_back(Vertex::getPositionAttributeDescription());
+        bindings.push_back(InstanceData::getBindingDescription());
+        auto instanceAttributes = InstanceData::getAttributeDescriptions();
+        attributes.insert(attributes.end(), instanceAttributes.begin(), instanceAttributes.end());
+        break;
+    }
+    case VertexLayout::None:
+        break;
+    }
+}
+
+VkPipeline PipelineRegistry::_createPipeline(
+    const PipelineState &state,
+    VkShaderModule vertexShader,
+    VkShaderModule fragmentShader,
+    VkRenderPass renderPass)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertexShader;
+    vertShaderStageInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
+    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = fragmentShader;
+    fragShaderStageInfo.pName = "main";
+
+    VkSpecializationInfo vertSpecializationInfo = state.vertexSpecialization.info();
+    if (!state.vertexSpecialization.empty())
+    {
+        vertShaderStageInfo.pSpecializationInfo = &vertSpecializationInfo;
+    }
+
+    VkSpecializationInfo fragSpecializationInfo = state.fragmentSpecialization.info();
+    if (!state.fragmentSpecialization.empty())
+    {
+        fragShaderStageInfo.pSpecializationInfo = &fragSpecializationInfo;
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+    uint32_t stageCount = fragmentShader == VK_NULL_HANDLE ? 1 : 2;
+
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+    describeVertexInput(state.vertexLayout, bindingDescriptions, attributeDescriptions);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = state.topology;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport and scissor are set while encoding.
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = state.polygonMode;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = state.cullMode;
+    rasterizer.frontFace = state.frontFace;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = state.depthTest;
+    depthStencil.depthWriteEnable = state.depthWrite;
+    depthStencil.depthCompareOp = state.depthCompareOp;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    // Same blending on every attachment of the subpass.
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = state.blendEnable;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(state.colorAttachmentCount, colorBlendAttachment);
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = state.colorAttachmentCount;
+    colorBlending.pAttachments = colorBlendAttachments.data();
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = stageCount;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = state.layout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = state.subpass;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(_device, _pipelineCache->handle, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create graphics pipeline");
+    }
+
+    // Startup metric: compare cold (empty cache) and warm (seeded from disk) runs.
+    // Runs on a worker, so build the line first to keep it in one piece.
+    auto endTime = std::chrono::high_resolution_clock::now();
+    double elapsed = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    std::ostringstream message;
+    message << "Pipeline created in " << elapsed << " ms ("
+            << (_pipelineCache->isWarm() ? "warm" : "cold") << " cache)." << std::endl;
+    std::cout << message.str();
+
+    return pipeline;
+}
@@ -0,0 +1,175 @@
+#ifndef PipelineRegistry_hpp
+#define PipelineRegistry_hpp
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "MeshUtilities.hpp"
+#include "PipelineCache.hpp"
+#include "ShaderVariant.hpp"
+#include "ThreadPool.hpp"
+
+typedef uint32_t ShaderId;
+typedef uint32_t PipelineHandle;
+
+static const PipelineHandle INVALID_PIPELINE = ~0u;
+
+// Fragment shader of depth only pipelines.
+static const ShaderId NO_SHADER = ~0u;
+
+enum class VertexLayout : uint32_t
+{
+    Mesh,
+    // Mesh plus InstanceData at binding 1.
+    MeshInstanced,
+    // MeshPool positions plus InstanceData at binding 1.
+    PositionInstanced,
+    // Nothing bound, the vertex shader builds its own positions.
+    None,
+};
+
+// Everything that makes two graphics pipelines different. Viewport and
+// scissor are dynamic, so the same pipeline survives a resize.
+struct PipelineState
+{
+    ShaderId vertexShader = 0;
+    ShaderId fragmentShader = 0;
+    Specialization vertexSpecialization;
+    Specialization fragmentSpecialization;
+    VertexLayout vertexLayout = VertexLayout::Mesh;
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkBool32 depthTest = VK_TRUE;
+    VkBool32 depthWrite = VK_TRUE;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+    VkBool32 blendEnable = VK_FALSE;
+    // Color attachments of the subpass, 0 for depth only passes.
+    uint32_t colorAttachmentCount = 1;
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+
+    // Render passes with the same key are compatible, see Swapchain::createRenderPass.
+    uint64_t renderPassKey = 0;
+    uint32_t subpass = 0;
+
+    uint64_t hash() const;
+    bool operator==(const PipelineState &other) const;
+};
+
+struct PipelineStateHasher
+{
+    size_t operator()(const PipelineState &state) const { return static_cast<size_t>(state.hash()); }
+};
+
+// Inputs of a pipeline layout, equal ones share it.
+struct PipelineLayoutKey
+{
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    std::vector<VkPushConstantRange> pushConstantRanges;
+
+    uint64_t hash() const;
+    bool operator==(const PipelineLayoutKey &other) const;
+};
+
+struct PipelineLayoutKeyHasher
+{
+    size_t operator()(const PipelineLayoutKey &key) const { return static_cast<size_t>(key.hash()); }
+};
+
+// Owns every pipeline, pipeline layout and shader module. Identical
+// requests return the same objects, so adding materials only costs a
+// compile for state combinations that are actually new. Compilation runs
+// on the worker pool, callers poll the handle they got back.
+class PipelineRegistry
+{
+public:
+    PipelineRegistry(){};
+    ~PipelineRegistry(){};
+
+    void init(VkDevice &device, PipelineCache &pipelineCache, ThreadPool &threadPool);
+    void clean();
+
+    // Reads each path once, modules with identical SPIR-V are shared.
+    ShaderId loadShader(const std::string &path);
+
+    VkPipelineLayout getLayout(
+        const std::vector<VkDescriptorSetLayout> &setLayouts,
+        const std::vector<VkPushConstantRange> &pushConstantRanges = std::vector<VkPushConstantRange>());
+
+    // Schedules a compile on a miss. The render pass has to stay alive until
+    // the pipeline is ready, any pass matching `state.renderPassKey` is fine.
+    PipelineHandle request(const PipelineState &state, VkRenderPass renderPass);
+
+    bool isReady(PipelineHandle handle) const;
+
+    // The compiled pipeline, else the fallback if that one is ready, else VK_NULL_HANDLE.
+    VkPipeline pipeline(PipelineHandle handle) const;
+
+    // Blocks until the pipeline is compiled.
+    VkPipeline wait(PipelineHandle handle);
+
+    VkPipeline get(const PipelineState &state, VkRenderPass renderPass) { return wait(request(state, renderPass)); }
+
+    // Drawn in place of pipelines that are still compiling.
+    void setFallback(PipelineHandle handle) { _fallback = handle; }
+
+    // Blocks until every scheduled compile has finished.
+    void waitIdle();
+
+    // Compute pipelines are few and small, they compile on the calling thread.
+    VkPipeline getCompute(ShaderId shader, const Specialization &specialization, VkPipelineLayout layout);
+
+private:
+    enum Status
+    {
+        Pending,
+        Ready,
+        Failed
+    };
+
+    struct Entry
+    {
+        PipelineState state;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        std::atomic<int> status;
+        std::string error;
+    };
+
+    VkShaderModule _createShaderModule(const std::vector<char> &code);
+    VkPipeline _createPipeline(
+        const PipelineState &state,
+        VkShaderModule vertexShader,
+        VkShaderModule fragmentShader,
+        VkRenderPass renderPass);
+    void _check(const Entry &entry) const;
+
+    VkDevice _device = VK_NULL_HANDLE;
+    PipelineCache *_pipelineCache = nullptr;
+    ThreadPool *_threadPool = nullptr;
+
+    std::unordered_map<std::string, ShaderId> _shaderPaths;
+    std::unordered_map<uint64_t, ShaderId> _shaderContents;
+    std::vector<VkShaderModule> _shaderModules;
+
+    std::unordered_map<PipelineLayoutKey, VkPipelineLayout, PipelineLayoutKeyHasher> _layouts;
+
+    // Entries are only added from the calling thread, workers fill in the result.
+    std::vector<std::unique_ptr<Entry>> _entries;
+    std::unordered_map<PipelineState, PipelineHandle, PipelineStateHasher> _handles;
+    PipelineHandle _fallback = INVALID_PIPELINE;
+
+    std::unordered_map<uint64_t, VkPipeline> _computePipelines;
+
+    std::mutex _compiledMutex;
+    std::condition_variable _compiled;
+
+    uint32_t _pipelineHits = 0;
+};
+
+#endif
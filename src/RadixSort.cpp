@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <array>
+
+#include "RadixSort.hpp"
+
+namespace
+{
+const uint32_t RADIX_BITS = 8;
+const uint32_t BUCKETS = 1u << RADIX_BITS;
+const uint32_t PASSES = 64 / RADIX_BITS;
+
+// Below this a single chunk beats the scheduling cost.
+const size_t MIN_CHUNK_SIZE = 4096;
+
+typedef std::array<uint32_t, BUCKETS> Histogram;
+}
+
+void RadixSort::sort(std::vector<SortItem> &items, std::vector<SortItem> &scratch, ThreadPool *pool)
+{
+    const size_t count = items.size();
+    scratch.resize(count);
+    if (count < 2)
+    {
+        return;
+    }
+
+    size_t workers = pool ? pool->size() + 1 : 1;
+    size_t chunkCount = std::max<size_t>(1, std::min(workers, count / MIN_CHUNK_SIZE));
+    size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    // Histograms, then write offsets, for each chunk.
+    std::vector<Histogram> histograms(chunkCount);
+
+    auto forEachChunk = [&](const std::function<void(size_t, size_t, size_t)> &function) {
+        auto run = [&](size_t chunk) {
+            size_t begin = chunk * chunkSize;
+            function(chunk, begin, std::min(begin + chunkSize, count));
+        };
+
+        if (chunkCount == 1)
+        {
+            run(0);
+            return;
+        }
+
+        pool->parallelFor(chunkCount, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++)
+            {
+                run(chunk);
+            }
+        });
+    };
+
+    SortItem *source = items.data();
+    SortItem *destination = scratch.data();
+
+    for (uint32_t pass = 0; pass < PASSES; pass++)
+    {
+        const uint32_t shift = pass * RADIX_BITS;
+
+        forEachChunk([&](size_t chunk, size_t begin, size_t end) {
+            Histogram &histogram = histograms[chunk];
+            histogram.fill(0);
+            for (size_t i = begin; i < end; i++)
+            {
+                histogram[(source[i].key >> shift) & (BUCKETS - 1)]++;
+            }
+        });
+
+        // Digit major, chunk minor, keeps the sort stable.
+        uint32_t offset = 0;
+        bool skip = false;
+        for (uint32_t bucket = 0; bucket < BUCKETS; bucket++)
+        {
+            uint32_t bucketTotal = 0;
+            for (size_t chunk = 0; chunk < chunkCount; chunk++)
+            {
+                uint32_t chunkCountInBucket = histograms[chunk][bucket];
+                histograms[chunk][bucket] = offset + bucketTotal;
+                bucketTotal += chunkCountInBucket;
+            }
+
+            if (bucketTotal == count)
+            {
+                skip = true;
+                break;
+            }
+            offset += bucketTotal;
+        }
+
+        if (skip)
+        {
+            continue;
+        }
+
+        forEachChunk([&](size_t chunk, size_t begin, size_t end) {
+            Histogram &offsets = histograms[chunk];
+            for (size_t i = begin; i < end; i++)
+            {
+                destination[offsets[(source[i].key >> shift) & (BUCKETS - 1)]++] = source[i];
+            }
+        });
+
+        std::swap(source, destination);
+    }
+
+    if (source != items.data())
+    {
+        items.swap(scratch);
+    }
+}
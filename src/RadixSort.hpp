@@ -0,0 +1,24 @@
+#ifndef RadixSort_hpp
+#define RadixSort_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+struct SortItem
+{
+    uint64_t key;
+    uint32_t index;
+};
+
+class RadixSort
+{
+public:
+    // Stable LSD sort on the keys, 8 bits per pass. Passes where every key
+    // has the same digit are skipped, so unused high bits cost a histogram.
+    // Large inputs are split across `pool` when one is given.
+    static void sort(std::vector<SortItem> &items, std::vector<SortItem> &scratch, ThreadPool *pool = nullptr);
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef Ray_hpp
+#define Ray_hpp
+
+#include <algorithm>
+#include <cmath>
+
+#include "common.hpp"
+
+// Half line from an origin along a unit direction. The inverse direction
+// is kept for the slab test, infinite along axes the ray is parallel to.
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverseDirection;
+
+    Ray() : origin(0.0f), direction(0.0f, 0.0f, 1.0f), inverseDirection(INFINITY, INFINITY, 1.0f) {}
+
+    Ray(const glm::vec3 &origin, const glm::vec3 &direction)
+        : origin(origin), direction(glm::normalize(direction))
+    {
+        inverseDirection = glm::vec3(1.0f / this->direction.x, 1.0f / this->direction.y, 1.0f / this->direction.z);
+    }
+
+    // Distance where the ray enters the box, 0 from inside.
+    bool intersectsBox(const glm::vec3 &min, const glm::vec3 &max, float maxDistance, float &distance) const
+    {
+        float enter = 0.0f;
+        float exit = maxDistance;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float near = (min[axis] - origin[axis]) * inverseDirection[axis];
+            float far = (max[axis] - origin[axis]) * inverseDirection[axis];
+            if (near > far)
+            {
+                std::swap(near, far);
+            }
+            enter = std::max(enter, near);
+            exit = std::min(exit, far);
+        }
+
+        distance = enter;
+        return enter <= exit;
+    }
+
+    // Distance of the first hit, 0 from inside.
+    bool intersectsSphere(const glm::vec3 &center, float radius, float maxDistance, float &distance) const
+    {
+        glm::vec3 offset = center - origin;
+        float along = glm::dot(offset, direction);
+        float squaredRadius = radius * radius;
+        float squaredCenter = glm::dot(offset, offset);
+        if (squaredCenter <= squaredRadius)
+        {
+            distance = 0.0f;
+            return true;
+        }
+
+        // Behind the origin, or passes beside the sphere.
+        float squaredMiss = squaredCenter - along * along;
+        if (along < 0.0f || squaredMiss > squaredRadius)
+        {
+            return false;
+        }
+
+        distance = along - std::sqrt(squaredRadius - squaredMiss);
+        return distance <= maxDistance;
+    }
+};
+
+#endif
@@ -0,0 +1,720 @@
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+
+#include "RenderGraph.hpp"
+#include "GpuProfiler.hpp"
+#include "VulkanUtilities.hpp"
+
+namespace
+{
+const VkAccessFlags WRITE_ACCESS =
+    VK_ACCESS_SHADER_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT |
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+const VkPipelineStageFlags DEPTH_TESTS =
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+struct UsageInfo
+{
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    // Ignored for buffers.
+    VkImageLayout layout;
+};
+
+UsageInfo usageInfo(ResourceUsage usage, VkImageAspectFlags aspect)
+{
+    VkImageLayout readLayout = (aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0
+                                   ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                   : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    switch (usage)
+    {
+    case ResourceUsage::TransferWrite:
+        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+    case ResourceUsage::ComputeRead:
+        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL};
+    case ResourceUsage::ComputeWrite:
+        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL};
+    case ResourceUsage::ComputeSampled:
+        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, readLayout};
+    case ResourceUsage::IndirectRead:
+        return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED};
+    case ResourceUsage::VertexInput:
+        return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED};
+    case ResourceUsage::VertexRead:
+        return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, readLayout};
+    case ResourceUsage::FragmentRead:
+        return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, readLayout};
+    case ResourceUsage::ColorAttachment:
+        return {
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    case ResourceUsage::DepthAttachment:
+        return {
+            DEPTH_TESTS,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    }
+
+    throw std::runtime_error("Unable to find the resource usage.");
+}
+
+bool isWriteUsage(ResourceUsage usage)
+{
+    return usage == ResourceUsage::TransferWrite ||
+           usage == ResourceUsage::ComputeWrite ||
+           usage == ResourceUsage::ColorAttachment ||
+           usage == ResourceUsage::DepthAttachment;
+}
+
+std::string stageNames(VkPipelineStageFlags stages)
+{
+    static const std::pair<VkPipelineStageFlags, const char *> names[] = {
+        {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, "top"},
+        {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, "indirect"},
+        {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, "vertex"},
+        {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, "early tests"},
+        {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, "fragment"},
+        {VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, "late tests"},
+        {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, "color"},
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, "compute"},
+        {VK_PIPELINE_STAGE_TRANSFER_BIT, "transfer"},
+    };
+
+    std::string result;
+    for (auto &name : names)
+    {
+        if ((stages & name.first) != 0)
+        {
+            result += result.empty() ? name.second : std::string("|") + name.second;
+        }
+    }
+    return result;
+}
+}
+
+void RenderGraph::init(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+    _device = device;
+    _physicalDevice = physicalDevice;
+}
+
+void RenderGraph::clean()
+{
+    for (auto &memory : _transients)
+    {
+        _destroyTransients(memory);
+    }
+    _transients.clear();
+    _states.clear();
+    reset(0);
+}
+
+void RenderGraph::reset(uint32_t slot)
+{
+    _passes.clear();
+    _resources.clear();
+
+    _slot = slot;
+    if (_transients.size() <= slot)
+    {
+        _transients.resize(slot + 1);
+    }
+}
+
+void RenderGraph::invalidate()
+{
+    _states.clear();
+}
+
+uint64_t RenderGraph::_handleKey(const Resource &resource)
+{
+    // Non-dispatchable handles are pointers or integers depending on the platform.
+    return resource.isImage ? (uint64_t)resource.image : (uint64_t)resource.buffer;
+}
+
+RenderResource RenderGraph::importBuffer(const std::string &name, VkBuffer buffer)
+{
+    Resource resource;
+    resource.name = name;
+    resource.buffer = buffer;
+
+    auto found = _states.find(_handleKey(resource));
+    if (found != _states.end())
+    {
+        resource.state = found->second;
+    }
+
+    _resources.push_back(resource);
+    return static_cast<RenderResource>(_resources.size() - 1);
+}
+
+RenderResource RenderGraph::importImage(const std::string &name, VkImage image, VkImageAspectFlags aspect, VkImageLayout layout)
+{
+    Resource resource;
+    resource.name = name;
+    resource.isImage = true;
+    resource.image = image;
+    resource.aspect = aspect;
+    resource.state.layout = layout;
+
+    auto found = _states.find(_handleKey(resource));
+    if (found != _states.end())
+    {
+        resource.state = found->second;
+    }
+
+    _resources.push_back(resource);
+    return static_cast<RenderResource>(_resources.size() - 1);
+}
+
+RenderResource RenderGraph::createImage(const std::string &name, const TransientImageInfo &info)
+{
+    Resource resource;
+    resource.name = name;
+    resource.isImage = true;
+    resource.aspect = info.aspect;
+    resource.transient = true;
+    resource.info = info;
+
+    _resources.push_back(resource);
+    return static_cast<RenderResource>(_resources.size() - 1);
+}
+
+void RenderGraph::markOutput(RenderResource resource)
+{
+    _resources[resource].output = true;
+}
+
+RenderPassId RenderGraph::addPass(const std::string &name, Record record)
+{
+    Pass pass;
+    pass.name = name;
+    pass.record = record;
+
+    _passes.push_back(pass);
+    return static_cast<RenderPassId>(_passes.size() - 1);
+}
+
+void RenderGraph::read(RenderPassId pass, RenderResource resource, ResourceUsage usage)
+{
+    if (isWriteUsage(usage))
+    {
+        throw std::runtime_error("Unable to read a resource with a write usage.");
+    }
+
+    _passes[pass].accesses.push_back({resource, usage, false, false, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED});
+}
+
+void RenderGraph::write(RenderPassId pass, RenderResource resource, ResourceUsage usage)
+{
+    if (!isWriteUsage(usage))
+    {
+        throw std::runtime_error("Unable to write a resource with a read usage.");
+    }
+
+    _passes[pass].accesses.push_back({resource, usage, true, false, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED});
+}
+
+void RenderGraph::attachment(
+    RenderPassId pass,
+    RenderResource resource,
+    ResourceUsage usage,
+    VkImageLayout initialLayout,
+    VkImageLayout finalLayout)
+{
+    if (usage != ResourceUsage::ColorAttachment && usage != ResourceUsage::DepthAttachment)
+    {
+        throw std::runtime_error("Unable to use a resource as an attachment without an attachment usage.");
+    }
+
+    _passes[pass].accesses.push_back({resource, usage, true, true, initialLayout, finalLayout});
+}
+
+void RenderGraph::compile()
+{
+    _stats = RenderGraphStats();
+    _stats.passes = static_cast<uint32_t>(_passes.size());
+
+    _cull();
+    _allocateTransients();
+    _deriveBarriers();
+    _storeStates();
+}
+
+void RenderGraph::_cull()
+{
+    std::vector<bool> needed(_resources.size());
+    for (size_t i = 0; i < _resources.size(); i++)
+    {
+        needed[i] = _resources[i].output;
+    }
+
+    // From the last pass: a pass runs when it writes something needed
+    // later, then what it reads is needed before it.
+    for (size_t i = _passes.size(); i-- > 0;)
+    {
+        Pass &pass = _passes[i];
+        pass.culled = true;
+        for (auto &access : pass.accesses)
+        {
+            if (access.write && needed[access.resource])
+            {
+                pass.culled = false;
+            }
+        }
+
+        if (pass.culled)
+        {
+            _stats.culled++;
+            continue;
+        }
+
+        // Fills and discarded attachments don't depend on earlier writes,
+        // every other write is a read too.
+        for (auto &access : pass.accesses)
+        {
+            bool overwrites = access.attachment ? access.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED
+                                                : access.usage == ResourceUsage::TransferWrite;
+            if (overwrites)
+            {
+                needed[access.resource] = false;
+            }
+        }
+        for (auto &access : pass.accesses)
+        {
+            bool overwrites = access.attachment ? access.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED
+                                                : access.usage == ResourceUsage::TransferWrite;
+            if (!overwrites)
+            {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::_allocateTransients()
+{
+    std::vector<RenderResource> transients;
+    std::vector<uint64_t> key;
+    for (uint32_t i = 0; i < _passes.size(); i++)
+    {
+        if (_passes[i].culled)
+        {
+            continue;
+        }
+
+        for (auto &access : _passes[i].accesses)
+        {
+            Resource &resource = _resources[access.resource];
+            if (resource.transient)
+            {
+                resource.firstPass = resource.firstPass == NONE ? i : resource.firstPass;
+                resource.lastPass = i;
+            }
+        }
+    }
+
+    // Images only used by culled passes are never created.
+    for (RenderResource i = 0; i < _resources.size(); i++)
+    {
+        const Resource &resource = _resources[i];
+        if (resource.transient && resource.firstPass != NONE)
+        {
+            transients.push_back(i);
+            key.insert(key.end(), {
+                static_cast<uint64_t>(resource.info.format),
+                resource.info.extent.width,
+                resource.info.extent.height,
+                resource.info.usage,
+                resource.info.aspect,
+                resource.firstPass,
+                resource.lastPass});
+        }
+    }
+    _stats.transientImages = static_cast<uint32_t>(transients.size());
+
+    TransientMemory &memory = _transients[_slot];
+    if (key != memory.key)
+    {
+        _destroyTransients(memory);
+        memory.key = key;
+
+        if (_device == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        std::vector<AliasRequest> requests;
+        for (RenderResource index : transients)
+        {
+            const Resource &resource = _resources[index];
+
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent = {resource.info.extent.width, resource.info.extent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = resource.info.format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = resource.info.usage;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            Allocation allocation = {};
+            if (vkCreateImage(_device, &imageInfo, nullptr, &allocation.image) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Unable to create a transient image.");
+            }
+
+            VkMemoryRequirements memoryRequirements;
+            vkGetImageMemoryRequirements(_device, allocation.image, &memoryRequirements);
+            allocation.size = memoryRequirements.size;
+            memory.allocations.push_back(allocation);
+
+            requests.push_back({memoryRequirements.size, memoryRequirements.memoryTypeBits, resource.firstPass, resource.lastPass});
+        }
+
+        std::vector<AliasBlock> plan = planAliases(requests);
+        for (uint32_t b = 0; b < plan.size(); b++)
+        {
+            VkMemoryAllocateInfo allocationInfo = {};
+            allocationInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocationInfo.allocationSize = plan[b].size;
+            allocationInfo.memoryTypeIndex = VulkanUtilities::findMemoryType(
+                _physicalDevice,
+                plan[b].memoryTypeBits,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+            Block block = {VK_NULL_HANDLE, plan[b].size};
+            if (vkAllocateMemory(_device, &allocationInfo, nullptr, &block.memory) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Unable to allocate transient image memory.");
+            }
+            memory.blocks.push_back(block);
+
+            for (uint32_t request : plan[b].requests)
+            {
+                Allocation &allocation = memory.allocations[request];
+                allocation.block = b;
+                vkBindImageMemory(_device, allocation.image, block.memory, 0);
+
+                const Resource &resource = _resources[transients[request]];
+                allocation.view = VulkanUtilities::createImageView(allocation.image, resource.info.format, resource.info.aspect, _device);
+            }
+        }
+    }
+
+    if (memory.allocations.empty())
+    {
+        return;
+    }
+
+    const std::vector<Allocation> &allocations = memory.allocations;
+    for (uint32_t i = 0; i < transients.size(); i++)
+    {
+        Resource &resource = _resources[transients[i]];
+        resource.allocation = i;
+        resource.image = allocations[i].image;
+        _stats.transientBytes += allocations[i].size;
+
+        // The image that last used the same memory, if any.
+        uint32_t latest = 0;
+        for (uint32_t j = 0; j < transients.size(); j++)
+        {
+            const Resource &other = _resources[transients[j]];
+            if (j != i && allocations[j].block == allocations[i].block &&
+                other.lastPass < resource.firstPass && other.lastPass + 1 > latest)
+            {
+                latest = other.lastPass + 1;
+                resource.aliased = transients[j];
+            }
+        }
+    }
+
+    _stats.memoryBlocks = static_cast<uint32_t>(memory.blocks.size());
+    for (auto &block : memory.blocks)
+    {
+        _stats.allocatedBytes += block.size;
+    }
+}
+
+void RenderGraph::_destroyTransients(TransientMemory &memory)
+{
+    if (memory.allocations.empty())
+    {
+        memory.key.clear();
+        return;
+    }
+
+    // Earlier frames of the slot may still use them.
+    vkDeviceWaitIdle(_device);
+
+    for (auto &allocation : memory.allocations)
+    {
+        vkDestroyImageView(_device, allocation.view, nullptr);
+        vkDestroyImage(_device, allocation.image, nullptr);
+    }
+    for (auto &block : memory.blocks)
+    {
+        vkFreeMemory(_device, block.memory, nullptr);
+    }
+
+    memory.allocations.clear();
+    memory.blocks.clear();
+    memory.key.clear();
+}
+
+std::vector<AliasBlock> RenderGraph::planAliases(const std::vector<AliasRequest> &requests)
+{
+    std::vector<uint32_t> order(requests.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&requests](uint32_t a, uint32_t b) {
+        return requests[a].size > requests[b].size;
+    });
+
+    std::vector<AliasBlock> blocks;
+    for (uint32_t index : order)
+    {
+        const AliasRequest &request = requests[index];
+
+        bool placed = false;
+        for (auto &block : blocks)
+        {
+            if ((block.memoryTypeBits & request.memoryTypeBits) == 0)
+            {
+                continue;
+            }
+
+            bool overlaps = std::any_of(block.requests.begin(), block.requests.end(), [&](uint32_t other) {
+                return requests[other].firstPass <= request.lastPass && request.firstPass <= requests[other].lastPass;
+            });
+            if (overlaps)
+            {
+                continue;
+            }
+
+            block.size = std::max(block.size, request.size);
+            block.memoryTypeBits &= request.memoryTypeBits;
+            block.requests.push_back(index);
+            placed = true;
+            break;
+        }
+
+        if (!placed)
+        {
+            blocks.push_back({request.size, request.memoryTypeBits, {index}});
+        }
+    }
+
+    return blocks;
+}
+
+void RenderGraph::_deriveBarriers()
+{
+    for (uint32_t i = 0; i < _passes.size(); i++)
+    {
+        Pass &pass = _passes[i];
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        // Aliased images start after everything done to their predecessor.
+        for (auto &resource : _resources)
+        {
+            if (resource.transient && resource.firstPass == i && resource.aliased != NONE)
+            {
+                const State &previous = _resources[resource.aliased].state;
+                resource.state.writeStages = previous.writeStages | previous.readStages;
+                resource.state.writeAccess = previous.writeAccess;
+            }
+        }
+
+        for (auto &access : pass.accesses)
+        {
+            _addAccess(pass, access);
+        }
+
+        if (pass.dstStages != 0)
+        {
+            _stats.barriers++;
+            _stats.transitions += static_cast<uint32_t>(pass.imageBarriers.size());
+        }
+    }
+}
+
+void RenderGraph::_addAccess(Pass &pass, const Access &access)
+{
+    Resource &resource = _resources[access.resource];
+    State &state = resource.state;
+    UsageInfo info = usageInfo(access.usage, resource.aspect);
+
+    // Layout when the pass begins, and once it is done.
+    VkImageLayout layout = info.layout;
+    VkImageLayout finalLayout = info.layout;
+    if (access.attachment)
+    {
+        layout = access.initialLayout;
+        finalLayout = access.finalLayout;
+    }
+
+    bool discard = access.attachment && layout == VK_IMAGE_LAYOUT_UNDEFINED;
+    bool transition = resource.isImage && !discard && layout != state.layout;
+
+    if (access.write || transition)
+    {
+        // Waits for every earlier access, and makes the last write available.
+        VkPipelineStageFlags previous = state.writeStages | state.readStages;
+        if (previous != 0 || transition)
+        {
+            pass.srcStages |= previous != 0 ? previous : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            pass.dstStages |= info.stages;
+
+            if (transition)
+            {
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.oldLayout = state.layout;
+                barrier.newLayout = layout;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = resource.image;
+                barrier.subresourceRange = {resource.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+                barrier.srcAccessMask = state.writeAccess;
+                barrier.dstAccessMask = info.access;
+                pass.imageBarriers.push_back(barrier);
+            }
+            else
+            {
+                pass.srcAccess |= state.writeAccess;
+                pass.dstAccess |= info.access;
+            }
+        }
+
+        if (access.write)
+        {
+            state.writeStages = info.stages;
+            state.writeAccess = info.access & WRITE_ACCESS;
+            state.readStages = 0;
+            state.visibleStages = 0;
+            state.visibleAccess = 0;
+        }
+        else
+        {
+            // Only transitioned, other readers still wait for the transition.
+            state.writeStages = info.stages;
+            state.writeAccess = 0;
+            state.readStages = info.stages;
+            state.visibleStages = info.stages;
+            state.visibleAccess = info.access;
+        }
+    }
+    else
+    {
+        // Reads after reads only wait when the write isn't visible to them yet.
+        bool visible = (state.visibleStages & info.stages) == info.stages &&
+                       (state.visibleAccess & info.access) == info.access;
+        if (state.writeStages != 0 && !visible)
+        {
+            pass.srcStages |= state.writeStages;
+            pass.dstStages |= info.stages;
+            pass.srcAccess |= state.writeAccess;
+            pass.dstAccess |= info.access;
+            state.visibleStages |= info.stages;
+            state.visibleAccess |= info.access;
+        }
+        state.readStages |= info.stages;
+    }
+
+    if (resource.isImage)
+    {
+        state.layout = finalLayout;
+    }
+}
+
+void RenderGraph::_storeStates()
+{
+    for (auto &resource : _resources)
+    {
+        if (!resource.transient)
+        {
+            _states[_handleKey(resource)] = resource.state;
+        }
+    }
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    for (auto &pass : _passes)
+    {
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        if (pass.dstStages != 0)
+        {
+            VkMemoryBarrier memoryBarrier = {};
+            memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            memoryBarrier.srcAccessMask = pass.srcAccess;
+            memoryBarrier.dstAccessMask = pass.dstAccess;
+
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                pass.srcStages,
+                pass.dstStages,
+                0,
+                pass.srcAccess != 0 ? 1 : 0,
+                &memoryBarrier,
+                0,
+                nullptr,
+                static_cast<uint32_t>(pass.imageBarriers.size()),
+                pass.imageBarriers.data());
+        }
+
+        GpuScope scope(_profiler, commandBuffer, pass.name);
+        pass.record(commandBuffer);
+    }
+}
+
+VkImage RenderGraph::image(RenderResource resource) const
+{
+    return _resources[resource].image;
+}
+
+VkImageView RenderGraph::imageView(RenderResource resource) const
+{
+    const Resource &found = _resources[resource];
+    return found.allocation != NONE ? _transients[_slot].allocations[found.allocation].view : VK_NULL_HANDLE;
+}
+
+std::string RenderGraph::describe() const
+{
+    std::ostringstream out;
+    for (auto &pass : _passes)
+    {
+        out << pass.name;
+        if (pass.culled)
+        {
+            out << ": culled";
+        }
+        else if (pass.dstStages != 0)
+        {
+            out << ": " << stageNames(pass.srcStages) << " -> " << stageNames(pass.dstStages);
+            if (!pass.imageBarriers.empty())
+            {
+                out << ", " << pass.imageBarriers.size() << " transitions";
+            }
+        }
+        out << std::endl;
+    }
+    return out.str();
+}
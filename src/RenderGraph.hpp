@@ -0,0 +1,248 @@
+#ifndef RenderGraph_hpp
+#define RenderGraph_hpp
+
+#include <functional>
+#include <unordered_map>
+
+#include "common.hpp"
+
+class GpuProfiler;
+
+typedef uint32_t RenderResource;
+typedef uint32_t RenderPassId;
+
+// How a pass touches a resource. Each one has fixed stages, access and
+// image layout, the barriers are derived from those.
+enum class ResourceUsage : uint32_t
+{
+    TransferWrite,
+    // Storage buffers, and storage images in GENERAL layout.
+    ComputeRead,
+    ComputeWrite,
+    // Sampled image, in the read only depth layout for depth.
+    ComputeSampled,
+    IndirectRead,
+    // Vertex and index buffers, fetched by the input assembler.
+    VertexInput,
+    VertexRead,
+    FragmentRead,
+    ColorAttachment,
+    DepthAttachment,
+};
+
+// Image owned by the graph, only alive between its first and last pass.
+// Images whose lifetimes don't overlap share memory.
+struct TransientImageInfo
+{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = {};
+    VkImageUsageFlags usage = 0;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+// Image to place in memory, lifetime in pass order.
+struct AliasRequest
+{
+    VkDeviceSize size;
+    uint32_t memoryTypeBits;
+    uint32_t firstPass;
+    uint32_t lastPass;
+};
+
+// Memory shared by requests with disjoint lifetimes, all bound at offset 0.
+struct AliasBlock
+{
+    VkDeviceSize size;
+    uint32_t memoryTypeBits;
+    std::vector<uint32_t> requests;
+};
+
+// Counts of the last compile.
+struct RenderGraphStats
+{
+    uint32_t passes = 0;
+    uint32_t culled = 0;
+    // vkCmdPipelineBarrier calls, and image layout transitions in them.
+    uint32_t barriers = 0;
+    uint32_t transitions = 0;
+    uint32_t transientImages = 0;
+    uint32_t memoryBlocks = 0;
+    // Sum of the transient image sizes, against what was allocated.
+    VkDeviceSize transientBytes = 0;
+    VkDeviceSize allocatedBytes = 0;
+};
+
+// Frame built from passes that declare what they read and write. Compiling
+// culls the passes nothing needs, derives the barriers and layout
+// transitions between the rest, and places the transient images in memory.
+// Rebuilt every frame: reset, import, add passes, compile, execute.
+class RenderGraph
+{
+public:
+    typedef std::function<void(VkCommandBuffer)> Record;
+
+    RenderGraph(){};
+    ~RenderGraph(){};
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice);
+    void clean();
+
+    // Drops the passes and resources. Transient memory belongs to `slot`, the
+    // swapchain image being recorded, so frames in flight never share it.
+    // It is kept for the next frame of the slot with the same images.
+    void reset(uint32_t slot);
+    // Forgets the state of imported resources, after they were recreated.
+    void invalidate();
+
+    // Imported resources keep their state from one frame to the next, `layout`
+    // is only used the first time an image is seen.
+    RenderResource importBuffer(const std::string &name, VkBuffer buffer);
+    RenderResource importImage(const std::string &name, VkImage image, VkImageAspectFlags aspect, VkImageLayout layout);
+    RenderResource createImage(const std::string &name, const TransientImageInfo &info);
+    // Needed at the end of the frame. The last pass writing it is never
+    // culled, nor are earlier writers it depends on: a pass that discards or
+    // fills it stops the dependency.
+    void markOutput(RenderResource resource);
+
+    RenderPassId addPass(const std::string &name, Record record);
+    void read(RenderPassId pass, RenderResource resource, ResourceUsage usage);
+    void write(RenderPassId pass, RenderResource resource, ResourceUsage usage);
+    // Image transitioned by the render pass the pass records. It must be in
+    // `initialLayout` when the pass begins, UNDEFINED discards the contents.
+    void attachment(
+        RenderPassId pass,
+        RenderResource resource,
+        ResourceUsage usage,
+        VkImageLayout initialLayout,
+        VkImageLayout finalLayout);
+
+    void compile();
+    // Records the barriers and the passes that were not culled.
+    void execute(VkCommandBuffer commandBuffer);
+
+    // Each pass then runs in a scope of its name, null turns it off.
+    void setProfiler(GpuProfiler *profiler) { _profiler = profiler; }
+
+    // Valid after compile.
+    VkImage image(RenderResource resource) const;
+    VkImageView imageView(RenderResource resource) const;
+    bool isCulled(RenderPassId pass) const { return _passes[pass].culled; }
+    const RenderGraphStats &stats() const { return _stats; }
+    // One line per pass with its barrier, for debugging.
+    std::string describe() const;
+
+    // Greedy placement, largest first, into the first block whose requests
+    // all live in other passes.
+    static std::vector<AliasBlock> planAliases(const std::vector<AliasRequest> &requests);
+
+private:
+    static const uint32_t NONE = ~0u;
+
+    struct Access
+    {
+        RenderResource resource;
+        ResourceUsage usage;
+        bool write;
+        // Render pass attachments only.
+        bool attachment;
+        VkImageLayout initialLayout;
+        VkImageLayout finalLayout;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        Record record;
+        std::vector<Access> accesses;
+        bool culled = false;
+
+        // Derived, recorded before the pass.
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        VkAccessFlags srcAccess = 0;
+        VkAccessFlags dstAccess = 0;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+    };
+
+    // Where a resource was last written and read, as barriers need it.
+    struct State
+    {
+        // Last write, and the readers since then.
+        VkPipelineStageFlags writeStages = 0;
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags readStages = 0;
+        // Stages and access the last write was already made visible to.
+        VkPipelineStageFlags visibleStages = 0;
+        VkAccessFlags visibleAccess = 0;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    struct Resource
+    {
+        std::string name;
+        bool isImage = false;
+        bool output = false;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageAspectFlags aspect = 0;
+        State state;
+
+        // Transient images.
+        bool transient = false;
+        TransientImageInfo info;
+        uint32_t firstPass = NONE;
+        uint32_t lastPass = NONE;
+        uint32_t allocation = NONE;
+        // Previous image in the same memory, waited on before the first use.
+        RenderResource aliased = NONE;
+    };
+
+    // Transient image with its view, bound into one of the slot's blocks.
+    struct Allocation
+    {
+        VkImage image;
+        VkImageView view;
+        VkDeviceSize size;
+        uint32_t block;
+    };
+
+    struct Block
+    {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+    };
+
+    // Transient memory of one slot, kept while the images and their
+    // lifetimes are the same.
+    struct TransientMemory
+    {
+        std::vector<uint64_t> key;
+        std::vector<Allocation> allocations;
+        std::vector<Block> blocks;
+    };
+
+    void _cull();
+    void _allocateTransients();
+    void _destroyTransients(TransientMemory &memory);
+    void _deriveBarriers();
+    void _addAccess(Pass &pass, const Access &access);
+    void _storeStates();
+
+    static uint64_t _handleKey(const Resource &resource);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
+    GpuProfiler *_profiler = nullptr;
+
+    std::vector<Pass> _passes;
+    std::vector<Resource> _resources;
+    RenderGraphStats _stats;
+
+    // Imported resource states at the end of the previous frames, by handle.
+    std::unordered_map<uint64_t, State> _states;
+
+    uint32_t _slot = 0;
+    std::vector<TransientMemory> _transients;
+};
+
+#endif
@@ -1,55 +1,180 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
 #include "Renderer.hpp"
-#include "Pipeline.hpp"
+#include "ApiCounters.hpp"
+#include "Input.hpp"
+#include "SceneFile.hpp"
+#include "CpuProfiler.hpp"
 
 // Resources paths.
 const std::string CUBE_MODEL_PATH = "./resources/models/cube.obj";
-const std::string PLANE_MODEL_PATH = "./resources/models/plane.obj";
-const std::string TEXTURE_PATH = "./resources/textures/grid.png";
 const std::string VERT_SHADER_PATH = "./resources/shaders/vert.spv";
 const std::string FRAG_SHADER_PATH = "./resources/shaders/frag.spv";
+const std::string DEPTH_VERT_SHADER_PATH = "./resources/shaders/depth_vert.spv";
+const std::string GBUFFER_FRAG_SHADER_PATH = "./resources/shaders/gbuffer_frag.spv";
+const std::string FULLSCREEN_VERT_SHADER_PATH = "./resources/shaders/fullscreen_vert.spv";
+const std::string DEFERRED_FRAG_SHADER_PATH = "./resources/shaders/deferred_frag.spv";
+const std::string PIPELINE_CACHE_PATH = "./pipeline_cache.bin";
 
-void Renderer::init(Swapchain &swapchain, const int width, const int height)
+// --gpu-driven          cull on the GPU and draw with indirect commands
+// --occlusion           two phase Hi-Z culling, with --gpu-driven
+// --software-occlusion  rasterize the occluders on the CPU
+// --depth-prepass       depth only pass before shading
+// --instances <count>   add a grid of cubes, with --gpu-driven
+// --lights <count>      add random point and spot lights
+// --deferred            shade from a G-buffer, without --gpu-driven
+// --dynamic-resolution  scale the rendering to fit the frame budget
+// --frame-budget <ms>   GPU time per frame, with --dynamic-resolution
+// --scene <path>        scene file to render, text or compiled
+// --stream <size>       stream the scene by cells of this size, without --gpu-driven
+// --stream-budget <MB>  streamed mesh memory, with --stream
+// --counters <output>   per frame workload counters, console, overlay or a CSV path
+bool RendererSettings::parseArgument(int argc, char **argv, int &i)
+{
+    std::string argument = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (argument == "--gpu-driven")
+    {
+        gpuDriven = true;
+    }
+    else if (argument == "--occlusion")
+    {
+        occlusionCulling = true;
+    }
+    else if (argument == "--software-occlusion")
+    {
+        softwareOcclusion = true;
+    }
+    else if (argument == "--depth-prepass")
+    {
+        depthPrePass = true;
+    }
+    else if (argument == "--deferred")
+    {
+        deferred = true;
+    }
+    else if (argument == "--dynamic-resolution")
+    {
+        dynamicResolution = true;
+    }
+    else if (argument == "--frame-budget" && hasValue)
+    {
+        frameBudget = std::stof(argv[++i]);
+    }
+    else if (argument == "--instances" && hasValue)
+    {
+        stressInstances = static_cast<uint32_t>(std::stoul(argv[++i]));
+    }
+    else if (argument == "--lights" && hasValue)
+    {
+        lightCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+    }
+    else if (argument == "--scene" && hasValue)
+    {
+        scenePath = argv[++i];
+    }
+    else if (argument == "--stream" && hasValue)
+    {
+        streamCellSize = std::stof(argv[++i]);
+    }
+    else if (argument == "--stream-budget" && hasValue)
+    {
+        streamBudget = static_cast<uint32_t>(std::stoul(argv[++i]));
+    }
+    else if (argument == "--counters" && hasValue)
+    {
+        counters = argv[++i];
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void Renderer::init(
+    Swapchain &swapchain,
+    const int width,
+    const int height,
+    const RendererSettings &settings)
 {
     // TODO: These can be constant
     auto &physicalDevice = swapchain.physicalDevice;
-    auto &commandPool = swapchain.commandPool;
     auto &renderPass = swapchain.renderPass;
-    auto &graphicsQueue = swapchain.graphicsQueue;
     uint32_t imageCount = swapchain.imageCount;
     _device = swapchain.device;
+    _physicalDevice = swapchain.physicalDevice;
 
-    std::string planeName = std::string("plane");
-    Object plane(planeName, PLANE_MODEL_PATH);
+    _screenSize = glm::vec2(width, height);
 
-    std::string cubeName = std::string("cube");
-    Object cube(cubeName, CUBE_MODEL_PATH);
+    // Scene assets load on it too.
+    _threadPool.reset(new ThreadPool());
+    _loadScene(swapchain, settings);
 
-    _objects.emplace_back(plane);
-    _objects.emplace_back(cube);
+    VulkanUtilities::createTextureSampler(_textureSampler, _device);
 
-    _objects.back().info.model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.5f, 0.0f));
+    createDescriptorSetLayout();
 
-    _screenSize = glm::vec2(width, height);
+    _pipelineCache.init(physicalDevice, _device, PIPELINE_CACHE_PATH);
+    _pipelines.init(_device, _pipelineCache, *_threadPool);
 
-    VulkanUtilities::createTextureSampler(_textureSampler, _device);
+    _lighting.init(swapchain, _pipelines, settings.lightCount);
+    _addLights(settings.lightCount);
 
-    for (auto &object : _objects)
+    _profiler.init(swapchain);
+    _counting = !settings.counters.empty();
+    if (_counting)
     {
-        object.load(physicalDevice, _device, commandPool, graphicsQueue);
+        _countersToConsole = settings.counters == "console";
+        bool toFile = !_countersToConsole && settings.counters != "overlay";
+        _counters.init(swapchain, toFile ? settings.counters : std::string());
     }
+    _graph.init(_device, _physicalDevice);
+    _graph.setProfiler(&_profiler);
+    _importFrameImages(swapchain);
 
-    Object::createDescriptorSetLayout(_device, _textureSampler);
+    _objectPipelineState.vertexShader = _pipelines.loadShader(VERT_SHADER_PATH);
+    _objectPipelineState.fragmentShader = _pipelines.loadShader(FRAG_SHADER_PATH);
 
-    Pipeline::create(
-        _device,
-        _screenSize[0],
-        _screenSize[1],
-        Object::descriptorSetLayout,
-        _objectPipelineLayout,
-        renderPass,
-        _objectPipeline);
-
-    VkDeviceSize bufferSize = VulkanUtilities::nextOffset(sizeof(VulkanUtilities::CameraInfo)) + sizeof(VulkanUtilities::LightInfo);
+    _objectPipelineState.vertexLayout = VertexLayout::MeshInstanced;
+    _objectPipelineState.layout = _pipelines.getLayout({_descriptorSetLayout});
+    _objectPipelineState.renderPassKey = swapchain.renderPassKey;
+    _objectPipelineState.subpass = SUBPASS_MAIN;
+    // Also passes against the pre-pass depth, so the fallback works in both modes.
+    _objectPipelineState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    // Positions only, no fragment shader.
+    _depthPipelineState.vertexShader = _pipelines.loadShader(DEPTH_VERT_SHADER_PATH);
+    _depthPipelineState.fragmentShader = NO_SHADER;
+    _depthPipelineState.vertexLayout = VertexLayout::PositionInstanced;
+    _depthPipelineState.layout = _pipelines.getLayout({});
+    _depthPipelineState.colorAttachmentCount = 0;
+    _depthPipelineState.renderPassKey = swapchain.renderPassKey;
+    _depthPipelineState.subpass = SUBPASS_DEPTH;
+    _depthPipeline = _pipelines.request(_depthPipelineState, renderPass);
+    _depthPrePass = settings.depthPrePass;
+
+    // Before the object pipelines, which then also get their G-buffer variant.
+    _deferred = settings.deferred && !settings.gpuDriven && swapchain.deferred;
+    if (_deferred)
+    {
+        _initDeferred(swapchain);
+    }
+
+    // Objects whose variant is still compiling are drawn with the default one.
+    _pipelines.setFallback(_requestObjectPipeline(FeaturesDefault, renderPass));
+
+    // Per material, streamed entities only show up later.
+    for (uint32_t i = 0; i < _sceneFile.materialCount(); i++)
+    {
+        _requestObjectPipeline(_sceneFile.material(i).features, renderPass);
+    }
+
+    VkDeviceSize bufferSize = sizeof(VulkanUtilities::LightInfo);
     _uniformBuffers.resize(imageCount);
     _uniformBuffersMemory.resize(imageCount);
 
@@ -66,28 +191,355 @@ void Renderer::init(Swapchain &swapchain, const int width, const int height)
     }
 
     createDescriptorPool(imageCount);
+    createDescriptorSets(imageCount);
+
+    _gpuDriven = settings.gpuDriven && IndirectRenderer::isSupported(swapchain);
+    if (settings.gpuDriven && !_gpuDriven)
+    {
+        std::cerr << "drawIndirectFirstInstance is unsupported, drawing from the CPU." << std::endl;
+    }
+
+    // The GPU-driven path has instance buffers of its own.
+    _instanceBuffers.resize(imageCount, VK_NULL_HANDLE);
+    _instanceBuffersMemory.resize(imageCount, VK_NULL_HANDLE);
+    _instanceData.resize(imageCount, nullptr);
+    if (!_gpuDriven)
+    {
+        // Streamed entities show up later, growing would wait for the GPU.
+        _reserveInstances(_streaming ? _sceneFile.instanceCount() : _scene.size());
+    }
+
+    if (_gpuDriven)
+    {
+        _initIndirect(swapchain, settings);
+    }
+
+    _softwareOcclusion = settings.softwareOcclusion && !_gpuDriven;
+    _occlusion.resize(OCCLUSION_WIDTH, OCCLUSION_WIDTH * static_cast<uint32_t>(height) / static_cast<uint32_t>(width));
+
+    _dynamicResolution = settings.dynamicResolution && swapchain.offscreen;
+    if (_dynamicResolution)
+    {
+        // The depth pyramid is built from the whole depth image.
+        float minScale = MIN_RENDER_SCALE;
+        if (_gpuDriven && _indirect.occlusionCulling())
+        {
+            std::cerr << "Occlusion culling needs the full resolution, the render scale stays at 1." << std::endl;
+            minScale = 1.0f;
+        }
+        if (!_profiler.available())
+        {
+            std::cerr << "No GPU times to scale by, the render scale stays at 1." << std::endl;
+            minScale = 1.0f;
+        }
+        _resolution.init(swapchain, _pipelines, settings.frameBudget, minScale);
+    }
+}
+
+void Renderer::_loadScene(Swapchain &swapchain, const RendererSettings &settings)
+{
+    _sceneFile.load(settings.scenePath);
+
+    if (_sceneFile.materialCount() == 0)
+    {
+        throw std::runtime_error("Unable to use scene " + settings.scenePath + ", it has no material.");
+    }
+    if (_sceneFile.materialCount() > (1u << DrawKey::MATERIAL_BITS))
+    {
+        throw std::runtime_error("Unable to use scene " + settings.scenePath + ", it has too many materials.");
+    }
+
+    _streaming = settings.streamCellSize > 0.0f && !settings.gpuDriven;
+    if (settings.streamCellSize > 0.0f && !_streaming)
+    {
+        std::cerr << "Streaming needs the CPU path, the whole scene stays resident." << std::endl;
+    }
+
+    // Entities with the same path share one mesh in the pool.
+    std::vector<uint32_t> meshes;
+    if (_streaming)
+    {
+        // Room for the budget in vertices and in indices, any mix fits.
+        VkDeviceSize budget = static_cast<VkDeviceSize>(settings.streamBudget) * 1024 * 1024;
+        _meshes.reserveStreamed(
+            static_cast<uint32_t>(budget / (sizeof(Vertex) + sizeof(glm::vec3))),
+            static_cast<uint32_t>(budget / sizeof(uint32_t)));
+    }
+    else
+    {
+        std::vector<std::string> meshPaths;
+        for (uint32_t i = 0; i < _sceneFile.meshCount(); i++)
+        {
+            meshPaths.push_back(_sceneFile.mesh(i));
+        }
+        meshes = _meshes.addAll(meshPaths, _threadPool.get());
+    }
+
+    // The stress grid reuses the cube, nothing can be added after the upload.
+    if (settings.gpuDriven && settings.stressInstances > 0)
+    {
+        _stressMesh = _meshes.add(CUBE_MODEL_PATH);
+    }
+    _meshes.upload(swapchain.physicalDevice, _device, swapchain.commandPool, swapchain.graphicsQueue);
+
+    // Textures are few and small next to the meshes, they stay resident.
+    std::vector<std::string> texturePaths;
+    for (uint32_t i = 0; i < _sceneFile.textureCount(); i++)
+    {
+        texturePaths.push_back(_sceneFile.texture(i));
+    }
+    VulkanUtilities::createTextureImages(
+        texturePaths,
+        _threadPool.get(),
+        _textureImages,
+        _textureImagesMemory,
+        swapchain.graphicsQueue,
+        swapchain.commandPool,
+        _device,
+        swapchain.physicalDevice);
+
+    _textureImageViews.resize(_textureImages.size());
+    for (size_t i = 0; i < _textureImages.size(); i++)
+    {
+        VulkanUtilities::createTextureImageView(_textureImageViews[i], _textureImages[i], _device);
+    }
+
+    for (uint32_t i = 0; i < _sceneFile.materialCount(); i++)
+    {
+        _materialTextures.push_back(_sceneFile.material(i).texture);
+    }
+
+    if (_streaming)
+    {
+        VkDeviceSize budget = static_cast<VkDeviceSize>(settings.streamBudget) * 1024 * 1024;
+        _streamer.init(swapchain, _sceneFile, settings.streamCellSize, budget);
+        return;
+    }
+
+    // Parents come first in the file, their handles are known by their children.
+    std::vector<EntityHandle> entities(_sceneFile.instanceCount());
+    _scene.reserve(_sceneFile.instanceCount());
+    for (uint32_t i = 0; i < _sceneFile.instanceCount(); i++)
+    {
+        uint32_t parent = _sceneFile.instances()[i].parent;
+        entities[i] = _createEntity(
+            i,
+            meshes[_sceneFile.instances()[i].mesh],
+            parent == SceneFile::NO_PARENT ? EntityHandle() : entities[parent]);
+    }
+}
+
+EntityHandle Renderer::_createEntity(uint32_t index, uint32_t mesh, EntityHandle parent)
+{
+    const SceneFileInstance &instance = _sceneFile.instances()[index];
+    EntityHandle entity = _scene.create(_sceneFile.string(instance.name), mesh, parent);
+
+    glm::quat rotation(instance.rotation[3], instance.rotation[0], instance.rotation[1], instance.rotation[2]);
+    _scene.setPosition(entity, glm::vec3(instance.position[0], instance.position[1], instance.position[2]));
+    _scene.setRotation(entity, rotation);
+    _scene.setScale(entity, glm::vec3(instance.scale[0], instance.scale[1], instance.scale[2]));
+    _scene.setMaterial(entity, instance.material);
+    _scene.setFeatures(entity, _sceneFile.material(instance.material).features);
+
+    if (instance.flags & SceneFileOccluder)
+    {
+        _scene.setFlags(entity, EntityOccluder);
+    }
+    if (instance.flags & SceneFileSpin)
+    {
+        _spinners.push_back({entity, rotation});
+    }
+    return entity;
+}
+
+void Renderer::_initIndirect(Swapchain &swapchain, const RendererSettings &settings)
+{
+    // Cubes on a square grid next to the scene.
+    if (settings.stressInstances > 0)
+    {
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(settings.stressInstances))));
+        for (uint32_t i = 0; i < settings.stressInstances; i++)
+        {
+            EntityHandle entity = _scene.create("stress", _stressMesh);
+            _scene.setPosition(entity, glm::vec3(3.0f * (i % side), 0.5f, -3.0f * (1 + i / side)));
+        }
+    }
+
+    // Instances follow the dense order, final once the scene is updated.
+    _scene.updateTransforms(_meshes.ranges(), _threadPool.get());
+    for (size_t i = 0; i < _scene.size(); i++)
+    {
+        _indirect.addInstance(_scene.models()[i], _scene.meshes()[i], _meshes);
+    }
+
+    _indirect.init(swapchain, _pipelines, _meshes, _descriptorSetLayout, settings.occlusionCulling);
+    _resumeRenderPass = swapchain.resumeRenderPass;
+}
+
+void Renderer::_importFrameImages(Swapchain &swapchain)
+{
+    _colorImages = swapchain.getImages();
+    _depthImage = swapchain.getDepthImage();
+    _sceneColorImage = swapchain.getSceneColorImage();
+    _depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (VulkanUtilities::hasStencilComponent(swapchain.depthFormat))
+    {
+        _depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+}
+
+void Renderer::_addLights(uint32_t count)
+{
+    // Same lights on every run.
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_real_distribution<float> ground(-10.0f, 10.0f);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        glm::vec3 color(unit(generator), unit(generator), unit(generator));
+        float range = 0.5f + 1.5f * unit(generator);
+
+        // One in four points down at the ground.
+        if (i % 4 == 3)
+        {
+            glm::vec3 position(ground(generator), 1.0f + unit(generator), ground(generator));
+            _lighting.addSpotLight(position, 2.0f * range, color, glm::vec3(0.0f, -1.0f, 0.0f), 0.3f, 0.5f);
+        }
+        else
+        {
+            glm::vec3 position(ground(generator), 0.2f + 0.5f * unit(generator), ground(generator));
+            _lighting.addPointLight(position, range, color);
+        }
+    }
+}
+
+void Renderer::_initDeferred(Swapchain &swapchain)
+{
+    _deferredRenderPass = swapchain.deferredRenderPass;
+    _deferredRenderPassKey = swapchain.deferredRenderPassKey;
+    _deferredFramebuffers = swapchain.getDeferredFramebuffers();
+    _gbufferShader = _pipelines.loadShader(GBUFFER_FRAG_SHADER_PATH);
+
+    _gbufferSetLayout = VulkanUtilities::createDescriptorSetLayout(
+        _device,
+        {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT},
+        VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    poolSize.descriptorCount = 3;
 
-    // Create descriptor sets (one per object)
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_gbufferPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create descriptor pool.");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _gbufferPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_gbufferSetLayout;
+
+    if (vkAllocateDescriptorSets(_device, &allocInfo, &_gbufferSet) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to allocate descriptor sets.");
+    }
+
+    _updateGBufferSet(swapchain);
+
+    VkPushConstantRange lightingConstants = {};
+    lightingConstants.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    lightingConstants.offset = 0;
+    lightingConstants.size = sizeof(glm::mat4);
+
+    // One full screen triangle, nothing to test against.
+    _lightingPipelineState.vertexShader = _pipelines.loadShader(FULLSCREEN_VERT_SHADER_PATH);
+    _lightingPipelineState.fragmentShader = _pipelines.loadShader(DEFERRED_FRAG_SHADER_PATH);
+    _lightingPipelineState.fragmentSpecialization = Specialization::of(FragmentFeatures::fromFlags(FeaturesDefault));
+    _lightingPipelineState.vertexLayout = VertexLayout::None;
+    _lightingPipelineState.depthTest = VK_FALSE;
+    _lightingPipelineState.depthWrite = VK_FALSE;
+    _lightingPipelineState.layout = _pipelines.getLayout({_descriptorSetLayout, _gbufferSetLayout}, {lightingConstants});
+    _lightingPipelineState.renderPassKey = _deferredRenderPassKey;
+    _lightingPipelineState.subpass = SUBPASS_LIGHTING;
+    _lightingPipeline = _pipelines.request(_lightingPipelineState, _deferredRenderPass);
+}
+
+void Renderer::_updateGBufferSet(Swapchain &swapchain)
+{
+    // Same order as the input attachments of the lighting subpass.
+    std::array<VkDescriptorImageInfo, 3> imageInfos = {};
+    imageInfos[0].imageView = swapchain.getAlbedoImageView();
+    imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[1].imageView = swapchain.getNormalImageView();
+    imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[2].imageView = swapchain.getDepthImageView();
+    imageInfos[2].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
+    for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++)
+    {
+        descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[binding].dstSet = _gbufferSet;
+        descriptorWrites[binding].dstBinding = binding;
+        descriptorWrites[binding].dstArrayElement = 0;
+        descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        descriptorWrites[binding].descriptorCount = 1;
+        descriptorWrites[binding].pImageInfo = &imageInfos[binding];
+    }
+
+    Counted::vkUpdateDescriptorSets(_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+PipelineHandle Renderer::_requestObjectPipeline(uint32_t features, VkRenderPass renderPass)
+{
+    PipelineState state = _objectPipelineState;
+    state.fragmentSpecialization = Specialization::of(FragmentFeatures::fromFlags(features));
+
+    ObjectPipelines &pipelines = _objectPipelines[features];
+    pipelines.shaded = _pipelines.request(state, renderPass);
+
+    if (_deferred)
+    {
+        PipelineState gbufferState = state;
+        gbufferState.fragmentShader = _gbufferShader;
+        gbufferState.colorAttachmentCount = 2;
+        gbufferState.renderPassKey = _deferredRenderPassKey;
+        gbufferState.subpass = SUBPASS_GBUFFER;
+        pipelines.gbuffer = _pipelines.request(gbufferState, _deferredRenderPass);
+    }
 
-    for (auto &object : _objects)
+    // After the pre-pass only the front-most fragment passes, nothing to write.
+    // Alpha tested objects are not in the pre-pass and keep the shaded variant.
+    pipelines.afterPrePass = pipelines.shaded;
+    if ((features & FeatureAlphaTest) == 0)
     {
-        object.generateDescriptorSets(_device, _descriptorPool, _uniformBuffers, _textureSampler, imageCount);
+        state.depthCompareOp = VK_COMPARE_OP_EQUAL;
+        state.depthWrite = VK_FALSE;
+        pipelines.afterPrePass = _pipelines.request(state, renderPass);
     }
+
+    return pipelines.shaded;
 }
 
 void Renderer::createDescriptorPool(uint32_t imageCount)
 {
-    // Two pools for each object. Uniform and sampler
-    const uint32_t objectsCount = static_cast<uint32_t>(_objects.size() * 2) + 1;
-    // Descriptor sets must be allocated from a descriptor pool.
-    // It'll be created every frame
+    // One set per material and swapchain image, objects only differ in push constants.
+    uint32_t setCount = static_cast<uint32_t>(_materialTextures.size()) * imageCount;
     std::array<VkDescriptorPoolSize, 3> poolSizes = {};
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = objectsCount * imageCount;
+    poolSizes[0].descriptorCount = 2 * setCount;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = objectsCount * imageCount;
-    poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[2].descriptorCount = objectsCount * imageCount;
+    poolSizes[1].descriptorCount = setCount;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = 3 * setCount;
 
     VkDescriptorPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -95,7 +547,7 @@ void Renderer::createDescriptorPool(uint32_t imageCount)
     poolInfo.pPoolSizes = poolSizes.data();
 
     // Specify maximum number of descriptor sets that may be allocated.
-    poolInfo.maxSets = objectsCount * imageCount;
+    poolInfo.maxSets = setCount;
 
     if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS)
     {
@@ -103,10 +555,164 @@ void Renderer::createDescriptorPool(uint32_t imageCount)
     }
 }
 
+void Renderer::createDescriptorSetLayout()
+{
+    // Sampler binding
+    VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
+    samplerLayoutBinding.binding = 1;
+    samplerLayoutBinding.descriptorCount = 1;
+    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerLayoutBinding.pImmutableSamplers = nullptr;
+    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding lightBinding = {};
+    lightBinding.binding = 2;
+    lightBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    lightBinding.descriptorCount = 1;
+    lightBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    std::array<VkDescriptorSetLayoutBinding, 6> bindings = {samplerLayoutBinding, lightBinding};
+
+    // Clustered lights: uniforms, lights, cluster ranges and light indices.
+    for (uint32_t binding = 3; binding <= 6; binding++)
+    {
+        VkDescriptorSetLayoutBinding &clusterBinding = bindings[binding - 1];
+        clusterBinding.binding = binding;
+        clusterBinding.descriptorType = binding == 3 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        clusterBinding.descriptorCount = 1;
+        clusterBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    // Bindings must be combined into a VkDescriptorSetLayout object
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create descriptor set layout.");
+    }
+}
+
+void Renderer::createDescriptorSets(uint32_t imageCount)
+{
+    uint32_t setCount = static_cast<uint32_t>(_materialTextures.size()) * imageCount;
+    _descriptorSets.resize(setCount);
+    std::vector<VkDescriptorSetLayout> layouts(setCount, _descriptorSetLayout);
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(_device, &allocInfo, _descriptorSets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to allocate descriptor sets.");
+    }
+
+    for (uint32_t set = 0; set < setCount; set++)
+    {
+        uint32_t material = set / imageCount;
+        uint32_t i = set % imageCount;
+
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = _textureImageViews[_materialTextures[material]];
+        imageInfo.sampler = _textureSampler;
+
+        VkDescriptorBufferInfo lightInfo = {};
+        lightInfo.buffer = _uniformBuffers[i];
+        lightInfo.offset = 0;
+        lightInfo.range = sizeof(VulkanUtilities::LightInfo);
+
+        std::array<VkDescriptorBufferInfo, 4> clusterInfos = {
+            _lighting.uniformInfo(i),
+            _lighting.lightInfo(i),
+            _lighting.clusterInfo(i),
+            _lighting.indexInfo(i)};
+
+        std::array<VkWriteDescriptorSet, 6> descriptorWrites = {};
+
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = _descriptorSets[set];
+        descriptorWrites[0].dstBinding = 1;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pImageInfo = &imageInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = _descriptorSets[set];
+        descriptorWrites[1].dstBinding = 2;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pBufferInfo = &lightInfo;
+
+        for (uint32_t binding = 3; binding <= 6; binding++)
+        {
+            VkWriteDescriptorSet &clusterWrite = descriptorWrites[binding - 1];
+            clusterWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            clusterWrite.dstSet = _descriptorSets[set];
+            clusterWrite.dstBinding = binding;
+            clusterWrite.dstArrayElement = 0;
+            clusterWrite.descriptorType = binding == 3 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            clusterWrite.descriptorCount = 1;
+            clusterWrite.pBufferInfo = &clusterInfos[binding - 3];
+        }
+
+        Counted::vkUpdateDescriptorSets(_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+VkDescriptorSet Renderer::_descriptorSet(uint32_t material, const uint32_t imageIndex) const
+{
+    return _descriptorSets[material * _uniformBuffers.size() + imageIndex];
+}
+
 void Renderer::update(const double deltaTime)
 {
+    CpuScope scope("update");
     _time += deltaTime;
-    _camera.update();
+    _camera.update(deltaTime);
+
+    if (_streaming)
+    {
+        _streamer.update(_camera.getPosition(), deltaTime, _scene, _meshes, [this](uint32_t instance, uint32_t mesh, EntityHandle parent) {
+            return _createEntity(instance, mesh, parent);
+        });
+
+        // Streamed out with their cell.
+        _spinners.erase(
+            std::remove_if(_spinners.begin(), _spinners.end(), [this](const Spinner &spinner) { return !_scene.isAlive(spinner.entity); }),
+            _spinners.end());
+    }
+
+    glm::quat spin = glm::angleAxis(static_cast<float>(_time) * SPIN_SPEED, glm::vec3(0.0f, 1.0f, 0.0f));
+    for (const Spinner &spinner : _spinners)
+    {
+        _scene.setRotation(spinner.entity, spin * spinner.rotation);
+    }
+
+    // Toggled on press, not while held.
+    bool prePassKey = Input::instance().pressed(Input::KeyP);
+    if (prePassKey && !_prePassKeyDown)
+    {
+        _depthPrePass = !_depthPrePass;
+        std::cout << "Depth pre-pass " << (_depthPrePass ? "on." : "off.") << std::endl;
+    }
+    _prePassKeyDown = prePassKey;
+
+    bool pickButton = Input::instance().pressed(Input::MouseLeft);
+    if (pickButton && !_pickButtonDown)
+    {
+        _pick();
+    }
+    _pickButtonDown = pickButton;
+
+    _reportStats(deltaTime);
 }
 
 void Renderer::encode(
@@ -118,11 +724,24 @@ void Renderer::encode(
     const VkSemaphore &endSemaphore,
     const VkFence &submissionFence)
 {
-    VkDeviceSize offsets[] = {0};
+    CpuScope scope("encode");
+    auto encodeStart = std::chrono::high_resolution_clock::now();
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    glm::mat4 viewProjection = _camera.getViewProjectionMatrix();
 
     updateUniforms(imageIndex);
 
+    // Only the entities that moved, and what hangs from them.
+    {
+        CpuScope transforms("transforms");
+        _scene.updateTransforms(_meshes.ranges(), _threadPool.get());
+        _updateBvh();
+        if (!_gpuDriven)
+        {
+            _updateTransforms();
+        }
+    }
+
     VkCommandBufferBeginInfo beginInfo = {};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
@@ -133,27 +752,219 @@ void Renderer::encode(
         throw std::runtime_error("Failed to begin recording command buffer!");
     }
 
-    std::array<VkClearValue, 2> clearValues = {};
-    clearValues[0].color = {1.0f, 1.0f, 1.0f, 1.0f};
-    clearValues[1].depthStencil = {1.0f, 0};
+    // Reads a frame from a few frames ago, if it is done.
+    _profiler.beginFrame(commandBuffer, imageIndex);
+    _frameTimings.gpu = _profiler.frameTime();
+    if (_counting)
+    {
+        _counters.beginFrame(commandBuffer, imageIndex);
+    }
+
+    if (_dynamicResolution)
+    {
+        if (_frameTimings.gpu >= 0.0)
+        {
+            _resolution.update(static_cast<float>(_frameTimings.gpu));
+        }
+        renderPassInfo.renderArea.extent = _resolution.renderExtent();
+    }
+
+    bool occlusion = _gpuDriven && _indirect.occlusionCulling();
+    if (!_gpuDriven)
+    {
+        CpuScope prepare("prepare objects");
+        _prepareObjects(imageIndex);
+    }
+
+    // Barriers and layout transitions between the passes come from what
+    // each one declares.
+    _graph.reset(imageIndex);
+    RenderResource output = _graph.importImage("color", _colorImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+    RenderResource depth = _graph.importImage("depth", _depthImage, _depthAspect, VK_IMAGE_LAYOUT_UNDEFINED);
+    _graph.markOutput(output);
+
+    // Streamed meshes are copied into the pool before anything draws.
+    MeshResources meshes = {};
+    if (_streaming)
+    {
+        meshes = _streamer.importResources(_graph, _meshes);
+        _streamer.addUploadPass(_graph, meshes, imageIndex, _meshes);
+    }
+
+    // With dynamic resolution the scene goes to part of its own image, which
+    // the upscale pass then samples.
+    RenderResource color = output;
+    VkImageLayout colorLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    if (_dynamicResolution)
+    {
+        color = _graph.importImage("scene color", _sceneColorImage, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+        colorLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
 
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    LightResources lights = _lighting.addPasses(
+        _graph,
+        imageIndex,
+        _camera.getViewMatrix(),
+        _camera.getProjectionMatrix(),
+        _camera.getNear(),
+        _camera.getFar(),
+        renderPassInfo.renderArea.extent);
+
+    CullResources draws = {};
+    if (_gpuDriven)
+    {
+        draws = _indirect.importResources(_graph, imageIndex);
+        _indirect.addUploadPass(_graph, draws, imageIndex, _scene);
+        _indirect.addCullPasses(_graph, draws, imageIndex, viewProjection, occlusion ? CullPhase::Early : CullPhase::All);
+    }
+
+    // The deferred pass also clears the G-buffer, to the background color and unlit.
+    std::array<VkClearValue, 4> clearValues = {};
+    clearValues[ATTACHMENT_COLOR].color = {1.0f, 1.0f, 1.0f, 1.0f};
+    clearValues[ATTACHMENT_DEPTH].depthStencil = {1.0f, 0};
+    clearValues[ATTACHMENT_ALBEDO].color = {1.0f, 1.0f, 1.0f, 1.0f};
+    clearValues[ATTACHMENT_NORMAL].color = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    renderPassInfo.clearValueCount = _deferred ? 4 : 2;
     renderPassInfo.pClearValues = clearValues.data();
+    if (_deferred)
+    {
+        renderPassInfo.renderPass = _deferredRenderPass;
+        renderPassInfo.framebuffer = _deferredFramebuffers[imageIndex];
+    }
+
+    VkViewport viewport = {};
+    viewport.width = _screenSize[0];
+    viewport.height = _screenSize[1];
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    if (_dynamicResolution)
+    {
+        viewport.width = static_cast<float>(renderPassInfo.renderArea.extent.width);
+        viewport.height = static_cast<float>(renderPassInfo.renderArea.extent.height);
+    }
+
+    VkRect2D scissor = {};
+    scissor.extent = renderPassInfo.renderArea.extent;
+
+    // Empty when the pre-pass is off or still compiling.
+    bool prePass = !_gpuDriven && !_deferred && _depthPrePass && _pipelines.isReady(_depthPipeline);
+
+    RenderPassId scene = _graph.addPass("scene", [&](VkCommandBuffer commandBuffer) {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        _binds.reset(commandBuffer);
+        if (_deferred)
+        {
+            GpuScope subpass(&_profiler, commandBuffer, "g-buffer");
+            _drawObjects(commandBuffer, imageIndex, ObjectPass::GBuffer);
+        }
+        else if (prePass)
+        {
+            GpuScope subpass(&_profiler, commandBuffer, "depth pre-pass");
+            _drawDepthPrePass(commandBuffer, imageIndex);
+        }
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _objectPipeline);
+        vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
 
-    for (auto &object : _objects)
+        if (_gpuDriven)
+        {
+            GpuScope subpass(&_profiler, commandBuffer, "draw indirect");
+            _indirect.draw(commandBuffer, _binds, imageIndex, _descriptorSet(0, imageIndex), viewProjection);
+        }
+        else if (_deferred)
+        {
+            GpuScope subpass(&_profiler, commandBuffer, "lighting");
+            _drawLighting(commandBuffer, imageIndex);
+        }
+        else
+        {
+            GpuScope subpass(&_profiler, commandBuffer, "shading");
+            _drawObjects(commandBuffer, imageIndex, prePass ? ObjectPass::AfterPrePass : ObjectPass::Shaded);
+        }
+
+        vkCmdEndRenderPass(commandBuffer);
+        _addBindStats();
+    });
+    _graph.attachment(scene, color, ResourceUsage::ColorAttachment, VK_IMAGE_LAYOUT_UNDEFINED, colorLayout);
+    _graph.attachment(
+        scene,
+        depth,
+        ResourceUsage::DepthAttachment,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        _deferred ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    _graph.read(scene, lights.clusters, ResourceUsage::FragmentRead);
+    _graph.read(scene, lights.indices, ResourceUsage::FragmentRead);
+    if (_streaming)
+    {
+        _graph.read(scene, meshes.vertices, ResourceUsage::VertexInput);
+        _graph.read(scene, meshes.positions, ResourceUsage::VertexInput);
+        _graph.read(scene, meshes.indices, ResourceUsage::VertexInput);
+    }
+    if (_gpuDriven)
+    {
+        _graph.read(scene, draws.instances, ResourceUsage::VertexRead);
+        _graph.read(scene, draws.commands, ResourceUsage::IndirectRead);
+        _graph.read(scene, draws.count, ResourceUsage::IndirectRead);
+    }
+
+    // Second phase: what the first one missed, tested against its depth.
+    if (occlusion)
+    {
+        _indirect.addDepthPyramidPass(_graph, draws, depth);
+        _indirect.addCullPasses(_graph, draws, imageIndex, viewProjection, CullPhase::Late);
+
+        VkRenderPassBeginInfo resumeInfo = renderPassInfo;
+        resumeInfo.renderPass = _resumeRenderPass;
+        resumeInfo.clearValueCount = 0;
+        resumeInfo.pClearValues = nullptr;
+
+        RenderPassId resume = _graph.addPass("resume scene", [&](VkCommandBuffer commandBuffer) {
+            vkCmdBeginRenderPass(commandBuffer, &resumeInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+            _binds.reset(commandBuffer);
+            _indirect.draw(commandBuffer, _binds, imageIndex, _descriptorSet(0, imageIndex), viewProjection);
+            vkCmdEndRenderPass(commandBuffer);
+            _addBindStats();
+        });
+        _graph.attachment(resume, color, ResourceUsage::ColorAttachment, colorLayout, colorLayout);
+        _graph.attachment(
+            resume,
+            depth,
+            ResourceUsage::DepthAttachment,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+        _graph.read(resume, lights.clusters, ResourceUsage::FragmentRead);
+        _graph.read(resume, lights.indices, ResourceUsage::FragmentRead);
+        _graph.read(resume, draws.instances, ResourceUsage::VertexRead);
+        _graph.read(resume, draws.commands, ResourceUsage::IndirectRead);
+        _graph.read(resume, draws.count, ResourceUsage::IndirectRead);
+    }
+
+    if (_dynamicResolution)
+    {
+        _resolution.addUpscalePass(_graph, imageIndex, color, output);
+    }
+
+    {
+        CpuScope compile("graph compile");
+        _graph.compile();
+    }
     {
-        VkBuffer vertexBuffers[] = {object.vertexBuffer};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(commandBuffer, object.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _objectPipelineLayout, 0, 1, &object.descriptorSet(imageIndex), 0, nullptr);
-        vkCmdDrawIndexed(commandBuffer, object.indicesCount, 1, 0, 0, 0);
+        CpuScope execute("graph execute");
+        _graph.execute(commandBuffer);
     }
+    _frameStats.barriers += _graph.stats().barriers;
 
-    vkCmdEndRenderPass(commandBuffer);
+    if (_counting)
+    {
+        _counters.endFrame(commandBuffer);
+    }
+    _profiler.endFrame(commandBuffer);
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
     {
@@ -170,35 +981,429 @@ void Renderer::encode(
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = &endSemaphore;
 
-    vkResetFences(_device, 1, &submissionFence);
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, submissionFence);
+    auto submitStart = std::chrono::high_resolution_clock::now();
+    {
+        CpuScope submit("submit");
+        vkResetFences(_device, 1, &submissionFence);
+        Counted::vkQueueSubmit(graphicsQueue, 1, &submitInfo, submissionFence);
+    }
+    auto submitEnd = std::chrono::high_resolution_clock::now();
+
+    _frameTimings.encode = std::chrono::duration<double, std::milli>(submitStart - encodeStart).count();
+    _frameTimings.submit = std::chrono::duration<double, std::milli>(submitEnd - submitStart).count();
 }
 
-void Renderer::updateUniforms(const uint32_t imageIndex)
+void Renderer::_reserveInstances(size_t count)
+{
+    if (count <= _instanceCapacity)
+    {
+        return;
+    }
+
+    // Rare, only when objects are added. Buffers may still be in flight.
+    vkDeviceWaitIdle(_device);
+
+    VkDeviceSize bufferSize = sizeof(InstanceData) * count;
+    for (size_t i = 0; i < _instanceBuffers.size(); i++)
+    {
+        if (_instanceBuffers[i] != VK_NULL_HANDLE)
+        {
+            Counted::vkUnmapMemory(_device, _instanceBuffersMemory[i]);
+            vkDestroyBuffer(_device, _instanceBuffers[i], nullptr);
+            vkFreeMemory(_device, _instanceBuffersMemory[i], nullptr);
+        }
+
+        VulkanUtilities::createBuffer(
+            _device,
+            _physicalDevice,
+            bufferSize,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _instanceBuffers[i],
+            _instanceBuffersMemory[i]);
+
+        // Stays mapped, written every frame.
+        Counted::vkMapMemory(_device, _instanceBuffersMemory[i], 0, bufferSize, 0, &_instanceData[i]);
+    }
+
+    _instanceCapacity = count;
+}
+
+void Renderer::_prepareObjects(const uint32_t imageIndex)
 {
-    VulkanUtilities::CameraInfo cameraInfo = {};
-    cameraInfo.viewProjection = _camera.getViewProjectionMatrix();
+    Frustum frustum = Frustum::fromMatrix(_camera.getViewProjectionMatrix());
 
+    if (_softwareOcclusion)
+    {
+        _renderOccluders();
+    }
+
+    // Whole subtrees of the BVH in or out of the frustum at once.
+    _visible.clear();
+    _bvh.cull(frustum, _scene.bounds(), _visible);
+
+    const std::vector<uint32_t> &meshes = _scene.meshes();
+    const std::vector<uint32_t> &features = _scene.features();
+    const std::vector<uint32_t> &materials = _scene.materials();
+    const std::vector<uint32_t> &flags = _scene.flags();
+
+    _batcher.clear();
+    for (uint32_t i : _visible)
+    {
+        const MeshRange &range = _meshes.range(meshes[i]);
+        bool occluder = (flags[i] & EntityOccluder) != 0;
+        if (_softwareOcclusion && !occluder && !_occlusion.isVisible(range.min, range.max, _modelViewProjections[i]))
+        {
+            _frameStats.occluded++;
+            continue;
+        }
+
+        // Normalized device depth of the center, opaque objects sort front to back.
+        glm::vec4 clip = _modelViewProjections[i] * glm::vec4(range.center, 1.0f);
+        float depth = clip.w > 0.0f ? clip.z / clip.w : 0.0f;
+
+        InstanceData instance;
+        instance.modelViewProjection = _modelViewProjections[i];
+        instance.model = _scene.models()[i];
+
+        _batcher.add(DrawKey::make(features[i], materials[i], meshes[i], depth), instance);
+    }
+    _batcher.build(_threadPool.get());
+
+    auto &instances = _batcher.instances();
+    if (instances.empty())
+    {
+        return;
+    }
+    _reserveInstances(instances.size());
+    memcpy(_instanceData[imageIndex], instances.data(), sizeof(InstanceData) * instances.size());
+}
+
+void Renderer::_renderOccluders()
+{
+    _occlusion.clear();
+
+    // Off screen occluders are clipped away during setup.
+    const std::vector<glm::vec3> &positions = _meshes.positions();
+    const std::vector<uint32_t> &indices = _meshes.indices();
+    for (size_t i = 0; i < _scene.size(); i++)
+    {
+        if (_scene.flags()[i] & EntityOccluder)
+        {
+            const MeshRange &range = _meshes.range(_scene.meshes()[i]);
+            _occlusion.addOccluder(
+                positions.data() + range.vertexOffset,
+                indices.data() + range.firstIndex,
+                range.indexCount,
+                _modelViewProjections[i]);
+        }
+    }
+
+    _occlusion.render(_threadPool.get());
+}
+
+void Renderer::_drawDepthPrePass(VkCommandBuffer commandBuffer, const uint32_t imageIndex)
+{
+    for (auto &group : _batcher.groups())
+    {
+        // Discarded fragments would still write depth.
+        if (group.features & FeatureAlphaTest)
+        {
+            continue;
+        }
+
+        _binds.bindPipeline(_pipelines.pipeline(_depthPipeline));
+        _binds.bindVertexBuffer(0, _meshes.positionBuffer);
+        _binds.bindVertexBuffer(1, _instanceBuffers[imageIndex]);
+        _binds.bindIndexBuffer(_meshes.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+        const MeshRange &range = _meshes.range(group.mesh);
+        Counted::vkCmdDrawIndexed(commandBuffer, range.indexCount, group.instanceCount, range.firstIndex, range.vertexOffset, group.firstInstance);
+        _frameStats.draws++;
+    }
+}
+
+void Renderer::_drawObjects(VkCommandBuffer commandBuffer, const uint32_t imageIndex, ObjectPass pass)
+{
+    for (auto &group : _batcher.groups())
+    {
+        // Skipped while neither the variant nor the fallback is compiled.
+        const ObjectPipelines &pipelines = _objectPipelines.at(group.features);
+        VkPipeline groupPipeline = VK_NULL_HANDLE;
+        if (pass == ObjectPass::GBuffer)
+        {
+            // The registry fallback is a forward pipeline, fall back to the default G-buffer one instead.
+            PipelineHandle handle = _pipelines.isReady(pipelines.gbuffer) ? pipelines.gbuffer : _objectPipelines.at(FeaturesDefault).gbuffer;
+            groupPipeline = _pipelines.isReady(handle) ? _pipelines.pipeline(handle) : VK_NULL_HANDLE;
+        }
+        else
+        {
+            groupPipeline = _pipelines.pipeline(pass == ObjectPass::AfterPrePass ? pipelines.afterPrePass : pipelines.shaded);
+        }
+
+        if (groupPipeline == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+
+        // Everything is requested per group, BindState drops what is already bound.
+        _binds.bindPipeline(groupPipeline);
+        _binds.bindDescriptorSet(_objectPipelineState.layout, 0, _descriptorSet(group.material, imageIndex));
+        _binds.bindVertexBuffer(0, _meshes.vertexBuffer);
+        _binds.bindVertexBuffer(1, _instanceBuffers[imageIndex]);
+        _binds.bindIndexBuffer(_meshes.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+        const MeshRange &range = _meshes.range(group.mesh);
+        Counted::vkCmdDrawIndexed(commandBuffer, range.indexCount, group.instanceCount, range.firstIndex, range.vertexOffset, group.firstInstance);
+        _frameStats.draws++;
+    }
+}
+
+void Renderer::_drawLighting(VkCommandBuffer commandBuffer, const uint32_t imageIndex)
+{
+    if (!_pipelines.isReady(_lightingPipeline))
+    {
+        return;
+    }
+
+    _binds.bindPipeline(_pipelines.pipeline(_lightingPipeline));
+    _binds.bindDescriptorSet(_lightingPipelineState.layout, 0, _descriptorSet(0, imageIndex));
+    _binds.bindDescriptorSet(_lightingPipelineState.layout, 1, _gbufferSet);
+
+    // World positions come back from the depth attachment.
+    glm::mat4 inverseViewProjection = glm::inverse(_camera.getViewProjectionMatrix());
+    Counted::vkCmdPushConstants(commandBuffer, _lightingPipelineState.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::mat4), &inverseViewProjection);
+
+    Counted::vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    _frameStats.draws++;
+}
+
+void Renderer::_addBindStats()
+{
+    _frameStats.bindsRequested += _binds.stats().requested;
+    _frameStats.bindsIssued += _binds.stats().issued;
+}
+
+void Renderer::_reportStats(double deltaTime)
+{
+    _frameStats.frames++;
+    _frameStats.elapsed += deltaTime;
+    if (_frameStats.elapsed < STATS_INTERVAL)
+    {
+        return;
+    }
+
+    double frames = static_cast<double>(_frameStats.frames);
+    std::cout << "Frame stats: " << frames / _frameStats.elapsed << " fps, "
+              << "pre-pass " << (_depthPrePass ? "on, " : "off, ")
+              << _frameStats.draws / frames << " draws, "
+              << _frameStats.occluded / frames << " occluded, "
+              << _frameStats.bindsRequested / frames << " scene binds requested, "
+              << _frameStats.bindsIssued / frames << " scene binds issued, "
+              << _frameStats.barriers / frames << " barriers, "
+              << _frameStats.bvhRebuilds / frames << " BVH rebuilds per frame." << std::endl;
+    if (_streaming)
+    {
+        const StreamingStats &streaming = _streamer.stats();
+        std::cout << "Streaming: " << streaming.residentCells << "/" << streaming.cells << " cells resident, "
+                  << streaming.loadingCells << " loading, "
+                  << streaming.residentBytes / (1024 * 1024) << " MB, "
+                  << streaming.uploadedBytes / (1024 * 1024) << " MB uploaded, "
+                  << streaming.evictions << " evictions." << std::endl;
+    }
+    if (_dynamicResolution)
+    {
+        std::cout << "Render scale " << _resolution.scale() << ", GPU " << _resolution.gpuTime() << " ms." << std::endl;
+    }
+    _reportGpuTimes();
+    if (_countersToConsole)
+    {
+        _reportCounters();
+    }
+
+    _frameStats = FrameStats();
+}
+
+void Renderer::_reportCounters()
+{
+    FrameCounts counts = _counters.averages();
+    _counters.resetAverages();
+
+    std::cout << "Counters per frame: ";
+    if (_counters.hasStatistics())
+    {
+        for (uint32_t statistic = 0; statistic < StatisticCount; statistic++)
+        {
+            std::cout << counts.statistics[statistic] << " " << FrameCounters::name(static_cast<PipelineStatistic>(statistic)) << ", ";
+        }
+    }
+    for (uint32_t call = 0; call < ApiCallCount; call++)
+    {
+        std::cout << counts.calls[call] << " " << ApiCounters::name(static_cast<ApiCall>(call))
+                  << (call + 1 < ApiCallCount ? ", " : ".");
+    }
+    std::cout << std::endl;
+}
+
+void Renderer::_reportGpuTimes()
+{
+    std::vector<GpuScopeTime> scopes = _profiler.averages();
+    _profiler.resetAverages();
+    if (scopes.empty())
+    {
+        return;
+    }
+
+    // Children in parentheses after their parent.
+    std::cout << "GPU " << scopes[0].milliseconds << " ms";
+    uint32_t depth = 1;
+    for (size_t i = 1; i < scopes.size(); i++)
+    {
+        const GpuScopeTime &scope = scopes[i];
+        if (scope.depth > depth)
+        {
+            std::cout << " (";
+        }
+        else
+        {
+            for (; depth > scope.depth; depth--)
+            {
+                std::cout << ")";
+            }
+            std::cout << (i == 1 ? ": " : ", ");
+        }
+        depth = scope.depth;
+        std::cout << scope.name << " " << scope.milliseconds;
+    }
+    for (; depth > 1; depth--)
+    {
+        std::cout << ")";
+    }
+    std::cout << "." << std::endl;
+}
+
+void Renderer::updateUniforms(const uint32_t imageIndex)
+{
+    CpuScope scope("uniforms");
     VulkanUtilities::LightInfo lightInfo = {};
     lightInfo.direction = glm::normalize(glm::vec3(0.2f, 1.0f, 1.0f));
 
     void *data;
-    vkMapMemory(_device, _uniformBuffersMemory[imageIndex], 0, sizeof(cameraInfo) + sizeof(lightInfo), 0, &data);
-    memcpy(data, &cameraInfo, sizeof(cameraInfo));
-    memcpy(
-        static_cast<char *>(data) + VulkanUtilities::nextOffset(sizeof(VulkanUtilities::CameraInfo)),
-        &lightInfo,
-        sizeof(lightInfo));
-    vkUnmapMemory(_device, _uniformBuffersMemory[imageIndex]);
+    Counted::vkMapMemory(_device, _uniformBuffersMemory[imageIndex], 0, sizeof(lightInfo), 0, &data);
+    memcpy(data, &lightInfo, sizeof(lightInfo));
+    Counted::vkUnmapMemory(_device, _uniformBuffersMemory[imageIndex]);
+}
+
+void Renderer::_updateBvh()
+{
+    if (_scene.layoutVersion() != _bvhVersion || _bvh.needsRebuild())
+    {
+        _bvh.build(_scene.bounds());
+        _bvhVersion = _scene.layoutVersion();
+        _frameStats.bvhRebuilds++;
+    }
+    else
+    {
+        _bvh.refit(_scene.bounds(), _scene.changed());
+    }
+}
+
+void Renderer::_pick()
+{
+    // Items are dense indices of the layout the BVH was built for.
+    if (_bvhVersion != _scene.layoutVersion())
+    {
+        return;
+    }
+
+    // The cursor is captured, the camera looks through the screen center.
+    Ray ray = _camera.getRay();
+
+    // Spheres are loose, a ground plane's holds everything above it. Those
+    // hit are tested again with the mesh box, in the entity's space.
+    auto hitsMeshBox = [this, &ray](uint32_t item, float &distance) {
+        const glm::mat4 &model = _scene.models()[item];
+        const MeshRange &range = _meshes.range(_scene.meshes()[item]);
+        glm::mat4 inverse = glm::inverse(model);
+        Ray local(glm::vec3(inverse * glm::vec4(ray.origin, 1.0f)), glm::vec3(inverse * glm::vec4(ray.direction, 0.0f)));
+
+        float localDistance;
+        if (!local.intersectsBox(range.min, range.max, INFINITY, localDistance))
+        {
+            return false;
+        }
+
+        glm::vec3 point = glm::vec3(model * glm::vec4(local.origin + local.direction * localDistance, 1.0f));
+        distance = glm::length(point - ray.origin);
+        return true;
+    };
+
+    BvhHit hit;
+    if (_bvh.raycast(ray, _scene.bounds(), _camera.getFar(), hit, hitsMeshBox))
+    {
+        std::cout << "Picked " << _scene.name(_scene.handleAt(hit.item)) << " at " << hit.distance << "." << std::endl;
+    }
+    else
+    {
+        std::cout << "Picked nothing." << std::endl;
+    }
+}
+
+void Renderer::_updateTransforms()
+{
+    _modelViewProjections.resize(_scene.size());
+
+    TransformUtilities::multiplyBatch(
+        _camera.getViewProjectionMatrix(),
+        _scene.models().data(),
+        _modelViewProjections.data(),
+        _scene.size());
 }
 
 void Renderer::clean()
 {
+    if (_gpuDriven)
+    {
+        _indirect.clean();
+    }
+    _lighting.clean();
+    if (_dynamicResolution)
+    {
+        _resolution.clean();
+    }
+    _graph.clean();
+    _profiler.clean();
+    if (_counting)
+    {
+        _counters.clean();
+    }
+    if (_streaming)
+    {
+        _streamer.clean();
+    }
+    _meshes.clean(_device);
+    _sceneFile.clear();
+
+    _pipelines.clean();
+    _pipelineCache.save();
+    _pipelineCache.clean();
+    _threadPool.reset();
+
     vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
-    vkDestroyPipeline(_device, _objectPipeline, nullptr);
-    vkDestroyPipelineLayout(_device, _objectPipelineLayout, nullptr);
+    if (_deferred)
+    {
+        vkDestroyDescriptorPool(_device, _gbufferPool, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _gbufferSetLayout, nullptr);
+    }
     vkDestroySampler(_device, _textureSampler, nullptr);
-    vkDestroyDescriptorSetLayout(_device, Object::descriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _descriptorSetLayout, nullptr);
+
+    for (size_t i = 0; i < _textureImages.size(); i++)
+    {
+        vkDestroyImageView(_device, _textureImageViews[i], nullptr);
+        vkDestroyImage(_device, _textureImages[i], nullptr);
+        vkFreeMemory(_device, _textureImagesMemory[i], nullptr);
+    }
 
     for (size_t i = 0; i < _uniformBuffers.size(); i++)
     {
@@ -206,31 +1411,66 @@ void Renderer::clean()
         vkDestroyBuffer(_device, _uniformBuffers[i], nullptr);
     }
 
-    for (auto &object : _objects)
+    // Never created without instances to draw.
+    for (size_t i = 0; i < _instanceBuffers.size(); i++)
     {
-        object.clean(_device);
+        if (_instanceBuffers[i] == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+        Counted::vkUnmapMemory(_device, _instanceBuffersMemory[i]);
+        vkDestroyBuffer(_device, _instanceBuffers[i], nullptr);
+        vkFreeMemory(_device, _instanceBuffersMemory[i], nullptr);
     }
 }
 
-void Renderer::resize(VkRenderPass &renderPass, const int width, const int height)
+void Renderer::resize(Swapchain &swapchain, const int width, const int height)
 {
-    if (width == _screenSize[0] && height == _screenSize[1])
+    _screenSize[0] = width;
+    _screenSize[1] = height;
+
+    // The attachments and the depth pyramid are new images.
+    _graph.invalidate();
+    _importFrameImages(swapchain);
+    if (_dynamicResolution)
     {
-        return;
+        _resolution.resize(swapchain, _pipelines);
     }
 
-    vkDestroyPipeline(_device, _objectPipeline, nullptr);
-    vkDestroyPipelineLayout(_device, _objectPipelineLayout, nullptr);
+    // Compatible render passes share the key and get the existing pipeline
+    // back, anything else compiles once.
+    _objectPipelineState.renderPassKey = swapchain.renderPassKey;
+    _depthPipelineState.renderPassKey = swapchain.renderPassKey;
+    _depthPipeline = _pipelines.request(_depthPipelineState, swapchain.renderPass);
 
-    _screenSize[0] = width;
-    _screenSize[1] = height;
+    if (_deferred)
+    {
+        _deferredRenderPass = swapchain.deferredRenderPass;
+        _deferredRenderPassKey = swapchain.deferredRenderPassKey;
+        _deferredFramebuffers = swapchain.getDeferredFramebuffers();
+        _updateGBufferSet(swapchain);
 
-    Pipeline::create(
-        _device,
-        width,
-        height,
-        Object::descriptorSetLayout,
-        _objectPipelineLayout,
-        renderPass,
-        _objectPipeline);
+        _lightingPipelineState.renderPassKey = _deferredRenderPassKey;
+        _lightingPipeline = _pipelines.request(_lightingPipelineState, _deferredRenderPass);
+    }
+
+    std::vector<uint32_t> variants;
+    for (auto &entry : _objectPipelines)
+    {
+        variants.push_back(entry.first);
+    }
+
+    _pipelines.setFallback(_requestObjectPipeline(FeaturesDefault, swapchain.renderPass));
+    for (uint32_t features : variants)
+    {
+        _requestObjectPipeline(features, swapchain.renderPass);
+    }
+
+    if (_gpuDriven)
+    {
+        _indirect.resize(swapchain);
+        _resumeRenderPass = swapchain.resumeRenderPass;
+    }
+
+    _occlusion.resize(OCCLUSION_WIDTH, OCCLUSION_WIDTH * static_cast<uint32_t>(height) / static_cast<uint32_t>(width));
 }
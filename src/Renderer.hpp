@@ -3,17 +3,100 @@
 
 #include "Swapchain.hpp"
 #include "MeshUtilities.hpp"
-#include "Object.hpp"
+#include "Scene.hpp"
+#include "Bvh.hpp"
 #include "Camera.hpp"
+#include "PipelineRegistry.hpp"
+#include "ThreadPool.hpp"
+#include "TransformUtilities.hpp"
+#include "MeshPool.hpp"
+#include "IndirectRenderer.hpp"
+#include "InstanceBatcher.hpp"
+#include "BindState.hpp"
+#include "OcclusionRasterizer.hpp"
+#include "ClusteredLighting.hpp"
+#include "RenderGraph.hpp"
+#include "DynamicResolution.hpp"
+#include "GpuProfiler.hpp"
+#include "FrameCounters.hpp"
+#include "WorldStreamer.hpp"
+
+struct RendererSettings
+{
+    // Cull on the GPU and draw with indirect commands.
+    bool gpuDriven = false;
+    // Extra cubes laid out on a grid, GPU-driven path only.
+    uint32_t stressInstances = 0;
+    // Depth only pass before shading, CPU path only. Toggled with P.
+    bool depthPrePass = false;
+    // Two phase Hi-Z culling, GPU-driven path only.
+    bool occlusionCulling = false;
+    // Occluders rasterized on the CPU, CPU path only.
+    bool softwareOcclusion = false;
+    // Random point and spot lights over the ground, shaded per cluster.
+    uint32_t lightCount = 0;
+    // G-buffer subpass then one lighting pass per pixel, CPU path only,
+    // needs Swapchain::deferred.
+    bool deferred = false;
+    // Render scale follows the GPU frame time, needs Swapchain::offscreen.
+    bool dynamicResolution = false;
+    // GPU milliseconds per frame the render scale aims for.
+    float frameBudget = 16.0f;
+    // SceneFile, text or compiled.
+    std::string scenePath = "./resources/scenes/default.scene";
+    // Side of the square cells the scene streams in by, 0 keeps the whole
+    // scene resident. CPU path only.
+    float streamCellSize = 0.0f;
+    // Megabytes of streamed meshes.
+    uint32_t streamBudget = 256;
+    // Pipeline statistics and Vulkan call counts per frame: "console" with
+    // the stats, "overlay" for the app to show, or a CSV file path. Off
+    // when empty.
+    std::string counters;
+
+    // Reads argv[i], and its value, if it is a renderer flag. Shared by the
+    // app and the benchmarks.
+    bool parseArgument(int argc, char **argv, int &i);
+};
+
+// Accumulated between two stats lines.
+struct FrameStats
+{
+    uint32_t frames = 0;
+    double elapsed = 0.0;
+    uint64_t draws = 0;
+    uint64_t occluded = 0;
+    // Graphics binds inside the scene render passes, compute binds are not
+    // tracked.
+    uint64_t bindsRequested = 0;
+    uint64_t bindsIssued = 0;
+    uint64_t barriers = 0;
+    uint64_t bvhRebuilds = 0;
+};
+
+// CPU milliseconds of the last encode, the submit apart.
+struct FrameTimings
+{
+    double encode = 0.0;
+    double submit = 0.0;
+    // GPU milliseconds of an earlier frame, negative when none was read.
+    double gpu = -1.0;
+};
 
 class Renderer
 {
 public:
     Renderer() {};
 
-    void init(Swapchain &swapchain, const int width, const int heigth);
+    void init(
+        Swapchain &swapchain,
+        const int width,
+        const int heigth,
+        const RendererSettings &settings = RendererSettings());
     void update(const double deltaTime);
     void createDescriptorPool(uint32_t imageCount);
+    void createDescriptorSetLayout();
+    void createDescriptorSets(uint32_t imageCount);
     void updateUniforms(const uint32_t imageIndex);
     void encode(
         const VkQueue &graphicsQueue,
@@ -24,29 +107,201 @@ public:
         const VkSemaphore &endSemaphore,
         const VkFence &submissionFence);
     void clean();
-    void resize(VkRenderPass &renderPass, const int width, const int height);
+    void resize(Swapchain &swapchain, const int width, const int height);
+
+    Camera &camera() { return _camera; }
+    const FrameTimings &frameTimings() const { return _frameTimings; }
+    const GpuProfiler &gpuProfiler() const { return _profiler; }
+    // Only counting with RendererSettings::counters.
+    const FrameCounters &frameCounters() const { return _counters; }
 
     ~Renderer() {};
 
 private:
+    // Which of ObjectPipelines draws the objects.
+    enum class ObjectPass
+    {
+        Shaded,
+        AfterPrePass,
+        GBuffer,
+    };
+
+    PipelineHandle _requestObjectPipeline(uint32_t features, VkRenderPass renderPass);
+    // Meshes and textures on the thread pool, then the entities.
+    void _loadScene(Swapchain &swapchain, const RendererSettings &settings);
+    // From instance `index` of the scene file.
+    EntityHandle _createEntity(uint32_t index, uint32_t mesh, EntityHandle parent);
+    // Sets are grouped by material, the GPU-driven path and the lighting
+    // pass use the ones of material 0.
+    VkDescriptorSet _descriptorSet(uint32_t material, const uint32_t imageIndex) const;
+    void _updateTransforms();
+    // Rebuilds the BVH when the scene layout changed or it degraded, refits
+    // it otherwise.
+    void _updateBvh();
+    void _pick();
+    void _initIndirect(Swapchain &swapchain, const RendererSettings &settings);
+    // Culls, sorts and uploads the instances, before the render pass.
+    void _prepareObjects(const uint32_t imageIndex);
+    void _drawDepthPrePass(VkCommandBuffer commandBuffer, const uint32_t imageIndex);
+    void _drawObjects(VkCommandBuffer commandBuffer, const uint32_t imageIndex, ObjectPass pass);
+    void _initDeferred(Swapchain &swapchain);
+    void _updateGBufferSet(Swapchain &swapchain);
+    void _drawLighting(VkCommandBuffer commandBuffer, const uint32_t imageIndex);
+    // Adds what _binds saw since its last reset, at the end of a render pass.
+    void _addBindStats();
+    void _reserveInstances(size_t count);
+    void _renderOccluders();
+    void _importFrameImages(Swapchain &swapchain);
+    void _addLights(uint32_t count);
+    void _reportStats(double deltaTime);
+    // Per scope, averaged over the stats interval.
+    void _reportGpuTimes();
+    void _reportCounters();
+
+    // Seconds between two stats lines.
+    static constexpr double STATS_INTERVAL = 2.0;
+    // Software occlusion buffer width, the height follows the aspect ratio.
+    static const uint32_t OCCLUSION_WIDTH = 256;
+    // Radians per second.
+    static constexpr float SPIN_SPEED = 0.5f;
+    // Lowest dynamic resolution scale, per axis.
+    static constexpr float MIN_RENDER_SCALE = 0.5f;
+
     double _time = 0.0;
 
     VkDevice _device;
+    VkPhysicalDevice _physicalDevice;
     VkSampler _textureSampler;
 
+    // Scene textures, in file order.
+    std::vector<VkImage> _textureImages;
+    std::vector<VkDeviceMemory> _textureImagesMemory;
+    std::vector<VkImageView> _textureImageViews;
+    // Texture of each material.
+    std::vector<uint32_t> _materialTextures;
+
     Camera _camera;
 
+    // Background work such as asset loading and pipeline compilation.
+    std::unique_ptr<ThreadPool> _threadPool;
+
     glm::vec2 _screenSize;
-    std::vector<Object> _objects;
+    // Stays mapped, streamed cells create their entities from it.
+    SceneFile _sceneFile;
+    Scene _scene;
+    // Turn around the vertical axis, their children with them.
+    struct Spinner
+    {
+        EntityHandle entity;
+        // From the scene file, the spin is applied on top.
+        glm::quat rotation;
+    };
+    std::vector<Spinner> _spinners;
+    // Over the scene bounds, for frustum culling and picking.
+    Bvh _bvh;
+    // Scene::layoutVersion the BVH was built for.
+    uint32_t _bvhVersion = ~0u;
+    // Dense indices of the entities in the frustum.
+    std::vector<uint32_t> _visible;
+    bool _pickButtonDown = false;
     VkDescriptorPool _descriptorPool;
+    VkDescriptorSetLayout _descriptorSetLayout;
+
+    // MVP per entity, same order as the scene arrays.
+    std::vector<glm::mat4> _modelViewProjections;
+
+    // Every mesh, objects only hold an index.
+    MeshPool _meshes;
+    // Cube of the GPU-driven stress grid, added before the upload.
+    uint32_t _stressMesh = MeshPool::NO_MESH;
+    // Visible objects grouped by mesh and material, one draw per group.
+    InstanceBatcher _batcher;
+    BindState _binds;
+    FrameStats _frameStats;
+    FrameTimings _frameTimings;
 
     // Pipelines.
-    VkPipelineLayout _objectPipelineLayout;
-    VkPipeline _objectPipeline;
+    PipelineCache _pipelineCache;
+    PipelineRegistry _pipelines;
+    PipelineState _objectPipelineState;
+    struct ObjectPipelines
+    {
+        PipelineHandle shaded = INVALID_PIPELINE;
+        // Depth equal test and no depth write.
+        PipelineHandle afterPrePass = INVALID_PIPELINE;
+        // Writes the G-buffer, deferred path only.
+        PipelineHandle gbuffer = INVALID_PIPELINE;
+    };
+
+    // One pair per FragmentFeature combination in use.
+    std::unordered_map<uint32_t, ObjectPipelines> _objectPipelines;
+
+    // Depth pre-pass.
+    bool _depthPrePass = false;
+    bool _prePassKeyDown = false;
+    PipelineState _depthPipelineState;
+    PipelineHandle _depthPipeline = INVALID_PIPELINE;
+
+    // Deferred shading, in Swapchain::deferredRenderPass.
+    bool _deferred = false;
+    VkRenderPass _deferredRenderPass = VK_NULL_HANDLE;
+    std::vector<VkFramebuffer> _deferredFramebuffers;
+    uint64_t _deferredRenderPassKey = 0;
+    ShaderId _gbufferShader = 0;
+    PipelineState _lightingPipelineState;
+    PipelineHandle _lightingPipeline = INVALID_PIPELINE;
+    // Input attachments, one set since the G-buffer is shared.
+    VkDescriptorSetLayout _gbufferSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool _gbufferPool = VK_NULL_HANDLE;
+    VkDescriptorSet _gbufferSet = VK_NULL_HANDLE;
+
+    // Scene rendered at a fraction of the swapchain extent.
+    bool _dynamicResolution = false;
+    DynamicResolution _resolution;
+
+    // Software occlusion culling.
+    bool _softwareOcclusion = false;
+    OcclusionRasterizer _occlusion;
+
+    // Scene cells around the camera, the rest is not loaded.
+    bool _streaming = false;
+    WorldStreamer _streamer;
+
+    // Point and spot lights, both paths.
+    ClusteredLighting _lighting;
+
+    // Times the frame and each graph pass.
+    GpuProfiler _profiler;
+    // Optional, geometry, shading and API calls per frame.
+    bool _counting = false;
+    bool _countersToConsole = false;
+    FrameCounters _counters;
+
+    // Rebuilt every frame in encode.
+    RenderGraph _graph;
+    // Imported into the graph, recreated on resize.
+    std::vector<VkImage> _colorImages;
+    // Offscreen scene color, dynamic resolution only.
+    VkImage _sceneColorImage = VK_NULL_HANDLE;
+    VkImage _depthImage = VK_NULL_HANDLE;
+    VkImageAspectFlags _depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+    // GPU-driven path.
+    bool _gpuDriven = false;
+    IndirectRenderer _indirect;
+    // Resumes the frame after the occlusion culling late phase.
+    VkRenderPass _resumeRenderPass = VK_NULL_HANDLE;
 
     // Per frame data.
     std::vector<VkBuffer> _uniformBuffers;
     std::vector<VkDeviceMemory> _uniformBuffersMemory;
+    std::vector<VkDescriptorSet> _descriptorSets;
+
+    // InstanceData per visible object, persistently mapped.
+    std::vector<VkBuffer> _instanceBuffers;
+    std::vector<VkDeviceMemory> _instanceBuffersMemory;
+    std::vector<void *> _instanceData;
+    size_t _instanceCapacity = 0;
 };
 
 #endif
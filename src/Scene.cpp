@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <numeric>
+
+#include "Scene.hpp"
+#include "ThreadPool.hpp"
+
+const uint32_t Scene::NO_PARENT;
+
+namespace
+{
+// Entry i of the result is entry order[i] of values.
+template <typename T>
+void permute(std::vector<T> &values, const std::vector<uint32_t> &order)
+{
+    std::vector<T> sorted;
+    sorted.reserve(values.size());
+    for (uint32_t index : order)
+    {
+        sorted.push_back(std::move(values[index]));
+    }
+    values.swap(sorted);
+}
+}
+
+EntityHandle Scene::create(const std::string &name, uint32_t mesh, EntityHandle parent)
+{
+    uint32_t parentIndex = parent == EntityHandle() ? NO_PARENT : indexOf(parent);
+
+    uint32_t slot;
+    if (!_freeSlots.empty())
+    {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(_slots.size());
+        _slots.push_back({0, 0});
+    }
+
+    _slots[slot].index = static_cast<uint32_t>(_models.size());
+    _positions.push_back(glm::vec3(0.0f));
+    _rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    _scales.push_back(glm::vec3(1.0f));
+    _dirty.push_back(1);
+    _models.push_back(glm::mat4(1.0f));
+    _bounds.push_back(glm::vec4(0.0f));
+    _meshes.push_back(mesh);
+    _materials.push_back(0);
+    _features.push_back(FeaturesDefault);
+    _flags.push_back(0);
+    _names.push_back(name);
+    _slotOf.push_back(slot);
+    _parentSlots.push_back(parentIndex == NO_PARENT ? NO_PARENT : parent.index);
+    _parents.push_back(parentIndex);
+    _childCounts.push_back(0);
+    if (parentIndex != NO_PARENT)
+    {
+        _childCounts[parentIndex]++;
+    }
+
+    // A root after children, or a child of a deeper entity, breaks the
+    // depth order.
+    _hierarchyChanged = true;
+    _layoutVersion++;
+
+    EntityHandle entity;
+    entity.index = slot;
+    entity.generation = _slots[slot].generation;
+    return entity;
+}
+
+void Scene::destroy(EntityHandle entity)
+{
+    // Leaves, the common case, go without looking at the hierarchy.
+    uint32_t index = indexOf(entity);
+    if (_childCounts[index] == 0)
+    {
+        _remove(index);
+        _hierarchyChanged = true;
+        return;
+    }
+
+    if (_hierarchyChanged)
+    {
+        _sortHierarchy();
+    }
+
+    // Descendants come after their ancestors, one pass finds the subtree.
+    index = indexOf(entity);
+    std::vector<uint32_t> subtree = {index};
+    std::vector<uint8_t> inSubtree(size() - index, 0);
+    inSubtree[0] = 1;
+    for (uint32_t i = index + 1; i < size(); i++)
+    {
+        uint32_t parent = _parents[i];
+        if (parent != NO_PARENT && parent >= index && inSubtree[parent - index])
+        {
+            inSubtree[i - index] = 1;
+            subtree.push_back(i);
+        }
+    }
+
+    // From the back, so the entity moved into a hole is never one to remove.
+    for (auto it = subtree.rbegin(); it != subtree.rend(); ++it)
+    {
+        _remove(*it);
+    }
+    _hierarchyChanged = true;
+}
+
+void Scene::_remove(uint32_t index)
+{
+    uint32_t slot = _slotOf[index];
+    uint32_t last = static_cast<uint32_t>(_models.size() - 1);
+    if (_parentSlots[index] != NO_PARENT)
+    {
+        _childCounts[_slots[_parentSlots[index]].index]--;
+    }
+
+    // The last entity takes the hole, the arrays stay dense.
+    if (index != last)
+    {
+        _positions[index] = _positions[last];
+        _rotations[index] = _rotations[last];
+        _scales[index] = _scales[last];
+        _dirty[index] = _dirty[last];
+        _models[index] = _models[last];
+        _bounds[index] = _bounds[last];
+        _meshes[index] = _meshes[last];
+        _materials[index] = _materials[last];
+        _features[index] = _features[last];
+        _flags[index] = _flags[last];
+        _names[index] = std::move(_names[last]);
+        _slotOf[index] = _slotOf[last];
+        _parentSlots[index] = _parentSlots[last];
+        _childCounts[index] = _childCounts[last];
+        _slots[_slotOf[index]].index = index;
+    }
+
+    _positions.pop_back();
+    _rotations.pop_back();
+    _scales.pop_back();
+    _dirty.pop_back();
+    _models.pop_back();
+    _bounds.pop_back();
+    _meshes.pop_back();
+    _materials.pop_back();
+    _features.pop_back();
+    _flags.pop_back();
+    _names.pop_back();
+    _slotOf.pop_back();
+    _parentSlots.pop_back();
+    _parents.pop_back();
+    _childCounts.pop_back();
+
+    _slots[slot].generation++;
+    _freeSlots.push_back(slot);
+    _layoutVersion++;
+}
+
+void Scene::clear()
+{
+    for (uint32_t slot : _slotOf)
+    {
+        _slots[slot].generation++;
+        _freeSlots.push_back(slot);
+    }
+
+    _positions.clear();
+    _rotations.clear();
+    _scales.clear();
+    _dirty.clear();
+    _models.clear();
+    _bounds.clear();
+    _meshes.clear();
+    _materials.clear();
+    _features.clear();
+    _flags.clear();
+    _names.clear();
+    _slotOf.clear();
+    _parentSlots.clear();
+    _parents.clear();
+    _childCounts.clear();
+    _levels.clear();
+    _changed.clear();
+    _hierarchyChanged = false;
+    _layoutVersion++;
+}
+
+void Scene::reserve(size_t count)
+{
+    _positions.reserve(count);
+    _rotations.reserve(count);
+    _scales.reserve(count);
+    _dirty.reserve(count);
+    _models.reserve(count);
+    _bounds.reserve(count);
+    _meshes.reserve(count);
+    _materials.reserve(count);
+    _features.reserve(count);
+    _flags.reserve(count);
+    _names.reserve(count);
+    _slotOf.reserve(count);
+    _parentSlots.reserve(count);
+    _parents.reserve(count);
+    _childCounts.reserve(count);
+    _slots.reserve(count);
+}
+
+bool Scene::isAlive(EntityHandle entity) const
+{
+    return entity.index < _slots.size() && _slots[entity.index].generation == entity.generation;
+}
+
+uint32_t Scene::indexOf(EntityHandle entity) const
+{
+    if (!isAlive(entity))
+    {
+        throw std::runtime_error("Unable to find entity, it was destroyed.");
+    }
+
+    return _slots[entity.index].index;
+}
+
+EntityHandle Scene::handleAt(uint32_t index) const
+{
+    EntityHandle entity;
+    entity.index = _slotOf.at(index);
+    entity.generation = _slots[entity.index].generation;
+    return entity;
+}
+
+void Scene::setParent(EntityHandle entity, EntityHandle parent)
+{
+    uint32_t index = indexOf(entity);
+    uint32_t parentSlot = NO_PARENT;
+    if (parent != EntityHandle())
+    {
+        indexOf(parent);
+        for (uint32_t ancestor = parent.index; ancestor != NO_PARENT; ancestor = _parentSlots[_slots[ancestor].index])
+        {
+            if (ancestor == entity.index)
+            {
+                throw std::runtime_error("Unable to parent an entity to its own descendant.");
+            }
+        }
+        parentSlot = parent.index;
+    }
+
+    if (_parentSlots[index] != NO_PARENT)
+    {
+        _childCounts[_slots[_parentSlots[index]].index]--;
+    }
+    if (parentSlot != NO_PARENT)
+    {
+        _childCounts[_slots[parentSlot].index]++;
+    }
+
+    _parentSlots[index] = parentSlot;
+    _dirty[index] = 1;
+    _hierarchyChanged = true;
+}
+
+void Scene::setPosition(EntityHandle entity, const glm::vec3 &position)
+{
+    uint32_t index = indexOf(entity);
+    _positions[index] = position;
+    _dirty[index] = 1;
+}
+
+void Scene::setRotation(EntityHandle entity, const glm::quat &rotation)
+{
+    uint32_t index = indexOf(entity);
+    _rotations[index] = rotation;
+    _dirty[index] = 1;
+}
+
+void Scene::setScale(EntityHandle entity, const glm::vec3 &scale)
+{
+    uint32_t index = indexOf(entity);
+    _scales[index] = scale;
+    _dirty[index] = 1;
+}
+
+void Scene::_sortHierarchy()
+{
+    uint32_t count = static_cast<uint32_t>(size());
+    for (uint32_t i = 0; i < count; i++)
+    {
+        _parents[i] = _parentSlots[i] == NO_PARENT ? NO_PARENT : _slots[_parentSlots[i]].index;
+    }
+
+    // Walks up to the first entity with a known depth, then back down.
+    std::vector<uint32_t> depths(count, NO_PARENT);
+    std::vector<uint32_t> path;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t top = i;
+        path.clear();
+        while (depths[top] == NO_PARENT && _parents[top] != NO_PARENT)
+        {
+            path.push_back(top);
+            top = _parents[top];
+        }
+        if (depths[top] == NO_PARENT)
+        {
+            depths[top] = 0;
+        }
+
+        uint32_t depth = depths[top];
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+        {
+            depths[*it] = ++depth;
+        }
+    }
+
+    if (!std::is_sorted(depths.begin(), depths.end()))
+    {
+        // Stable, so entities of one depth keep their relative order.
+        std::vector<uint32_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&depths](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+
+        permute(_positions, order);
+        permute(_rotations, order);
+        permute(_scales, order);
+        permute(_models, order);
+        permute(_bounds, order);
+        permute(_meshes, order);
+        permute(_materials, order);
+        permute(_features, order);
+        permute(_flags, order);
+        permute(_names, order);
+        permute(_slotOf, order);
+        permute(_parentSlots, order);
+        permute(_childCounts, order);
+        permute(depths, order);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            _slots[_slotOf[i]].index = i;
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            _parents[i] = _parentSlots[i] == NO_PARENT ? NO_PARENT : _slots[_parentSlots[i]].index;
+        }
+
+        // Every dense index moved, whatever mirrors the arrays is stale.
+        std::fill(_dirty.begin(), _dirty.end(), 1);
+        _layoutVersion++;
+    }
+
+    // A child is one deeper than its parent, depths never skip.
+    _levels.clear();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (depths[i] == _levels.size())
+        {
+            _levels.push_back(i);
+        }
+    }
+    _levels.push_back(count);
+
+    _hierarchyChanged = false;
+}
+
+void Scene::updateTransforms(const std::vector<MeshRange> &ranges, ThreadPool *threadPool)
+{
+    if (_hierarchyChanged)
+    {
+        _sortHierarchy();
+    }
+
+    // Dirty flags down the hierarchy, parents are visited first.
+    _changed.clear();
+    for (uint32_t i = 0; i < size(); i++)
+    {
+        if (!_dirty[i] && _parents[i] != NO_PARENT && _dirty[_parents[i]])
+        {
+            _dirty[i] = 1;
+        }
+        if (_dirty[i])
+        {
+            _changed.push_back(i);
+        }
+    }
+
+    // One depth at a time, a depth only reads the world matrices above it.
+    size_t first = 0;
+    for (size_t level = 0; level + 1 < _levels.size() && first < _changed.size(); level++)
+    {
+        size_t end = std::lower_bound(_changed.begin() + first, _changed.end(), _levels[level + 1]) - _changed.begin();
+        const uint32_t *indices = _changed.data() + first;
+        auto update = [this, indices, &ranges](size_t begin, size_t last) {
+            for (size_t k = begin; k < last; k++)
+            {
+                _updateWorld(indices[k], ranges);
+            }
+        };
+
+        size_t levelCount = end - first;
+        if (threadPool != nullptr && levelCount >= PARALLEL_MIN)
+        {
+            threadPool->parallelFor(levelCount, update);
+        }
+        else
+        {
+            update(0, levelCount);
+        }
+        first = end;
+    }
+
+    for (uint32_t index : _changed)
+    {
+        _dirty[index] = 0;
+    }
+}
+
+void Scene::_updateWorld(uint32_t index, const std::vector<MeshRange> &ranges)
+{
+    // Translation * rotation * scale, without the matrix products.
+    glm::mat4 local = glm::mat4_cast(_rotations[index]);
+    local[0] *= _scales[index].x;
+    local[1] *= _scales[index].y;
+    local[2] *= _scales[index].z;
+    local[3] = glm::vec4(_positions[index], 1.0f);
+
+    uint32_t parent = _parents[index];
+    _models[index] = parent == NO_PARENT ? local : _models[parent] * local;
+    _bounds[index] = ranges[_meshes[index]].boundingSphere(_models[index]);
+}
+
+void Scene::updateBounds(const std::vector<MeshRange> &ranges)
+{
+    for (size_t i = 0; i < _models.size(); i++)
+    {
+        _bounds[i] = ranges[_meshes[i]].boundingSphere(_models[i]);
+    }
+}
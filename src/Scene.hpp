@@ -0,0 +1,147 @@
+#ifndef Scene_hpp
+#define Scene_hpp
+
+#include "common.hpp"
+#include "MeshPool.hpp"
+#include "ShaderVariant.hpp"
+
+class ThreadPool;
+
+// Slot of an entity and the generation it was created in. Once the entity
+// is destroyed the slot moves to the next generation and old handles to it
+// stop resolving. Default constructed, it is no entity.
+struct EntityHandle
+{
+    uint32_t index = ~0u;
+    uint32_t generation = 0;
+
+    bool operator==(const EntityHandle &other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const EntityHandle &other) const { return !(*this == other); }
+};
+
+enum EntityFlags : uint32_t
+{
+    // Rasterized by the software occlusion culling, never culled by it.
+    EntityOccluder = 1 << 0,
+};
+
+// Every entity of the scene, one dense array per component. Position i of
+// each array belongs to the same entity, so a pass only touches the arrays
+// it needs and walks them in order. Destroying moves the last entity into
+// the hole, handles go through a slot table to find where an entity is.
+//
+// Entities have a local transform relative to an optional parent. The
+// arrays are kept sorted by depth in the hierarchy, so parents come before
+// their children and each depth is one contiguous range. Moving an entity
+// marks it dirty, updateTransforms then recomputes the world matrices of
+// the dirty subtrees only, one depth at a time, in parallel within a depth.
+class Scene
+{
+public:
+    static const uint32_t NO_PARENT = ~0u;
+
+    Scene(){};
+    ~Scene(){};
+
+    EntityHandle create(const std::string &name, uint32_t mesh, EntityHandle parent = EntityHandle());
+    // Also destroys the children.
+    void destroy(EntityHandle entity);
+    void clear();
+    void reserve(size_t count);
+
+    bool isAlive(EntityHandle entity) const;
+    // Position in the dense arrays, moves when entities are destroyed or
+    // the hierarchy changes.
+    uint32_t indexOf(EntityHandle entity) const;
+    EntityHandle handleAt(uint32_t index) const;
+    size_t size() const { return _models.size(); }
+    // Changes whenever an entity is created, destroyed or moved in the
+    // dense arrays, so anything keyed by dense index knows to rebuild.
+    uint32_t layoutVersion() const { return _layoutVersion; }
+
+    // No entity to make it a root. The world matrix is kept until the next
+    // update, the local transform is not.
+    void setParent(EntityHandle entity, EntityHandle parent);
+    void setPosition(EntityHandle entity, const glm::vec3 &position);
+    void setRotation(EntityHandle entity, const glm::quat &rotation);
+    void setScale(EntityHandle entity, const glm::vec3 &scale);
+    void setMaterial(EntityHandle entity, uint32_t material) { _materials[indexOf(entity)] = material; }
+    void setFeatures(EntityHandle entity, uint32_t features) { _features[indexOf(entity)] = features; }
+    void setFlags(EntityHandle entity, uint32_t flags) { _flags[indexOf(entity)] = flags; }
+    const glm::mat4 &model(EntityHandle entity) const { return _models[indexOf(entity)]; }
+    const std::string &name(EntityHandle entity) const { return _names[indexOf(entity)]; }
+
+    // Reorders the arrays if the hierarchy changed, then recomputes world
+    // matrices and bounds of the dirty entities and their descendants. The
+    // pool may be null.
+    void updateTransforms(const std::vector<MeshRange> &ranges, ThreadPool *threadPool);
+    // Bounds of every entity from the current world matrices.
+    void updateBounds(const std::vector<MeshRange> &ranges);
+
+    // Dense indices whose world matrix changed in the last update, in order.
+    // Every entity when the arrays were reordered.
+    const std::vector<uint32_t> &changed() const { return _changed; }
+
+    // Dense arrays, size() long.
+    // World matrices, valid after updateTransforms.
+    const std::vector<glm::mat4> &models() const { return _models; }
+    // Center and radius, valid after updateTransforms.
+    const std::vector<glm::vec4> &bounds() const { return _bounds; }
+    // Index into the MeshPool.
+    const std::vector<uint32_t> &meshes() const { return _meshes; }
+    const std::vector<uint32_t> &materials() const { return _materials; }
+    // FragmentFeature flags, select the pipeline variant.
+    const std::vector<uint32_t> &features() const { return _features; }
+    // EntityFlags.
+    const std::vector<uint32_t> &flags() const { return _flags; }
+    // Dense index of the parent or NO_PARENT, valid after updateTransforms.
+    const std::vector<uint32_t> &parents() const { return _parents; }
+
+private:
+    struct Slot
+    {
+        uint32_t index;
+        uint32_t generation;
+    };
+
+    // Below this many entities in a depth the update stays on the caller.
+    static const size_t PARALLEL_MIN = 4096;
+
+    void _remove(uint32_t index);
+    void _sortHierarchy();
+    void _updateWorld(uint32_t index, const std::vector<MeshRange> &ranges);
+
+    // Local transforms.
+    std::vector<glm::vec3> _positions;
+    std::vector<glm::quat> _rotations;
+    std::vector<glm::vec3> _scales;
+    std::vector<uint8_t> _dirty;
+
+    std::vector<glm::mat4> _models;
+    std::vector<glm::vec4> _bounds;
+    std::vector<uint32_t> _meshes;
+    std::vector<uint32_t> _materials;
+    std::vector<uint32_t> _features;
+    std::vector<uint32_t> _flags;
+    // Only read by tools, kept apart from the per frame data.
+    std::vector<std::string> _names;
+    // Owning slot of each dense entry.
+    std::vector<uint32_t> _slotOf;
+
+    // Parent slots are the reference, dense parents and the depth ranges
+    // are derived from them when the hierarchy changed.
+    std::vector<uint32_t> _parentSlots;
+    std::vector<uint32_t> _parents;
+    std::vector<uint32_t> _childCounts;
+    // First dense index of each depth, then size().
+    std::vector<uint32_t> _levels;
+    bool _hierarchyChanged = false;
+    uint32_t _layoutVersion = 0;
+
+    std::vector<uint32_t> _changed;
+
+    std::vector<Slot> _slots;
+    std::vector<uint32_t> _freeSlots;
+};
+
+#endif
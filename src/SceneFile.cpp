@@ -0,0 +1,417 @@
+#include "SceneFile.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "ShaderVariant.hpp"
+
+namespace
+{
+const char MAGIC[4] = {'V', 'K', 'S', 'C'};
+
+uint32_t align4(size_t size)
+{
+    return static_cast<uint32_t>((size + 3) & ~size_t(3));
+}
+}
+
+const uint32_t SceneFile::NO_PARENT;
+const uint32_t SceneFile::VERSION;
+
+SceneFile::~SceneFile()
+{
+    clear();
+}
+
+void SceneFile::clear()
+{
+#ifndef _WIN32
+    if (_mapping != nullptr)
+    {
+        munmap(_mapping, _mappingSize);
+    }
+#endif
+    _mapping = nullptr;
+    _mappingSize = 0;
+    _image.clear();
+    _data = nullptr;
+    _size = 0;
+}
+
+void SceneFile::load(const std::string &path)
+{
+    clear();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open scene " + path + ".");
+    }
+
+    char magic[sizeof(MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    if (file.gcount() == sizeof(magic) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0)
+    {
+        file.close();
+        _map(path);
+    }
+    else
+    {
+        file.clear();
+        file.seekg(0);
+        std::stringstream text;
+        text << file.rdbuf();
+        _parseText(path, text.str());
+    }
+
+    _validate(path);
+}
+
+void SceneFile::save(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(_data, static_cast<std::streamsize>(_size));
+    if (!file)
+    {
+        throw std::runtime_error("Unable to write scene " + path + ".");
+    }
+}
+
+void SceneFile::_map(const std::string &path)
+{
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    size_t size = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+    _image.resize(align4(size) / sizeof(uint32_t));
+    file.read(reinterpret_cast<char *>(_image.data()), static_cast<std::streamsize>(size));
+    if (!file)
+    {
+        throw std::runtime_error("Unable to read scene " + path + ".");
+    }
+    _data = reinterpret_cast<const char *>(_image.data());
+    _size = size;
+#else
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("Unable to open scene " + path + ".");
+    }
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0)
+    {
+        close(descriptor);
+        throw std::runtime_error("Unable to read scene " + path + ".");
+    }
+
+    // Pages come in as the sections are first touched.
+    size_t size = static_cast<size_t>(status.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Unable to map scene " + path + ".");
+    }
+
+    _mapping = mapping;
+    _mappingSize = size;
+    _data = static_cast<const char *>(mapping);
+    _size = size;
+#endif
+}
+
+void SceneFile::_validate(const std::string &path) const
+{
+    auto fail = [&path](const std::string &reason) {
+        throw std::runtime_error("Unable to load scene " + path + ", " + reason + ".");
+    };
+
+    if (_size < sizeof(SceneFileHeader))
+    {
+        fail("shorter than its header");
+    }
+
+    const SceneFileHeader &header = _header();
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        fail("not a scene file");
+    }
+    if (header.version != VERSION)
+    {
+        fail("version " + std::to_string(header.version) + " instead of " + std::to_string(VERSION));
+    }
+    if (header.size != _size)
+    {
+        fail("truncated");
+    }
+
+    auto fits = [this](uint32_t offset, uint64_t count, size_t elementSize) {
+        return offset % 4 == 0 && offset + count * elementSize <= _size;
+    };
+    if (!fits(header.meshesOffset, header.meshCount, sizeof(uint32_t)) ||
+        !fits(header.texturesOffset, header.textureCount, sizeof(uint32_t)) ||
+        !fits(header.materialsOffset, header.materialCount, sizeof(SceneFileMaterial)) ||
+        !fits(header.instancesOffset, header.instanceCount, sizeof(SceneFileInstance)) ||
+        !fits(header.stringsOffset, header.stringsSize, 1))
+    {
+        fail("a section is outside the file");
+    }
+
+    // Every string ends inside the table once the last one does.
+    if (header.stringsSize == 0 || _data[header.stringsOffset + header.stringsSize - 1] != '\0')
+    {
+        fail("the string table is not terminated");
+    }
+
+    // Bounds checks only, the records are used as they are.
+    const uint32_t *meshes = _section<uint32_t>(header.meshesOffset);
+    for (uint32_t i = 0; i < header.meshCount; i++)
+    {
+        if (meshes[i] >= header.stringsSize)
+        {
+            fail("mesh " + std::to_string(i) + " has no path");
+        }
+    }
+
+    const uint32_t *textures = _section<uint32_t>(header.texturesOffset);
+    for (uint32_t i = 0; i < header.textureCount; i++)
+    {
+        if (textures[i] >= header.stringsSize)
+        {
+            fail("texture " + std::to_string(i) + " has no path");
+        }
+    }
+
+    const SceneFileMaterial *materials = _section<SceneFileMaterial>(header.materialsOffset);
+    for (uint32_t i = 0; i < header.materialCount; i++)
+    {
+        if (materials[i].texture >= header.textureCount)
+        {
+            fail("material " + std::to_string(i) + " uses a missing texture");
+        }
+    }
+
+    const SceneFileInstance *records = instances();
+    for (uint32_t i = 0; i < header.instanceCount; i++)
+    {
+        const SceneFileInstance &instance = records[i];
+        if (instance.name >= header.stringsSize || instance.mesh >= header.meshCount || instance.material >= header.materialCount)
+        {
+            fail("instance " + std::to_string(i) + " refers to a missing name, mesh or material");
+        }
+        if (instance.parent != NO_PARENT && instance.parent >= i)
+        {
+            fail("instance " + std::to_string(i) + " comes before its parent");
+        }
+    }
+}
+
+void SceneFile::_parseText(const std::string &path, const std::string &text)
+{
+    std::string strings;
+    auto addString = [&strings](const std::string &value) {
+        uint32_t offset = static_cast<uint32_t>(strings.size());
+        strings += value;
+        strings.push_back('\0');
+        return offset;
+    };
+
+    std::vector<uint32_t> meshes;
+    std::vector<uint32_t> textures;
+    std::vector<SceneFileMaterial> materials;
+    std::vector<SceneFileInstance> instances;
+    std::unordered_map<std::string, uint32_t> meshNames;
+    std::unordered_map<std::string, uint32_t> textureNames;
+    std::unordered_map<std::string, uint32_t> materialNames;
+    std::unordered_map<std::string, uint32_t> instanceNames;
+
+    std::istringstream lines(text);
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(lines, line))
+    {
+        lineNumber++;
+        auto fail = [&](const std::string &reason) {
+            throw std::runtime_error("Unable to parse " + path + ":" + std::to_string(lineNumber) + ", " + reason + ".");
+        };
+
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string keyword;
+        if (!(tokens >> keyword))
+        {
+            continue;
+        }
+
+        // Index of a name declared on an earlier line.
+        auto lookup = [&](const std::unordered_map<std::string, uint32_t> &names, const char *kind) {
+            std::string name;
+            if (!(tokens >> name))
+            {
+                fail(std::string("expected a ") + kind);
+            }
+            auto found = names.find(name);
+            if (found == names.end())
+            {
+                fail(std::string("unknown ") + kind + " " + name);
+            }
+            return found->second;
+        };
+
+        auto declare = [&](std::unordered_map<std::string, uint32_t> &names, uint32_t index) {
+            std::string name;
+            if (!(tokens >> name))
+            {
+                fail("expected a name");
+            }
+            if (!names.emplace(name, index).second)
+            {
+                fail(name + " is declared twice");
+            }
+            return name;
+        };
+
+        auto readVector = [&](float *values) {
+            if (!(tokens >> values[0] >> values[1] >> values[2]))
+            {
+                fail("expected three numbers");
+            }
+        };
+
+        if (keyword == "mesh" || keyword == "texture")
+        {
+            bool mesh = keyword == "mesh";
+            std::vector<uint32_t> &paths = mesh ? meshes : textures;
+            declare(mesh ? meshNames : textureNames, static_cast<uint32_t>(paths.size()));
+
+            std::string resource;
+            if (!(tokens >> resource))
+            {
+                fail("expected a path");
+            }
+            paths.push_back(addString(resource));
+        }
+        else if (keyword == "material")
+        {
+            declare(materialNames, static_cast<uint32_t>(materials.size()));
+
+            SceneFileMaterial material;
+            material.texture = lookup(textureNames, "texture");
+            material.features = FeaturesDefault;
+
+            std::string option;
+            while (tokens >> option)
+            {
+                if (option == "untextured")
+                {
+                    material.features &= ~FeatureTextured;
+                }
+                else if (option == "unlit")
+                {
+                    material.features &= ~FeatureLit;
+                }
+                else if (option == "alphatest")
+                {
+                    material.features |= FeatureAlphaTest;
+                }
+                else
+                {
+                    fail("unknown material option " + option);
+                }
+            }
+            materials.push_back(material);
+        }
+        else if (keyword == "instance")
+        {
+            SceneFileInstance instance = {};
+            instance.name = addString(declare(instanceNames, static_cast<uint32_t>(instances.size())));
+            instance.mesh = lookup(meshNames, "mesh");
+            instance.material = lookup(materialNames, "material");
+            instance.parent = NO_PARENT;
+            instance.rotation[3] = 1.0f;
+            instance.scale[0] = instance.scale[1] = instance.scale[2] = 1.0f;
+
+            std::string option;
+            while (tokens >> option)
+            {
+                if (option == "parent")
+                {
+                    instance.parent = lookup(instanceNames, "parent instance");
+                }
+                else if (option == "position")
+                {
+                    readVector(instance.position);
+                }
+                else if (option == "rotation")
+                {
+                    float degrees[3];
+                    readVector(degrees);
+                    glm::quat rotation(glm::radians(glm::vec3(degrees[0], degrees[1], degrees[2])));
+                    instance.rotation[0] = rotation.x;
+                    instance.rotation[1] = rotation.y;
+                    instance.rotation[2] = rotation.z;
+                    instance.rotation[3] = rotation.w;
+                }
+                else if (option == "scale")
+                {
+                    readVector(instance.scale);
+                }
+                else if (option == "occluder")
+                {
+                    instance.flags |= SceneFileOccluder;
+                }
+                else if (option == "spin")
+                {
+                    instance.flags |= SceneFileSpin;
+                }
+                else
+                {
+                    fail("unknown instance option " + option);
+                }
+            }
+            instances.push_back(instance);
+        }
+        else
+        {
+            fail("unknown declaration " + keyword);
+        }
+    }
+
+    // Laid out like the binary file, header then each section.
+    SceneFileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.textureCount = static_cast<uint32_t>(textures.size());
+    header.materialCount = static_cast<uint32_t>(materials.size());
+    header.instanceCount = static_cast<uint32_t>(instances.size());
+    header.meshesOffset = sizeof(SceneFileHeader);
+    header.texturesOffset = header.meshesOffset + header.meshCount * sizeof(uint32_t);
+    header.materialsOffset = header.texturesOffset + header.textureCount * sizeof(uint32_t);
+    header.instancesOffset = header.materialsOffset + header.materialCount * sizeof(SceneFileMaterial);
+    header.stringsOffset = header.instancesOffset + header.instanceCount * sizeof(SceneFileInstance);
+    header.stringsSize = static_cast<uint32_t>(strings.size());
+    header.size = header.stringsOffset + align4(strings.size());
+
+    _image.assign(header.size / sizeof(uint32_t), 0);
+    char *image = reinterpret_cast<char *>(_image.data());
+    std::memcpy(image, &header, sizeof(header));
+    std::memcpy(image + header.meshesOffset, meshes.data(), meshes.size() * sizeof(uint32_t));
+    std::memcpy(image + header.texturesOffset, textures.data(), textures.size() * sizeof(uint32_t));
+    std::memcpy(image + header.materialsOffset, materials.data(), materials.size() * sizeof(SceneFileMaterial));
+    std::memcpy(image + header.instancesOffset, instances.data(), instances.size() * sizeof(SceneFileInstance));
+    std::memcpy(image + header.stringsOffset, strings.data(), strings.size());
+
+    _data = image;
+    _size = header.size;
+}
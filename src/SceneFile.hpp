@@ -0,0 +1,122 @@
+#ifndef SceneFile_hpp
+#define SceneFile_hpp
+
+#include "common.hpp"
+
+// Binary layout, also what the text form is parsed into. Sections follow
+// the header, every reference is an index or an offset from the start of
+// the file, so the file is used in place wherever it is mapped. Little
+// endian, 4 byte aligned.
+struct SceneFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t size;
+
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t materialCount;
+    uint32_t instanceCount;
+
+    // Meshes and textures are string offsets, one uint32_t each.
+    uint32_t meshesOffset;
+    uint32_t texturesOffset;
+    uint32_t materialsOffset;
+    uint32_t instancesOffset;
+    // Null terminated strings, offsets into it are relative to its start.
+    uint32_t stringsOffset;
+    uint32_t stringsSize;
+};
+
+struct SceneFileMaterial
+{
+    uint32_t texture;
+    // FragmentFeature flags.
+    uint32_t features;
+};
+
+enum SceneFileInstanceFlags : uint32_t
+{
+    SceneFileOccluder = 1 << 0,
+    // Turns around its vertical axis.
+    SceneFileSpin = 1 << 1,
+};
+
+struct SceneFileInstance
+{
+    float position[3];
+    // x, y, z, w.
+    float rotation[4];
+    float scale[3];
+    uint32_t name;
+    uint32_t mesh;
+    uint32_t material;
+    // Earlier instance or NO_PARENT.
+    uint32_t parent;
+    uint32_t flags;
+};
+
+static_assert(sizeof(SceneFileHeader) == 52, "SceneFileHeader is part of the file format.");
+static_assert(sizeof(SceneFileMaterial) == 8, "SceneFileMaterial is part of the file format.");
+static_assert(sizeof(SceneFileInstance) == 60, "SceneFileInstance is part of the file format.");
+
+// Meshes, textures, materials and instances of a scene. The text form is
+// for authoring, one declaration per line:
+//
+//   mesh <name> <path>
+//   texture <name> <path>
+//   material <name> <texture> [untextured] [unlit] [alphatest]
+//   instance <name> <mesh> <material> [parent <instance>]
+//       [position x y z] [rotation x y z] [scale x y z] [occluder] [spin]
+//
+// Rotations are Euler angles in degrees, parents are declared before their
+// children. The binary form is compiled from it with save() and mapped
+// as is by load(), checked once but never parsed per instance.
+class SceneFile
+{
+public:
+    static const uint32_t NO_PARENT = ~0u;
+    static const uint32_t VERSION = 1;
+
+    SceneFile(){};
+    ~SceneFile();
+
+    // Text or binary, told apart by the magic.
+    void load(const std::string &path);
+    // Always binary.
+    void save(const std::string &path) const;
+    void clear();
+
+    uint32_t meshCount() const { return _header().meshCount; }
+    const char *mesh(uint32_t index) const { return string(_section<uint32_t>(_header().meshesOffset)[index]); }
+    uint32_t textureCount() const { return _header().textureCount; }
+    const char *texture(uint32_t index) const { return string(_section<uint32_t>(_header().texturesOffset)[index]); }
+    uint32_t materialCount() const { return _header().materialCount; }
+    const SceneFileMaterial &material(uint32_t index) const { return _section<SceneFileMaterial>(_header().materialsOffset)[index]; }
+    uint32_t instanceCount() const { return _header().instanceCount; }
+    const SceneFileInstance *instances() const { return _section<SceneFileInstance>(_header().instancesOffset); }
+    const char *string(uint32_t offset) const { return _data + _header().stringsOffset + offset; }
+
+private:
+    SceneFile(SceneFile const &) = delete;
+    void operator=(SceneFile const &) = delete;
+
+    void _parseText(const std::string &path, const std::string &text);
+    void _map(const std::string &path);
+    // Throws unless every offset, index and string is inside the file.
+    void _validate(const std::string &path) const;
+
+    const SceneFileHeader &_header() const { return *reinterpret_cast<const SceneFileHeader *>(_data); }
+    template <typename T>
+    const T *_section(uint32_t offset) const { return reinterpret_cast<const T *>(_data + offset); }
+
+    // Built from the text form, or the file read whole without mmap.
+    std::vector<uint32_t> _image;
+    void *_mapping = nullptr;
+    size_t _mappingSize = 0;
+
+    const char *_data = nullptr;
+    size_t _size = 0;
+};
+
+#endif
@@ -0,0 +1,8 @@
+#include "ShaderVariant.hpp"
+
+// Out of line definitions, the maps are referenced by address.
+constexpr size_t SpecializationLayout<FragmentFeatures>::count;
+constexpr VkSpecializationMapEntry SpecializationLayout<FragmentFeatures>::entries[];
+
+constexpr size_t SpecializationLayout<CullFeatures>::count;
+constexpr VkSpecializationMapEntry SpecializationLayout<CullFeatures>::entries[];
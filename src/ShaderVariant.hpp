@@ -0,0 +1,133 @@
+#ifndef ShaderVariant_hpp
+#define ShaderVariant_hpp
+
+#include <cstddef>
+#include <cstring>
+
+#include "common.hpp"
+
+// Describes how the members of T map to `constant_id`s in a shader.
+// Specialize with a constexpr `entries` array next to the struct.
+template <typename T>
+struct SpecializationLayout;
+
+// Packed specialization constants for one shader stage. Stored by value in
+// PipelineState, so variants with equal constants share a pipeline.
+struct Specialization
+{
+    const VkSpecializationMapEntry *entries = nullptr;
+    uint32_t entryCount = 0;
+    uint32_t dataSize = 0;
+    std::array<uint8_t, 64> data{};
+
+    template <typename T>
+    static Specialization of(const T &constants)
+    {
+        static_assert(sizeof(T) <= sizeof(std::array<uint8_t, 64>), "Specialization constants don't fit.");
+
+        Specialization specialization;
+        specialization.entries = SpecializationLayout<T>::entries;
+        specialization.entryCount = static_cast<uint32_t>(SpecializationLayout<T>::count);
+        specialization.dataSize = static_cast<uint32_t>(sizeof(T));
+        memcpy(specialization.data.data(), &constants, sizeof(T));
+        return specialization;
+    }
+
+    bool empty() const { return entryCount == 0; }
+
+    // Points into this object, keep it alive until the pipeline is created.
+    VkSpecializationInfo info() const
+    {
+        VkSpecializationInfo specializationInfo = {};
+        specializationInfo.mapEntryCount = entryCount;
+        specializationInfo.pMapEntries = entries;
+        specializationInfo.dataSize = dataSize;
+        specializationInfo.pData = data.data();
+        return specializationInfo;
+    }
+
+    bool operator==(const Specialization &other) const
+    {
+        return entries == other.entries &&
+               entryCount == other.entryCount &&
+               dataSize == other.dataSize &&
+               memcmp(data.data(), other.data.data(), dataSize) == 0;
+    }
+};
+
+// Every entry has to lie inside T.
+constexpr bool specializationFits(const VkSpecializationMapEntry *entries, size_t count, size_t size)
+{
+    return count == 0 || (entries[0].offset + entries[0].size <= size && specializationFits(entries + 1, count - 1, size));
+}
+
+enum FragmentFeature
+{
+    FeatureTextured = 1 << 0,
+    FeatureLit = 1 << 1,
+    FeatureAlphaTest = 1 << 2,
+
+    FeaturesDefault = FeatureTextured | FeatureLit,
+};
+
+// Mirrors the constants at the top of shader.frag.
+struct FragmentFeatures
+{
+    VkBool32 textured = VK_TRUE;
+    VkBool32 lit = VK_TRUE;
+    VkBool32 alphaTest = VK_FALSE;
+    float lightColor[3] = {1.0f, 1.0f, 1.0f};
+    float ambient = 0.02f;
+    float alphaCutoff = 0.5f;
+
+    static FragmentFeatures fromFlags(uint32_t flags)
+    {
+        FragmentFeatures features;
+        features.textured = (flags & FeatureTextured) ? VK_TRUE : VK_FALSE;
+        features.lit = (flags & FeatureLit) ? VK_TRUE : VK_FALSE;
+        features.alphaTest = (flags & FeatureAlphaTest) ? VK_TRUE : VK_FALSE;
+        return features;
+    }
+};
+
+template <>
+struct SpecializationLayout<FragmentFeatures>
+{
+    static constexpr size_t count = 8;
+    static constexpr VkSpecializationMapEntry entries[count] = {
+        {0, offsetof(FragmentFeatures, textured), sizeof(VkBool32)},
+        {1, offsetof(FragmentFeatures, lit), sizeof(VkBool32)},
+        {2, offsetof(FragmentFeatures, alphaTest), sizeof(VkBool32)},
+        {3, offsetof(FragmentFeatures, lightColor) + 0 * sizeof(float), sizeof(float)},
+        {4, offsetof(FragmentFeatures, lightColor) + 1 * sizeof(float), sizeof(float)},
+        {5, offsetof(FragmentFeatures, lightColor) + 2 * sizeof(float), sizeof(float)},
+        {6, offsetof(FragmentFeatures, ambient), sizeof(float)},
+        {7, offsetof(FragmentFeatures, alphaCutoff), sizeof(float)},
+    };
+};
+
+static_assert(
+    specializationFits(SpecializationLayout<FragmentFeatures>::entries, SpecializationLayout<FragmentFeatures>::count, sizeof(FragmentFeatures)),
+    "FragmentFeatures specialization map is out of bounds.");
+
+// Mirrors the constants at the top of cull.comp.
+struct CullFeatures
+{
+    // Append visible draws behind a counter instead of zeroing culled ones.
+    VkBool32 compact = VK_TRUE;
+};
+
+template <>
+struct SpecializationLayout<CullFeatures>
+{
+    static constexpr size_t count = 1;
+    static constexpr VkSpecializationMapEntry entries[count] = {
+        {0, offsetof(CullFeatures, compact), sizeof(VkBool32)},
+    };
+};
+
+static_assert(
+    specializationFits(SpecializationLayout<CullFeatures>::entries, SpecializationLayout<CullFeatures>::count, sizeof(CullFeatures)),
+    "CullFeatures specialization map is out of bounds.");
+
+#endif
@@ -1,5 +1,11 @@
 #include "Swapchain.hpp"
 #include "VulkanUtilities.hpp"
+#include "Hash.hpp"
+#include "CpuProfiler.hpp"
+
+// G-buffer layout, see gbuffer.frag. Both are mandatory color attachment formats.
+static const VkFormat GBUFFER_ALBEDO_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+static const VkFormat GBUFFER_NORMAL_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
 
 Swapchain::Swapchain()
 {
@@ -19,10 +25,31 @@ void Swapchain::init(VkInstance &instance, VkSurfaceKHR &surface, const int widt
     VulkanUtilities::QueueFamilyIndices queues = VulkanUtilities::getGraphicsQueueFamilyIndex(physicalDevice, surface);
     std::set<uint32_t> queueIndices = queues.getIndices();
 
-    VkPhysicalDeviceFeatures deviceFeatures = {};
-    deviceFeatures.samplerAnisotropy = VK_TRUE;
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+    features = {};
+    features.samplerAnisotropy = VK_TRUE;
+    // Used by the GPU-driven path, which falls back when they are missing.
+    features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    features.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    // Frame counters, left out when missing.
+    features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+
+    std::vector<const char *> optionalExtensions;
+    if (VulkanUtilities::isDeviceExtensionSupported(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+    {
+        optionalExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+
+    VulkanUtilities::createLogicalDevice(physicalDevice, queueIndices, features, optionalExtensions, device);
+
+    if (!optionalExtensions.empty())
+    {
+        cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+    }
 
-    VulkanUtilities::createLogicalDevice(physicalDevice, queueIndices, deviceFeatures, device);
     // Retrieve references to the queues
     vkGetDeviceQueue(device, queues.graphicsFamily, 0, &graphicsQueue);
     vkGetDeviceQueue(device, queues.presentFamily, 0, &_presentQueue);
@@ -50,10 +77,14 @@ void Swapchain::setup(const int width, const int height)
     imageCount = parameters.imageCount;
     VulkanUtilities::createSwapchain(parameters, _surface, device, queues, _swapchain);
 
-    // Render pass.
-    createRenderPass();
+    // Render pass. It doesn't depend on the extent, so it outlives resizes and
+    // pipelines still compiling against it stay valid.
+    if (renderPass == VK_NULL_HANDLE)
+    {
+        createRenderPass();
+    }
 
-    VkFormat depthFormat = VulkanUtilities::findDepthFormat(physicalDevice);
+    depthFormat = VulkanUtilities::findDepthFormat(physicalDevice);
     VulkanUtilities::createDepthResources(
         _depthImage,
         _depthImageMemory,
@@ -64,6 +95,53 @@ void Swapchain::setup(const int width, const int height)
         device,
         physicalDevice);
 
+    // Only read by the lighting subpass, never stored. Without lazily
+    // allocated memory they are full size images, only made when used.
+    if (deferred)
+    {
+        VkImageUsageFlags gbufferUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        VulkanUtilities::createTransientAttachment(
+            _albedoImage,
+            _albedoImageMemory,
+            _albedoImageView,
+            parameters.extent,
+            GBUFFER_ALBEDO_FORMAT,
+            gbufferUsage,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            device,
+            physicalDevice);
+        VulkanUtilities::createTransientAttachment(
+            _normalImage,
+            _normalImageMemory,
+            _normalImageView,
+            parameters.extent,
+            GBUFFER_NORMAL_FORMAT,
+            gbufferUsage,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            device,
+            physicalDevice);
+    }
+
+    if (offscreen)
+    {
+        VulkanUtilities::createImage(
+            physicalDevice,
+            device,
+            parameters.extent.width,
+            parameters.extent.height,
+            parameters.surface.format,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _sceneColorImage,
+            _sceneColorImageMemory);
+        _sceneColorImageView = VulkanUtilities::createImageView(
+            _sceneColorImage,
+            parameters.surface.format,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            device);
+    }
+
     // Obtain presentable images from associated with the swapchain.
     vkGetSwapchainImagesKHR(device, _swapchain, &parameters.imageCount, nullptr);
     imageCount = parameters.imageCount;
@@ -82,12 +160,14 @@ void Swapchain::setup(const int width, const int height)
             device);
     }
 
-    // Create swapchain framebuffers.
+    // Create swapchain framebuffers. Offscreen, they all draw the scene
+    // color image and the present framebuffers own the swapchain images.
     _swapchainFramebuffers.resize(imageCount);
 
     for (size_t i = 0; i < imageCount; i++)
     {
-        std::array<VkImageView, 2> attachments = {_swapchainImageViews[i], _depthImageView};
+        VkImageView colorView = offscreen ? _sceneColorImageView : _swapchainImageViews[i];
+        std::array<VkImageView, 2> attachments = {colorView, _depthImageView};
 
         VkFramebufferCreateInfo framebufferInfo = {};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -103,6 +183,44 @@ void Swapchain::setup(const int width, const int height)
         }
     }
 
+    // Same images plus the G-buffer, in ATTACHMENT_* order.
+    _deferredFramebuffers.resize(deferred ? imageCount : 0);
+    for (size_t i = 0; i < _deferredFramebuffers.size(); i++)
+    {
+        VkImageView colorView = offscreen ? _sceneColorImageView : _swapchainImageViews[i];
+        std::array<VkImageView, 4> attachments = {colorView, _depthImageView, _albedoImageView, _normalImageView};
+
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = deferredRenderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
+        framebufferInfo.width = parameters.extent.width;
+        framebufferInfo.height = parameters.extent.height;
+        framebufferInfo.layers = 1;
+        if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &_deferredFramebuffers[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Unable to create deferred framebuffers.");
+        }
+    }
+
+    _presentFramebuffers.resize(offscreen ? imageCount : 0);
+    for (size_t i = 0; i < _presentFramebuffers.size(); i++)
+    {
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = presentRenderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &_swapchainImageViews[i];
+        framebufferInfo.width = parameters.extent.width;
+        framebufferInfo.height = parameters.extent.height;
+        framebufferInfo.layers = 1;
+        if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &_presentFramebuffers[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Unable to create present framebuffers.");
+        }
+    }
+
     // Create command buffers.
 
     _commandBuffers.resize(_swapchainFramebuffers.size());
@@ -122,6 +240,15 @@ void Swapchain::clean()
 {
     unset();
 
+    vkDestroyRenderPass(device, renderPass, nullptr);
+    vkDestroyRenderPass(device, resumeRenderPass, nullptr);
+    vkDestroyRenderPass(device, deferredRenderPass, nullptr);
+    vkDestroyRenderPass(device, presentRenderPass, nullptr);
+    renderPass = VK_NULL_HANDLE;
+    resumeRenderPass = VK_NULL_HANDLE;
+    deferredRenderPass = VK_NULL_HANDLE;
+    presentRenderPass = VK_NULL_HANDLE;
+
     for (size_t i = 0; i < _imageAvailableSemaphores.size(); i++)
     {
         vkDestroySemaphore(device, _imageAvailableSemaphores[i], nullptr);
@@ -139,9 +266,16 @@ void Swapchain::unset()
     {
         vkDestroyFramebuffer(device, _swapchainFramebuffers[i], nullptr);
     }
+    for (size_t i = 0; i < _deferredFramebuffers.size(); i++)
+    {
+        vkDestroyFramebuffer(device, _deferredFramebuffers[i], nullptr);
+    }
+    for (size_t i = 0; i < _presentFramebuffers.size(); i++)
+    {
+        vkDestroyFramebuffer(device, _presentFramebuffers[i], nullptr);
+    }
 
     vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(_commandBuffers.size()), _commandBuffers.data());
-    vkDestroyRenderPass(device, renderPass, nullptr);
 
     vkDestroyImageView(device, _depthImageView, nullptr);
     for (size_t i = 0; i < _swapchainImageViews.size(); i++)
@@ -150,6 +284,22 @@ void Swapchain::unset()
     }
     vkDestroyImage(device, _depthImage, nullptr);
     vkFreeMemory(device, _depthImageMemory, nullptr);
+
+    if (deferred)
+    {
+        vkDestroyImageView(device, _albedoImageView, nullptr);
+        vkDestroyImage(device, _albedoImage, nullptr);
+        vkFreeMemory(device, _albedoImageMemory, nullptr);
+        vkDestroyImageView(device, _normalImageView, nullptr);
+        vkDestroyImage(device, _normalImage, nullptr);
+        vkFreeMemory(device, _normalImageMemory, nullptr);
+    }
+    if (offscreen)
+    {
+        vkDestroyImageView(device, _sceneColorImageView, nullptr);
+        vkDestroyImage(device, _sceneColorImage, nullptr);
+        vkFreeMemory(device, _sceneColorImageMemory, nullptr);
+    }
     vkDestroySwapchainKHR(device, _swapchain, nullptr);
 }
 
@@ -189,7 +339,8 @@ void Swapchain::createRenderPass()
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // Offscreen, the present pass samples it.
+    colorAttachment.finalLayout = offscreen ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     VkAttachmentReference colorAttachmentRef = {};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -199,7 +350,8 @@ void Swapchain::createRenderPass()
     depthAttachment.format = VulkanUtilities::findDepthFormat(physicalDevice);
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // Kept for the Hi-Z pyramid and the resumed pass.
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -209,38 +361,265 @@ void Swapchain::createRenderPass()
     depthAttachmentRef.attachment = 1;
     depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-    // Subpass.
+    // Subpasses. The depth pre-pass fills the depth buffer alone so the main
+    // pass only shades visible fragments. It stays empty when disabled.
+    VkSubpassDescription depthSubpass = {};
+    depthSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    depthSubpass.colorAttachmentCount = 0;
+    depthSubpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    VkSubpassDescription mainSubpass = {};
+    mainSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    mainSubpass.colorAttachmentCount = 1;
+    mainSubpass.pColorAttachments = &colorAttachmentRef;
+    mainSubpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    std::array<VkSubpassDescription, 2> subpasses = {depthSubpass, mainSubpass};
+
+    // Dependencies.
+
+    std::array<VkSubpassDependency, 3> dependencies = {};
+
+    // The previous frame may still test against the shared depth image.
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = SUBPASS_DEPTH;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    // Color is first used by the main pass, after the image is acquired.
+    dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].dstSubpass = SUBPASS_MAIN;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = 0;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    // Main pass depth tests read what the pre-pass wrote.
+    dependencies[2].srcSubpass = SUBPASS_DEPTH;
+    dependencies[2].dstSubpass = SUBPASS_MAIN;
+    dependencies[2].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[2].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[2].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[2].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    // Render pass.
+    std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create render pass.");
+    }
+
+    // Same pass loading what the first one stored. Only load ops and layouts
+    // differ, so it stays compatible with the framebuffers and pipelines.
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[0].initialLayout = colorAttachment.finalLayout;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    // The pyramid build reads depth in between, the main pass writes it again.
+    dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &resumeRenderPass) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create render pass.");
+    }
+
+    // Pipelines only care about attachment formats and sample counts,
+    // so a pass recreated on resize can keep using the same pipelines.
+    renderPassKey = FNV_OFFSET_BASIS;
+    for (auto &attachment : attachments)
+    {
+        renderPassKey = hashCombine(renderPassKey, attachment.format);
+        renderPassKey = hashCombine(renderPassKey, attachment.samples);
+    }
+    renderPassKey = hashCombine(renderPassKey, renderPassInfo.subpassCount);
+
+    if (deferred)
+    {
+        _createDeferredRenderPass(colorAttachment, depthAttachment);
+    }
+    if (offscreen)
+    {
+        _createPresentRenderPass();
+    }
+}
+
+void Swapchain::_createPresentRenderPass()
+{
+    // Every pixel is written by the upscale.
+    VkAttachmentDescription colorAttachment = {};
+    colorAttachment.format = parameters.surface.format;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference colorRef = {};
+    colorRef.attachment = 0;
+    colorRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass = {};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-    subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-    // Dependencies.
+    subpass.pColorAttachments = &colorRef;
 
+    // After the image is acquired.
     VkSubpassDependency dependency = {};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
     dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     dependency.srcAccessMask = 0;
     dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
-    // Render pass.
-    std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachment;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
     renderPassInfo.dependencyCount = 1;
     renderPassInfo.pDependencies = &dependency;
 
-    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &presentRenderPass) != VK_SUCCESS)
     {
-        throw std::runtime_error("Unable to create render pass.");
+        throw std::runtime_error("Unable to create present render pass.");
     }
+
+    presentRenderPassKey = FNV_OFFSET_BASIS;
+    presentRenderPassKey = hashCombine(presentRenderPassKey, colorAttachment.format);
+    presentRenderPassKey = hashCombine(presentRenderPassKey, colorAttachment.samples);
+    presentRenderPassKey = hashCombine(presentRenderPassKey, renderPassInfo.subpassCount);
+}
+
+void Swapchain::_createDeferredRenderPass(VkAttachmentDescription colorAttachment, VkAttachmentDescription depthAttachment)
+{
+    // The lighting subpass covers every pixel.
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+    // Nothing reads depth after the pass.
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    // Cleared and dropped, on tilers they never leave tile memory.
+    VkAttachmentDescription albedoAttachment = {};
+    albedoAttachment.format = GBUFFER_ALBEDO_FORMAT;
+    albedoAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    albedoAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    albedoAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    albedoAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    albedoAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    albedoAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    albedoAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentDescription normalAttachment = albedoAttachment;
+    normalAttachment.format = GBUFFER_NORMAL_FORMAT;
+
+    std::array<VkAttachmentReference, 2> gbufferRefs = {};
+    gbufferRefs[0].attachment = ATTACHMENT_ALBEDO;
+    gbufferRefs[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    gbufferRefs[1].attachment = ATTACHMENT_NORMAL;
+    gbufferRefs[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthRef = {};
+    depthRef.attachment = ATTACHMENT_DEPTH;
+    depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorRef = {};
+    colorRef.attachment = ATTACHMENT_COLOR;
+    colorRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // Input attachment indices of deferred.frag.
+    std::array<VkAttachmentReference, 3> inputRefs = {};
+    inputRefs[0].attachment = ATTACHMENT_ALBEDO;
+    inputRefs[0].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    inputRefs[1].attachment = ATTACHMENT_NORMAL;
+    inputRefs[1].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    inputRefs[2].attachment = ATTACHMENT_DEPTH;
+    inputRefs[2].layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    VkSubpassDescription gbufferSubpass = {};
+    gbufferSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    gbufferSubpass.colorAttachmentCount = static_cast<uint32_t>(gbufferRefs.size());
+    gbufferSubpass.pColorAttachments = gbufferRefs.data();
+    gbufferSubpass.pDepthStencilAttachment = &depthRef;
+
+    VkSubpassDescription lightingSubpass = {};
+    lightingSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    lightingSubpass.inputAttachmentCount = static_cast<uint32_t>(inputRefs.size());
+    lightingSubpass.pInputAttachments = inputRefs.data();
+    lightingSubpass.colorAttachmentCount = 1;
+    lightingSubpass.pColorAttachments = &colorRef;
+
+    std::array<VkSubpassDescription, 2> subpasses = {gbufferSubpass, lightingSubpass};
+
+    std::array<VkSubpassDependency, 3> dependencies = {};
+
+    // The previous frame may still read the shared G-buffer and depth.
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = SUBPASS_GBUFFER;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    // Color is first written by the lighting pass, after the image is acquired.
+    dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].dstSubpass = SUBPASS_LIGHTING;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = 0;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    // Each pixel only reads its own G-buffer texel, so by region.
+    dependencies[2].srcSubpass = SUBPASS_GBUFFER;
+    dependencies[2].dstSubpass = SUBPASS_LIGHTING;
+    dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[2].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    std::array<VkAttachmentDescription, 4> attachments = {colorAttachment, depthAttachment, albedoAttachment, normalAttachment};
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &deferredRenderPass) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create deferred render pass.");
+    }
+
+    // Different attachments, so a different key from the forward pass.
+    deferredRenderPassKey = FNV_OFFSET_BASIS;
+    for (auto &attachment : attachments)
+    {
+        deferredRenderPassKey = hashCombine(deferredRenderPassKey, attachment.format);
+        deferredRenderPassKey = hashCombine(deferredRenderPassKey, attachment.samples);
+    }
+    deferredRenderPassKey = hashCombine(deferredRenderPassKey, renderPassInfo.subpassCount);
 }
 
 void Swapchain::resize(const int width, const int height)
@@ -258,16 +637,23 @@ void Swapchain::resize(const int width, const int height)
 VkResult Swapchain::run(VkRenderPassBeginInfo &info)
 {
     // Wait for current command buffer
-    vkWaitForFences(device, 1, &_inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    {
+        CpuScope scope("wait fence");
+        vkWaitForFences(device, 1, &_inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
 
     // Retrieve next image from swapchain
-    VkResult status = vkAcquireNextImageKHR(
-        device,
-        _swapchain,
-        std::numeric_limits<uint64_t>::max(),
-        _imageAvailableSemaphores[currentFrame],
-        VK_NULL_HANDLE,
-        &imageIndex);
+    VkResult status;
+    {
+        CpuScope scope("acquire");
+        status = vkAcquireNextImageKHR(
+            device,
+            _swapchain,
+            std::numeric_limits<uint64_t>::max(),
+            _imageAvailableSemaphores[currentFrame],
+            VK_NULL_HANDLE,
+            &imageIndex);
+    }
 
     if (status != VK_SUCCESS && status != VK_SUBOPTIMAL_KHR)
     {
@@ -285,6 +671,7 @@ VkResult Swapchain::run(VkRenderPassBeginInfo &info)
 
 VkResult Swapchain::commit()
 {
+    CpuScope scope("present");
     VkSemaphore signalSemaphores[] = {_renderFinishedSemaphores[currentFrame]};
     // Present on swap chain.
     VkPresentInfoKHR presentInfo = {};
@@ -4,6 +4,20 @@
 #include "common.hpp"
 #include "VulkanUtilities.hpp"
 
+// Subpasses of Swapchain::renderPass.
+static const uint32_t SUBPASS_DEPTH = 0;
+static const uint32_t SUBPASS_MAIN = 1;
+
+// Subpasses of Swapchain::deferredRenderPass.
+static const uint32_t SUBPASS_GBUFFER = 0;
+static const uint32_t SUBPASS_LIGHTING = 1;
+
+// Attachments of Swapchain::deferredRenderPass.
+static const uint32_t ATTACHMENT_COLOR = 0;
+static const uint32_t ATTACHMENT_DEPTH = 1;
+static const uint32_t ATTACHMENT_ALBEDO = 2;
+static const uint32_t ATTACHMENT_NORMAL = 3;
+
 class Swapchain
 {
 public:
@@ -25,12 +39,45 @@ public:
     VkSemaphore &getStartSemaphore() { return _imageAvailableSemaphores[currentFrame]; }
     VkSemaphore &getEndSemaphore() { return _renderFinishedSemaphores[currentFrame]; }
     VkFence &getFence() { return _inFlightFences[currentFrame]; }
+    const std::vector<VkImage> &getImages() const { return _swapchainImages; }
+    VkImage &getDepthImage() { return _depthImage; }
+    VkImageView &getDepthImageView() { return _depthImageView; }
+    VkImageView &getAlbedoImageView() { return _albedoImageView; }
+    VkImageView &getNormalImageView() { return _normalImageView; }
+    VkImage &getSceneColorImage() { return _sceneColorImage; }
+    VkImageView &getSceneColorImageView() { return _sceneColorImageView; }
+    // Recreated on resize, like the swapchain ones.
+    const std::vector<VkFramebuffer> &getDeferredFramebuffers() const { return _deferredFramebuffers; }
+    const std::vector<VkFramebuffer> &getPresentFramebuffers() const { return _presentFramebuffers; }
+
+    // Set before init. The scene then renders into an image of its own,
+    // which presentRenderPass scales into the swapchain image.
+    bool offscreen = false;
+    // Set before init. Creates the G-buffer, deferredRenderPass and its
+    // framebuffers, nothing of it otherwise.
+    bool deferred = false;
 
     VkPhysicalDevice physicalDevice;
     VkDevice device;
     VkQueue graphicsQueue;
     VkCommandPool commandPool;
-    VkRenderPass renderPass;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    // Compatible with renderPass, loads color and depth instead of clearing.
+    VkRenderPass resumeRenderPass = VK_NULL_HANDLE;
+    // G-buffer pass then a full screen lighting pass, both on chip, deferred only.
+    VkRenderPass deferredRenderPass = VK_NULL_HANDLE;
+    // Swapchain image alone, offscreen only.
+    VkRenderPass presentRenderPass = VK_NULL_HANDLE;
+    VkFormat depthFormat;
+    // Equal for render passes that are compatible with each other.
+    uint64_t renderPassKey = 0;
+    uint64_t deferredRenderPassKey = 0;
+    uint64_t presentRenderPassKey = 0;
+
+    // Enabled device features.
+    VkPhysicalDeviceFeatures features = {};
+    // VK_KHR_draw_indirect_count, null when the device lacks it.
+    PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
 
     VulkanUtilities::SwapchainParameters parameters;
 
@@ -39,6 +86,10 @@ public:
     uint32_t imageCount;
 
 private:
+    // Variant of the forward pass attachments, called by createRenderPass.
+    void _createDeferredRenderPass(VkAttachmentDescription colorAttachment, VkAttachmentDescription depthAttachment);
+    void _createPresentRenderPass();
+
     VkSwapchainKHR _swapchain;
     VkSurfaceKHR _surface;
     VkQueue _presentQueue;
@@ -53,6 +104,19 @@ private:
     VkDeviceMemory _depthImageMemory;
     VkImageView _depthImageView;
 
+    // G-buffer, transient.
+    VkImage _albedoImage = VK_NULL_HANDLE;
+    VkDeviceMemory _albedoImageMemory = VK_NULL_HANDLE;
+    VkImageView _albedoImageView = VK_NULL_HANDLE;
+    VkImage _normalImage = VK_NULL_HANDLE;
+    VkDeviceMemory _normalImageMemory = VK_NULL_HANDLE;
+    VkImageView _normalImageView = VK_NULL_HANDLE;
+
+    // Scene color when offscreen, at full size, the scene may only cover part of it.
+    VkImage _sceneColorImage = VK_NULL_HANDLE;
+    VkDeviceMemory _sceneColorImageMemory = VK_NULL_HANDLE;
+    VkImageView _sceneColorImageView = VK_NULL_HANDLE;
+
     // Swapchain images.
     std::vector<VkImage> _swapchainImages;
     std::vector<VkImageView> _swapchainImageViews;
@@ -60,6 +124,8 @@ private:
     // Buffers.
     std::vector<VkCommandBuffer> _commandBuffers;
     std::vector<VkFramebuffer> _swapchainFramebuffers;
+    std::vector<VkFramebuffer> _deferredFramebuffers;
+    std::vector<VkFramebuffer> _presentFramebuffers;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+
+#include "ThreadPool.hpp"
+#include "CpuProfiler.hpp"
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        _workers.emplace_back(&ThreadPool::_work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+
+    _taskAvailable.notify_all();
+
+    for (auto &worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(const std::function<void()> &task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push(task);
+    }
+
+    _taskAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this] { return _tasks.empty() && _running == 0; });
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t begin, size_t end)> &function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    struct Batch
+    {
+        size_t rangeCount;
+        size_t rangeSize;
+        std::atomic<size_t> next;
+        std::atomic<size_t> done;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    // Shared with helpers that may only start after the call returned.
+    auto batch = std::make_shared<Batch>();
+    batch->rangeCount = std::min(count, _workers.size() + 1);
+    batch->rangeSize = (count + batch->rangeCount - 1) / batch->rangeCount;
+    batch->next = 0;
+    batch->done = 0;
+
+    // A helper only touches `function` after claiming a range, and every
+    // range is finished before returning.
+    const auto *body = &function;
+    auto runRanges = [batch, body, count]() {
+        size_t range;
+        while ((range = batch->next++) < batch->rangeCount)
+        {
+            size_t begin = range * batch->rangeSize;
+            (*body)(begin, std::min(begin + batch->rangeSize, count));
+
+            if (++batch->done == batch->rangeCount)
+            {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                batch->finished.notify_all();
+            }
+        }
+    };
+
+    for (size_t i = 1; i < batch->rangeCount; i++)
+    {
+        submit(runRanges);
+    }
+
+    runRanges();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->finished.wait(lock, [&batch] { return batch->done == batch->rangeCount; });
+}
+
+void ThreadPool::_work()
+{
+    CpuProfiler::instance().setThreadName("worker");
+
+    while (true)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _taskAvailable.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+
+            if (_stopping && _tasks.empty())
+            {
+                return;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop();
+            _running++;
+        }
+
+        try
+        {
+            CpuScope scope("task");
+            task();
+        }
+        catch (const std::exception &e)
+        {
+            // Tasks report their own failures, this only keeps the worker alive.
+            std::cerr << "Worker task failed: " << e.what() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running--;
+
+            if (_tasks.empty() && _running == 0)
+            {
+                _idle.notify_all();
+            }
+        }
+    }
+}
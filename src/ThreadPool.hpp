@@ -0,0 +1,47 @@
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO of tasks.
+class ThreadPool
+{
+public:
+    // Zero picks one worker per hardware thread, minus the main thread.
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    void submit(const std::function<void()> &task);
+
+    // Blocks until the queue is empty and no task is running.
+    void wait();
+
+    // Splits [0, count) in at most size() + 1 ranges and blocks until all
+    // of them ran. The caller takes ranges too, so a pool busy with long
+    // tasks delays nothing.
+    void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)> &function);
+
+    size_t size() const { return _workers.size(); }
+
+private:
+    ThreadPool(ThreadPool const &) = delete;
+    void operator=(ThreadPool const &) = delete;
+
+    void _work();
+
+    std::vector<std::thread> _workers;
+    std::queue<std::function<void()>> _tasks;
+
+    std::mutex _mutex;
+    std::condition_variable _taskAvailable;
+    std::condition_variable _idle;
+    size_t _running = 0;
+    bool _stopping = false;
+};
+
+#endif
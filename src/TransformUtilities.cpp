@@ -0,0 +1,43 @@
+#include "TransformUtilities.hpp"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TRANSFORM_UTILITIES_SSE
+#endif
+
+void TransformUtilities::multiplyBatch(
+    const glm::mat4 &viewProjection,
+    const glm::mat4 *models,
+    glm::mat4 *out,
+    size_t count)
+{
+#ifdef TRANSFORM_UTILITIES_SSE
+    // Matrices are column major: out column j = sum over k of vp column k * model[j][k].
+    const float *vp = &viewProjection[0][0];
+    const __m128 vp0 = _mm_loadu_ps(vp + 0);
+    const __m128 vp1 = _mm_loadu_ps(vp + 4);
+    const __m128 vp2 = _mm_loadu_ps(vp + 8);
+    const __m128 vp3 = _mm_loadu_ps(vp + 12);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const float *model = &models[i][0][0];
+        float *result = &out[i][0][0];
+
+        for (int column = 0; column < 4; column++)
+        {
+            const float *m = model + column * 4;
+            __m128 sum = _mm_mul_ps(vp0, _mm_set1_ps(m[0]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(vp1, _mm_set1_ps(m[1])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(vp2, _mm_set1_ps(m[2])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(vp3, _mm_set1_ps(m[3])));
+            _mm_storeu_ps(result + column * 4, sum);
+        }
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i] = viewProjection * models[i];
+    }
+#endif
+}
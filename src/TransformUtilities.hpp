@@ -0,0 +1,18 @@
+#ifndef TransformUtilities_hpp
+#define TransformUtilities_hpp
+
+#include "common.hpp"
+
+class TransformUtilities
+{
+public:
+    // out[i] = viewProjection * models[i]. The left matrix stays in registers
+    // for the whole batch, SSE on x86 and plain glm elsewhere.
+    static void multiplyBatch(
+        const glm::mat4 &viewProjection,
+        const glm::mat4 *models,
+        glm::mat4 *out,
+        size_t count);
+};
+
+#endif
@@ -1,5 +1,8 @@
 #include <fstream>
+#include <cstring>
 #include "VulkanUtilities.hpp"
+#include "ApiCounters.hpp"
+#include "ThreadPool.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -15,6 +18,25 @@ VkDeviceSize VulkanUtilities::_minUniformBufferOffsetAlignment = 0;
 
 VkDebugUtilsMessengerEXT VulkanUtilities::_debugMessenger;
 
+bool VulkanUtilities::isDeviceExtensionSupported(const VkPhysicalDevice &device, const char *name)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+    for (const auto &extension : extensions)
+    {
+        if (strcmp(extension.extensionName, name) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool checkDeviceExtensionsSupport(VkPhysicalDevice device)
 {
     uint32_t extensionCount;
@@ -33,7 +55,7 @@ bool checkDeviceExtensionsSupport(VkPhysicalDevice device)
     return requiredExtensions.empty();
 }
 
-uint32_t findMemoryType(VkPhysicalDevice &physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+uint32_t VulkanUtilities::findMemoryType(VkPhysicalDevice &physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
     // This object will have to array fields:
     // - memoryTypes
@@ -54,7 +76,7 @@ uint32_t findMemoryType(VkPhysicalDevice &physicalDevice, uint32_t typeFilter, V
     throw std::runtime_error("Unable to find suitable memory type.");
 }
 
-bool hasStencilComponent(VkFormat format)
+bool VulkanUtilities::hasStencilComponent(VkFormat format)
 {
     return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
@@ -102,7 +124,7 @@ void VulkanUtilities::endSingleTimeCommands(
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    Counted::vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
     // Wait for a queue to finish executing its commands
     vkQueueWaitIdle(graphicsQueue);
 
@@ -317,6 +339,7 @@ void VulkanUtilities::createLogicalDevice(
     const VkPhysicalDevice physicalDevice,
     std::set<u_int32_t> &queuesIndices,
     VkPhysicalDeviceFeatures &deviceFeatures,
+    const std::vector<const char *> &optionalExtensions,
     VkDevice &device)
 {
     float queuePriority = 1.0f;
@@ -339,8 +362,12 @@ void VulkanUtilities::createLogicalDevice(
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    // Optional extensions are checked by the caller.
+    std::vector<const char *> extensions(deviceExtensions);
+    extensions.insert(extensions.end(), optionalExtensions.begin(), optionalExtensions.end());
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     if (enableValidationLayers)
     {
@@ -381,23 +408,23 @@ VulkanUtilities::SwapchainParameters VulkanUtilities::generateSwapchainParameter
     return params;
 };
 
-void VulkanUtilities::createVertexBuffer(
-    Mesh &mesh,
+void VulkanUtilities::createDeviceLocalBuffer(
+    const void *source,
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
     VkDevice &device,
-    VkBuffer &vertexBuffer,
     VkPhysicalDevice &physicalDevice,
-    VkDeviceMemory &vertexBufferMemory,
+    VkBuffer &buffer,
+    VkDeviceMemory &bufferMemory,
     VkCommandPool &commandPool,
     VkQueue &graphicsQueue)
 {
-    VkDeviceSize bufferSize = sizeof(mesh.vertices[0]) * mesh.vertices.size();
-
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
     VulkanUtilities::createBuffer(
         device,
         physicalDevice,
-        bufferSize,
+        size,
         // Such buffer can be used as source in a memory transfer operation.
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
@@ -405,26 +432,47 @@ void VulkanUtilities::createVertexBuffer(
         stagingBufferMemory);
 
     void *data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, mesh.vertices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+    Counted::vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+    memcpy(data, source, (size_t)size);
+    Counted::vkUnmapMemory(device, stagingBufferMemory);
 
     VulkanUtilities::createBuffer(
         device,
         physicalDevice,
-        bufferSize,
+        size,
         // Buffer can be used as destination in a memory transfer operation.
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
         // Property flag meaning the buffer is located in device local memory
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        vertexBuffer,
-        vertexBufferMemory);
+        buffer,
+        bufferMemory);
 
-    VulkanUtilities::copyBuffer(stagingBuffer, vertexBuffer, bufferSize, device, commandPool, graphicsQueue);
+    VulkanUtilities::copyBuffer(stagingBuffer, buffer, size, device, commandPool, graphicsQueue);
 
     // Destroying staging buffer object.
     vkDestroyBuffer(device, stagingBuffer, nullptr);
     vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
+void VulkanUtilities::createVertexBuffer(
+    Mesh &mesh,
+    VkDevice &device,
+    VkBuffer &vertexBuffer,
+    VkPhysicalDevice &physicalDevice,
+    VkDeviceMemory &vertexBufferMemory,
+    VkCommandPool &commandPool,
+    VkQueue &graphicsQueue)
+{
+    createDeviceLocalBuffer(
+        mesh.vertices.data(),
+        sizeof(mesh.vertices[0]) * mesh.vertices.size(),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        device,
+        physicalDevice,
+        vertexBuffer,
+        vertexBufferMemory,
+        commandPool,
+        graphicsQueue);
 };
 
 void VulkanUtilities::createBuffer(
@@ -474,39 +522,16 @@ void VulkanUtilities::createIndexBuffer(
     VkCommandPool &commandPool,
     VkQueue &graphicsQueue)
 {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    VulkanUtilities::createBuffer(
-        device,
-        physicalDevice,
-        bufferSize,
-        // Use buffer as a transfer source.
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer,
-        stagingBufferMemory);
-
-    void *data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    VulkanUtilities::createBuffer(
+    createDeviceLocalBuffer(
+        indices.data(),
+        sizeof(indices[0]) * indices.size(),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
         device,
         physicalDevice,
-        bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         indexBuffer,
-        indexBufferMemory);
-
-    VulkanUtilities::copyBuffer(stagingBuffer, indexBuffer, bufferSize, device, commandPool, graphicsQueue);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+        indexBufferMemory,
+        commandPool,
+        graphicsQueue);
 }
 
 void VulkanUtilities::transitionImageLayout(
@@ -654,9 +679,9 @@ void VulkanUtilities::createTextureImage(
     // Data is pointing to a pointer to the beginning
     // of the stagingBufferMemory
     void *data;
-    vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
+    Counted::vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
     memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(device, stagingBufferMemory);
+    Counted::vkUnmapMemory(device, stagingBufferMemory);
 
     // Here I just wrote pixels data into stagingBufferMemory
     // Now I need to clear original pixels
@@ -711,6 +736,156 @@ void VulkanUtilities::createTextureImage(
     vkFreeMemory(device, stagingBufferMemory, nullptr);
 }
 
+void VulkanUtilities::createTextureImages(
+    const std::vector<std::string> &paths,
+    ThreadPool *threadPool,
+    std::vector<VkImage> &textureImages,
+    std::vector<VkDeviceMemory> &textureImagesMemory,
+    VkQueue &graphicsQueue,
+    VkCommandPool &commandPool,
+    VkDevice &device,
+    VkPhysicalDevice &physicalDevice)
+{
+    struct Pixels
+    {
+        stbi_uc *data = nullptr;
+        int width = 0;
+        int height = 0;
+        VkDeviceSize offset = 0;
+    };
+
+    std::vector<Pixels> decoded(paths.size());
+    auto decode = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            int channels;
+            decoded[i].data = stbi_load(paths[i].c_str(), &decoded[i].width, &decoded[i].height, &channels, STBI_rgb_alpha);
+        }
+    };
+    if (threadPool != nullptr)
+    {
+        threadPool->parallelFor(paths.size(), decode);
+    }
+    else
+    {
+        decode(0, paths.size());
+    }
+
+    // Back to back in the staging buffer, RGBA8 keeps every offset aligned.
+    VkDeviceSize stagingSize = 0;
+    std::string failed;
+    for (size_t i = 0; i < decoded.size(); i++)
+    {
+        if (!decoded[i].data && failed.empty())
+        {
+            failed = paths[i];
+        }
+        decoded[i].offset = stagingSize;
+        stagingSize += static_cast<VkDeviceSize>(decoded[i].width) * decoded[i].height * 4;
+    }
+
+    if (!failed.empty() || stagingSize == 0)
+    {
+        for (auto &pixels : decoded)
+        {
+            stbi_image_free(pixels.data);
+        }
+        if (!failed.empty())
+        {
+            throw std::runtime_error("Unable to load texture " + failed + ".");
+        }
+        return;
+    }
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(
+        device,
+        physicalDevice,
+        stagingSize,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingBuffer,
+        stagingBufferMemory);
+
+    char *data;
+    Counted::vkMapMemory(device, stagingBufferMemory, 0, stagingSize, 0, reinterpret_cast<void **>(&data));
+    for (auto &pixels : decoded)
+    {
+        memcpy(data + pixels.offset, pixels.data, static_cast<size_t>(pixels.width) * pixels.height * 4);
+        stbi_image_free(pixels.data);
+    }
+    Counted::vkUnmapMemory(device, stagingBufferMemory);
+
+    textureImages.resize(decoded.size());
+    textureImagesMemory.resize(decoded.size());
+    std::vector<VkImageMemoryBarrier> barriers(decoded.size());
+    for (size_t i = 0; i < decoded.size(); i++)
+    {
+        createImage(
+            physicalDevice,
+            device,
+            static_cast<uint32_t>(decoded[i].width),
+            static_cast<uint32_t>(decoded[i].height),
+            VK_FORMAT_R8G8B8A8_UNORM,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            textureImages[i],
+            textureImagesMemory[i]);
+
+        VkImageMemoryBarrier &barrier = barriers[i];
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = textureImages[i];
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    }
+
+    // Every transition and copy in one submission.
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(commandPool, device);
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    for (size_t i = 0; i < decoded.size(); i++)
+    {
+        VkBufferImageCopy region = {};
+        region.bufferOffset = decoded[i].offset;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageExtent = {static_cast<uint32_t>(decoded[i].width), static_cast<uint32_t>(decoded[i].height), 1};
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, textureImages[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+
+    for (auto &barrier : barriers)
+    {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    endSingleTimeCommands(commandBuffer, graphicsQueue, commandPool, device);
+
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
 void VulkanUtilities::createImage(
     VkPhysicalDevice &physicalDevice,
     VkDevice &device,
@@ -721,7 +896,8 @@ void VulkanUtilities::createImage(
     VkImageUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory)
+    VkDeviceMemory &imageMemory,
+    uint32_t mipLevels)
 {
     // Set image object info
     VkImageCreateInfo imageInfo = {};
@@ -730,7 +906,7 @@ void VulkanUtilities::createImage(
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = format;
     imageInfo.tiling = tiling;
@@ -836,7 +1012,9 @@ VkImageView VulkanUtilities::createImageView(
     VkImage &image,
     VkFormat const &format,
     VkImageAspectFlags aspectFlags,
-    VkDevice &device)
+    VkDevice &device,
+    uint32_t baseMipLevel,
+    uint32_t levelCount)
 {
     VkImageView imageView;
 
@@ -846,8 +1024,8 @@ VkImageView VulkanUtilities::createImageView(
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+    viewInfo.subresourceRange.levelCount = levelCount;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -930,10 +1108,80 @@ VkFormat VulkanUtilities::findDepthFormat(VkPhysicalDevice &physicalDevice)
     return VulkanUtilities::findSupportedFormat(
         {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
         VK_IMAGE_TILING_OPTIMAL,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT,
         physicalDevice);
 }
 
+void VulkanUtilities::createTransientAttachment(
+    VkImage &image,
+    VkDeviceMemory &imageMemory,
+    VkImageView &imageView,
+    VkExtent2D &extent,
+    VkFormat format,
+    VkImageUsageFlags usage,
+    VkImageAspectFlags aspectFlags,
+    VkDevice &device,
+    VkPhysicalDevice &physicalDevice)
+{
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = extent.width;
+    imageInfo.extent.height = extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create transient attachment.");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    // Tile based GPUs keep the contents on chip and never back lazy memory,
+    // desktop GPUs don't have it and get regular device memory.
+    const VkMemoryPropertyFlags lazy = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    uint32_t memoryType = UINT32_MAX;
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        if ((memRequirements.memoryTypeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & lazy) == lazy)
+        {
+            memoryType = i;
+            break;
+        }
+    }
+
+    if (memoryType == UINT32_MAX)
+    {
+        memoryType = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to allocate transient attachment memory.");
+    }
+
+    vkBindImageMemory(device, image, imageMemory, 0);
+
+    imageView = createImageView(image, format, aspectFlags, device);
+}
+
 void VulkanUtilities::createDepthResources(
     VkImage &depthImage,
     VkDeviceMemory &depthImageMemory,
@@ -953,7 +1201,8 @@ void VulkanUtilities::createDepthResources(
         swapChainExtent.height,
         depthFormat,
         VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        // Sampled to build the Hi-Z pyramid, read by the deferred lighting subpass.
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         depthImage,
         depthImageMemory);
@@ -1159,3 +1408,31 @@ VkDeviceSize VulkanUtilities::nextOffset(size_t size)
 
     return size + _minUniformBufferOffsetAlignment - remainder;
 }
+
+VkDescriptorSetLayout VulkanUtilities::createDescriptorSetLayout(
+    VkDevice device,
+    const std::vector<VkDescriptorType> &types,
+    VkShaderStageFlags stages)
+{
+    std::vector<VkDescriptorSetLayoutBinding> bindings(types.size());
+    for (uint32_t i = 0; i < bindings.size(); i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = types[i];
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = stages;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    VkDescriptorSetLayout setLayout;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create descriptor set layout.");
+    }
+
+    return setLayout;
+}
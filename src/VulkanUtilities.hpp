@@ -3,6 +3,8 @@
 #include "MeshUtilities.hpp"
 #include "common.hpp"
 
+class ThreadPool;
+
 class VulkanUtilities
 {
 private:
@@ -42,15 +44,6 @@ public:
         uint32_t imageCount;
     };
 
-    struct ObjectInfo {
-        glm::mat4 model;
-    };
-
-    struct CameraInfo
-    {
-        glm::mat4 viewProjection;
-    };
-
     struct LightInfo
     {
         glm::vec3 direction;
@@ -62,10 +55,12 @@ public:
     static bool isDeviceSuitable(const VkPhysicalDevice &device, VkSurfaceKHR &surface);
     static VulkanUtilities::SwapchainSupportDetails querySwapchainSupport(const VkPhysicalDevice &device, VkSurfaceKHR &surface);
     static VulkanUtilities::QueueFamilyIndices getGraphicsQueueFamilyIndex(const VkPhysicalDevice &device, VkSurfaceKHR &surface);
+    static bool isDeviceExtensionSupported(const VkPhysicalDevice &device, const char *name);
     static void createLogicalDevice(
         const VkPhysicalDevice physicalDevice,
         std::set<u_int32_t> &queuesIndices,
         VkPhysicalDeviceFeatures &deviceFeatures,
+        const std::vector<const char *> &optionalExtensions,
         VkDevice &device);
     static VulkanUtilities::SwapchainParameters generateSwapchainParameters(
         VkPhysicalDevice &physicalDevice,
@@ -88,6 +83,18 @@ public:
         VkBuffer &buffer,
         VkDeviceMemory &bufferMemory);
 
+    // Uploads `source` through a staging buffer.
+    static void createDeviceLocalBuffer(
+        const void *source,
+        VkDeviceSize size,
+        VkBufferUsageFlags usage,
+        VkDevice &device,
+        VkPhysicalDevice &physicalDevice,
+        VkBuffer &buffer,
+        VkDeviceMemory &bufferMemory,
+        VkCommandPool &commandPool,
+        VkQueue &graphicsQueue);
+
     static void createVertexBuffer(
         Mesh &mesh,
         VkDevice &device,
@@ -125,6 +132,18 @@ public:
         VkDevice &device,
         VkPhysicalDevice &physicalDevice);
 
+    // Decodes every path on the pool, which may be null, then uploads them
+    // all through one staging buffer and one command buffer.
+    static void createTextureImages(
+        const std::vector<std::string> &paths,
+        ThreadPool *threadPool,
+        std::vector<VkImage> &textureImages,
+        std::vector<VkDeviceMemory> &textureImagesMemory,
+        VkQueue &graphicsQueue,
+        VkCommandPool &commandPool,
+        VkDevice &device,
+        VkPhysicalDevice &physicalDevice);
+
     static void createImage(
         VkPhysicalDevice &physicalDevice,
         VkDevice &device,
@@ -135,7 +154,8 @@ public:
         VkImageUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkImage &image,
-        VkDeviceMemory &imageMemory);
+        VkDeviceMemory &imageMemory,
+        uint32_t mipLevels = 1);
 
     static VkCommandBuffer beginSingleTimeCommands(VkCommandPool &commandPool, VkDevice &device);
 
@@ -163,11 +183,16 @@ public:
         VkCommandPool &commandPool,
         VkDevice &device);
 
+    // Index of a memory type allowed by `typeFilter` with all of `properties`.
+    static uint32_t findMemoryType(VkPhysicalDevice &physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
     static VkImageView createImageView(
         VkImage &image,
         VkFormat const &format,
         VkImageAspectFlags aspectFlags,
-        VkDevice &device);
+        VkDevice &device,
+        uint32_t baseMipLevel = 0,
+        uint32_t levelCount = 1);
 
     static void createTextureImageView(
         VkImageView &textureImageView,
@@ -186,6 +211,19 @@ public:
         VkDevice &device,
         VkPhysicalDevice &physicalDevice);
 
+    // Attachment that only lives inside a render pass, backed by lazily
+    // allocated memory where the device has it.
+    static void createTransientAttachment(
+        VkImage &image,
+        VkDeviceMemory &imageMemory,
+        VkImageView &imageView,
+        VkExtent2D &extent,
+        VkFormat format,
+        VkImageUsageFlags usage,
+        VkImageAspectFlags aspectFlags,
+        VkDevice &device,
+        VkPhysicalDevice &physicalDevice);
+
     static VkFormat findSupportedFormat(
         const std::vector<VkFormat> &candidates,
         VkImageTiling tiling,
@@ -194,6 +232,8 @@ public:
 
     static VkFormat findDepthFormat(VkPhysicalDevice &physicalDevice);
 
+    static bool hasStencilComponent(VkFormat format);
+
     static bool checkValidationLayerSupport(std::vector<const char *> validationLayers);
 
     static void createInstance(VkInstance &instance, bool debugEnabled);
@@ -209,4 +249,10 @@ public:
         VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
 
     static VkDeviceSize nextOffset(size_t size);
+
+    // Binding i gets types[i].
+    static VkDescriptorSetLayout createDescriptorSetLayout(
+        VkDevice device,
+        const std::vector<VkDescriptorType> &types,
+        VkShaderStageFlags stages);
 };
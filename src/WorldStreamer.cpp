@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "WorldStreamer.hpp"
+#include "ApiCounters.hpp"
+#include "VulkanUtilities.hpp"
+
+void WorldStreamer::init(Swapchain &swapchain, const SceneFile &file, float cellSize, VkDeviceSize budget)
+{
+    _device = swapchain.device;
+    _file = &file;
+    _cellSize = cellSize;
+    _budget = budget;
+    _stopping = false;
+
+    _partition(file);
+    _meshes.resize(file.meshCount());
+    _stats.cells = static_cast<uint32_t>(_cells.size());
+
+    _io.reset(new ThreadPool(1));
+
+    uint32_t imageCount = swapchain.imageCount;
+    _stagingBuffers.resize(imageCount);
+    _stagingBuffersMemory.resize(imageCount);
+    _stagingData.resize(imageCount);
+    for (uint32_t i = 0; i < imageCount; i++)
+    {
+        VulkanUtilities::createBuffer(
+            _device,
+            swapchain.physicalDevice,
+            STAGING_SIZE,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _stagingBuffers[i],
+            _stagingBuffersMemory[i]);
+
+        Counted::vkMapMemory(_device, _stagingBuffersMemory[i], 0, STAGING_SIZE, 0, &_stagingData[i]);
+    }
+}
+
+void WorldStreamer::clean()
+{
+    // Queued reads are skipped, the one running finishes.
+    _stopping = true;
+    _io.reset();
+
+    for (size_t i = 0; i < _stagingBuffers.size(); i++)
+    {
+        Counted::vkUnmapMemory(_device, _stagingBuffersMemory[i]);
+        vkDestroyBuffer(_device, _stagingBuffers[i], nullptr);
+        vkFreeMemory(_device, _stagingBuffersMemory[i], nullptr);
+    }
+    _stagingBuffers.clear();
+    _stagingBuffersMemory.clear();
+    _stagingData.clear();
+
+    _cells.clear();
+    _meshes.clear();
+    _uploads.clear();
+    _results.clear();
+    _file = nullptr;
+}
+
+void WorldStreamer::_partition(const SceneFile &file)
+{
+    // Children go with their root, whose position is in world space.
+    const SceneFileInstance *instances = file.instances();
+    std::unordered_map<uint64_t, uint32_t> cellOfKey;
+    std::vector<uint32_t> cellOf(file.instanceCount());
+    std::vector<uint32_t> localIndex(file.instanceCount());
+
+    for (uint32_t i = 0; i < file.instanceCount(); i++)
+    {
+        const SceneFileInstance &instance = instances[i];
+        uint32_t cell;
+        if (instance.parent != SceneFile::NO_PARENT)
+        {
+            cell = cellOf[instance.parent];
+        }
+        else
+        {
+            int32_t x = static_cast<int32_t>(std::floor(instance.position[0] / _cellSize));
+            int32_t z = static_cast<int32_t>(std::floor(instance.position[2] / _cellSize));
+            uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+
+            auto found = cellOfKey.find(key);
+            if (found == cellOfKey.end())
+            {
+                found = cellOfKey.emplace(key, static_cast<uint32_t>(_cells.size())).first;
+                _cells.push_back(Cell());
+                _cells.back().x = x;
+                _cells.back().z = z;
+            }
+            cell = found->second;
+        }
+
+        Cell &target = _cells[cell];
+        cellOf[i] = cell;
+        localIndex[i] = static_cast<uint32_t>(target.instances.size());
+        target.instances.push_back(i);
+        target.parents.push_back(instance.parent == SceneFile::NO_PARENT ? SceneFile::NO_PARENT : localIndex[instance.parent]);
+        if (std::find(target.meshes.begin(), target.meshes.end(), instance.mesh) == target.meshes.end())
+        {
+            target.meshes.push_back(instance.mesh);
+        }
+    }
+}
+
+void WorldStreamer::update(const glm::vec3 &position, double deltaTime, Scene &scene, MeshPool &meshes, const CreateEntity &create)
+{
+    if (_hasPosition && deltaTime > 0.0)
+    {
+        _velocity = (position - _position) / static_cast<float>(deltaTime);
+    }
+    _position = position;
+    _hasPosition = true;
+    glm::vec3 predicted = position + _velocity * LOOK_AHEAD;
+
+    _receive();
+
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> evictable;
+    for (uint32_t i = 0; i < _cells.size(); i++)
+    {
+        Cell &cell = _cells[i];
+        cell.distance = std::min(_distance(cell, position), _distance(cell, predicted));
+
+        if (cell.state != CellState::Unloaded && cell.distance > UNLOAD_DISTANCE)
+        {
+            _unloadCell(cell, scene, meshes);
+        }
+        else if (cell.state == CellState::Unloaded && cell.distance <= LOAD_DISTANCE)
+        {
+            candidates.push_back(i);
+        }
+        else if (cell.state == CellState::Resident && cell.distance > LOAD_DISTANCE)
+        {
+            evictable.push_back(i);
+        }
+    }
+
+    // Farthest first out of the hysteresis band, only when over budget.
+    std::sort(evictable.begin(), evictable.end(), [this](uint32_t a, uint32_t b) {
+        return _cells[a].distance > _cells[b].distance;
+    });
+    size_t evicted = 0;
+    for (; evicted < evictable.size() && _stats.residentBytes > _budget; evicted++)
+    {
+        _unloadCell(_cells[evictable[evicted]], scene, meshes);
+        _stats.evictions++;
+    }
+
+    // Under the budget but too fragmented for a mesh, one more until it fits.
+    if (_roomNeeded && evicted < evictable.size())
+    {
+        _unloadCell(_cells[evictable[evicted]], scene, meshes);
+        _stats.evictions++;
+    }
+    _roomNeeded = false;
+
+    uint32_t loading = 0;
+    for (const Cell &cell : _cells)
+    {
+        loading += cell.state == CellState::Loading ? 1 : 0;
+    }
+
+    // Nearest first, the budget is soft: a cell that starts under it may
+    // end a little over.
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+        return _cells[a].distance < _cells[b].distance;
+    });
+    for (size_t i = 0; i < candidates.size() && loading < MAX_LOADING_CELLS && _stats.residentBytes < _budget; i++)
+    {
+        _loadCell(_cells[candidates[i]]);
+        loading++;
+    }
+
+    // Meshes uploaded by the last frame are visible to this one.
+    _stats.residentCells = 0;
+    for (Cell &cell : _cells)
+    {
+        if (cell.state == CellState::Loading && _isReady(cell))
+        {
+            const SceneFileInstance *instances = _file->instances();
+            cell.entities.resize(cell.instances.size());
+            for (size_t i = 0; i < cell.instances.size(); i++)
+            {
+                uint32_t instance = cell.instances[i];
+                EntityHandle parent = cell.parents[i] == SceneFile::NO_PARENT ? EntityHandle() : cell.entities[cell.parents[i]];
+                cell.entities[i] = create(instance, _meshes[instances[instance].mesh].poolMesh, parent);
+            }
+            cell.state = CellState::Resident;
+            loading--;
+        }
+        _stats.residentCells += cell.state == CellState::Resident ? 1 : 0;
+    }
+    _stats.loadingCells = loading;
+}
+
+void WorldStreamer::_receive()
+{
+    std::vector<ReadResult> results;
+    {
+        std::lock_guard<std::mutex> lock(_resultsMutex);
+        results.swap(_results);
+    }
+
+    for (ReadResult &result : results)
+    {
+        StreamedMesh &mesh = _meshes[result.mesh];
+        if (!result.error.empty())
+        {
+            throw std::runtime_error("Unable to stream mesh " + std::string(_file->mesh(result.mesh)) + ": " + result.error);
+        }
+
+        // Every cell using it unloaded while it was read.
+        if (mesh.users == 0)
+        {
+            mesh.state = MeshState::Unloaded;
+            continue;
+        }
+
+        mesh.bytes = _meshBytes(result.data);
+        if (mesh.bytes > STAGING_SIZE)
+        {
+            throw std::runtime_error("Unable to stream mesh " + std::string(_file->mesh(result.mesh)) + ", larger than the staging buffer.");
+        }
+
+        mesh.data = std::move(result.data);
+        mesh.state = MeshState::Read;
+        _stats.residentBytes += mesh.bytes;
+        _uploads.push_back(result.mesh);
+    }
+}
+
+void WorldStreamer::_loadCell(Cell &cell)
+{
+    cell.state = CellState::Loading;
+    for (uint32_t index : cell.meshes)
+    {
+        StreamedMesh &mesh = _meshes[index];
+        mesh.users++;
+        if (mesh.state != MeshState::Unloaded)
+        {
+            continue;
+        }
+
+        mesh.state = MeshState::Reading;
+        std::string path = _file->mesh(index);
+        _io->submit([this, index, path]() {
+            if (_stopping)
+            {
+                return;
+            }
+
+            ReadResult result;
+            result.mesh = index;
+            try
+            {
+                MeshUtilities::loadMesh(path, result.data);
+            }
+            catch (const std::exception &e)
+            {
+                result.error = e.what();
+            }
+
+            std::lock_guard<std::mutex> lock(_resultsMutex);
+            _results.push_back(std::move(result));
+        });
+    }
+}
+
+void WorldStreamer::_unloadCell(Cell &cell, Scene &scene, MeshPool &meshes)
+{
+    // Children were created after their parents, from the back they are
+    // leaves when destroyed.
+    for (auto it = cell.entities.rbegin(); it != cell.entities.rend(); ++it)
+    {
+        if (scene.isAlive(*it))
+        {
+            scene.destroy(*it);
+        }
+    }
+    cell.entities.clear();
+
+    for (uint32_t mesh : cell.meshes)
+    {
+        _releaseMesh(mesh, meshes);
+    }
+    cell.state = CellState::Unloaded;
+}
+
+void WorldStreamer::_releaseMesh(uint32_t index, MeshPool &meshes)
+{
+    StreamedMesh &mesh = _meshes[index];
+    if (--mesh.users > 0)
+    {
+        return;
+    }
+
+    // A read one is dropped when it arrives.
+    if (mesh.state == MeshState::Read)
+    {
+        mesh.data = Mesh();
+        _stats.residentBytes -= mesh.bytes;
+        mesh.state = MeshState::Unloaded;
+    }
+    else if (mesh.state == MeshState::Resident)
+    {
+        // Frames still in flight may draw it. The upload reusing its ranges
+        // is ordered after them by the graph barrier on the pool buffers.
+        meshes.removeStreamed(mesh.poolMesh);
+        mesh.poolMesh = MeshPool::NO_MESH;
+        _stats.residentBytes -= mesh.bytes;
+        mesh.state = MeshState::Unloaded;
+    }
+}
+
+bool WorldStreamer::_isReady(const Cell &cell) const
+{
+    for (uint32_t mesh : cell.meshes)
+    {
+        if (_meshes[mesh].state != MeshState::Resident)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+float WorldStreamer::_distance(const Cell &cell, const glm::vec3 &position) const
+{
+    // From the cell border on the XZ plane, 0 inside.
+    float x = position.x / _cellSize;
+    float z = position.z / _cellSize;
+    float dx = std::max(std::max(static_cast<float>(cell.x) - x, x - static_cast<float>(cell.x + 1)), 0.0f);
+    float dz = std::max(std::max(static_cast<float>(cell.z) - z, z - static_cast<float>(cell.z + 1)), 0.0f);
+    return std::sqrt(dx * dx + dz * dz);
+}
+
+VkDeviceSize WorldStreamer::_meshBytes(const Mesh &mesh)
+{
+    return mesh.vertices.size() * (sizeof(Vertex) + sizeof(glm::vec3)) + mesh.indices.size() * sizeof(uint32_t);
+}
+
+MeshResources WorldStreamer::importResources(RenderGraph &graph, const MeshPool &meshes) const
+{
+    MeshResources resources;
+    resources.vertices = graph.importBuffer("mesh vertices", meshes.vertexBuffer);
+    resources.positions = graph.importBuffer("mesh positions", meshes.positionBuffer);
+    resources.indices = graph.importBuffer("mesh indices", meshes.indexBuffer);
+    return resources;
+}
+
+void WorldStreamer::addUploadPass(RenderGraph &graph, const MeshResources &resources, uint32_t imageIndex, MeshPool &meshes)
+{
+    _vertexRegions.clear();
+    _positionRegions.clear();
+    _indexRegions.clear();
+
+    uint8_t *staged = static_cast<uint8_t *>(_stagingData[imageIndex]);
+    VkDeviceSize used = 0;
+    // Meshes without room in the pool, they keep their place in the queue.
+    std::vector<uint32_t> waiting;
+    while (!_uploads.empty())
+    {
+        uint32_t index = _uploads.front();
+        StreamedMesh &mesh = _meshes[index];
+        if (mesh.state != MeshState::Read)
+        {
+            // Released while waiting.
+            _uploads.pop_front();
+            continue;
+        }
+
+        // The rest waits for the next frame.
+        if (used + mesh.bytes > STAGING_SIZE)
+        {
+            break;
+        }
+
+        // No free range large enough, smaller meshes may still fit and
+        // update evicts to make room.
+        uint32_t poolMesh = meshes.addStreamed(mesh.data);
+        if (poolMesh == MeshPool::NO_MESH)
+        {
+            waiting.push_back(index);
+            _uploads.pop_front();
+            _roomNeeded = true;
+            continue;
+        }
+
+        const MeshRange &range = meshes.range(poolMesh);
+        VkDeviceSize vertexOffset = static_cast<VkDeviceSize>(range.vertexOffset);
+
+        VkDeviceSize size = sizeof(Vertex) * mesh.data.vertices.size();
+        memcpy(staged + used, mesh.data.vertices.data(), size);
+        _vertexRegions.push_back({used, sizeof(Vertex) * vertexOffset, size});
+        used += size;
+
+        glm::vec3 *positions = reinterpret_cast<glm::vec3 *>(staged + used);
+        for (size_t i = 0; i < mesh.data.vertices.size(); i++)
+        {
+            positions[i] = mesh.data.vertices[i].pos;
+        }
+        size = sizeof(glm::vec3) * mesh.data.vertices.size();
+        _positionRegions.push_back({used, sizeof(glm::vec3) * vertexOffset, size});
+        used += size;
+
+        size = sizeof(uint32_t) * mesh.data.indices.size();
+        memcpy(staged + used, mesh.data.indices.data(), size);
+        _indexRegions.push_back({used, sizeof(uint32_t) * range.firstIndex, size});
+        used += size;
+
+        mesh.poolMesh = poolMesh;
+        mesh.data = Mesh();
+        mesh.state = MeshState::Resident;
+        _uploads.pop_front();
+    }
+    _uploads.insert(_uploads.begin(), waiting.begin(), waiting.end());
+
+    if (used == 0)
+    {
+        return;
+    }
+    _stats.uploadedBytes += used;
+
+    VkBuffer stagingBuffer = _stagingBuffers[imageIndex];
+    VkBuffer vertexBuffer = meshes.vertexBuffer;
+    VkBuffer positionBuffer = meshes.positionBuffer;
+    VkBuffer indexBuffer = meshes.indexBuffer;
+    RenderPassId pass = graph.addPass("stream meshes", [=](VkCommandBuffer commandBuffer) {
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, vertexBuffer, static_cast<uint32_t>(_vertexRegions.size()), _vertexRegions.data());
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, positionBuffer, static_cast<uint32_t>(_positionRegions.size()), _positionRegions.data());
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, indexBuffer, static_cast<uint32_t>(_indexRegions.size()), _indexRegions.data());
+    });
+    graph.write(pass, resources.vertices, ResourceUsage::TransferWrite);
+    graph.write(pass, resources.positions, ResourceUsage::TransferWrite);
+    graph.write(pass, resources.indices, ResourceUsage::TransferWrite);
+}
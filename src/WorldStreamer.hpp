@@ -0,0 +1,184 @@
+#ifndef WorldStreamer_hpp
+#define WorldStreamer_hpp
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "common.hpp"
+#include "MeshPool.hpp"
+#include "RenderGraph.hpp"
+#include "Scene.hpp"
+#include "SceneFile.hpp"
+#include "Swapchain.hpp"
+#include "ThreadPool.hpp"
+
+// Pool buffers imported into the frame graph, written by the upload pass
+// and read by every pass that draws.
+struct MeshResources
+{
+    RenderResource vertices;
+    RenderResource positions;
+    RenderResource indices;
+};
+
+// State after the last update.
+struct StreamingStats
+{
+    uint32_t cells = 0;
+    uint32_t residentCells = 0;
+    uint32_t loadingCells = 0;
+    // Streamed meshes loaded from disk, on the GPU or waiting for it.
+    VkDeviceSize residentBytes = 0;
+    // Since the start.
+    uint64_t uploadedBytes = 0;
+    uint32_t evictions = 0;
+};
+
+// Streams the instances of a scene file by square cells of the XZ plane
+// around the camera. Each cell lists the meshes its instances use. Their
+// files are read on a background I/O thread, then copied into the room
+// reserved in the MeshPool through a per frame staging buffer, at most
+// STAGING_SIZE bytes a frame, and the entities of a cell are created once
+// all its meshes are on the GPU. Nothing waits on the disk or the GPU.
+//
+// Cells load within LOAD_DISTANCE cells of the camera, or of where it will
+// be LOOK_AHEAD seconds later at its current velocity, and unload beyond
+// UNLOAD_DISTANCE, the band between the two keeps a cell on the border from
+// loading and unloading every frame. Over the memory budget the farthest
+// cells of that band go first, and no new cell starts loading. The same
+// happens one cell a frame while a mesh finds no free range large enough
+// in the fragmented pool room, even under the budget.
+class WorldStreamer
+{
+public:
+    // Creates the entity of a scene file instance, with its mesh in the pool.
+    typedef std::function<EntityHandle(uint32_t instance, uint32_t mesh, EntityHandle parent)> CreateEntity;
+
+    WorldStreamer(){};
+    ~WorldStreamer(){};
+
+    // The file is read as cells load and must stay mapped. `budget` is in
+    // bytes of streamed meshes.
+    void init(Swapchain &swapchain, const SceneFile &file, float cellSize, VkDeviceSize budget);
+    void clean();
+
+    // Once per frame before encode. Picks the cells to load and unload, and
+    // creates the entities of the cells whose meshes were uploaded.
+    void update(const glm::vec3 &position, double deltaTime, Scene &scene, MeshPool &meshes, const CreateEntity &create);
+
+    MeshResources importResources(RenderGraph &graph, const MeshPool &meshes) const;
+    // Copies meshes read since the last frame into the pool, before the
+    // passes that draw.
+    void addUploadPass(RenderGraph &graph, const MeshResources &resources, uint32_t imageIndex, MeshPool &meshes);
+
+    const StreamingStats &stats() const { return _stats; }
+
+private:
+    // In cells, from the cell border.
+    static constexpr float LOAD_DISTANCE = 1.0f;
+    static constexpr float UNLOAD_DISTANCE = 2.0f;
+    // Seconds.
+    static constexpr float LOOK_AHEAD = 1.0f;
+    // Bytes of each staging buffer, also the largest mesh.
+    static const VkDeviceSize STAGING_SIZE = 16 * 1024 * 1024;
+    // Cells waiting for the I/O thread at once, nearest first.
+    static const uint32_t MAX_LOADING_CELLS = 4;
+
+    enum class CellState
+    {
+        Unloaded,
+        Loading,
+        Resident,
+    };
+
+    struct Cell
+    {
+        int32_t x = 0;
+        int32_t z = 0;
+        CellState state = CellState::Unloaded;
+        // Scene file instances, parents before their children.
+        std::vector<uint32_t> instances;
+        // Position of each parent in `instances`, NO_PARENT for roots.
+        std::vector<uint32_t> parents;
+        // Scene file meshes the instances use, each once.
+        std::vector<uint32_t> meshes;
+        // Same order as instances, while resident.
+        std::vector<EntityHandle> entities;
+        // In cells, from the camera or its predicted position.
+        float distance = 0.0f;
+    };
+
+    enum class MeshState
+    {
+        Unloaded,
+        // Queued on the I/O thread.
+        Reading,
+        // In memory, waiting for room in the staging buffer.
+        Read,
+        Resident,
+    };
+
+    struct StreamedMesh
+    {
+        MeshState state = MeshState::Unloaded;
+        // Loading or resident cells that use it.
+        uint32_t users = 0;
+        uint32_t poolMesh = MeshPool::NO_MESH;
+        VkDeviceSize bytes = 0;
+        // While read.
+        Mesh data;
+    };
+
+    struct ReadResult
+    {
+        uint32_t mesh;
+        Mesh data;
+        std::string error;
+    };
+
+    void _partition(const SceneFile &file);
+    void _receive();
+    void _loadCell(Cell &cell);
+    void _unloadCell(Cell &cell, Scene &scene, MeshPool &meshes);
+    void _releaseMesh(uint32_t mesh, MeshPool &meshes);
+    bool _isReady(const Cell &cell) const;
+    float _distance(const Cell &cell, const glm::vec3 &position) const;
+
+    static VkDeviceSize _meshBytes(const Mesh &mesh);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    const SceneFile *_file = nullptr;
+    float _cellSize = 1.0f;
+    VkDeviceSize _budget = 0;
+
+    std::vector<Cell> _cells;
+    std::vector<StreamedMesh> _meshes;
+    // Read meshes in the order they arrived.
+    std::deque<uint32_t> _uploads;
+    // Set when a mesh didn't fit in the pool room, cleared by update.
+    bool _roomNeeded = false;
+    StreamingStats _stats;
+
+    glm::vec3 _position = glm::vec3(0.0f);
+    glm::vec3 _velocity = glm::vec3(0.0f);
+    bool _hasPosition = false;
+
+    // One worker, file reads never hold back the frame pool.
+    std::unique_ptr<ThreadPool> _io;
+    // Set by clean, queued reads then skip their file.
+    std::atomic<bool> _stopping{false};
+    std::mutex _resultsMutex;
+    std::vector<ReadResult> _results;
+
+    // Per frame data.
+    std::vector<VkBuffer> _stagingBuffers;
+    std::vector<VkDeviceMemory> _stagingBuffersMemory;
+    std::vector<void *> _stagingData;
+    std::vector<VkBufferCopy> _vertexRegions;
+    std::vector<VkBufferCopy> _positionRegions;
+    std::vector<VkBufferCopy> _indexRegions;
+};
+
+#endif
@@ -2,6 +2,8 @@
 #include "Swapchain.hpp"
 #include "Renderer.hpp"
 #include "Input.hpp"
+#include "SceneFile.hpp"
+#include "CpuProfiler.hpp"
 
 #ifdef NDEBUG
 bool enableValidationLayers = false;
@@ -13,6 +15,13 @@ bool enableValidationLayers = true;
 static const int WIDTH = 480;
 static const int HEIGHT = 480;
 static const int MAX_FRAMES_IN_FLIGHT = 2;
+// Seconds each frame advances during a replay, whatever it really took.
+static const double REPLAY_STEP = 1.0 / 60.0;
+// CPU trace captured with T.
+static const std::string TRACE_PATH = "./trace.json";
+static const uint32_t TRACE_FRAMES = 60;
+// Seconds between two updates of the counters in the window title.
+static const double OVERLAY_INTERVAL = 0.5;
 
 static const std::vector<const char *> validationLayers = {
     "VK_LAYER_KHRONOS_validation"};
@@ -32,6 +41,11 @@ static void mouseCallback(GLFWwindow *window, double xPos, double yPos)
     Input::instance().mouseMoveEvent(xPos, yPos);
 }
 
+static void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
+{
+    Input::instance().mouseButtonEvent(button, action);
+}
+
 class VulkanApp
 {
 private:
@@ -49,18 +63,63 @@ private:
     VkRenderPassBeginInfo renderPassInfo;
 
 public:
+    RendererSettings settings;
+    // Input events to save at exit, or to replay instead of the live ones.
+    std::string recordPath;
+    std::string replayPath;
+    // CPU trace of frames [traceFirst, traceFirst + traceFrames).
+    std::string tracePath;
+    uint32_t traceFirst = 0;
+    uint32_t traceFrames = 0;
+    bool traceKeyDown = false;
+
     void mainLoop()
     {
         double timer = glfwGetTime();
+        double overlayTimer = timer;
+        bool overlay = settings.counters == "overlay";
+        bool replaying = Input::instance().isReplaying();
+        std::vector<double> frameTimes;
 
         while (!glfwWindowShouldClose(window))
         {
-            Input::instance().update();
+            CpuProfiler::instance().endFrame();
+            CpuScope frame("frame");
+
             double currentTime = glfwGetTime();
             double frameTime = currentTime - timer;
             timer = currentTime;
+
+            // Replays advance by fixed steps, the same path on every run.
+            if (replaying)
+            {
+                frameTimes.push_back(frameTime);
+                if (Input::instance().replayFinished())
+                {
+                    break;
+                }
+                frameTime = REPLAY_STEP;
+            }
+
+            Input::instance().update(frameTime);
             renderer.update(frameTime);
 
+            // Toggled on press, not while held.
+            bool traceKey = Input::instance().pressed(Input::KeyT);
+            if (traceKey && !traceKeyDown)
+            {
+                CpuProfiler::instance().capture(TRACE_PATH, TRACE_FRAMES);
+            }
+            traceKeyDown = traceKey;
+
+            // No text rendering, the window title shows the counters.
+            if (overlay && currentTime - overlayTimer >= OVERLAY_INTERVAL)
+            {
+                std::string title = "Vulkan - " + renderer.frameCounters().summary();
+                glfwSetWindowTitle(window, title.c_str());
+                overlayTimer = currentTime;
+            }
+
             VkResult status = swapchain.run(renderPassInfo);
             if (status == VK_SUCCESS || status == VK_SUBOPTIMAL_KHR)
             {
@@ -90,13 +149,41 @@ public:
                 Input::instance().resizeEvent(width, height);
 
                 swapchain.resize(width, height);
-                renderer.resize(swapchain.renderPass, width, height);
+                renderer.resize(swapchain, width, height);
             }
 
             swapchain.step();
         }
 
         vkDeviceWaitIdle(swapchain.device);
+
+        if (replaying)
+        {
+            reportReplay(frameTimes);
+        }
+    }
+
+    // Wall clock frame times, the first one also counts the loading.
+    static void reportReplay(std::vector<double> frameTimes)
+    {
+        if (frameTimes.size() < 2)
+        {
+            return;
+        }
+        frameTimes.erase(frameTimes.begin());
+
+        double total = 0.0;
+        for (double frameTime : frameTimes)
+        {
+            total += frameTime;
+        }
+        std::sort(frameTimes.begin(), frameTimes.end());
+
+        std::cout << "Replay: " << frameTimes.size() << " frames in " << total << " s, "
+                  << 1000.0 * total / frameTimes.size() << " ms average, "
+                  << 1000.0 * frameTimes[frameTimes.size() / 2] << " ms median, "
+                  << 1000.0 * frameTimes[frameTimes.size() * 99 / 100] << " ms 99th percentile, "
+                  << 1000.0 * frameTimes.back() << " ms worst." << std::endl;
     }
 
     void cleanup()
@@ -130,6 +217,7 @@ public:
         glfwSetFramebufferSizeCallback(window, resizeCallback);
         glfwSetKeyCallback(window, keyCallback);
         glfwSetCursorPosCallback(window, mouseCallback);
+        glfwSetMouseButtonCallback(window, mouseButtonCallback);
     }
 
     void initVulkan()
@@ -150,26 +238,99 @@ public:
 
     void run()
     {
+        CpuProfiler::instance().setThreadName("main");
+        if (!tracePath.empty())
+        {
+            CpuProfiler::instance().capture(tracePath, traceFrames, traceFirst);
+        }
+
         createWindow();
         initVulkan();
 
+        swapchain.offscreen = settings.dynamicResolution;
+        swapchain.deferred = settings.deferred && !settings.gpuDriven;
         swapchain.init(instance, surface, width, height);
 
+        if (!replayPath.empty())
+        {
+            Input::instance().startReplay(replayPath);
+        }
+        if (!recordPath.empty())
+        {
+            Input::instance().startRecording();
+        }
         Input::instance().resizeEvent(width, height);
 
-        renderer.init(swapchain, width, height);
+        renderer.init(swapchain, width, height, settings);
 
         mainLoop();
         cleanup();
+
+        if (!recordPath.empty())
+        {
+            Input::instance().saveRecording(recordPath);
+        }
     }
 };
 
-int main()
+// Renderer flags, see RendererSettings::parseArgument, and:
+// --record <path>       save the input events at exit
+// --replay <path>       play recorded input at a fixed time step, then exit
+// --trace <path> <first frame> <frame count>  write a CPU trace of these frames, T traces the next 60
+static void parseArguments(int argc, char **argv, VulkanApp &app)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (app.settings.parseArgument(argc, argv, i))
+        {
+            continue;
+        }
+
+        std::string argument = argv[i];
+        if (argument == "--record" && i + 1 < argc)
+        {
+            app.recordPath = argv[++i];
+        }
+        else if (argument == "--replay" && i + 1 < argc)
+        {
+            app.replayPath = argv[++i];
+        }
+        else if (argument == "--trace" && i + 3 < argc)
+        {
+            app.tracePath = argv[++i];
+            app.traceFirst = static_cast<uint32_t>(std::stoul(argv[++i]));
+            app.traceFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else
+        {
+            std::cerr << "Ignoring unknown argument " << argument << "." << std::endl;
+        }
+    }
+}
+
+// --compile-scene <text> <binary>  compile a scene file and exit, without a window
+static void compileScene(const std::string &textPath, const std::string &binaryPath)
+{
+    SceneFile file;
+    file.load(textPath);
+    file.save(binaryPath);
+
+    std::cout << "Compiled " << file.instanceCount() << " instances into " << binaryPath << "." << std::endl;
+}
+
+int main(int argc, char **argv)
 {
     VulkanApp app;
 
     try
     {
+        if (argc == 4 && std::string(argv[1]) == "--compile-scene")
+        {
+            compileScene(argv[2], argv[3]);
+            return EXIT_SUCCESS;
+        }
+
+        parseArguments(argc, argv, app);
         app.run();
     }
     catch (const std::exception &e)
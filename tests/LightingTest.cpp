@@ -0,0 +1,73 @@
+// Light assignment of the CPU version of cluster.comp on the demo camera.
+
+#include "TestUtilities.hpp"
+#include "ClusterGrid.hpp"
+
+namespace
+{
+// Same as Camera.
+const float FOV = 65.0f;
+const float NEAR = 0.01f;
+const float FAR = 100.0f;
+
+ClusterGrid demoGrid()
+{
+    glm::mat4 projection = glm::perspective(glm::radians(FOV), 16.0f / 9.0f, NEAR, FAR);
+    projection[1][1] *= -1.0f;
+    return ClusterGrid::fromProjection(projection, NEAR, FAR);
+}
+
+// A light right in front of the camera lands in the center tiles of its
+// slice, not in the corners nor in the other slices.
+void testSingleLight(const ClusterGrid &grid)
+{
+    std::vector<glm::vec4> lights = {glm::vec4(0.0f, 0.0f, -5.0f, 0.1f)};
+    std::vector<ClusterRange> ranges;
+    std::vector<uint32_t> indices;
+    grid.assign(lights, ranges, indices);
+
+    uint32_t slice = grid.slice(5.0f);
+    EXPECT(ranges.size() == ClusterGrid::COUNT);
+    EXPECT(ranges[ClusterGrid::index(ClusterGrid::COUNT_X / 2, ClusterGrid::COUNT_Y / 2, slice)].count == 1);
+    EXPECT(ranges[ClusterGrid::index(0, 0, slice)].count == 0);
+    EXPECT(ranges[ClusterGrid::index(ClusterGrid::COUNT_X / 2, ClusterGrid::COUNT_Y / 2, slice - 2)].count == 0);
+}
+
+// Ranges cover the index list without overlapping, a light behind the
+// camera is in none of them.
+void testRanges(const ClusterGrid &grid)
+{
+    std::vector<glm::vec4> lights = {
+        glm::vec4(0.0f, 0.0f, -5.0f, 1.0f),
+        glm::vec4(2.0f, 1.0f, -20.0f, 4.0f),
+        glm::vec4(0.0f, 0.0f, 10.0f, 1.0f)};
+    std::vector<ClusterRange> ranges;
+    std::vector<uint32_t> indices;
+    grid.assign(lights, ranges, indices);
+
+    uint32_t covered = 0;
+    bool inside = true;
+    bool behind = false;
+    for (auto &range : ranges)
+    {
+        covered += range.count;
+        inside = inside && range.offset + range.count <= indices.size();
+        for (uint32_t i = range.offset; i < range.offset + range.count && i < indices.size(); i++)
+        {
+            behind = behind || indices[i] == 2;
+        }
+    }
+    EXPECT(covered == indices.size());
+    EXPECT(inside);
+    EXPECT(!behind);
+}
+}
+
+int main()
+{
+    ClusterGrid grid = demoGrid();
+    testSingleLight(grid);
+    testRanges(grid);
+
+    return testResult("lighting");
+}
@@ -0,0 +1,76 @@
+// A prop right behind a wall is culled, one in front of it or next to it
+// is not, with and without the thread pool.
+
+#include "TestUtilities.hpp"
+#include "OcclusionRasterizer.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+// Unit box standing on the origin, walls and props scale it.
+const glm::vec3 BOX_MIN(-0.5f, 0.0f, -0.5f);
+const glm::vec3 BOX_MAX(0.5f, 1.0f, 0.5f);
+
+struct Box
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+
+    Box()
+    {
+        for (int corner = 0; corner < 8; corner++)
+        {
+            positions.push_back(glm::vec3(
+                (corner & 1) ? BOX_MAX.x : BOX_MIN.x,
+                (corner & 2) ? BOX_MAX.y : BOX_MIN.y,
+                (corner & 4) ? BOX_MAX.z : BOX_MIN.z));
+        }
+
+        // Two triangles per face, corners indexed by their xyz bits.
+        const uint32_t faces[6][4] = {
+            {0, 2, 6, 4}, {1, 5, 7, 3}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 6, 7, 5}};
+        for (auto &face : faces)
+        {
+            uint32_t quad[6] = {face[0], face[1], face[2], face[0], face[2], face[3]};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+};
+
+glm::mat4 boxModel(const glm::vec3 &position, const glm::vec3 &size)
+{
+    return glm::scale(glm::translate(glm::mat4(1.0f), position), size);
+}
+
+void testWall(ThreadPool *pool)
+{
+    Box box;
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.5f, 2000.0f);
+    projection[1][1] *= -1.0f;
+    glm::mat4 viewProjection = projection * glm::lookAt(glm::vec3(0.0f, 1.8f, 0.0f), glm::vec3(0.0f, 1.8f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    OcclusionRasterizer rasterizer(128, 64);
+    rasterizer.clear();
+    rasterizer.addOccluder(box.positions.data(), box.indices.data(), box.indices.size(), viewProjection * boxModel(glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(10.0f, 20.0f, 1.0f)));
+    rasterizer.render(pool);
+
+    EXPECT(!rasterizer.isVisible(BOX_MIN, BOX_MAX, viewProjection * boxModel(glm::vec3(0.0f, 0.0f, -40.0f), glm::vec3(2.0f))));
+    EXPECT(rasterizer.isVisible(BOX_MIN, BOX_MAX, viewProjection * boxModel(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(2.0f))));
+    EXPECT(rasterizer.isVisible(BOX_MIN, BOX_MAX, viewProjection * boxModel(glm::vec3(15.0f, 0.0f, -40.0f), glm::vec3(2.0f))));
+
+    // Without occluders nothing is culled.
+    rasterizer.clear();
+    rasterizer.render(pool);
+    EXPECT(rasterizer.isVisible(BOX_MIN, BOX_MAX, viewProjection * boxModel(glm::vec3(0.0f, 0.0f, -40.0f), glm::vec3(2.0f))));
+}
+}
+
+int main()
+{
+    testWall(nullptr);
+
+    ThreadPool pool;
+    testWall(&pool);
+
+    return testResult("occlusion");
+}
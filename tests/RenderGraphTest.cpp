@@ -0,0 +1,232 @@
+// Pass culling, derived barriers and transient placement, without a
+// device: imported handles are made up and no memory is allocated.
+
+#include <algorithm>
+#include <random>
+
+#include "TestUtilities.hpp"
+#include "RenderGraph.hpp"
+
+namespace
+{
+const RenderGraph::Record NOTHING = [](VkCommandBuffer) {};
+
+VkBuffer fakeBuffer(uint64_t value)
+{
+    return (VkBuffer)(uintptr_t)value;
+}
+
+VkImage fakeImage(uint64_t value)
+{
+    return (VkImage)(uintptr_t)value;
+}
+
+bool contains(const std::string &text, const std::string &part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+// Passes that write nothing needed go, and so do earlier writes a later
+// pass overwrites.
+void testCulling()
+{
+    RenderGraph graph;
+    graph.reset(0);
+    RenderResource output = graph.importImage("output", fakeImage(1), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+    RenderResource unused = graph.importBuffer("unused", fakeBuffer(2));
+    RenderResource input = graph.importBuffer("input", fakeBuffer(3));
+    graph.markOutput(output);
+
+    RenderPassId overwritten = graph.addPass("overwritten", NOTHING);
+    graph.write(overwritten, output, ResourceUsage::ComputeWrite);
+    RenderPassId producer = graph.addPass("producer", NOTHING);
+    graph.write(producer, input, ResourceUsage::ComputeWrite);
+    RenderPassId orphan = graph.addPass("orphan", NOTHING);
+    graph.write(orphan, unused, ResourceUsage::ComputeWrite);
+    RenderPassId draw = graph.addPass("draw", NOTHING);
+    graph.read(draw, input, ResourceUsage::FragmentRead);
+    graph.attachment(draw, output, ResourceUsage::ColorAttachment, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    graph.compile();
+
+    EXPECT(graph.isCulled(overwritten));
+    EXPECT(!graph.isCulled(producer));
+    EXPECT(graph.isCulled(orphan));
+    EXPECT(!graph.isCulled(draw));
+    EXPECT(graph.stats().culled == 2);
+
+    // Loading the attachment depends on what was written before.
+    graph.reset(0);
+    output = graph.importImage("output", fakeImage(1), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+    graph.markOutput(output);
+    RenderPassId clear = graph.addPass("clear", NOTHING);
+    graph.write(clear, output, ResourceUsage::TransferWrite);
+    RenderPassId blend = graph.addPass("blend", NOTHING);
+    graph.attachment(blend, output, ResourceUsage::ColorAttachment, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    graph.compile();
+
+    EXPECT(!graph.isCulled(clear));
+    EXPECT(!graph.isCulled(blend));
+}
+
+// One barrier per dependency, none between readers once the write is
+// visible to them, and the state carries over to the next frame.
+void testBarriers()
+{
+    RenderGraph graph;
+    for (int frame = 0; frame < 2; frame++)
+    {
+        graph.reset(0);
+        RenderResource output = graph.importImage("output", fakeImage(1), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+        RenderResource lights = graph.importBuffer("lights", fakeBuffer(2));
+        RenderResource history = graph.importBuffer("history", fakeBuffer(3));
+        graph.markOutput(output);
+        graph.markOutput(history);
+
+        RenderPassId cull = graph.addPass("cull", NOTHING);
+        graph.write(cull, lights, ResourceUsage::ComputeWrite);
+        RenderPassId shade = graph.addPass("shade", NOTHING);
+        graph.read(shade, lights, ResourceUsage::FragmentRead);
+        graph.attachment(shade, output, ResourceUsage::ColorAttachment, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        RenderPassId overlay = graph.addPass("overlay", NOTHING);
+        graph.read(overlay, lights, ResourceUsage::FragmentRead);
+        graph.attachment(overlay, output, ResourceUsage::ColorAttachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        RenderPassId post = graph.addPass("post", NOTHING);
+        graph.read(post, output, ResourceUsage::ComputeSampled);
+        graph.write(post, lights, ResourceUsage::ComputeWrite);
+        graph.write(post, history, ResourceUsage::ComputeWrite);
+        graph.compile();
+
+        std::string description = graph.describe();
+        // The second frame waits for the previous one: cull for the lights
+        // post wrote, shade for the output post sampled.
+        EXPECT(contains(description, frame == 0 ? "cull\n" : "cull: compute -> compute\n"));
+        EXPECT(contains(description, frame == 0 ? "shade: compute -> fragment\n" : "shade: compute -> fragment|color\n"));
+        // Lights are visible already, the attachment waits for shade.
+        EXPECT(contains(description, "overlay: color -> color\n"));
+        // Output to shader read only, lights rewritten after the fragment reads.
+        EXPECT(contains(description, "post: fragment|color|compute -> compute, 1 transitions\n"));
+        EXPECT(graph.stats().transitions == 1);
+        EXPECT(graph.stats().barriers == (frame == 0 ? 3u : 4u));
+    }
+}
+
+// Transient lifetimes span the passes left after culling, images only
+// used by culled passes are not created.
+void testTransients()
+{
+    RenderGraph graph;
+    graph.reset(0);
+    RenderResource output = graph.importImage("output", fakeImage(1), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+    graph.markOutput(output);
+
+    TransientImageInfo info;
+    info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    info.extent = {64, 64};
+    info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    RenderResource used = graph.createImage("used", info);
+    RenderResource dropped = graph.createImage("dropped", info);
+
+    RenderPassId write = graph.addPass("write", NOTHING);
+    graph.attachment(write, used, ResourceUsage::ColorAttachment, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    RenderPassId debug = graph.addPass("debug", NOTHING);
+    graph.attachment(debug, dropped, ResourceUsage::ColorAttachment, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    RenderPassId resolve = graph.addPass("resolve", NOTHING);
+    graph.read(resolve, used, ResourceUsage::FragmentRead);
+    graph.attachment(resolve, output, ResourceUsage::ColorAttachment, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    graph.compile();
+
+    EXPECT(graph.isCulled(debug));
+    EXPECT(graph.stats().transientImages == 1);
+    EXPECT(contains(graph.describe(), "resolve: color -> fragment, 1 transitions\n"));
+}
+
+// Block of each request, checked against the plan's invariants.
+std::vector<uint32_t> checkPlan(const std::vector<AliasRequest> &requests, const std::vector<AliasBlock> &blocks)
+{
+    std::vector<uint32_t> blockOf(requests.size(), ~0u);
+    bool once = true;
+    bool fits = true;
+    bool disjoint = true;
+    for (uint32_t b = 0; b < blocks.size(); b++)
+    {
+        const AliasBlock &block = blocks[b];
+        for (uint32_t request : block.requests)
+        {
+            once = once && blockOf[request] == ~0u;
+            blockOf[request] = b;
+            // Every image is bound at offset 0 of its block.
+            fits = fits && requests[request].size <= block.size &&
+                   (requests[request].memoryTypeBits & block.memoryTypeBits) == block.memoryTypeBits &&
+                   block.memoryTypeBits != 0;
+            for (uint32_t other : block.requests)
+            {
+                disjoint = disjoint && (other == request ||
+                                        requests[other].lastPass < requests[request].firstPass ||
+                                        requests[request].lastPass < requests[other].firstPass);
+            }
+        }
+    }
+
+    EXPECT(once);
+    EXPECT(std::find(blockOf.begin(), blockOf.end(), ~0u) == blockOf.end());
+    EXPECT(fits);
+    EXPECT(disjoint);
+    return blockOf;
+}
+
+void testPlanAliases()
+{
+    // Largest first: a, c overlaps a, b fits after a, d needs other memory.
+    std::vector<AliasRequest> requests = {
+        {100, 0x1, 0, 1},
+        {50, 0x3, 2, 3},
+        {80, 0x1, 1, 2},
+        {10, 0x2, 5, 5}};
+    std::vector<AliasBlock> blocks = RenderGraph::planAliases(requests);
+    std::vector<uint32_t> blockOf = checkPlan(requests, blocks);
+
+    EXPECT(blocks.size() == 3);
+    EXPECT(blockOf[0] == blockOf[1]);
+    EXPECT(blockOf[2] != blockOf[0]);
+    EXPECT(blockOf[3] != blockOf[0] && blockOf[3] != blockOf[2]);
+    EXPECT(blocks[blockOf[0]].size == 100);
+    EXPECT(blocks[blockOf[0]].memoryTypeBits == 0x1);
+
+    // Random lifetimes keep the invariants, and images that never overlap
+    // all end up in one block.
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<uint32_t> passes(0, 20);
+    std::uniform_int_distribution<uint32_t> sizes(1, 1 << 20);
+    std::uniform_int_distribution<uint32_t> types(1, 7);
+    for (int round = 0; round < 100; round++)
+    {
+        std::vector<AliasRequest> random(20);
+        for (auto &request : random)
+        {
+            uint32_t first = passes(generator);
+            uint32_t last = passes(generator);
+            request = {sizes(generator), types(generator), std::min(first, last), std::max(first, last)};
+        }
+        checkPlan(random, RenderGraph::planAliases(random));
+    }
+
+    std::vector<AliasRequest> sequence;
+    for (uint32_t pass = 0; pass < 8; pass++)
+    {
+        sequence.push_back({1024u * (pass + 1), 0x1, pass, pass});
+    }
+    blocks = RenderGraph::planAliases(sequence);
+    EXPECT(blocks.size() == 1);
+    EXPECT(blocks[0].size == 8 * 1024);
+}
+}
+
+int main()
+{
+    testCulling();
+    testBarriers();
+    testTransients();
+    testPlanAliases();
+
+    return testResult("render graph");
+}
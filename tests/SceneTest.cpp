@@ -0,0 +1,64 @@
+// Generational handles and the transform hierarchy of Scene.
+
+#include "TestUtilities.hpp"
+#include "Scene.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+// Destroyed handles stop resolving, even once their slot is reused, and
+// the entity moved into the hole keeps its own.
+void testHandles()
+{
+    Scene scene;
+    EntityHandle first = scene.create("first", 0);
+    EntityHandle second = scene.create("second", 1);
+    EntityHandle third = scene.create("third", 2);
+
+    scene.destroy(first);
+    EntityHandle fourth = scene.create("fourth", 3);
+
+    EXPECT(!scene.isAlive(first));
+    EXPECT(fourth.index == first.index && fourth != first);
+    EXPECT(scene.indexOf(third) == 0 && scene.meshes()[0] == 2 && scene.name(third) == "third");
+    EXPECT(scene.indexOf(second) == 1 && scene.handleAt(2) == fourth);
+}
+
+// Children follow their parent, and go with it.
+void testHierarchy(ThreadPool *pool)
+{
+    Scene scene;
+    EntityHandle parent = scene.create("parent", 0);
+    EntityHandle child = scene.create("child", 0, parent);
+    EntityHandle grandchild = scene.create("grandchild", 0, child);
+    EntityHandle other = scene.create("other", 0);
+
+    scene.setPosition(parent, glm::vec3(1.0f, 0.0f, 0.0f));
+    scene.setPosition(child, glm::vec3(0.0f, 2.0f, 0.0f));
+    scene.setPosition(grandchild, glm::vec3(0.0f, 0.0f, 3.0f));
+    scene.updateTransforms(std::vector<MeshRange>(1), pool);
+
+    glm::vec4 position = scene.model(grandchild)[3];
+    EXPECT(position.x == 1.0f && position.y == 2.0f && position.z == 3.0f);
+
+    // Moving the parent again reaches the whole subtree.
+    scene.setPosition(parent, glm::vec3(-1.0f, 0.0f, 0.0f));
+    scene.updateTransforms(std::vector<MeshRange>(1), pool);
+    EXPECT(scene.model(grandchild)[3].x == -1.0f);
+
+    scene.destroy(parent);
+    EXPECT(!scene.isAlive(child) && !scene.isAlive(grandchild));
+    EXPECT(scene.isAlive(other) && scene.size() == 1);
+}
+}
+
+int main()
+{
+    testHandles();
+    testHierarchy(nullptr);
+
+    ThreadPool pool;
+    testHierarchy(&pool);
+
+    return testResult("scene");
+}
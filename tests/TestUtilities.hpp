@@ -0,0 +1,38 @@
+#ifndef TestUtilities_hpp
+#define TestUtilities_hpp
+
+#include <iostream>
+
+// Shared by the test executables. A failed expectation is printed and the
+// test keeps going, main returns testResult().
+#define EXPECT(condition) expect((condition), #condition, __FILE__, __LINE__)
+
+inline int &failureCount()
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline void expect(bool condition, const char *expression, const char *file, int line)
+{
+    if (!condition)
+    {
+        std::cerr << file << ":" << line << ": expected " << expression << std::endl;
+        failureCount()++;
+    }
+}
+
+// Exit code of the test executable.
+inline int testResult(const char *name)
+{
+    if (failureCount() > 0)
+    {
+        std::cerr << name << ": " << failureCount() << " failed." << std::endl;
+        return 1;
+    }
+
+    std::cout << name << ": passed." << std::endl;
+    return 0;
+}
+
+#endif